@@ -242,6 +242,7 @@ static void pulse_update(struct apu *apu);
 static void triangle_update(struct apu *apu);
 static void noise_update(struct apu *apu);
 static void dmc_update(struct apu *apu);
+static void apu_update_deadline(struct apu *apu);
 
 static struct mops apu_mops = {
 	.writeb = (writeb_t)apu_writeb
@@ -406,6 +407,9 @@ void ctrl_writeb(struct apu *apu, uint8_t b, address_t UNUSED(address))
 
 	/* Writing to this register clears the DMC interrupt flag. */
 	apu->r.stat.dmc_interrupt = 0;
+
+	/* DMC state might have changed */
+	apu_update_deadline(apu);
 }
 
 void seq_writeb(struct apu *apu, uint8_t b, address_t UNUSED(address))
@@ -414,7 +418,7 @@ void seq_writeb(struct apu *apu, uint8_t b, address_t UNUSED(address))
 	apu->r.seq.raw = b;
 
 	/* On a write the sequencer, the divider and sequencer are reset. */
-	apu->seq_clock.num_remaining_cycles = 0;
+	clock_schedule(&apu->seq_clock, current_cycle);
 	apu->seq_step = 0;
 
 	/* Clear frame interrupt flag upon setting the interrupt inhibit flag */
@@ -658,6 +662,17 @@ void dmc_update(struct apu *apu)
 	apu->dmc.counter--;
 }
 
+void apu_update_deadline(struct apu *apu)
+{
+	bool dmc_busy;
+
+	/* The main clock is only run when its registers are accessed, unless
+	the DMC is reading memory (which might get remapped) or interrupting
+	the CPU, in which case it has to run in lockstep with the CPU. */
+	dmc_busy = (apu->dmc.byte_count != 0) || apu->r.stat.dmc_interrupt;
+	clock_set_deadline(&apu->main_clock, dmc_busy ? 0 : CLOCK_NO_DEADLINE);
+}
+
 void apu_tick(struct apu *apu)
 {
 	float pulse1;
@@ -705,6 +720,9 @@ void apu_tick(struct apu *apu)
 
 	/* Always consume one cycle */
 	clock_consume(1);
+
+	/* Update deadline based on DMC state */
+	apu_update_deadline(apu);
 }
 
 void length_counter_tick(struct apu *apu)
@@ -956,6 +974,9 @@ void seq_tick(struct apu *apu)
 	bool l;
 	bool e;
 
+	/* Bring main clock up to date as channel units are updated below */
+	clock_catch_up(&apu->main_clock);
+
 	/* Get current frame sequencer step */
 	s = apu->seq_step;
 
@@ -1042,6 +1063,7 @@ bool apu_init(struct controller_instance *instance)
 	apu->main_region.area = res;
 	apu->main_region.mops = &apu_mops;
 	apu->main_region.data = apu;
+	apu->main_region.clock = &apu->main_clock;
 	memory_region_add(&apu->main_region);
 
 	/* Add control/status region */
@@ -1052,6 +1074,7 @@ bool apu_init(struct controller_instance *instance)
 	apu->ctrl_stat_region.area = res;
 	apu->ctrl_stat_region.mops = &ctrl_stat_mops;
 	apu->ctrl_stat_region.data = apu;
+	apu->ctrl_stat_region.clock = &apu->main_clock;
 	memory_region_add(&apu->ctrl_stat_region);
 
 	/* Add frame counter region */
@@ -1062,6 +1085,7 @@ bool apu_init(struct controller_instance *instance)
 	apu->seq_region.area = res;
 	apu->seq_region.mops = &seq_mops;
 	apu->seq_region.data = apu;
+	apu->seq_region.clock = &apu->main_clock;
 	memory_region_add(&apu->seq_region);
 
 	/* Add main clock */
@@ -1127,6 +1151,9 @@ void apu_reset(struct controller_instance *instance)
 	apu->triangle.len_counter_silenced = true;
 	apu->triangle.linear_counter_silenced = true;
 	apu->noise.len_counter_silenced = true;
+
+	/* Initialize main clock deadline */
+	apu_update_deadline(apu);
 }
 
 void apu_deinit(struct controller_instance *instance)
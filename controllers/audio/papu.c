@@ -993,6 +993,10 @@ void seq_tick(struct papu *papu)
 	7     -           Clock    -
 	--------------------------------
 	Rate  256 Hz      64 Hz    128 Hz */
+
+	/* Bring main clock up to date as channel units are updated below */
+	clock_catch_up(&papu->main_clock);
+
 	switch (papu->seq_step) {
 	case 0:
 	case 4:
@@ -1036,6 +1040,7 @@ bool papu_init(struct controller_instance *instance)
 	papu->region.area = res;
 	papu->region.mops = &papu_mops;
 	papu->region.data = papu;
+	papu->region.clock = &papu->main_clock;
 	memory_region_add(&papu->region);
 
 	/* Add wave RAM region */
@@ -1046,6 +1051,7 @@ bool papu_init(struct controller_instance *instance)
 	papu->wave_region.area = res;
 	papu->wave_region.mops = &ram_mops;
 	papu->wave_region.data = papu->wave_ram;
+	papu->wave_region.clock = &papu->main_clock;
 	memory_region_add(&papu->wave_region);
 
 	/* Add frame sequencer clock */
@@ -1064,6 +1070,7 @@ bool papu_init(struct controller_instance *instance)
 	papu->main_clock.data = papu;
 	papu->main_clock.tick = (clock_tick_t)papu_tick;
 	papu->main_clock.enabled = true;
+	papu->main_clock.sync_cycle = CLOCK_NO_DEADLINE;
 	clock_add(&papu->main_clock);
 
 	/* Initialize audio frontend */
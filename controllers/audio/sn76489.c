@@ -321,6 +321,7 @@ bool sn76489_init(struct controller_instance *instance)
 	sn76489->region.area = res;
 	sn76489->region.pops = &sn76489_pops;
 	sn76489->region.data = sn76489;
+	sn76489->region.clock = &sn76489->clock;
 	port_region_add(&sn76489->region);
 
 	/* Add clock */
@@ -332,6 +333,7 @@ bool sn76489_init(struct controller_instance *instance)
 	sn76489->clock.data = sn76489;
 	sn76489->clock.tick = (clock_tick_t)sn76489_tick;
 	sn76489->clock.enabled = true;
+	sn76489->clock.sync_cycle = CLOCK_NO_DEADLINE;
 	clock_add(&sn76489->clock);
 
 	/* Initialize audio frontend */
@@ -49,14 +49,20 @@ static void ram_en_writeb(struct mbc1 *mbc1, uint8_t b, address_t address);
 static void rom_low_writeb(struct mbc1 *mbc1, uint8_t b, address_t address);
 static void rom_high_writeb(struct mbc1 *mbc1, uint8_t b, address_t address);
 static void mode_sel_writeb(struct mbc1 *mbc1, uint8_t b, address_t address);
+static uint8_t *rom1_map(struct mbc1 *mbc1, address_t address, bool *writable);
+static uint8_t *extram_map(struct mbc1 *mbc1, address_t address,
+	bool *writable);
+static void remap(struct mbc1 *mbc1);
 
 static struct mops rom1_mops = {
-	.readb = (readb_t)rom1_readb
+	.readb = (readb_t)rom1_readb,
+	.map = (map_t)rom1_map
 };
 
 static struct mops extram_mops = {
 	.readb = (readb_t)extram_readb,
-	.writeb = (writeb_t)extram_writeb
+	.writeb = (writeb_t)extram_writeb,
+	.map = (map_t)extram_map
 };
 
 static struct mops ram_en_mops = {
@@ -124,6 +130,48 @@ void extram_writeb(struct mbc1 *mbc1, uint8_t b, address_t address)
 	mbc1->ram[offset] = b;
 }
 
+uint8_t *rom1_map(struct mbc1 *mbc1, address_t address, bool *writable)
+{
+	uint8_t rom_num;
+
+	/* Set ROM bank number (bits 5-6 depend on mode selection) */
+	rom_num = mbc1->rom_num_low;
+	if (mbc1->mode_sel == ROM_SELECT_MODE)
+		bitops_setb(&rom_num, 5, 2, mbc1->rom_num_high);
+
+	/* Leave page unmapped until a bank gets selected (on reset) */
+	*writable = false;
+	if (rom_num == 0)
+		return NULL;
+
+	/* Return ROM contents (skipping ROM0) */
+	return mbc1->rom + address + (rom_num - 1) * ROM_BANK_SIZE;
+}
+
+uint8_t *extram_map(struct mbc1 *mbc1, address_t address, bool *writable)
+{
+	uint8_t ram_num;
+
+	/* Keep using callbacks if RAM is disabled */
+	if (!mbc1->ram_enabled)
+		return NULL;
+
+	/* Set RAM bank number depending on mode selection */
+	ram_num = (mbc1->mode_sel == RAM_SELECT_MODE) ? mbc1->rom_num_high : 0;
+
+	/* Return RAM contents */
+	*writable = true;
+	return mbc1->ram + address + ram_num * RAM_BANK_SIZE;
+}
+
+void remap(struct mbc1 *mbc1)
+{
+	/* Update mapped ROM and RAM banks */
+	memory_region_remap(&mbc1->rom1_region);
+	if (mbc1->ram_size != 0)
+		memory_region_remap(&mbc1->extram_region);
+}
+
 void ram_en_writeb(struct mbc1 *mbc1, uint8_t b, address_t UNUSED(address))
 {
 	uint8_t ram_enable;
@@ -131,6 +179,7 @@ void ram_en_writeb(struct mbc1 *mbc1, uint8_t b, address_t UNUSED(address))
 	/* Any value with 0xOA in the lower 4 bits enables RAM */
 	ram_enable = bitops_getb(&b, 0, 4);
 	mbc1->ram_enabled = (ram_enable == 0x0A);
+	remap(mbc1);
 }
 
 void rom_low_writeb(struct mbc1 *mbc1, uint8_t b, address_t UNUSED(address))
@@ -141,18 +190,21 @@ void rom_low_writeb(struct mbc1 *mbc1, uint8_t b, address_t UNUSED(address))
 	/* MBC translates bank number 0 to 1 */
 	if (mbc1->rom_num_low == 0)
 		mbc1->rom_num_low = 1;
+	remap(mbc1);
 }
 
 void rom_high_writeb(struct mbc1 *mbc1, uint8_t b, address_t UNUSED(address))
 {
 	/* Set RAM or upper ROM bank number (register size is 2 bits) */
 	mbc1->rom_num_high = bitops_getb(&b, 0, 2);
+	remap(mbc1);
 }
 
 void mode_sel_writeb(struct mbc1 *mbc1, uint8_t b, address_t UNUSED(address))
 {
 	/* Set mode selection (register size is 1 bit) */
 	mbc1->mode_sel = bitops_getb(&b, 0, 1);
+	remap(mbc1);
 }
 
 bool mbc1_init(struct controller_instance *instance)
@@ -279,6 +331,7 @@ void mbc1_reset(struct controller_instance *instance)
 	mbc1->rom_num_high = 0;
 	mbc1->ram_enabled = false;
 	mbc1->mode_sel = ROM_SELECT_MODE;
+	remap(mbc1);
 }
 
 void mbc1_deinit(struct controller_instance *instance)
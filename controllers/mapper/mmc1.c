@@ -82,23 +82,31 @@ static uint8_t prg_rom_readb(struct mmc1 *mmc1, address_t address);
 static uint16_t prg_rom_readw(struct mmc1 *mmc1, address_t address);
 static uint8_t chr_rom_readb(struct mmc1 *mmc1, address_t address);
 static uint16_t chr_rom_readw(struct mmc1 *mmc1, address_t address);
+static uint8_t *vram_map(struct mmc1 *mmc1, address_t address, bool *writable);
+static uint8_t *prg_rom_map(struct mmc1 *mmc1, address_t address,
+	bool *writable);
+static uint8_t *chr_rom_map(struct mmc1 *mmc1, address_t address,
+	bool *writable);
 static void load_writeb(struct mmc1 *mmc1, uint8_t b, address_t a);
 
 static struct mops vram_mops = {
 	.readb = (readb_t)vram_readb,
 	.readw = (readw_t)vram_readw,
 	.writeb = (writeb_t)vram_writeb,
-	.writew = (writew_t)vram_writew
+	.writew = (writew_t)vram_writew,
+	.map = (map_t)vram_map
 };
 
 static struct mops prg_rom_mops = {
 	.readb = (readb_t)prg_rom_readb,
-	.readw = (readw_t)prg_rom_readw
+	.readw = (readw_t)prg_rom_readw,
+	.map = (map_t)prg_rom_map
 };
 
 static struct mops chr_rom_mops = {
 	.readb = (readb_t)chr_rom_readb,
-	.readw = (readw_t)chr_rom_readw
+	.readw = (readw_t)chr_rom_readw,
+	.map = (map_t)chr_rom_map
 };
 
 static struct mops load_mops = {
@@ -241,6 +249,39 @@ uint16_t chr_rom_readw(struct mmc1 *mmc1, address_t address)
 	return rom_mops.readw(mmc1->chr_rom, address);
 }
 
+uint8_t *vram_map(struct mmc1 *mmc1, address_t address, bool *writable)
+{
+	mirror_address(mmc1, &address);
+	*writable = true;
+
+	/* Leave page unmapped until VRAM gets set (on init) */
+	if (!mmc1->vram)
+		return NULL;
+	return mmc1->vram + address;
+}
+
+uint8_t *prg_rom_map(struct mmc1 *mmc1, address_t address, bool *writable)
+{
+	remap_prg_rom(mmc1, &address);
+	*writable = false;
+
+	/* Leave page unmapped until PRG ROM gets set (on init) */
+	if (!mmc1->prg_rom)
+		return NULL;
+	return mmc1->prg_rom + address;
+}
+
+uint8_t *chr_rom_map(struct mmc1 *mmc1, address_t address, bool *writable)
+{
+	remap_chr_rom(mmc1, &address);
+	*writable = false;
+
+	/* Leave page unmapped until CHR ROM gets set (on init) */
+	if (!mmc1->chr_rom)
+		return NULL;
+	return mmc1->chr_rom + address;
+}
+
 void load_writeb(struct mmc1 *mmc1, uint8_t b, address_t address)
 {
 	union load load;
@@ -284,16 +325,22 @@ void load_writeb(struct mmc1 *mmc1, uint8_t b, address_t address)
 	switch (reg) {
 	case 0:
 		mmc1->control.raw = data;
+		memory_region_remap(&mmc1->vram_region);
+		memory_region_remap(&mmc1->prg_rom_region);
+		memory_region_remap(&mmc1->chr_region);
 		break;
 	case 1:
 		mmc1->chr_bank_0 = data;
+		memory_region_remap(&mmc1->chr_region);
 		break;
 	case 2:
 		mmc1->chr_bank_1 = data;
+		memory_region_remap(&mmc1->chr_region);
 		break;
 	case 3:
 	default:
 		mmc1->prg_bank.raw = data;
+		memory_region_remap(&mmc1->prg_rom_region);
 		break;
 	}
 
@@ -402,6 +449,11 @@ bool mmc1_init(struct controller_instance *instance)
 		CHR_ROM_OFFSET(cart_header),
 		mmc1->chr_rom_size);
 
+	/* Map banks now that VRAM and ROM contents are available */
+	memory_region_remap(&mmc1->vram_region);
+	memory_region_remap(&mmc1->prg_rom_region);
+	memory_region_remap(&mmc1->chr_region);
+
 	return true;
 }
 
@@ -424,6 +476,11 @@ void mmc1_reset(struct controller_instance *instance)
 	mmc1->prg_bank.raw = 0;
 	mmc1->shift_reg = SHIFT_REG_RESET_VALUE;
 	mmc1->shift_reg_step = 0;
+
+	/* Update mapped banks */
+	memory_region_remap(&mmc1->vram_region);
+	memory_region_remap(&mmc1->prg_rom_region);
+	memory_region_remap(&mmc1->chr_region);
 }
 
 void mmc1_deinit(struct controller_instance *instance)
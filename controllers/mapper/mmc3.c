@@ -89,6 +89,9 @@ static uint8_t prg_rom_readb(struct mmc3 *mmc3, address_t address);
 static uint16_t prg_rom_readw(struct mmc3 *mmc3, address_t address);
 static uint8_t chr_rom_readb(struct mmc3 *mmc3, address_t address);
 static uint16_t chr_rom_readw(struct mmc3 *mmc3, address_t address);
+static uint8_t *vram_map(struct mmc3 *mmc3, address_t address, bool *writable);
+static uint8_t *prg_rom_map(struct mmc3 *mmc3, address_t address,
+	bool *writable);
 static void bank_sel_data_writeb(struct mmc3 *mmc3, uint8_t b, address_t a);
 static void mirror_protect_writeb(struct mmc3 *mmc3, uint8_t b, address_t a);
 static void irq_latch_reload_writeb(struct mmc3 *mmc3, uint8_t b, address_t a);
@@ -98,12 +101,14 @@ static struct mops vram_mops = {
 	.readb = (readb_t)vram_readb,
 	.readw = (readw_t)vram_readw,
 	.writeb = (writeb_t)vram_writeb,
-	.writew = (writew_t)vram_writew
+	.writew = (writew_t)vram_writew,
+	.map = (map_t)vram_map
 };
 
 static struct mops prg_rom_mops = {
 	.readb = (readb_t)prg_rom_readb,
-	.readw = (readw_t)prg_rom_readw
+	.readw = (readw_t)prg_rom_readw,
+	.map = (map_t)prg_rom_map
 };
 
 static struct mops chr_rom_mops = {
@@ -315,6 +320,30 @@ uint16_t chr_rom_readw(struct mmc3 *mmc3, address_t address)
 	return rom_mops.readw(mmc3->chr_rom, address);
 }
 
+uint8_t *vram_map(struct mmc3 *mmc3, address_t address, bool *writable)
+{
+	mirror_address(mmc3, &address);
+	*writable = true;
+
+	/* Leave page unmapped until VRAM gets set (on init) */
+	if (!mmc3->vram)
+		return NULL;
+	return mmc3->vram + address;
+}
+
+uint8_t *prg_rom_map(struct mmc3 *mmc3, address_t address, bool *writable)
+{
+	remap_prg_rom(mmc3, &address);
+	*writable = false;
+
+	/* Leave page unmapped until PRG ROM gets set (on init) */
+	if (!mmc3->prg_rom)
+		return NULL;
+	return mmc3->prg_rom + address;
+}
+
+/* CHR ROM is not mapped as the MMC3 snoops PPU A12 on every CHR access */
+
 void bank_sel_data_writeb(struct mmc3 *mmc3, uint8_t b, address_t address)
 {
 	bool bank_select;
@@ -330,6 +359,9 @@ void bank_sel_data_writeb(struct mmc3 *mmc3, uint8_t b, address_t address)
 		/* Update bank number based on bank select register */
 		mmc3->regs[mmc3->bank_sel.reg] = b;
 	}
+
+	/* Update mapped PRG ROM banks */
+	memory_region_remap(&mmc3->prg_rom_region);
 }
 
 void mirror_protect_writeb(struct mmc3 *mmc3, uint8_t b, address_t address)
@@ -345,6 +377,7 @@ void mirror_protect_writeb(struct mmc3 *mmc3, uint8_t b, address_t address)
 		/* Update nametable mirroring (0: vertical; 1: horizontal) */
 		mirroring.raw = b;
 		mmc3->horizontal_mirroring = mirroring.nametable_mirroring;
+		memory_region_remap(&mmc3->vram_region);
 	} else {
 		/* Though these bits are functional on the MMC3, their main
 		purpose is to write-protect save RAM during power-off, so
@@ -548,6 +581,10 @@ bool mmc3_init(struct controller_instance *instance)
 		CHR_ROM_OFFSET(cart_header),
 		mmc3->chr_rom_size);
 
+	/* Map banks now that VRAM and ROM contents are available */
+	memory_region_remap(&mmc3->vram_region);
+	memory_region_remap(&mmc3->prg_rom_region);
+
 	return true;
 }
 
@@ -565,6 +602,10 @@ void mmc3_reset(struct controller_instance *instance)
 	mmc3->irq_enable = false;
 	mmc3->irq_active = false;
 	mmc3->horizontal_mirroring = false;
+
+	/* Update mapped banks */
+	memory_region_remap(&mmc3->vram_region);
+	memory_region_remap(&mmc3->prg_rom_region);
 }
 
 void mmc3_deinit(struct controller_instance *instance)
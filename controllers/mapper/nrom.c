@@ -23,20 +23,25 @@ static uint8_t vram_readb(struct nrom *nrom, address_t address);
 static uint16_t vram_readw(struct nrom *nrom, address_t address);
 static void vram_writeb(struct nrom *nrom, uint8_t b, address_t address);
 static void vram_writew(struct nrom *nrom, uint16_t w, address_t address);
+static uint8_t *vram_map(struct nrom *nrom, address_t address, bool *writable);
 static void mirror_address(struct nrom *nrom, address_t *address);
 static uint8_t prg_rom_readb(struct nrom *nrom, address_t address);
 static uint16_t prg_rom_readw(struct nrom *nrom, address_t address);
+static uint8_t *prg_rom_map(struct nrom *nrom, address_t address,
+	bool *writable);
 
 static struct mops vram_mops = {
 	.readb = (readb_t)vram_readb,
 	.readw = (readw_t)vram_readw,
 	.writeb = (writeb_t)vram_writeb,
-	.writew = (writew_t)vram_writew
+	.writew = (writew_t)vram_writew,
+	.map = (map_t)vram_map
 };
 
 static struct mops prg_rom_mops = {
 	.readb = (readb_t)prg_rom_readb,
-	.readw = (readw_t)prg_rom_readw
+	.readw = (readw_t)prg_rom_readw,
+	.map = (map_t)prg_rom_map
 };
 
 uint8_t vram_readb(struct nrom *nrom, address_t address)
@@ -63,6 +68,13 @@ void vram_writew(struct nrom *nrom, uint16_t w, address_t address)
 	ram_mops.writew(nrom->vram, w, address);
 }
 
+uint8_t *vram_map(struct nrom *nrom, address_t address, bool *writable)
+{
+	mirror_address(nrom, &address);
+	*writable = true;
+	return nrom->vram + address;
+}
+
 void mirror_address(struct nrom *nrom, address_t *address)
 {
 	bool bit;
@@ -103,6 +115,15 @@ uint16_t prg_rom_readw(struct nrom *nrom, address_t address)
 	return (*(mem + 1) << 8) | *mem;
 }
 
+uint8_t *prg_rom_map(struct nrom *nrom, address_t address, bool *writable)
+{
+	/* Handle NROM-128 mirroring */
+	address %= nrom->prg_rom_size;
+
+	*writable = false;
+	return nrom->prg_rom + address;
+}
+
 bool nrom_init(struct controller_instance *instance)
 {
 	struct nrom *nrom;
@@ -17,6 +17,7 @@ struct sega_mapper {
 	int rom_size;
 	struct resource rom_area;
 	struct resource rom_sel_area;
+	struct region *rom_region;
 	struct region rom_sel_region;
 	uint8_t rom_banks[NUM_BANKS];
 };
@@ -26,9 +27,12 @@ static void sega_mapper_reset(struct controller_instance *instance);
 static void sega_mapper_deinit(struct controller_instance *instance);
 static uint8_t sega_rom_readb(struct sega_mapper *mapper, address_t a);
 static void rom_sel_writeb(struct sega_mapper *mapper,  uint8_t b, address_t a);
+static uint8_t *sega_rom_map(struct sega_mapper *mapper, address_t a,
+	bool *writable);
 
 static struct mops sega_rom_mops = {
-	.readb = (readb_t)sega_rom_readb
+	.readb = (readb_t)sega_rom_readb,
+	.map = (map_t)sega_rom_map
 };
 
 static struct mops rom_sel_mops = {
@@ -58,8 +62,27 @@ void rom_sel_writeb(struct sega_mapper *mapper, uint8_t b, address_t address)
 	/* Mask most significant bits based on ROM size */
 	slot = b & ((mapper->rom_size / BANK_SIZE) - 1);
 
-	/* Update ROM bank number */
+	/* Update ROM bank number and mapped banks */
 	mapper->rom_banks[address] = slot;
+	memory_region_remap(mapper->rom_region);
+}
+
+uint8_t *sega_rom_map(struct sega_mapper *mapper, address_t address,
+	bool *writable)
+{
+	uint8_t slot;
+	int offset;
+
+	/* Get slot number based on address */
+	slot = address / BANK_SIZE;
+
+	/* Adapt address (first page cannot be swapped out) */
+	offset = address;
+	if (address >= PAGE_OFFSET)
+		offset += (mapper->rom_banks[slot] - slot) * BANK_SIZE;
+
+	*writable = false;
+	return mapper->rom + offset;
 }
 
 bool sega_mapper_init(struct controller_instance *instance)
@@ -107,6 +130,7 @@ bool sega_mapper_init(struct controller_instance *instance)
 	region->area = &sega_mapper->rom_area;
 	region->mops = &sega_rom_mops;
 	region->data = sega_mapper;
+	sega_mapper->rom_region = region;
 
 	/* Add ROM select region */
 	sega_mapper->rom_sel_area.type = RESOURCE_MEM;
@@ -131,6 +155,9 @@ void sega_mapper_reset(struct controller_instance *instance)
 	/* Initialize ROM bank numbers */
 	for (i = 0; i < NUM_BANKS; i++)
 		sega_mapper->rom_banks[i] = i;
+
+	/* Update mapped banks */
+	memory_region_remap(sega_mapper->rom_region);
 }
 
 void sega_mapper_deinit(struct controller_instance *instance)
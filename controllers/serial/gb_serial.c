@@ -69,8 +69,8 @@ void serial_writeb(struct serial *serial, uint8_t b, address_t address)
 		serial->sc = sc;
 
 		/* Enable/disable clock based on transfer state and type */
-		serial->clock.enabled = serial->sc.transfer_start_flag &&
-			(serial->sc.shift_clock == INTERNAL_CLOCK);
+		clock_enable(&serial->clock, serial->sc.transfer_start_flag &&
+			(serial->sc.shift_clock == INTERNAL_CLOCK));
 		break;
 	}
 }
@@ -88,7 +88,7 @@ void serial_tick(struct serial *serial)
 
 	/* Consume one clock cycle and disable clock */
 	clock_consume(1);
-	serial->clock.enabled = false;
+	clock_enable(&serial->clock, false);
 }
 
 bool serial_init(struct controller_instance *instance)
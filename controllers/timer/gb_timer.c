@@ -91,7 +91,7 @@ void timer_writeb(struct timer *timer, uint8_t b, address_t address)
 		timer->tac.value = tac.value;
 
 		/* Enable/disable TIMA clock */
-		timer->tima_clock.enabled = timer->tac.timer_enable;
+		clock_enable(&timer->tima_clock, timer->tac.timer_enable);
 		break;
 	}
 }
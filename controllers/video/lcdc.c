@@ -5,6 +5,7 @@
 #include <controller.h>
 #include <cpu.h>
 #include <memory.h>
+#include <trace.h>
 #include <util.h>
 #include <video.h>
 
@@ -138,6 +139,7 @@ static void lcdc_tick(struct lcdc *lcdc);
 static void lcdc_update_counters(struct lcdc *lcdc);
 static void lcdc_set_events(struct lcdc *lcdc);
 static uint8_t lcdc_readb(struct lcdc *lcdc, address_t address);
+static bool lcdc_stable(struct lcdc *lcdc, address_t address);
 static void lcdc_writeb(struct lcdc *lcdc, uint8_t b, address_t address);
 static void lcdc_draw_line(struct lcdc *lcdc, bool background);
 static void lcdc_draw_sprite_line(struct lcdc *lcdc, struct sprite *sprite);
@@ -150,7 +152,8 @@ static void lcdc_mode_3(struct lcdc *lcdc);
 
 static struct mops lcdc_mops = {
 	.readb = (readb_t)lcdc_readb,
-	.writeb = (writeb_t)lcdc_writeb
+	.writeb = (writeb_t)lcdc_writeb,
+	.stable = (stable_t)lcdc_stable
 };
 
 static lcdc_event_t lcdc_events[] = {
@@ -172,6 +175,12 @@ uint8_t lcdc_readb(struct lcdc *lcdc, address_t address)
 	}
 }
 
+bool lcdc_stable(struct lcdc *UNUSED(lcdc), address_t UNUSED(address))
+{
+	/* Registers are read without side effects */
+	return true;
+}
+
 void lcdc_writeb(struct lcdc *lcdc, uint8_t b, address_t address)
 {
 	uint16_t source_addr;
@@ -423,6 +432,8 @@ void lcdc_mode_0(struct lcdc *lcdc)
 	/* Update mode */
 	lcdc->stat.mode_flag = 0;
 
+	TRACE_BEGIN("lcdc_scanline");
+
 	/* Reset background line mask and draw background if needed */
 	memset(lcdc->line_mask, 0, LCD_WIDTH * sizeof(bool));
 	if (lcdc->ctrl.bg_display_enable)
@@ -470,6 +481,8 @@ void lcdc_mode_0(struct lcdc *lcdc)
 			lcdc_draw_sprite_line(lcdc, &sprites[i]);
 	}
 
+	TRACE_END("lcdc_scanline");
+
 	/* Fire interrupt if needed */
 	if (lcdc->stat.mode_0_hblank_interrupt)
 		cpu_interrupt(lcdc->lcdc_irq);
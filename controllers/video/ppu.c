@@ -4,10 +4,12 @@
 #include <string.h>
 #include <bitops.h>
 #include <clock.h>
+#include <cmdline.h>
 #include <controller.h>
 #include <cpu.h>
 #include <memory.h>
 #include <resource.h>
+#include <trace.h>
 #include <video.h>
 
 /* PPU registers */
@@ -44,6 +46,26 @@
 #define NUM_LUMA_VALUES		4
 #define NUM_SPRITES		64
 #define NUM_SPRITES_PER_LINE	8
+#define BATCH_END_DOT		339
+#define BATCH_END_ADDRESS	0x3000
+#define CHR_SIZE		0x2000
+#define NUM_CHR_PAGES		(CHR_SIZE >> MEM_PAGE_SHIFT)
+#define NUM_CHR_ROWS		(CHR_SIZE / TILE_SIZE * TILE_HEIGHT)
+
+/* Decoded tile rows (8 pixels of 2 bits, leftmost pixel in low byte) */
+#define CHR_ROW(address)	((address) / TILE_SIZE * TILE_HEIGHT + \
+					(address) % TILE_HEIGHT)
+#define ROW_PIXEL_BITS		8
+#define ROW_PIXEL_MASK		0xFF
+#define ROW_PLANE_SPREAD	0x8040201008040201ULL
+#define ROW_LSB_MASK		0x0101010101010101ULL
+
+/* Sprite line buffer entries */
+#define SPR_COLOR_MASK		0x03
+#define SPR_PALETTE_MASK	0x0C
+#define SPR_PALETTE_SHIFT	2
+#define SPR_BEHIND_BG		BIT(4)
+#define SPR_ZERO		BIT(5)
 
 /* PPU events sorted by priority */
 #define EVENT_OUTPUT		BIT(0)
@@ -64,6 +86,10 @@
 #define EVENT_SPRITE_EVAL	BIT(15)
 #define EVENT_FETCH_SPRITE	BIT(16)
 
+/* Events which have an effect while rendering is disabled */
+#define BLANK_EVENTS \
+	(EVENT_OUTPUT | EVENT_VBLANK_SET | EVENT_VBLANK_CLEAR)
+
 union ppu_ctrl {
 	uint8_t value;
 	struct {
@@ -170,12 +196,16 @@ struct ppu_render_data {
 	uint8_t attr_latch:2;
 	uint8_t shift_at_low;
 	uint8_t shift_at_high;
-	uint8_t shift_spr_low[NUM_SPRITES_PER_LINE];
-	uint8_t shift_spr_high[NUM_SPRITES_PER_LINE];
+	uint64_t shift_spr[NUM_SPRITES_PER_LINE];
 	uint8_t spr_attr_latches[NUM_SPRITES_PER_LINE];
 	uint8_t x_counters[NUM_SPRITES_PER_LINE];
 };
 
+struct ppu_line {
+	int events[NUM_DOTS];
+	int distances[NUM_DOTS];
+};
+
 struct ppu {
 	union ppu_ctrl ctrl;
 	union ppu_mask mask;
@@ -192,12 +222,22 @@ struct ppu {
 	int sprite_counter;
 	bool spr_0_evaluated;
 	bool spr_0_fetched;
-	int *events[NUM_SCANLINES];
-	int visible_line[NUM_DOTS];
-	int vblank_line[NUM_DOTS];
-	int pre_render_line[NUM_DOTS];
-	int idle_line[NUM_DOTS];
+	bool batch;
+	int tick_h;
+	int tick_v;
+	uint64_t tick_cycle;
+	struct ppu_line *lines[NUM_SCANLINES];
+	struct ppu_line *blank_lines[NUM_SCANLINES];
+	struct ppu_line visible_line;
+	struct ppu_line vblank_line;
+	struct ppu_line pre_render_line;
+	struct ppu_line idle_line;
+	struct ppu_line blank_visible_line;
+	struct ppu_line blank_pre_render_line;
 	struct ppu_render_data render_data;
+	uint64_t chr_rows[NUM_CHR_ROWS];
+	uint8_t *chr_pages[NUM_CHR_PAGES];
+	uint32_t chr_generation;
 	struct clock clock;
 	uint8_t oam[OAM_SIZE];
 	uint8_t sec_oam[SEC_OAM_SIZE];
@@ -215,15 +255,28 @@ static void ppu_reset(struct controller_instance *instance);
 static void ppu_deinit(struct controller_instance *instance);
 static void ppu_tick(struct ppu *ppu);
 static void ppu_update_counters(struct ppu *ppu);
+static bool ppu_rendering(struct ppu *ppu);
+static int ppu_find_event(struct ppu *ppu);
+static void ppu_resume_events(struct ppu *ppu);
+static bool ppu_can_batch(struct ppu *ppu);
+static void ppu_render_line(struct ppu *ppu);
 static void ppu_set_events(struct ppu *ppu);
 static void ppu_build_pre_render_line(struct ppu *ppu);
 static void ppu_build_visible_line(struct ppu *ppu);
 static void ppu_build_vblank_line(struct ppu *ppu);
+static void ppu_build_blank_line(struct ppu_line *blank_line,
+	struct ppu_line *line);
+static void ppu_build_distances(struct ppu_line *line);
 static uint8_t palette_readb(uint8_t *ram, address_t address);
 static void palette_writeb(uint8_t *ram, uint8_t b, address_t address);
 static uint8_t ppu_readb(struct ppu *ppu, address_t address);
+static bool ppu_stable(struct ppu *ppu, address_t address);
 static void ppu_writeb(struct ppu *ppu, uint8_t b, address_t address);
 static void ppu_output(struct ppu *ppu);
+static void ppu_output_pixel(struct ppu *ppu, int x, uint8_t bg,
+	uint8_t spr, struct color *colors);
+static void ppu_decode_bg_shifters(struct ppu *ppu, uint8_t *line);
+static void ppu_decode_sprites(struct ppu *ppu, uint8_t *line);
 static void ppu_shift_bg(struct ppu *ppu);
 static void ppu_shift_spr(struct ppu *ppu);
 static void ppu_reload_bg(struct ppu *ppu);
@@ -231,6 +284,14 @@ static void ppu_fetch_nt(struct ppu *ppu);
 static void ppu_fetch_at(struct ppu *ppu);
 static void ppu_fetch_low_bg(struct ppu *ppu);
 static void ppu_fetch_high_bg(struct ppu *ppu);
+static void ppu_fetch_tile(struct ppu *ppu);
+static void ppu_fetch_bg_row(struct ppu *ppu, uint8_t *pixels);
+static address_t ppu_bg_address(struct ppu *ppu);
+static uint64_t ppu_fetch_row(struct ppu *ppu, address_t address);
+static uint64_t ppu_decode_row(uint8_t low, uint8_t high);
+static void ppu_decode_chr_row(struct ppu *ppu, address_t address);
+static void ppu_update_chr(struct ppu *ppu);
+static void ppu_invalidate_chr(struct ppu *ppu, address_t address);
 static void ppu_vblank_set(struct ppu *ppu);
 static void ppu_vblank_clear(struct ppu *ppu);
 static void ppu_loopy_inc_hori_v(struct ppu *ppu);
@@ -241,6 +302,10 @@ static void ppu_sec_oam_clear(struct ppu *ppu);
 static void ppu_sprite_eval(struct ppu *ppu);
 static void ppu_fetch_sprite(struct ppu *ppu);
 
+static bool no_ppu_batch;
+PARAM(no_ppu_batch, bool, "no-ppu-batch", "nes",
+	"Disables scanline-batch PPU rendering")
+
 static struct mops palette_mops = {
 	.readb = (readb_t)palette_readb,
 	.writeb = (writeb_t)palette_writeb
@@ -248,7 +313,8 @@ static struct mops palette_mops = {
 
 static struct mops ppu_mops = {
 	.readb = (readb_t)ppu_readb,
-	.writeb = (writeb_t)ppu_writeb
+	.writeb = (writeb_t)ppu_writeb,
+	.stable = (stable_t)ppu_stable
 };
 
 static ppu_event_t ppu_events[] = {
@@ -380,9 +446,29 @@ uint8_t ppu_readb(struct ppu *ppu, address_t address)
 	}
 }
 
+bool ppu_stable(struct ppu *ppu, address_t address)
+{
+	switch (address) {
+	case PPUSTATUS:
+		/* Reading status only resets write toggle (sprite flags might
+		still change without the clock being scheduled while a scanline
+		is rendered lazily) */
+		if (ppu->mask.sprite_visibility &&
+			(ppu->clock.sync_cycle > ppu->clock.next_cycle))
+			return false;
+		return !ppu->write_toggle;
+	case PPUDATA:
+		/* Reading data increments VRAM address */
+		return false;
+	default:
+		return true;
+	}
+}
+
 void ppu_writeb(struct ppu *ppu, uint8_t b, address_t address)
 {
 	uint16_t t;
+	bool rendering;
 
 	switch (address) {
 	case PPUCTRL:
@@ -394,8 +480,12 @@ void ppu_writeb(struct ppu *ppu, uint8_t b, address_t address)
 		ppu->temp_vram_addr.v_nametable = bitops_getb(&b, 1, 1);
 		break;
 	case PPUMASK:
-		/* Write register */
+		/* Write register and go back to full event schedule if rendering
+		gets enabled (compact one skips dots which now matter) */
+		rendering = ppu_rendering(ppu);
 		ppu->mask.value = b;
+		if (!rendering && ppu_rendering(ppu))
+			ppu_resume_events(ppu);
 		break;
 	case OAMADDR:
 		/* Write register */
@@ -451,8 +541,11 @@ void ppu_writeb(struct ppu *ppu, uint8_t b, address_t address)
 		}
 		break;
 	case PPUDATA:
-		/* Write to VRAM incrementing address accordingly */
+		/* Write to VRAM incrementing address accordingly (pattern data
+		might have changed if CHR RAM is mapped) */
 		memory_writeb(ppu->bus_id, b, ppu->vram_addr.value);
+		if (ppu->vram_addr.value < CHR_SIZE)
+			ppu_invalidate_chr(ppu, ppu->vram_addr.value);
 		ppu->vram_addr.value += ppu->ctrl.vram_addr_increment ? 32 : 1;
 		break;
 	default:
@@ -482,6 +575,10 @@ void ppu_output(struct ppu *ppu)
 	/* Get current X coordinate from H counter (output starts at h = 2) */
 	x = ppu->h - 2;
 
+	/* Pixels are output one tick at a time (zone overlaps CPU quanta) */
+	if (x == 0)
+		TRACE_ASYNC_BEGIN("ppu_scanline");
+
 	/* Check if background clipping is enabled and must be discarded */
 	clipped = !ppu->mask.bg_show_left_col && (x < TILE_WIDTH);
 
@@ -509,9 +606,7 @@ void ppu_output(struct ppu *ppu)
 				continue;
 
 			/* Get pattern color */
-			l = bitops_getb(&r->shift_spr_low[i], 7, 1);
-			h = bitops_getb(&r->shift_spr_high[i], 7, 1);
-			color = l | (h << 1);
+			color = r->shift_spr[i] & ROW_PIXEL_MASK;
 
 			/* Skip if pixel is transparent */
 			if (color == 0)
@@ -556,6 +651,109 @@ void ppu_output(struct ppu *ppu)
 	/* Set pixel based on palette entry */
 	entry.value = memory_readb(ppu->bus_id, address);
 	video_set_pixel(x, ppu->v, ppu_palette[entry.luma][entry.chroma]);
+
+	if (x == SCREEN_WIDTH - 1)
+		TRACE_ASYNC_END("ppu_scanline");
+}
+
+void ppu_output_pixel(struct ppu *ppu, int x, uint8_t bg, uint8_t spr,
+	struct color *colors)
+{
+	uint8_t bg_color;
+	uint8_t color;
+	int entry;
+
+	/* Discard background pixel if disabled or clipped */
+	if (!ppu->mask.bg_visibility ||
+		(!ppu->mask.bg_show_left_col && (x < TILE_WIDTH)))
+		bg = 0;
+	bg_color = bg % NUM_PALETTE_ENTRIES;
+
+	/* Discard sprite pixel if clipped */
+	if (!ppu->mask.sprite_show_left_col && (x < TILE_WIDTH))
+		spr = 0;
+	color = spr & SPR_COLOR_MASK;
+
+	/* Set sprite 0 hit flag if needed (see ppu_output) */
+	if ((spr & SPR_ZERO) && ppu->spr_0_fetched && (x != 255) &&
+		(bg_color != 0))
+		ppu->status.sprite_0_hit = 1;
+
+	/* Compute palette entry based on priority (transparent background
+	pixels already point to first palette entry) */
+	if ((color != 0) && ((bg_color == 0) || !(spr & SPR_BEHIND_BG)))
+		entry = SPRITE_PALETTE_START - BG_PALETTE_START +
+			NUM_PALETTE_ENTRIES *
+			((spr & SPR_PALETTE_MASK) >> SPR_PALETTE_SHIFT) + color;
+	else
+		entry = bg;
+
+	/* Set pixel based on decoded palette entry */
+	video_set_pixel(x, ppu->v, colors[entry]);
+}
+
+void ppu_decode_bg_shifters(struct ppu *ppu, uint8_t *line)
+{
+	struct ppu_render_data *r = &ppu->render_data;
+	uint8_t palette;
+	uint8_t color;
+	int i;
+
+	/* Shifters hold the two tiles fetched during previous scanline: pixels
+	of the first one come with their palette from the attribute shifters,
+	while the second one gets the palette held by the attribute latch */
+	for (i = 0; i < 2 * TILE_WIDTH; i++) {
+		color = bitops_getw(&r->shift_bg_low, 15 - i, 1);
+		color |= bitops_getw(&r->shift_bg_high, 15 - i, 1) << 1;
+		palette = r->attr_latch;
+		if (i < TILE_WIDTH) {
+			palette = bitops_getb(&r->shift_at_low, 7 - i, 1);
+			palette |= bitops_getb(&r->shift_at_high, 7 - i, 1) << 1;
+		}
+		line[i] = (color != 0) ? NUM_PALETTE_ENTRIES * palette + color : 0;
+	}
+}
+
+void ppu_decode_sprites(struct ppu *ppu, uint8_t *line)
+{
+	struct ppu_render_data *r = &ppu->render_data;
+	union ppu_sprite_attributes attributes;
+	uint8_t color;
+	uint8_t flags;
+	int x;
+	int i;
+	int j;
+
+	/* Clear line */
+	memset(line, 0, SCREEN_WIDTH);
+
+	/* Return already if sprite rendering is not enabled */
+	if (!ppu->mask.sprite_visibility)
+		return;
+
+	/* A sprite becomes active once its X counter elapses and then shifts
+	out one pixel per dot: lay out opaque pixels from last to first sprite
+	so that the first opaque sprite wins */
+	for (i = NUM_SPRITES_PER_LINE - 1; i >= 0; i--) {
+		/* Build entry flags from attributes */
+		attributes.value = r->spr_attr_latches[i];
+		flags = attributes.palette << SPR_PALETTE_SHIFT;
+		if (attributes.priority)
+			flags |= SPR_BEHIND_BG;
+		if (i == 0)
+			flags |= SPR_ZERO;
+
+		/* Set opaque pixels */
+		for (j = 0; j < TILE_WIDTH; j++) {
+			x = r->x_counters[i] + j;
+			if (x >= SCREEN_WIDTH)
+				break;
+			color = (r->shift_spr[i] >> (j * ROW_PIXEL_BITS)) &
+				ROW_PIXEL_MASK;
+			if (color != 0)
+				line[x] = flags | color;
+		}
+	}
 }
 
 void ppu_shift_bg(struct ppu *ppu)
@@ -590,10 +788,8 @@ void ppu_shift_spr(struct ppu *ppu)
 
 	/* Shift sprite tile registers if needed */
 	for (i = 0; i < NUM_SPRITES_PER_LINE; i++)
-		if (r->x_counters[i] == 0) {
-			r->shift_spr_low[i] <<= 1;
-			r->shift_spr_high[i] <<= 1;
-		}
+		if (r->x_counters[i] == 0)
+			r->shift_spr[i] >>= ROW_PIXEL_BITS;
 
 	/* Decrement X counters if needed */
 	for (i = 0; i < NUM_SPRITES_PER_LINE; i++)
@@ -672,38 +868,163 @@ void ppu_fetch_at(struct ppu *ppu)
 
 void ppu_fetch_low_bg(struct ppu *ppu)
 {
-	address_t address;
 	struct ppu_render_data *r = &ppu->render_data;
 
 	/* Return already if BG rendering is not enabled */
 	if (!ppu->mask.bg_visibility)
 		return;
 
-	/* Select appropriate pattern table and compute address */
-	address = (ppu->ctrl.bg_pattern_table_addr == 0) ?
-		PATTERN_TABLE_0_START : PATTERN_TABLE_1_START;
-	address += r->nt * TILE_SIZE + ppu->vram_addr.fine_y_scroll;
-
 	/* Read low BG tile byte */
-	r->bg_low = memory_readb(ppu->bus_id, address);
+	r->bg_low = memory_readb(ppu->bus_id, ppu_bg_address(ppu));
 }
 
 void ppu_fetch_high_bg(struct ppu *ppu)
 {
-	address_t address;
 	struct ppu_render_data *r = &ppu->render_data;
 
 	/* Return already if rendering is not enabled */
 	if (!ppu->mask.bg_visibility)
 		return;
 
-	/* Select appropriate pattern table and compute address */
+	/* Read high BG tile byte (8 bytes after low BG tile byte) */
+	r->bg_high = memory_readb(ppu->bus_id, ppu_bg_address(ppu) + 8);
+}
+
+void ppu_fetch_tile(struct ppu *ppu)
+{
+	/* Fetch NT, AT and BG tile bytes and move to next tile */
+	ppu_fetch_nt(ppu);
+	ppu_fetch_at(ppu);
+	ppu_fetch_low_bg(ppu);
+	ppu_fetch_high_bg(ppu);
+	ppu_loopy_inc_hori_v(ppu);
+}
+
+void ppu_fetch_bg_row(struct ppu *ppu, uint8_t *pixels)
+{
+	struct ppu_render_data *r = &ppu->render_data;
+	uint64_t row = 0;
+	uint64_t opaque;
+	int i;
+
+	/* Fetch NT and AT bytes */
+	ppu_fetch_nt(ppu);
+	ppu_fetch_at(ppu);
+
+	/* Fetch decoded BG tile row and add palette offset to all of its
+	opaque pixels at once */
+	if (ppu->mask.bg_visibility) {
+		row = ppu_fetch_row(ppu, ppu_bg_address(ppu));
+		opaque = (row | (row >> 1)) & ROW_LSB_MASK;
+		row |= opaque * (NUM_PALETTE_ENTRIES * r->at);
+	}
+
+	/* Lay out pixels and move to next tile */
+	for (i = 0; i < TILE_WIDTH; i++)
+		pixels[i] = (row >> (i * ROW_PIXEL_BITS)) & ROW_PIXEL_MASK;
+	ppu_loopy_inc_hori_v(ppu);
+}
+
+address_t ppu_bg_address(struct ppu *ppu)
+{
+	address_t address;
+
+	/* Select appropriate pattern table and compute low BG tile address */
 	address = (ppu->ctrl.bg_pattern_table_addr == 0) ?
 		PATTERN_TABLE_0_START : PATTERN_TABLE_1_START;
-	address += r->nt * TILE_SIZE + ppu->vram_addr.fine_y_scroll + 8;
+	return address + ppu->render_data.nt * TILE_SIZE +
+		ppu->vram_addr.fine_y_scroll;
+}
+
+uint64_t ppu_fetch_row(struct ppu *ppu, address_t address)
+{
+	uint8_t low;
+	uint8_t high;
+
+	/* Use decoded row if pattern cache holds page */
+	ppu_update_chr(ppu);
+	if (ppu->chr_pages[address >> MEM_PAGE_SHIFT])
+		return ppu->chr_rows[CHR_ROW(address)];
+
+	/* Read both tile bytes through bus otherwise (fetches might be
+	snooped by mapper) */
+	low = memory_readb(ppu->bus_id, address);
+	high = memory_readb(ppu->bus_id, address + 8);
+	return ppu_decode_row(low, high);
+}
 
-	/* Read high BG tile byte */
-	r->bg_high = memory_readb(ppu->bus_id, address);
+uint64_t ppu_decode_row(uint8_t low, uint8_t high)
+{
+	uint64_t l;
+	uint64_t h;
+
+	/* Multiplying a byte by ROW_PLANE_SPREAD moves its bit n to bit
+	63 - 8 * n (without any carry), spreading bits 7...0 over bytes 0...7 */
+	l = ((low * ROW_PLANE_SPREAD) >> 7) & ROW_LSB_MASK;
+	h = ((high * ROW_PLANE_SPREAD) >> 7) & ROW_LSB_MASK;
+	return l | (h << 1);
+}
+
+void ppu_decode_chr_row(struct ppu *ppu, address_t address)
+{
+	uint8_t *mem;
+	address_t a;
+
+	/* Decode row from host memory backing page */
+	mem = ppu->chr_pages[address >> MEM_PAGE_SHIFT];
+	a = address & MEM_PAGE_MASK;
+	ppu->chr_rows[CHR_ROW(address)] = ppu_decode_row(mem[a], mem[a + 8]);
+}
+
+void ppu_update_chr(struct ppu *ppu)
+{
+	struct page *page;
+	address_t address;
+	uint8_t *mem;
+	int row;
+	int i;
+
+	/* Leave already if memory mapping did not change since last update */
+	if (ppu->chr_generation == memory_map_generation)
+		return;
+	ppu->chr_generation = memory_map_generation;
+
+	/* Decode all rows of pages whose backing host memory changed (pages
+	not backed by host memory are left out of cache) */
+	for (i = 0; i < NUM_CHR_PAGES; i++) {
+		page = memory_get_page(ppu->bus_id, i << MEM_PAGE_SHIFT);
+		mem = page ? page->readb.mem : NULL;
+		if (mem == ppu->chr_pages[i])
+			continue;
+		ppu->chr_pages[i] = mem;
+		if (!mem)
+			continue;
+		for (address = i << MEM_PAGE_SHIFT;
+			address < (address_t)(i + 1) << MEM_PAGE_SHIFT;
+			address += TILE_SIZE)
+			for (row = 0; row < TILE_HEIGHT; row++)
+				ppu_decode_chr_row(ppu, address + row);
+	}
+}
+
+void ppu_invalidate_chr(struct ppu *ppu, address_t address)
+{
+	uint8_t *mem;
+	address_t offset;
+	int i;
+
+	/* Leave already if written page is not cached */
+	ppu_update_chr(ppu);
+	mem = ppu->chr_pages[address >> MEM_PAGE_SHIFT];
+	if (!mem)
+		return;
+
+	/* Decode written row again (from its low tile byte) within all pages
+	mapping the same host memory (CHR RAM banks can be mapped twice) */
+	offset = address & MEM_PAGE_MASK & ~8;
+	for (i = 0; i < NUM_CHR_PAGES; i++)
+		if (ppu->chr_pages[i] == mem)
+			ppu_decode_chr_row(ppu, (i << MEM_PAGE_SHIFT) + offset);
 }
 
 void ppu_vblank_set(struct ppu *ppu)
@@ -872,8 +1193,7 @@ void ppu_fetch_sprite(struct ppu *ppu)
 	uint16_t address;
 	bool transparent;
 	int index;
-	uint8_t low;
-	uint8_t high;
+	uint64_t row;
 	uint8_t tile_number;
 	uint8_t y;
 	int height;
@@ -930,28 +1250,23 @@ void ppu_fetch_sprite(struct ppu *ppu)
 	address += !sprite->attributes.v_flip ?
 		y % TILE_HEIGHT : (TILE_HEIGHT - (y % TILE_HEIGHT) - 1);
 
-	/* Fetch tile data */
-	low = memory_readb(ppu->bus_id, address);
-	high = memory_readb(ppu->bus_id, address + 8);
+	/* Fetch decoded tile row */
+	row = ppu_fetch_row(ppu, address);
 
-	/* Reverse data on horizontal flip */
-	if (sprite->attributes.h_flip) {
-		low = bitops_reverse(low, 8);
-		high = bitops_reverse(high, 8);
-	}
+	/* Reverse pixels on horizontal flip */
+	if (sprite->attributes.h_flip)
+		row = __builtin_bswap64(row);
 
 	/* Dummy fetches are replaced by transparent data */
 	transparent = (sprite->y == 0xFF);
 	transparent |= ((ppu->v < sprite->y) || (ppu->v >= sprite->y + height));
 	if (transparent) {
-		ppu->render_data.shift_spr_low[index] = 0;
-		ppu->render_data.shift_spr_high[index] = 0;
+		ppu->render_data.shift_spr[index] = 0;
 		return;
 	}
 
-	/* Set tile data into shift registers */
-	ppu->render_data.shift_spr_low[index] = low;
-	ppu->render_data.shift_spr_high[index] = high;
+	/* Set tile row into shift register */
+	ppu->render_data.shift_spr[index] = row;
 }
 
 void ppu_build_pre_render_line(struct ppu *ppu)
@@ -968,7 +1283,7 @@ void ppu_build_pre_render_line(struct ppu *ppu)
 	/* Cycles 1-256 */
 		/* Add clear VBLANK/sprite 0/overflow during tick 1. */
 		cycle = 1;
-		ppu->pre_render_line[cycle] |= EVENT_VBLANK_CLEAR;
+		ppu->pre_render_line.events[cycle] |= EVENT_VBLANK_CLEAR;
 
 		/* The data for each tile is fetched during this phase. Each
 		memory access takes 2 PPU cycles to complete, and 4 must be
@@ -978,33 +1293,33 @@ void ppu_build_pre_render_line(struct ppu *ppu)
 			- Tile bitmap low
 			- Tile bitmap high (+ 8 bytes from tile bitmap low) */
 		for (cycle = 1; cycle <= 256; cycle += 8) {
-			ppu->pre_render_line[cycle] |= EVENT_FETCH_NT;
-			ppu->pre_render_line[cycle + 2] |= EVENT_FETCH_AT;
-			ppu->pre_render_line[cycle + 4] |= EVENT_FETCH_LOW_BG;
-			ppu->pre_render_line[cycle + 6] |= EVENT_FETCH_HIGH_BG;
+			ppu->pre_render_line.events[cycle] |= EVENT_FETCH_NT;
+			ppu->pre_render_line.events[cycle + 2] |= EVENT_FETCH_AT;
+			ppu->pre_render_line.events[cycle + 4] |= EVENT_FETCH_LOW_BG;
+			ppu->pre_render_line.events[cycle + 6] |= EVENT_FETCH_HIGH_BG;
 		}
 
 		/* BG and sprite shift registers shift during ticks 2...257. */
 		for (cycle = 2; cycle <= 257; cycle++) {
-			ppu->pre_render_line[cycle] |= EVENT_SHIFT_BG;
-			ppu->pre_render_line[cycle] |= EVENT_SHIFT_SPR;
+			ppu->pre_render_line.events[cycle] |= EVENT_SHIFT_BG;
+			ppu->pre_render_line.events[cycle] |= EVENT_SHIFT_SPR;
 		}
 
 		/* Shifters are reloaded during ticks 9, 17, ..., 257. */
 		for (cycle = 9; cycle <= 257; cycle += 8)
-			ppu->pre_render_line[cycle] |= EVENT_RELOAD_BG;
+			ppu->pre_render_line.events[cycle] |= EVENT_RELOAD_BG;
 
 		/* Add inc hori(v) updates during ticks 8, 16, ..., 256. */
 		for (cycle = 8; cycle <= 256; cycle += 8)
-			ppu->pre_render_line[cycle] |= EVENT_LOOPY_INC_HORI_V;
+			ppu->pre_render_line.events[cycle] |= EVENT_LOOPY_INC_HORI_V;
 
 		/* Add inc vert(v) update during tick 256. */
 		cycle = 256;
-		ppu->pre_render_line[cycle] |= EVENT_LOOPY_INC_VERT_V;
+		ppu->pre_render_line.events[cycle] |= EVENT_LOOPY_INC_VERT_V;
 
 		/* Add hori(v) = hori(t) during tick 257. */
 		cycle = 257;
-		ppu->pre_render_line[cycle] |= EVENT_LOOPY_SET_HORI_V;
+		ppu->pre_render_line.events[cycle] |= EVENT_LOOPY_SET_HORI_V;
 
 	/* Cycles 257-320 */
 		/* The tile data for the sprites on the next scanline are
@@ -1015,11 +1330,11 @@ void ppu_build_pre_render_line(struct ppu *ppu)
 		- Tile bitmap low
 		- Tile bitmap high (+ 8 bytes from tile bitmap low) */
 		for (cycle = 257; cycle < 320; cycle += 8)
-			ppu->pre_render_line[cycle] |= EVENT_FETCH_SPRITE;
+			ppu->pre_render_line.events[cycle] |= EVENT_FETCH_SPRITE;
 
 		/* Add vert(v) = vert(t) updates during ticks 280...304. */
 		for (cycle = 280; cycle <= 304; cycle++)
-			ppu->pre_render_line[cycle] |= EVENT_LOOPY_SET_VERT_V;
+			ppu->pre_render_line.events[cycle] |= EVENT_LOOPY_SET_VERT_V;
 
 	/* Cycles 321-336 */
 		/* This is where the first two tiles for the next scanline are
@@ -1031,23 +1346,23 @@ void ppu_build_pre_render_line(struct ppu *ppu)
 			- Tile bitmap low
 			- Tile bitmap high (+ 8 bytes from tile bitmap low) */
 		for (cycle = 321; cycle <= 336; cycle += 8) {
-			ppu->pre_render_line[cycle] |= EVENT_FETCH_NT;
-			ppu->pre_render_line[cycle + 2] |= EVENT_FETCH_AT;
-			ppu->pre_render_line[cycle + 4] |= EVENT_FETCH_LOW_BG;
-			ppu->pre_render_line[cycle + 6] |= EVENT_FETCH_HIGH_BG;
+			ppu->pre_render_line.events[cycle] |= EVENT_FETCH_NT;
+			ppu->pre_render_line.events[cycle + 2] |= EVENT_FETCH_AT;
+			ppu->pre_render_line.events[cycle + 4] |= EVENT_FETCH_LOW_BG;
+			ppu->pre_render_line.events[cycle + 6] |= EVENT_FETCH_HIGH_BG;
 		}
 
 		/* Background shift registers shift during ticks 322...337. */
 		for (cycle = 322; cycle <= 337; cycle++)
-			ppu->pre_render_line[cycle] |= EVENT_SHIFT_BG;
+			ppu->pre_render_line.events[cycle] |= EVENT_SHIFT_BG;
 
 		/* Shifters are reloaded during ticks 329 and 337. */
 		for (cycle = 329; cycle <= 337; cycle += 8)
-			ppu->pre_render_line[cycle] |= EVENT_RELOAD_BG;
+			ppu->pre_render_line.events[cycle] |= EVENT_RELOAD_BG;
 
 		/* Add inc hori(v) updates during ticks 328 and 336. */
 		for (cycle = 328; cycle <= 336; cycle += 8)
-			ppu->pre_render_line[cycle] |= EVENT_LOOPY_INC_HORI_V;
+			ppu->pre_render_line.events[cycle] |= EVENT_LOOPY_INC_HORI_V;
 
 	/* Cycles 337-340 */
 		/* Two bytes are fetched, but the purpose for this is unknown.
@@ -1055,8 +1370,8 @@ void ppu_build_pre_render_line(struct ppu *ppu)
 			- Nametable byte
 			- Nametable byte */
 		for (cycle = 337; cycle <= 340; cycle += 4) {
-			ppu->pre_render_line[cycle] |= EVENT_FETCH_NT;
-			ppu->pre_render_line[cycle + 2] |= EVENT_FETCH_NT;
+			ppu->pre_render_line.events[cycle] |= EVENT_FETCH_NT;
+			ppu->pre_render_line.events[cycle + 2] |= EVENT_FETCH_NT;
 		}
 }
 
@@ -1074,7 +1389,7 @@ void ppu_build_visible_line(struct ppu *ppu)
 	/* Cycles 1-256 */
 		/* Output pixels between ticks 2...257. */
 		for (cycle = 2; cycle <= 257; cycle++)
-			ppu->visible_line[cycle] |= EVENT_OUTPUT;
+			ppu->visible_line.events[cycle] |= EVENT_OUTPUT;
 
 		/* The data for each tile is fetched during this phase. Each
 		memory access takes 2 PPU cycles to complete, and 4 must be
@@ -1084,33 +1399,33 @@ void ppu_build_visible_line(struct ppu *ppu)
 			- Tile bitmap low
 			- Tile bitmap high (+ 8 bytes from tile bitmap low) */
 		for (cycle = 1; cycle <= 256; cycle += 8) {
-			ppu->visible_line[cycle] |= EVENT_FETCH_NT;
-			ppu->visible_line[cycle + 2] |= EVENT_FETCH_AT;
-			ppu->visible_line[cycle + 4] |= EVENT_FETCH_LOW_BG;
-			ppu->visible_line[cycle + 6] |= EVENT_FETCH_HIGH_BG;
+			ppu->visible_line.events[cycle] |= EVENT_FETCH_NT;
+			ppu->visible_line.events[cycle + 2] |= EVENT_FETCH_AT;
+			ppu->visible_line.events[cycle + 4] |= EVENT_FETCH_LOW_BG;
+			ppu->visible_line.events[cycle + 6] |= EVENT_FETCH_HIGH_BG;
 		}
 
 		/* BG and sprite shift registers shift during ticks 2...257. */
 		for (cycle = 2; cycle <= 257; cycle++) {
-			ppu->visible_line[cycle] |= EVENT_SHIFT_BG;
-			ppu->visible_line[cycle] |= EVENT_SHIFT_SPR;
+			ppu->visible_line.events[cycle] |= EVENT_SHIFT_BG;
+			ppu->visible_line.events[cycle] |= EVENT_SHIFT_SPR;
 		}
 
 		/* Shifters are reloaded during ticks 9, 17, ..., 257. */
 		for (cycle = 9; cycle <= 257; cycle += 8)
-			ppu->visible_line[cycle] |= EVENT_RELOAD_BG;
+			ppu->visible_line.events[cycle] |= EVENT_RELOAD_BG;
 
 		/* Add inc hori(v) updates during ticks 8, 16, ..., 256. */
 		for (cycle = 8; cycle <= 256; cycle += 8)
-			ppu->visible_line[cycle] |= EVENT_LOOPY_INC_HORI_V;
+			ppu->visible_line.events[cycle] |= EVENT_LOOPY_INC_HORI_V;
 
 		/* Add inc vert(v) update during tick 256. */
 		cycle = 256;
-		ppu->visible_line[cycle] |= EVENT_LOOPY_INC_VERT_V;
+		ppu->visible_line.events[cycle] |= EVENT_LOOPY_INC_VERT_V;
 
 		/* Add hori(v) = hori(t) during tick 257. */
 		cycle = 257;
-		ppu->visible_line[cycle] |= EVENT_LOOPY_SET_HORI_V;
+		ppu->visible_line.events[cycle] |= EVENT_LOOPY_SET_HORI_V;
 
 	/* Cycles 257-320 */
 		/* The tile data for the sprites on the next scanline are
@@ -1121,7 +1436,7 @@ void ppu_build_visible_line(struct ppu *ppu)
 		- Tile bitmap low
 		- Tile bitmap high (+ 8 bytes from tile bitmap low) */
 		for (cycle = 257; cycle < 320; cycle += 8)
-			ppu->visible_line[cycle] |= EVENT_FETCH_SPRITE;
+			ppu->visible_line.events[cycle] |= EVENT_FETCH_SPRITE;
 
 	/* Cycles 321-336 */
 		/* This is where the first two tiles for the next scanline are
@@ -1133,23 +1448,23 @@ void ppu_build_visible_line(struct ppu *ppu)
 			- Tile bitmap low
 			- Tile bitmap high (+ 8 bytes from tile bitmap low) */
 		for (cycle = 321; cycle <= 336; cycle += 8) {
-			ppu->visible_line[cycle] |= EVENT_FETCH_NT;
-			ppu->visible_line[cycle + 2] |= EVENT_FETCH_AT;
-			ppu->visible_line[cycle + 4] |= EVENT_FETCH_LOW_BG;
-			ppu->visible_line[cycle + 6] |= EVENT_FETCH_HIGH_BG;
+			ppu->visible_line.events[cycle] |= EVENT_FETCH_NT;
+			ppu->visible_line.events[cycle + 2] |= EVENT_FETCH_AT;
+			ppu->visible_line.events[cycle + 4] |= EVENT_FETCH_LOW_BG;
+			ppu->visible_line.events[cycle + 6] |= EVENT_FETCH_HIGH_BG;
 		}
 
 		/* Background shift registers shift during ticks 322...337. */
 		for (cycle = 322; cycle <= 337; cycle++)
-			ppu->visible_line[cycle] |= EVENT_SHIFT_BG;
+			ppu->visible_line.events[cycle] |= EVENT_SHIFT_BG;
 
 		/* Shifters are reloaded during ticks 329 and 337. */
 		for (cycle = 329; cycle <= 337; cycle += 8)
-			ppu->visible_line[cycle] |= EVENT_RELOAD_BG;
+			ppu->visible_line.events[cycle] |= EVENT_RELOAD_BG;
 
 		/* Add inc hori(v) updates during ticks 328 and 336. */
 		for (cycle = 328; cycle <= 336; cycle += 8)
-			ppu->visible_line[cycle] |= EVENT_LOOPY_INC_HORI_V;
+			ppu->visible_line.events[cycle] |= EVENT_LOOPY_INC_HORI_V;
 
 	/* Cycles 337-340 */
 		/* Two bytes are fetched, but the purpose for this is unknown.
@@ -1157,20 +1472,20 @@ void ppu_build_visible_line(struct ppu *ppu)
 			- Nametable byte
 			- Nametable byte */
 		for (cycle = 337; cycle <= 340; cycle += 4) {
-			ppu->visible_line[cycle] |= EVENT_FETCH_NT;
-			ppu->visible_line[cycle + 2] |= EVENT_FETCH_NT;
+			ppu->visible_line.events[cycle] |= EVENT_FETCH_NT;
+			ppu->visible_line.events[cycle + 2] |= EVENT_FETCH_NT;
 		}
 
 	/* Cycles 1-64 */
 		/* Secondary OAM (32-byte buffer for current sprites on
 		scanline) is initialized to $FF. */
 		cycle = 1;
-		ppu->visible_line[cycle] |= EVENT_SEC_OAM_CLEAR;
+		ppu->visible_line.events[cycle] |= EVENT_SEC_OAM_CLEAR;
 
 	/* Cycles 65-256 */
 		/* Sprite evaluation. */
 		cycle = 65;
-		ppu->visible_line[cycle] |= EVENT_SPRITE_EVAL;
+		ppu->visible_line.events[cycle] |= EVENT_SPRITE_EVAL;
 }
 
 void ppu_build_vblank_line(struct ppu *ppu)
@@ -1180,7 +1495,29 @@ void ppu_build_vblank_line(struct ppu *ppu)
 	/* Cycle 1 */
 		/* Add VBLANK set event. */
 		cycle = 1;
-		ppu->vblank_line[cycle] |= EVENT_VBLANK_SET;
+		ppu->vblank_line.events[cycle] |= EVENT_VBLANK_SET;
+}
+
+void ppu_build_blank_line(struct ppu_line *blank_line, struct ppu_line *line)
+{
+	int cycle;
+
+	/* Only keep events which matter while rendering is disabled */
+	for (cycle = 0; cycle < NUM_DOTS; cycle++)
+		blank_line->events[cycle] = line->events[cycle] & BLANK_EVENTS;
+}
+
+void ppu_build_distances(struct ppu_line *line)
+{
+	int next = NUM_DOTS;
+	int cycle;
+
+	/* Store number of dots until next event (or until end of scanline) */
+	for (cycle = NUM_DOTS - 1; cycle >= 0; cycle--) {
+		line->distances[cycle] = next - cycle;
+		if (line->events[cycle])
+			next = cycle;
+	}
 }
 
 void ppu_set_events(struct ppu *ppu)
@@ -1192,6 +1529,18 @@ void ppu_set_events(struct ppu *ppu)
 	ppu_build_visible_line(ppu);
 	ppu_build_vblank_line(ppu);
 
+	/* Build compact scanlines used while rendering is disabled */
+	ppu_build_blank_line(&ppu->blank_pre_render_line, &ppu->pre_render_line);
+	ppu_build_blank_line(&ppu->blank_visible_line, &ppu->visible_line);
+
+	/* Compute distances between events */
+	ppu_build_distances(&ppu->pre_render_line);
+	ppu_build_distances(&ppu->visible_line);
+	ppu_build_distances(&ppu->vblank_line);
+	ppu_build_distances(&ppu->idle_line);
+	ppu_build_distances(&ppu->blank_pre_render_line);
+	ppu_build_distances(&ppu->blank_visible_line);
+
 	/* Pre-render scanline (261)
 	This is a dummy scanline, whose sole purpose is to fill the
 	shift registers with the data for the first two tiles of the
@@ -1199,7 +1548,8 @@ void ppu_set_events(struct ppu *ppu)
 	scanline, the PPU still makes the same memory accesses it would
 	for a regular scanline. */
 	v = 261;
-	ppu->events[v] = ppu->pre_render_line;
+	ppu->lines[v] = &ppu->pre_render_line;
+	ppu->blank_lines[v] = &ppu->blank_pre_render_line;
 
 	/* Visible scanlines (0-239)
 	These are the visible scanlines, which contain the graphics to be
@@ -1207,15 +1557,18 @@ void ppu_set_events(struct ppu *ppu)
 	background and the sprites. During these scanlines, the PPU is busy
 	fetching data, so the program should not access PPU memory during this
 	time, unless rendering is turned off. */
-	for (v = 0; v <= 239; v++)
-		ppu->events[v] = ppu->visible_line;
+	for (v = 0; v <= 239; v++) {
+		ppu->lines[v] = &ppu->visible_line;
+		ppu->blank_lines[v] = &ppu->blank_visible_line;
+	}
 
 	/* Post-render scanline (240)
 	The PPU just idles during this scanline. Even though accessing PPU
 	memory from the program would be safe here, the VBlank flag isn't set
 	until after this scanline. */
 	v = 240;
-	ppu->events[v] = ppu->idle_line;
+	ppu->lines[v] = &ppu->idle_line;
+	ppu->blank_lines[v] = &ppu->idle_line;
 
 	/* Vertical blanking lines (241-260)
 	The VBlank flag of the PPU is set at tick 1 (the second tick) of
@@ -1223,9 +1576,12 @@ void ppu_set_events(struct ppu *ppu)
 	accesses during these scanlines, so PPU memory can be freely accessed by
 	the program. */
 	v = 241;
-	ppu->events[v] = ppu->vblank_line;
-	for (v = 242; v <= 260; v++)
-		ppu->events[v] = ppu->idle_line;
+	ppu->lines[v] = &ppu->vblank_line;
+	ppu->blank_lines[v] = &ppu->vblank_line;
+	for (v = 242; v <= 260; v++) {
+		ppu->lines[v] = &ppu->idle_line;
+		ppu->blank_lines[v] = &ppu->idle_line;
+	}
 }
 
 void ppu_update_counters(struct ppu *ppu)
@@ -1250,14 +1606,195 @@ void ppu_update_counters(struct ppu *ppu)
 		ppu->h++;
 }
 
+bool ppu_rendering(struct ppu *ppu)
+{
+	return ppu->mask.bg_visibility || ppu->mask.sprite_visibility;
+}
+
+int ppu_find_event(struct ppu *ppu)
+{
+	struct ppu_line **lines;
+	int num_dots = 0;
+	int n;
+
+	/* Select compact schedule if rendering is disabled */
+	lines = ppu_rendering(ppu) ? ppu->lines : ppu->blank_lines;
+
+	/* Jump from event to event (or from scanline to scanline) and let
+	counters handle the last dot until next event is found */
+	do {
+		n = lines[ppu->v]->distances[ppu->h];
+		ppu->h += n - 1;
+		ppu_update_counters(ppu);
+		num_dots += n;
+	} while (!lines[ppu->v]->events[ppu->h]);
+
+	return num_dots;
+}
+
+void ppu_resume_events(struct ppu *ppu)
+{
+	uint64_t cycle = ppu->tick_cycle;
+	int h = ppu->tick_h;
+	int v = ppu->tick_v;
+	int index;
+
+	/* Find first dot since last tick which machine time has not reached
+	yet (dots at current cycle are reached if PPU clock ticks first) -
+	no dot gets skipped before it as rendering was disabled */
+	index = current_clock ? current_clock->index : num_clocks;
+	do {
+		cycle += ppu->clock.div;
+		if (++h == NUM_DOTS) {
+			h = 0;
+			if (++v == NUM_SCANLINES)
+				v = 0;
+		}
+	} while ((cycle < ppu->clock.next_cycle) && ((cycle < current_cycle) ||
+		((cycle == current_cycle) && (ppu->clock.index < index))));
+
+	/* Drop lazy scanline and its deadline (it was planned while rendering
+	was disabled, so it has to be rendered dot by dot from now on) */
+	ppu->batch = false;
+	clock_set_deadline(&ppu->clock, 0);
+
+	/* Leave if next tick is already due at this dot */
+	if (cycle == ppu->clock.next_cycle)
+		return;
+
+	/* Rewind counters (undoing frame update if needed) */
+	if (v > ppu->v)
+		ppu->odd_frame = !ppu->odd_frame;
+	ppu->h = h;
+	ppu->v = v;
+
+	/* Move to next event of full schedule */
+	if (!ppu->lines[v]->events[h])
+		cycle += ppu_find_event(ppu) * ppu->clock.div;
+	clock_schedule(&ppu->clock, cycle);
+}
+
+bool ppu_can_batch(struct ppu *ppu)
+{
+	struct page *page;
+	address_t address;
+
+	/* Leave if batch rendering is disabled */
+	if (no_ppu_batch)
+		return false;
+
+	/* Pattern and name tables must be backed by host memory, as fetches
+	are then free of side effects (mappers snooping the PPU bus to clock
+	their counters need fetches to occur at their exact dot) */
+	for (address = 0; address < BATCH_END_ADDRESS;
+		address += MEM_PAGE_SIZE) {
+		page = memory_get_page(ppu->bus_id, address);
+		if (!page || !page->readb.mem)
+			return false;
+	}
+	return true;
+}
+
+void ppu_render_line(struct ppu *ppu)
+{
+	struct color colors[PALETTE_SIZE];
+	union ppu_palette_entry entry;
+	uint8_t bg[SCREEN_WIDTH + 2 * TILE_WIDTH];
+	uint8_t sprites[SCREEN_WIDTH];
+	int x;
+	int i;
+
+	/* Whole scanline is output at once */
+	TRACE_ASYNC_BEGIN("ppu_scanline");
+
+	/* Decode palette (it cannot change until scanline is complete) */
+	for (i = 0; i < PALETTE_SIZE; i++) {
+		entry.value = palette_readb(ppu->palette, i);
+		colors[i] = ppu_palette[entry.luma][entry.chroma];
+	}
+
+	/* Lay out sprites fetched during previous scanline */
+	ppu_decode_sprites(ppu, sprites);
+
+	/* Evaluate sprites during ticks 1...256 (results are only used by
+	sprite fetches starting at tick 257) */
+	ppu_sec_oam_clear(ppu);
+	ppu_sprite_eval(ppu);
+
+	/* Lay out background pixels from tiles sitting in shifters and then
+	from tiles fetched every 8 ticks between ticks 1...256 (shifters are
+	left as is, as they get entirely reloaded during ticks 321...337) */
+	memset(bg, 0, 2 * TILE_WIDTH);
+	if (ppu->mask.bg_visibility)
+		ppu_decode_bg_shifters(ppu, bg);
+	for (x = 0; x < SCREEN_WIDTH; x += TILE_WIDTH) {
+		ppu_fetch_bg_row(ppu, &bg[2 * TILE_WIDTH + x]);
+		if (x == SCREEN_WIDTH - TILE_WIDTH)
+			ppu_loopy_inc_vert_v(ppu);
+	}
+
+	/* Output pixels (ticks 2...257) */
+	for (x = 0; x < SCREEN_WIDTH; x++)
+		ppu_output_pixel(ppu,
+			x,
+			bg[x + ppu->fine_x_scroll],
+			sprites[x],
+			colors);
+
+	/* Fetch sprites for next scanline during ticks 257...320 (sprite
+	shifters are entirely reloaded, so they are not shifted above) */
+	ppu_loopy_set_hori_v(ppu);
+	for (i = 0; i < NUM_SPRITES_PER_LINE; i++)
+		ppu_fetch_sprite(ppu);
+
+	/* Fetch first two tiles for next scanline during ticks 321...337 */
+	for (x = 0; x < 2 * TILE_WIDTH; x += TILE_WIDTH) {
+		ppu_fetch_tile(ppu);
+		for (i = 0; i < TILE_WIDTH; i++)
+			ppu_shift_bg(ppu);
+		ppu_reload_bg(ppu);
+	}
+
+	/* Fetch first unused NT byte during tick 337 */
+	ppu_fetch_nt(ppu);
+
+	TRACE_ASYNC_END("ppu_scanline");
+}
+
 void ppu_tick(struct ppu *ppu)
 {
+	struct ppu_line **lines;
 	int event_mask;
 	int pos;
-	int num_cycles = 0;
+	int num_dots;
+	int v;
+
+	/* Render lazy scanline at once if it is caught up past its end (it
+	gets rendered dot by dot if it is caught up earlier, which happens when
+	the CPU accesses PPU registers or writes to a mapper mid-line) */
+	if (ppu->batch) {
+		ppu->batch = false;
+		if (clock_get_catch_up_cycle() >= ppu->clock.sync_cycle) {
+			num_dots = BATCH_END_DOT - ppu->h;
+			ppu_render_line(ppu);
+			ppu->h = BATCH_END_DOT;
+			ppu->tick_h = BATCH_END_DOT - 1;
+			ppu->tick_v = ppu->v;
+			ppu->tick_cycle = ppu->clock.next_cycle +
+				(num_dots - 1) * ppu->clock.div;
+			clock_consume(num_dots);
+			return;
+		}
+	}
+
+	/* Save tick position */
+	ppu->tick_h = ppu->h;
+	ppu->tick_v = ppu->v;
+	ppu->tick_cycle = ppu->clock.next_cycle;
 
 	/* Get event mask for current cycle */
-	event_mask = ppu->events[ppu->v][ppu->h];
+	lines = ppu_rendering(ppu) ? ppu->lines : ppu->blank_lines;
+	event_mask = lines[ppu->v]->events[ppu->h];
 
 	/* Loop through all events and fire them */
 	while ((pos = bitops_ffs(event_mask))) {
@@ -1266,14 +1803,19 @@ void ppu_tick(struct ppu *ppu)
 	}
 
 	/* Update h/v counters until next event is found */
-	do {
-		ppu_update_counters(ppu);
-		event_mask = ppu->events[ppu->v][ppu->h];
-		num_cycles++;
-	} while (!event_mask);
+	v = ppu->v;
+	num_dots = ppu_find_event(ppu);
 
 	/* Report cycle consumption */
-	clock_consume(num_cycles);
+	clock_consume(num_dots);
+
+	/* Render next visible scanline lazily if possible (clock is then only
+	scheduled once the scanline is complete, unless it is caught up) */
+	if ((ppu->v < SCREEN_HEIGHT) && (ppu->v != v) && ppu_can_batch(ppu)) {
+		ppu->batch = true;
+		clock_set_deadline(&ppu->clock, ppu->clock.next_cycle +
+			(BATCH_END_DOT - ppu->h) * ppu->clock.div);
+	}
 }
 
 bool ppu_init(struct controller_instance *instance)
@@ -1301,6 +1843,7 @@ bool ppu_init(struct controller_instance *instance)
 	ppu->region.area = res;
 	ppu->region.mops = &ppu_mops;
 	ppu->region.data = ppu;
+	ppu->region.clock = &ppu->clock;
 	memory_region_add(&ppu->region);
 
 	/* Add palette region */
@@ -1331,6 +1874,7 @@ bool ppu_init(struct controller_instance *instance)
 	ppu->clock.rate = res->data.clk;
 	ppu->clock.data = ppu;
 	ppu->clock.tick = (clock_tick_t)ppu_tick;
+	ppu->clock.watch_writes = true;
 	clock_add(&ppu->clock);
 
 	/* Prepare frame events */
@@ -1352,9 +1896,15 @@ void ppu_reset(struct controller_instance *instance)
 	ppu->h = 0;
 	ppu->v = 261;
 	ppu->sprite_counter = 0;
+	ppu->batch = false;
+
+	/* Invalidate pattern cache (it gets filled again on next fetch) */
+	memset(ppu->chr_pages, 0, sizeof(ppu->chr_pages));
+	ppu->chr_generation = memory_map_generation - 1;
 
-	/* Enable clock */
+	/* Enable clock (rendering is not lazy until next visible scanline) */
 	ppu->clock.enabled = true;
+	clock_set_deadline(&ppu->clock, 0);
 }
 
 void ppu_deinit(struct controller_instance *instance)
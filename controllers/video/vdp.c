@@ -8,6 +8,7 @@
 #include <log.h>
 #include <memory.h>
 #include <port.h>
+#include <trace.h>
 #include <util.h>
 #include <video.h>
 
@@ -198,20 +199,27 @@ static void vdp_deinit(struct controller_instance *instance);
 static void vdp_draw_line_bg(struct vdp *vdp);
 static void vdp_draw_line_sprites(struct vdp *vdp);
 static uint8_t vdp_read(struct vdp *vdp, port_t port);
+static bool vdp_stable(struct vdp *vdp, port_t port);
 static void vdp_write(struct vdp *vdp, uint8_t b, port_t port);
+static void vdp_write_bulk(struct vdp *vdp, uint8_t *buf, int count,
+	port_t port);
 static uint8_t ctrl_read(struct vdp *vdp);
 static void ctrl_write(struct vdp *vdp, uint8_t b);
 static uint8_t data_read(struct vdp *vdp);
 static void data_write(struct vdp *vdp, uint8_t b);
 static uint8_t scanline_read(struct vdp *vdp, port_t port);
+static bool scanline_stable(struct vdp *vdp, port_t port);
 
 static struct pops vdp_pops = {
 	.read = (read_t)vdp_read,
-	.write = (write_t)vdp_write
+	.write = (write_t)vdp_write,
+	.write_bulk = (write_bulk_t)vdp_write_bulk,
+	.stable = (port_stable_t)vdp_stable
 };
 
 static struct pops scanline_pops = {
-	.read = (read_t)scanline_read
+	.read = (read_t)scanline_read,
+	.stable = (port_stable_t)scanline_stable
 };
 
 uint8_t ctrl_read(struct vdp *vdp)
@@ -315,6 +323,24 @@ uint8_t vdp_read(struct vdp *vdp, port_t port)
 	return 0;
 }
 
+bool vdp_stable(struct vdp *vdp, port_t port)
+{
+	union status status;
+
+	switch (port) {
+	case DATA_PORT:
+		/* Reading data updates buffer and address */
+		return false;
+	case CTRL_PORT:
+		/* Reading control port only resets first write flag and status */
+		status.raw = 0;
+		status.reserved = 0x1F;
+		return vdp->cmd_first_write && (vdp->status.raw == status.raw);
+	default:
+		return true;
+	}
+}
+
 void vdp_write(struct vdp *vdp, uint8_t b, port_t port)
 {
 	/* Call appropriate port write function */
@@ -330,12 +356,46 @@ void vdp_write(struct vdp *vdp, uint8_t b, port_t port)
 	}
 }
 
+void vdp_write_bulk(struct vdp *vdp, uint8_t *buf, int count, port_t port)
+{
+	int address;
+	int n;
+
+	/* Write bytes one by one unless they go to VRAM through data port */
+	if ((port != DATA_PORT) || (vdp->code == 3)) {
+		while (count-- > 0)
+			vdp_write(vdp, *buf++, port);
+		return;
+	}
+
+	/* Copy bytes to VRAM (wrapping past $3FFF) */
+	while (count > 0) {
+		address = vdp->address;
+		n = VRAM_SIZE - address;
+		if (n > count)
+			n = count;
+		memcpy(&vdp->vram[address], buf, n);
+		vdp->address += n;
+		buf += n;
+		count -= n;
+	}
+
+	/* Read buffer gets loaded with last value written */
+	vdp->read_buffer = buf[-1];
+}
+
 uint8_t scanline_read(struct vdp *vdp, port_t UNUSED(port))
 {
 	/* Return current scanline index */
 	return vdp->v_counter;
 }
 
+bool scanline_stable(struct vdp *UNUSED(vdp), port_t UNUSED(port))
+{
+	/* Scanline counter is read without side effects */
+	return true;
+}
+
 void vdp_draw_line_bg(struct vdp *vdp)
 {
 	union vdp_addr vdp_addr;
@@ -632,10 +692,12 @@ void vdp_tick(struct vdp *vdp)
 {
 	/* Draw current line if within bounds */
 	if (vdp->v_counter < SCREEN_HEIGHT) {
+		TRACE_BEGIN("vdp_scanline");
 		video_lock();
 		vdp_draw_line_bg(vdp);
 		vdp_draw_line_sprites(vdp);
 		video_unlock();
+		TRACE_END("vdp_scanline");
 	}
 
 	/* Handle line counter */
@@ -14,6 +14,7 @@
 #endif
 #include <log.h>
 #include <memory.h>
+#include <trace.h>
 #include <util.h>
 #include <video.h>
 
@@ -59,8 +60,10 @@ struct chip8 {
 	uint8_t ST;
 	union opcode opcode;
 	uint16_t stack[STACK_SIZE];
+	uint64_t screen[SCREEN_HEIGHT];
 	int bus_id;
 	struct clock cpu_clock;
+	struct cpu_instance *instance;
 	struct clock counters_clock;
 	struct clock draw_clock;
 	int16_t *audio_buffer;
@@ -73,10 +76,12 @@ struct chip8 {
 static bool chip8_init(struct cpu_instance *instance);
 static void chip8_reset(struct cpu_instance *instance);
 static void chip8_deinit(struct cpu_instance *instance);
+static void chip8_step(struct chip8 *chip8);
 static void chip8_tick(struct chip8 *chip8);
 static void chip8_gen_audio(struct chip8 *chip8);
 static void chip8_update_counters(struct chip8 *chip8);
-static void chip8_draw(clock_data_t *data);
+static void chip8_draw(struct chip8 *chip8);
+static void chip8_update_screen(struct chip8 *chip8);
 static void chip8_event(int id, enum input_type type, struct chip8 *chip8);
 static inline void CLS(struct chip8 *chip8);
 static inline void RET(struct chip8 *chip8);
@@ -155,16 +160,9 @@ static struct input_desc input_descs[] = {
 #endif
 };
 
-void CLS(struct chip8 *UNUSED(chip8))
+void CLS(struct chip8 *chip8)
 {
-	uint8_t x, y;
-	struct color black = { 0, 0, 0 };
-
-	video_lock();
-	for (x = 0; x < SCREEN_WIDTH; x++)
-		for (y = 0; y < SCREEN_HEIGHT; y++)
-			video_set_pixel(x, y, black);
-	video_unlock();
+	memset(chip8->screen, 0, sizeof(chip8->screen));
 }
 
 void RET(struct chip8 *chip8)
@@ -294,24 +292,22 @@ void RND_Vx_byte(struct chip8 *chip8)
 
 void DRW_Vx_Vy_nibble(struct chip8 *chip8)
 {
-	uint8_t i, j, x, y, b, src, VF = 0;
-	struct color black = { 0, 0, 0 };
-	struct color white = { 255, 255, 255 };
-	struct color c;
-	bool pixel;
+	uint8_t i, x, y, VF = 0;
+	uint64_t row;
 
+	/* Screen rows hold leftmost pixel in their most significant bit, so a
+	sprite byte is moved to the top and rotated right to its (wrapping)
+	position, collisions being pixels set in both row and sprite */
+	x = chip8->V[chip8->opcode.x] % SCREEN_WIDTH;
 	for (i = 0; i < chip8->opcode.n; i++) {
-		b = memory_readb(chip8->bus_id, chip8->I + i);
+		row = (uint64_t)memory_readb(chip8->bus_id, chip8->I + i) <<
+			(SCREEN_WIDTH - NUM_PIXELS_PER_BYTE);
+		if (x != 0)
+			row = (row >> x) | (row << (SCREEN_WIDTH - x));
 		y = (chip8->V[chip8->opcode.y] + i) % SCREEN_HEIGHT;
-		for (j = 0; j < NUM_PIXELS_PER_BYTE; j++) {
-			x = (chip8->V[chip8->opcode.x] + j) % SCREEN_WIDTH;
-			src = b >> (NUM_PIXELS_PER_BYTE - j - 1) & 0x01;
-			c = video_get_pixel(x, y);
-			pixel = (c.r == white.r) ^ src;
-			video_set_pixel(x, y, pixel ? white : black);
-			if (src && !pixel)
-				VF = 1;
-		}
+		if (chip8->screen[y] & row)
+			VF = 1;
+		chip8->screen[y] ^= row;
 	}
 	chip8->V[0x0F] = VF;
 }
@@ -495,12 +491,25 @@ void opcode_F(struct chip8 *chip8)
 }
 
 void chip8_tick(struct chip8 *chip8)
+{
+	/* Execute instructions until next device deadline */
+	TRACE_BEGIN("chip8");
+	do
+		chip8_step(chip8);
+	while (clock_run_ahead());
+	TRACE_END("chip8");
+}
+
+void chip8_step(struct chip8 *chip8)
 {
 	/* Fetch opcode */
 	uint8_t o1 = memory_readb(chip8->bus_id, chip8->PC++);
 	uint8_t o2 = memory_readb(chip8->bus_id, chip8->PC++);
 	chip8->opcode.raw = (o1 << 8) | o2;
 
+	/* Count retired instruction */
+	chip8->instance->num_instructions++;
+
 	/* Execute opcode */
 	switch (chip8->opcode.main) {
 	case 0x00:
@@ -601,14 +610,35 @@ void chip8_update_counters(struct chip8 *chip8)
 	clock_consume(1);
 }
 
-void chip8_draw(clock_data_t *UNUSED(data))
+void chip8_draw(struct chip8 *chip8)
 {
+	/* Copy screen to frontend and display it */
+	chip8_update_screen(chip8);
 	video_update();
 
 	/* Report cycle consumption */
 	clock_consume(1);
 }
 
+void chip8_update_screen(struct chip8 *chip8)
+{
+	struct color black = { 0, 0, 0 };
+	struct color white = { 255, 255, 255 };
+	uint64_t row;
+	int x;
+	int y;
+
+	/* Set every frontend pixel from screen rows */
+	video_lock();
+	for (y = 0; y < SCREEN_HEIGHT; y++) {
+		row = chip8->screen[y];
+		for (x = 0; x < SCREEN_WIDTH; x++, row <<= 1)
+			video_set_pixel(x, y, (row >> (SCREEN_WIDTH - 1)) ?
+				white : black);
+	}
+	video_unlock();
+}
+
 static void chip8_event(int id, enum input_type type, struct chip8 *chip8)
 {
 	chip8->keys[id] = (type == EVENT_BUTTON_DOWN);
@@ -624,6 +654,7 @@ bool chip8_init(struct cpu_instance *instance)
 	/* Allocate chip8 structure and set private data */
 	chip8 = calloc(1, sizeof(struct chip8));
 	instance->priv_data = chip8;
+	chip8->instance = instance;
 
 	/* Initialize audio frontend */
 	audio_specs.freq = SAMPLING_FREQ;
@@ -666,6 +697,9 @@ bool chip8_init(struct cpu_instance *instance)
 	chip8->cpu_clock.tick = (clock_tick_t)chip8_tick;
 	clock_add(&chip8->cpu_clock);
 
+	/* Expose CPU clock for statistics */
+	instance->clock = &chip8->cpu_clock;
+
 	/* Add counters clock */
 	chip8->counters_clock.rate = COUNTERS_CLOCK_RATE;
 	chip8->counters_clock.data = chip8;
@@ -674,7 +708,8 @@ bool chip8_init(struct cpu_instance *instance)
 
 	/* Add draw clock */
 	chip8->draw_clock.rate = DRAW_CLOCK_RATE;
-	chip8->draw_clock.tick = chip8_draw;
+	chip8->draw_clock.data = chip8;
+	chip8->draw_clock.tick = (clock_tick_t)chip8_draw;
 	clock_add(&chip8->draw_clock);
 
 	return true;
@@ -683,9 +718,6 @@ bool chip8_init(struct cpu_instance *instance)
 void chip8_reset(struct cpu_instance *instance)
 {
 	struct chip8 *chip8 = instance->priv_data;
-	struct color black = { 0, 0, 0 };
-	int x;
-	int y;
 
 	/* Initialize registers */
 	memset(chip8->V, 0, NUM_REGISTERS);
@@ -696,9 +728,8 @@ void chip8_reset(struct cpu_instance *instance)
 	chip8->ST = 0;
 
 	/* Initialize screen */
-	for (y = 0; y < SCREEN_HEIGHT; y++)
-		for (x = 0; x < SCREEN_WIDTH; x++)
-			video_set_pixel(x, y, black);
+	memset(chip8->screen, 0, sizeof(chip8->screen));
+	chip8_update_screen(chip8);
 
 	/* Initialize input data */
 	memset(chip8->keys, 0, NUM_KEYS * sizeof(bool));
@@ -1,10 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <bitops.h>
 #include <clock.h>
 #include <cpu.h>
 #include <log.h>
 #include <memory.h>
+#include <trace.h>
 #include <util.h>
 
 #define DEFINE_AF_PAIR \
@@ -31,6 +33,553 @@
 #define INT_VECTOR(irq) \
 	(0x40 + (irq << 3))
 
+#define CACHE_NUM_BLOCKS	1024
+#define CACHE_MAX_UOPS		32
+
+/* Opcode table (opcode, length, instruction): unknown opcodes are handled
+by ILL */
+#define LR35902_OPCODES(X) \
+	X(0x00, 1, NOP(cpu)) \
+	X(0x01, 3, LD_rr_nn(cpu, &cpu->BC)) \
+	X(0x02, 1, LD_cBC_A(cpu)) \
+	X(0x03, 1, INC_rr(cpu, &cpu->BC)) \
+	X(0x04, 1, INC_r(cpu, &cpu->B)) \
+	X(0x05, 1, DEC_r(cpu, &cpu->B)) \
+	X(0x06, 2, LD_r_n(cpu, &cpu->B)) \
+	X(0x07, 1, RLCA(cpu)) \
+	X(0x08, 3, LD_cnn_SP(cpu)) \
+	X(0x09, 1, ADD_HL_rr(cpu, &cpu->BC)) \
+	X(0x0A, 1, LD_A_cBC(cpu)) \
+	X(0x0B, 1, DEC_rr(cpu, &cpu->BC)) \
+	X(0x0C, 1, INC_r(cpu, &cpu->C)) \
+	X(0x0D, 1, DEC_r(cpu, &cpu->C)) \
+	X(0x0E, 2, LD_r_n(cpu, &cpu->C)) \
+	X(0x0F, 1, RRCA(cpu)) \
+	X(0x10, 2, STOP(cpu)) \
+	X(0x11, 3, LD_rr_nn(cpu, &cpu->DE)) \
+	X(0x12, 1, LD_cDE_A(cpu)) \
+	X(0x13, 1, INC_rr(cpu, &cpu->DE)) \
+	X(0x14, 1, INC_r(cpu, &cpu->D)) \
+	X(0x15, 1, DEC_r(cpu, &cpu->D)) \
+	X(0x16, 2, LD_r_n(cpu, &cpu->D)) \
+	X(0x17, 1, RLA(cpu)) \
+	X(0x18, 2, JR_d(cpu)) \
+	X(0x19, 1, ADD_HL_rr(cpu, &cpu->DE)) \
+	X(0x1A, 1, LD_A_cDE(cpu)) \
+	X(0x1B, 1, DEC_rr(cpu, &cpu->DE)) \
+	X(0x1C, 1, INC_r(cpu, &cpu->E)) \
+	X(0x1D, 1, DEC_r(cpu, &cpu->E)) \
+	X(0x1E, 2, LD_r_n(cpu, &cpu->E)) \
+	X(0x1F, 1, RRA(cpu)) \
+	X(0x20, 2, JR_NZ_d(cpu)) \
+	X(0x21, 3, LD_rr_nn(cpu, &cpu->HL)) \
+	X(0x22, 1, LDI_cHL_A(cpu)) \
+	X(0x23, 1, INC_rr(cpu, &cpu->HL)) \
+	X(0x24, 1, INC_r(cpu, &cpu->H)) \
+	X(0x25, 1, DEC_r(cpu, &cpu->H)) \
+	X(0x26, 2, LD_r_n(cpu, &cpu->H)) \
+	X(0x27, 1, DAA(cpu)) \
+	X(0x28, 2, JR_Z_d(cpu)) \
+	X(0x29, 1, ADD_HL_rr(cpu, &cpu->HL)) \
+	X(0x2A, 1, LDI_A_cHL(cpu)) \
+	X(0x2B, 1, DEC_rr(cpu, &cpu->HL)) \
+	X(0x2C, 1, INC_r(cpu, &cpu->L)) \
+	X(0x2D, 1, DEC_r(cpu, &cpu->L)) \
+	X(0x2E, 2, LD_r_n(cpu, &cpu->L)) \
+	X(0x2F, 1, CPL(cpu)) \
+	X(0x30, 2, JR_NC_d(cpu)) \
+	X(0x31, 3, LD_rr_nn(cpu, &cpu->SP)) \
+	X(0x32, 1, LDD_cHL_A(cpu)) \
+	X(0x33, 1, INC_rr(cpu, &cpu->SP)) \
+	X(0x34, 1, INC_cHL(cpu)) \
+	X(0x35, 1, DEC_cHL(cpu)) \
+	X(0x36, 2, LD_cHL_n(cpu)) \
+	X(0x37, 1, SCF(cpu)) \
+	X(0x38, 2, JR_C_d(cpu)) \
+	X(0x39, 1, ADD_HL_rr(cpu, &cpu->SP)) \
+	X(0x3A, 1, LDD_A_cHL(cpu)) \
+	X(0x3B, 1, DEC_rr(cpu, &cpu->SP)) \
+	X(0x3C, 1, INC_r(cpu, &cpu->A)) \
+	X(0x3D, 1, DEC_r(cpu, &cpu->A)) \
+	X(0x3E, 2, LD_r_n(cpu, &cpu->A)) \
+	X(0x3F, 1, CCF(cpu)) \
+	X(0x40, 1, LD_r_r(cpu, &cpu->B, &cpu->B)) \
+	X(0x41, 1, LD_r_r(cpu, &cpu->B, &cpu->C)) \
+	X(0x42, 1, LD_r_r(cpu, &cpu->B, &cpu->D)) \
+	X(0x43, 1, LD_r_r(cpu, &cpu->B, &cpu->E)) \
+	X(0x44, 1, LD_r_r(cpu, &cpu->B, &cpu->H)) \
+	X(0x45, 1, LD_r_r(cpu, &cpu->B, &cpu->L)) \
+	X(0x46, 1, LD_r_cHL(cpu, &cpu->B)) \
+	X(0x47, 1, LD_r_r(cpu, &cpu->B, &cpu->A)) \
+	X(0x48, 1, LD_r_r(cpu, &cpu->C, &cpu->B)) \
+	X(0x49, 1, LD_r_r(cpu, &cpu->C, &cpu->C)) \
+	X(0x4A, 1, LD_r_r(cpu, &cpu->C, &cpu->D)) \
+	X(0x4B, 1, LD_r_r(cpu, &cpu->C, &cpu->E)) \
+	X(0x4C, 1, LD_r_r(cpu, &cpu->C, &cpu->H)) \
+	X(0x4D, 1, LD_r_r(cpu, &cpu->C, &cpu->L)) \
+	X(0x4E, 1, LD_r_cHL(cpu, &cpu->C)) \
+	X(0x4F, 1, LD_r_r(cpu, &cpu->C, &cpu->A)) \
+	X(0x50, 1, LD_r_r(cpu, &cpu->D, &cpu->B)) \
+	X(0x51, 1, LD_r_r(cpu, &cpu->D, &cpu->C)) \
+	X(0x52, 1, LD_r_r(cpu, &cpu->D, &cpu->D)) \
+	X(0x53, 1, LD_r_r(cpu, &cpu->D, &cpu->E)) \
+	X(0x54, 1, LD_r_r(cpu, &cpu->D, &cpu->H)) \
+	X(0x55, 1, LD_r_r(cpu, &cpu->D, &cpu->L)) \
+	X(0x56, 1, LD_r_cHL(cpu, &cpu->D)) \
+	X(0x57, 1, LD_r_r(cpu, &cpu->D, &cpu->A)) \
+	X(0x58, 1, LD_r_r(cpu, &cpu->E, &cpu->B)) \
+	X(0x59, 1, LD_r_r(cpu, &cpu->E, &cpu->C)) \
+	X(0x5A, 1, LD_r_r(cpu, &cpu->E, &cpu->D)) \
+	X(0x5B, 1, LD_r_r(cpu, &cpu->E, &cpu->E)) \
+	X(0x5C, 1, LD_r_r(cpu, &cpu->E, &cpu->H)) \
+	X(0x5D, 1, LD_r_r(cpu, &cpu->E, &cpu->L)) \
+	X(0x5E, 1, LD_r_cHL(cpu, &cpu->E)) \
+	X(0x5F, 1, LD_r_r(cpu, &cpu->E, &cpu->A)) \
+	X(0x60, 1, LD_r_r(cpu, &cpu->H, &cpu->B)) \
+	X(0x61, 1, LD_r_r(cpu, &cpu->H, &cpu->C)) \
+	X(0x62, 1, LD_r_r(cpu, &cpu->H, &cpu->D)) \
+	X(0x63, 1, LD_r_r(cpu, &cpu->H, &cpu->E)) \
+	X(0x64, 1, LD_r_r(cpu, &cpu->H, &cpu->H)) \
+	X(0x65, 1, LD_r_r(cpu, &cpu->H, &cpu->L)) \
+	X(0x66, 1, LD_r_cHL(cpu, &cpu->H)) \
+	X(0x67, 1, LD_r_r(cpu, &cpu->H, &cpu->A)) \
+	X(0x68, 1, LD_r_r(cpu, &cpu->L, &cpu->B)) \
+	X(0x69, 1, LD_r_r(cpu, &cpu->L, &cpu->C)) \
+	X(0x6A, 1, LD_r_r(cpu, &cpu->L, &cpu->D)) \
+	X(0x6B, 1, LD_r_r(cpu, &cpu->L, &cpu->E)) \
+	X(0x6C, 1, LD_r_r(cpu, &cpu->L, &cpu->H)) \
+	X(0x6D, 1, LD_r_r(cpu, &cpu->L, &cpu->L)) \
+	X(0x6E, 1, LD_r_cHL(cpu, &cpu->L)) \
+	X(0x6F, 1, LD_r_r(cpu, &cpu->L, &cpu->A)) \
+	X(0x70, 1, LD_cHL_r(cpu, &cpu->B)) \
+	X(0x71, 1, LD_cHL_r(cpu, &cpu->C)) \
+	X(0x72, 1, LD_cHL_r(cpu, &cpu->D)) \
+	X(0x73, 1, LD_cHL_r(cpu, &cpu->E)) \
+	X(0x74, 1, LD_cHL_r(cpu, &cpu->H)) \
+	X(0x75, 1, LD_cHL_r(cpu, &cpu->L)) \
+	X(0x76, 1, HALT(cpu)) \
+	X(0x77, 1, LD_cHL_r(cpu, &cpu->A)) \
+	X(0x78, 1, LD_r_r(cpu, &cpu->A, &cpu->B)) \
+	X(0x79, 1, LD_r_r(cpu, &cpu->A, &cpu->C)) \
+	X(0x7A, 1, LD_r_r(cpu, &cpu->A, &cpu->D)) \
+	X(0x7B, 1, LD_r_r(cpu, &cpu->A, &cpu->E)) \
+	X(0x7C, 1, LD_r_r(cpu, &cpu->A, &cpu->H)) \
+	X(0x7D, 1, LD_r_r(cpu, &cpu->A, &cpu->L)) \
+	X(0x7E, 1, LD_r_cHL(cpu, &cpu->A)) \
+	X(0x7F, 1, LD_r_r(cpu, &cpu->A, &cpu->A)) \
+	X(0x80, 1, ADD_A_r(cpu, &cpu->B)) \
+	X(0x81, 1, ADD_A_r(cpu, &cpu->C)) \
+	X(0x82, 1, ADD_A_r(cpu, &cpu->D)) \
+	X(0x83, 1, ADD_A_r(cpu, &cpu->E)) \
+	X(0x84, 1, ADD_A_r(cpu, &cpu->H)) \
+	X(0x85, 1, ADD_A_r(cpu, &cpu->L)) \
+	X(0x86, 1, ADD_A_cHL(cpu)) \
+	X(0x87, 1, ADD_A_r(cpu, &cpu->A)) \
+	X(0x88, 1, ADC_A_r(cpu, &cpu->B)) \
+	X(0x89, 1, ADC_A_r(cpu, &cpu->C)) \
+	X(0x8A, 1, ADC_A_r(cpu, &cpu->D)) \
+	X(0x8B, 1, ADC_A_r(cpu, &cpu->E)) \
+	X(0x8C, 1, ADC_A_r(cpu, &cpu->H)) \
+	X(0x8D, 1, ADC_A_r(cpu, &cpu->L)) \
+	X(0x8E, 1, ADC_A_cHL(cpu)) \
+	X(0x8F, 1, ADC_A_r(cpu, &cpu->A)) \
+	X(0x90, 1, SUB_A_r(cpu, &cpu->B)) \
+	X(0x91, 1, SUB_A_r(cpu, &cpu->C)) \
+	X(0x92, 1, SUB_A_r(cpu, &cpu->D)) \
+	X(0x93, 1, SUB_A_r(cpu, &cpu->E)) \
+	X(0x94, 1, SUB_A_r(cpu, &cpu->H)) \
+	X(0x95, 1, SUB_A_r(cpu, &cpu->L)) \
+	X(0x96, 1, SUB_A_cHL(cpu)) \
+	X(0x97, 1, SUB_A_r(cpu, &cpu->A)) \
+	X(0x98, 1, SBC_A_r(cpu, &cpu->B)) \
+	X(0x99, 1, SBC_A_r(cpu, &cpu->C)) \
+	X(0x9A, 1, SBC_A_r(cpu, &cpu->D)) \
+	X(0x9B, 1, SBC_A_r(cpu, &cpu->E)) \
+	X(0x9C, 1, SBC_A_r(cpu, &cpu->H)) \
+	X(0x9D, 1, SBC_A_r(cpu, &cpu->L)) \
+	X(0x9E, 1, SBC_A_cHL(cpu)) \
+	X(0x9F, 1, SBC_A_r(cpu, &cpu->A)) \
+	X(0xA0, 1, AND_r(cpu, &cpu->B)) \
+	X(0xA1, 1, AND_r(cpu, &cpu->C)) \
+	X(0xA2, 1, AND_r(cpu, &cpu->D)) \
+	X(0xA3, 1, AND_r(cpu, &cpu->E)) \
+	X(0xA4, 1, AND_r(cpu, &cpu->H)) \
+	X(0xA5, 1, AND_r(cpu, &cpu->L)) \
+	X(0xA6, 1, AND_cHL(cpu)) \
+	X(0xA7, 1, AND_r(cpu, &cpu->A)) \
+	X(0xA8, 1, XOR_r(cpu, &cpu->B)) \
+	X(0xA9, 1, XOR_r(cpu, &cpu->C)) \
+	X(0xAA, 1, XOR_r(cpu, &cpu->D)) \
+	X(0xAB, 1, XOR_r(cpu, &cpu->E)) \
+	X(0xAC, 1, XOR_r(cpu, &cpu->H)) \
+	X(0xAD, 1, XOR_r(cpu, &cpu->L)) \
+	X(0xAE, 1, XOR_cHL(cpu)) \
+	X(0xAF, 1, XOR_r(cpu, &cpu->A)) \
+	X(0xB0, 1, OR_r(cpu, &cpu->B)) \
+	X(0xB1, 1, OR_r(cpu, &cpu->C)) \
+	X(0xB2, 1, OR_r(cpu, &cpu->D)) \
+	X(0xB3, 1, OR_r(cpu, &cpu->E)) \
+	X(0xB4, 1, OR_r(cpu, &cpu->H)) \
+	X(0xB5, 1, OR_r(cpu, &cpu->L)) \
+	X(0xB6, 1, OR_cHL(cpu)) \
+	X(0xB7, 1, OR_r(cpu, &cpu->A)) \
+	X(0xB8, 1, CP_r(cpu, &cpu->B)) \
+	X(0xB9, 1, CP_r(cpu, &cpu->C)) \
+	X(0xBA, 1, CP_r(cpu, &cpu->D)) \
+	X(0xBB, 1, CP_r(cpu, &cpu->E)) \
+	X(0xBC, 1, CP_r(cpu, &cpu->H)) \
+	X(0xBD, 1, CP_r(cpu, &cpu->L)) \
+	X(0xBE, 1, CP_cHL(cpu)) \
+	X(0xBF, 1, CP_r(cpu, &cpu->A)) \
+	X(0xC0, 1, RET_NZ(cpu)) \
+	X(0xC1, 1, POP_rr(cpu, &cpu->BC)) \
+	X(0xC2, 3, JP_NZ_nn(cpu)) \
+	X(0xC3, 3, JP_nn(cpu)) \
+	X(0xC4, 3, CALL_NZ_nn(cpu)) \
+	X(0xC5, 1, PUSH_rr(cpu, &cpu->BC)) \
+	X(0xC6, 2, ADD_A_n(cpu)) \
+	X(0xC7, 1, RST_n(cpu, 0x00)) \
+	X(0xC8, 1, RET_Z(cpu)) \
+	X(0xC9, 1, RET(cpu)) \
+	X(0xCA, 3, JP_Z_nn(cpu)) \
+	X(0xCB, 2, lr35902_opcode_CB(cpu)) \
+	X(0xCC, 3, CALL_Z_nn(cpu)) \
+	X(0xCD, 3, CALL_nn(cpu)) \
+	X(0xCE, 2, ADC_A_n(cpu)) \
+	X(0xCF, 1, RST_n(cpu, 0x08)) \
+	X(0xD0, 1, RET_NC(cpu)) \
+	X(0xD1, 1, POP_rr(cpu, &cpu->DE)) \
+	X(0xD2, 3, JP_NC_nn(cpu)) \
+	X(0xD3, 1, ILL(cpu)) \
+	X(0xD4, 3, CALL_NC_nn(cpu)) \
+	X(0xD5, 1, PUSH_rr(cpu, &cpu->DE)) \
+	X(0xD6, 2, SUB_A_n(cpu)) \
+	X(0xD7, 1, RST_n(cpu, 0x10)) \
+	X(0xD8, 1, RET_C(cpu)) \
+	X(0xD9, 1, RETI(cpu)) \
+	X(0xDA, 3, JP_C_nn(cpu)) \
+	X(0xDB, 1, ILL(cpu)) \
+	X(0xDC, 3, CALL_C_nn(cpu)) \
+	X(0xDD, 1, ILL(cpu)) \
+	X(0xDE, 2, SBC_A_n(cpu)) \
+	X(0xDF, 1, RST_n(cpu, 0x18)) \
+	X(0xE0, 2, LD_cFF00pn_A(cpu)) \
+	X(0xE1, 1, POP_rr(cpu, &cpu->HL)) \
+	X(0xE2, 1, LD_cFF00pC_A(cpu)) \
+	X(0xE3, 1, ILL(cpu)) \
+	X(0xE4, 1, ILL(cpu)) \
+	X(0xE5, 1, PUSH_rr(cpu, &cpu->HL)) \
+	X(0xE6, 2, AND_n(cpu)) \
+	X(0xE7, 1, RST_n(cpu, 0x20)) \
+	X(0xE8, 2, ADD_SP_d(cpu)) \
+	X(0xE9, 1, JP_HL(cpu)) \
+	X(0xEA, 3, LD_cnn_A(cpu)) \
+	X(0xEB, 1, ILL(cpu)) \
+	X(0xEC, 1, ILL(cpu)) \
+	X(0xED, 1, ILL(cpu)) \
+	X(0xEE, 2, XOR_n(cpu)) \
+	X(0xEF, 1, RST_n(cpu, 0x28)) \
+	X(0xF0, 2, LD_A_cFF00pn(cpu)) \
+	X(0xF1, 1, POP_AF(cpu)) \
+	X(0xF2, 1, LD_A_cFF00pC(cpu)) \
+	X(0xF3, 1, DI(cpu)) \
+	X(0xF4, 1, ILL(cpu)) \
+	X(0xF5, 1, PUSH_AF(cpu)) \
+	X(0xF6, 2, OR_n(cpu)) \
+	X(0xF7, 1, RST_n(cpu, 0x30)) \
+	X(0xF8, 2, LD_HL_SPpd(cpu)) \
+	X(0xF9, 1, LD_SP_HL(cpu)) \
+	X(0xFA, 3, LD_A_cnn(cpu)) \
+	X(0xFB, 1, EI(cpu)) \
+	X(0xFC, 1, ILL(cpu)) \
+	X(0xFD, 1, ILL(cpu)) \
+	X(0xFE, 2, CP_n(cpu)) \
+	X(0xFF, 1, RST_n(cpu, 0x38))
+
+/* CB-prefixed opcode table (opcode, instruction) */
+#define LR35902_CB_OPCODES(X) \
+	X(0x00, RLC_r(cpu, &cpu->B)) \
+	X(0x01, RLC_r(cpu, &cpu->C)) \
+	X(0x02, RLC_r(cpu, &cpu->D)) \
+	X(0x03, RLC_r(cpu, &cpu->E)) \
+	X(0x04, RLC_r(cpu, &cpu->H)) \
+	X(0x05, RLC_r(cpu, &cpu->L)) \
+	X(0x06, RLC_cHL(cpu)) \
+	X(0x07, RLC_r(cpu, &cpu->A)) \
+	X(0x08, RRC_r(cpu, &cpu->B)) \
+	X(0x09, RRC_r(cpu, &cpu->C)) \
+	X(0x0A, RRC_r(cpu, &cpu->D)) \
+	X(0x0B, RRC_r(cpu, &cpu->E)) \
+	X(0x0C, RRC_r(cpu, &cpu->H)) \
+	X(0x0D, RRC_r(cpu, &cpu->L)) \
+	X(0x0E, RRC_cHL(cpu)) \
+	X(0x0F, RRC_r(cpu, &cpu->A)) \
+	X(0x10, RL_r(cpu, &cpu->B)) \
+	X(0x11, RL_r(cpu, &cpu->C)) \
+	X(0x12, RL_r(cpu, &cpu->D)) \
+	X(0x13, RL_r(cpu, &cpu->E)) \
+	X(0x14, RL_r(cpu, &cpu->H)) \
+	X(0x15, RL_r(cpu, &cpu->L)) \
+	X(0x16, RL_cHL(cpu)) \
+	X(0x17, RL_r(cpu, &cpu->A)) \
+	X(0x18, RR_r(cpu, &cpu->B)) \
+	X(0x19, RR_r(cpu, &cpu->C)) \
+	X(0x1A, RR_r(cpu, &cpu->D)) \
+	X(0x1B, RR_r(cpu, &cpu->E)) \
+	X(0x1C, RR_r(cpu, &cpu->H)) \
+	X(0x1D, RR_r(cpu, &cpu->L)) \
+	X(0x1E, RR_cHL(cpu)) \
+	X(0x1F, RR_r(cpu, &cpu->A)) \
+	X(0x20, SLA_r(cpu, &cpu->B)) \
+	X(0x21, SLA_r(cpu, &cpu->C)) \
+	X(0x22, SLA_r(cpu, &cpu->D)) \
+	X(0x23, SLA_r(cpu, &cpu->E)) \
+	X(0x24, SLA_r(cpu, &cpu->H)) \
+	X(0x25, SLA_r(cpu, &cpu->L)) \
+	X(0x26, SLA_cHL(cpu)) \
+	X(0x27, SLA_r(cpu, &cpu->A)) \
+	X(0x28, SRA_r(cpu, &cpu->B)) \
+	X(0x29, SRA_r(cpu, &cpu->C)) \
+	X(0x2A, SRA_r(cpu, &cpu->D)) \
+	X(0x2B, SRA_r(cpu, &cpu->E)) \
+	X(0x2C, SRA_r(cpu, &cpu->H)) \
+	X(0x2D, SRA_r(cpu, &cpu->L)) \
+	X(0x2E, SRA_cHL(cpu)) \
+	X(0x2F, SRA_r(cpu, &cpu->A)) \
+	X(0x30, SWAP_r(cpu, &cpu->B)) \
+	X(0x31, SWAP_r(cpu, &cpu->C)) \
+	X(0x32, SWAP_r(cpu, &cpu->D)) \
+	X(0x33, SWAP_r(cpu, &cpu->E)) \
+	X(0x34, SWAP_r(cpu, &cpu->H)) \
+	X(0x35, SWAP_r(cpu, &cpu->L)) \
+	X(0x36, SWAP_cHL(cpu)) \
+	X(0x37, SWAP_r(cpu, &cpu->A)) \
+	X(0x38, SRL_r(cpu, &cpu->B)) \
+	X(0x39, SRL_r(cpu, &cpu->C)) \
+	X(0x3A, SRL_r(cpu, &cpu->D)) \
+	X(0x3B, SRL_r(cpu, &cpu->E)) \
+	X(0x3C, SRL_r(cpu, &cpu->H)) \
+	X(0x3D, SRL_r(cpu, &cpu->L)) \
+	X(0x3E, SRL_cHL(cpu)) \
+	X(0x3F, SRL_r(cpu, &cpu->A)) \
+	X(0x40, BIT_n_r(cpu, 0, &cpu->B)) \
+	X(0x41, BIT_n_r(cpu, 0, &cpu->C)) \
+	X(0x42, BIT_n_r(cpu, 0, &cpu->D)) \
+	X(0x43, BIT_n_r(cpu, 0, &cpu->E)) \
+	X(0x44, BIT_n_r(cpu, 0, &cpu->H)) \
+	X(0x45, BIT_n_r(cpu, 0, &cpu->L)) \
+	X(0x46, BIT_n_cHL(cpu, 0)) \
+	X(0x47, BIT_n_r(cpu, 0, &cpu->A)) \
+	X(0x48, BIT_n_r(cpu, 1, &cpu->B)) \
+	X(0x49, BIT_n_r(cpu, 1, &cpu->C)) \
+	X(0x4A, BIT_n_r(cpu, 1, &cpu->D)) \
+	X(0x4B, BIT_n_r(cpu, 1, &cpu->E)) \
+	X(0x4C, BIT_n_r(cpu, 1, &cpu->H)) \
+	X(0x4D, BIT_n_r(cpu, 1, &cpu->L)) \
+	X(0x4E, BIT_n_cHL(cpu, 1)) \
+	X(0x4F, BIT_n_r(cpu, 1, &cpu->A)) \
+	X(0x50, BIT_n_r(cpu, 2, &cpu->B)) \
+	X(0x51, BIT_n_r(cpu, 2, &cpu->C)) \
+	X(0x52, BIT_n_r(cpu, 2, &cpu->D)) \
+	X(0x53, BIT_n_r(cpu, 2, &cpu->E)) \
+	X(0x54, BIT_n_r(cpu, 2, &cpu->H)) \
+	X(0x55, BIT_n_r(cpu, 2, &cpu->L)) \
+	X(0x56, BIT_n_cHL(cpu, 2)) \
+	X(0x57, BIT_n_r(cpu, 2, &cpu->A)) \
+	X(0x58, BIT_n_r(cpu, 3, &cpu->B)) \
+	X(0x59, BIT_n_r(cpu, 3, &cpu->C)) \
+	X(0x5A, BIT_n_r(cpu, 3, &cpu->D)) \
+	X(0x5B, BIT_n_r(cpu, 3, &cpu->E)) \
+	X(0x5C, BIT_n_r(cpu, 3, &cpu->H)) \
+	X(0x5D, BIT_n_r(cpu, 3, &cpu->L)) \
+	X(0x5E, BIT_n_cHL(cpu, 3)) \
+	X(0x5F, BIT_n_r(cpu, 3, &cpu->A)) \
+	X(0x60, BIT_n_r(cpu, 4, &cpu->B)) \
+	X(0x61, BIT_n_r(cpu, 4, &cpu->C)) \
+	X(0x62, BIT_n_r(cpu, 4, &cpu->D)) \
+	X(0x63, BIT_n_r(cpu, 4, &cpu->E)) \
+	X(0x64, BIT_n_r(cpu, 4, &cpu->H)) \
+	X(0x65, BIT_n_r(cpu, 4, &cpu->L)) \
+	X(0x66, BIT_n_cHL(cpu, 4)) \
+	X(0x67, BIT_n_r(cpu, 4, &cpu->A)) \
+	X(0x68, BIT_n_r(cpu, 5, &cpu->B)) \
+	X(0x69, BIT_n_r(cpu, 5, &cpu->C)) \
+	X(0x6A, BIT_n_r(cpu, 5, &cpu->D)) \
+	X(0x6B, BIT_n_r(cpu, 5, &cpu->E)) \
+	X(0x6C, BIT_n_r(cpu, 5, &cpu->H)) \
+	X(0x6D, BIT_n_r(cpu, 5, &cpu->L)) \
+	X(0x6E, BIT_n_cHL(cpu, 5)) \
+	X(0x6F, BIT_n_r(cpu, 5, &cpu->A)) \
+	X(0x70, BIT_n_r(cpu, 6, &cpu->B)) \
+	X(0x71, BIT_n_r(cpu, 6, &cpu->C)) \
+	X(0x72, BIT_n_r(cpu, 6, &cpu->D)) \
+	X(0x73, BIT_n_r(cpu, 6, &cpu->E)) \
+	X(0x74, BIT_n_r(cpu, 6, &cpu->H)) \
+	X(0x75, BIT_n_r(cpu, 6, &cpu->L)) \
+	X(0x76, BIT_n_cHL(cpu, 6)) \
+	X(0x77, BIT_n_r(cpu, 6, &cpu->A)) \
+	X(0x78, BIT_n_r(cpu, 7, &cpu->B)) \
+	X(0x79, BIT_n_r(cpu, 7, &cpu->C)) \
+	X(0x7A, BIT_n_r(cpu, 7, &cpu->D)) \
+	X(0x7B, BIT_n_r(cpu, 7, &cpu->E)) \
+	X(0x7C, BIT_n_r(cpu, 7, &cpu->H)) \
+	X(0x7D, BIT_n_r(cpu, 7, &cpu->L)) \
+	X(0x7E, BIT_n_cHL(cpu, 7)) \
+	X(0x7F, BIT_n_r(cpu, 7, &cpu->A)) \
+	X(0x80, RES_n_r(cpu, 0, &cpu->B)) \
+	X(0x81, RES_n_r(cpu, 0, &cpu->C)) \
+	X(0x82, RES_n_r(cpu, 0, &cpu->D)) \
+	X(0x83, RES_n_r(cpu, 0, &cpu->E)) \
+	X(0x84, RES_n_r(cpu, 0, &cpu->H)) \
+	X(0x85, RES_n_r(cpu, 0, &cpu->L)) \
+	X(0x86, RES_n_cHL(cpu, 0)) \
+	X(0x87, RES_n_r(cpu, 0, &cpu->A)) \
+	X(0x88, RES_n_r(cpu, 1, &cpu->B)) \
+	X(0x89, RES_n_r(cpu, 1, &cpu->C)) \
+	X(0x8A, RES_n_r(cpu, 1, &cpu->D)) \
+	X(0x8B, RES_n_r(cpu, 1, &cpu->E)) \
+	X(0x8C, RES_n_r(cpu, 1, &cpu->H)) \
+	X(0x8D, RES_n_r(cpu, 1, &cpu->L)) \
+	X(0x8E, RES_n_cHL(cpu, 1)) \
+	X(0x8F, RES_n_r(cpu, 1, &cpu->A)) \
+	X(0x90, RES_n_r(cpu, 2, &cpu->B)) \
+	X(0x91, RES_n_r(cpu, 2, &cpu->C)) \
+	X(0x92, RES_n_r(cpu, 2, &cpu->D)) \
+	X(0x93, RES_n_r(cpu, 2, &cpu->E)) \
+	X(0x94, RES_n_r(cpu, 2, &cpu->H)) \
+	X(0x95, RES_n_r(cpu, 2, &cpu->L)) \
+	X(0x96, RES_n_cHL(cpu, 2)) \
+	X(0x97, RES_n_r(cpu, 2, &cpu->A)) \
+	X(0x98, RES_n_r(cpu, 3, &cpu->B)) \
+	X(0x99, RES_n_r(cpu, 3, &cpu->C)) \
+	X(0x9A, RES_n_r(cpu, 3, &cpu->D)) \
+	X(0x9B, RES_n_r(cpu, 3, &cpu->E)) \
+	X(0x9C, RES_n_r(cpu, 3, &cpu->H)) \
+	X(0x9D, RES_n_r(cpu, 3, &cpu->L)) \
+	X(0x9E, RES_n_cHL(cpu, 3)) \
+	X(0x9F, RES_n_r(cpu, 3, &cpu->A)) \
+	X(0xA0, RES_n_r(cpu, 4, &cpu->B)) \
+	X(0xA1, RES_n_r(cpu, 4, &cpu->C)) \
+	X(0xA2, RES_n_r(cpu, 4, &cpu->D)) \
+	X(0xA3, RES_n_r(cpu, 4, &cpu->E)) \
+	X(0xA4, RES_n_r(cpu, 4, &cpu->H)) \
+	X(0xA5, RES_n_r(cpu, 4, &cpu->L)) \
+	X(0xA6, RES_n_cHL(cpu, 4)) \
+	X(0xA7, RES_n_r(cpu, 4, &cpu->A)) \
+	X(0xA8, RES_n_r(cpu, 5, &cpu->B)) \
+	X(0xA9, RES_n_r(cpu, 5, &cpu->C)) \
+	X(0xAA, RES_n_r(cpu, 5, &cpu->D)) \
+	X(0xAB, RES_n_r(cpu, 5, &cpu->E)) \
+	X(0xAC, RES_n_r(cpu, 5, &cpu->H)) \
+	X(0xAD, RES_n_r(cpu, 5, &cpu->L)) \
+	X(0xAE, RES_n_cHL(cpu, 5)) \
+	X(0xAF, RES_n_r(cpu, 5, &cpu->A)) \
+	X(0xB0, RES_n_r(cpu, 6, &cpu->B)) \
+	X(0xB1, RES_n_r(cpu, 6, &cpu->C)) \
+	X(0xB2, RES_n_r(cpu, 6, &cpu->D)) \
+	X(0xB3, RES_n_r(cpu, 6, &cpu->E)) \
+	X(0xB4, RES_n_r(cpu, 6, &cpu->H)) \
+	X(0xB5, RES_n_r(cpu, 6, &cpu->L)) \
+	X(0xB6, RES_n_cHL(cpu, 6)) \
+	X(0xB7, RES_n_r(cpu, 6, &cpu->A)) \
+	X(0xB8, RES_n_r(cpu, 7, &cpu->B)) \
+	X(0xB9, RES_n_r(cpu, 7, &cpu->C)) \
+	X(0xBA, RES_n_r(cpu, 7, &cpu->D)) \
+	X(0xBB, RES_n_r(cpu, 7, &cpu->E)) \
+	X(0xBC, RES_n_r(cpu, 7, &cpu->H)) \
+	X(0xBD, RES_n_r(cpu, 7, &cpu->L)) \
+	X(0xBE, RES_n_cHL(cpu, 7)) \
+	X(0xBF, RES_n_r(cpu, 7, &cpu->A)) \
+	X(0xC0, SET_n_r(cpu, 0, &cpu->B)) \
+	X(0xC1, SET_n_r(cpu, 0, &cpu->C)) \
+	X(0xC2, SET_n_r(cpu, 0, &cpu->D)) \
+	X(0xC3, SET_n_r(cpu, 0, &cpu->E)) \
+	X(0xC4, SET_n_r(cpu, 0, &cpu->H)) \
+	X(0xC5, SET_n_r(cpu, 0, &cpu->L)) \
+	X(0xC6, SET_n_cHL(cpu, 0)) \
+	X(0xC7, SET_n_r(cpu, 0, &cpu->A)) \
+	X(0xC8, SET_n_r(cpu, 1, &cpu->B)) \
+	X(0xC9, SET_n_r(cpu, 1, &cpu->C)) \
+	X(0xCA, SET_n_r(cpu, 1, &cpu->D)) \
+	X(0xCB, SET_n_r(cpu, 1, &cpu->E)) \
+	X(0xCC, SET_n_r(cpu, 1, &cpu->H)) \
+	X(0xCD, SET_n_r(cpu, 1, &cpu->L)) \
+	X(0xCE, SET_n_cHL(cpu, 1)) \
+	X(0xCF, SET_n_r(cpu, 1, &cpu->A)) \
+	X(0xD0, SET_n_r(cpu, 2, &cpu->B)) \
+	X(0xD1, SET_n_r(cpu, 2, &cpu->C)) \
+	X(0xD2, SET_n_r(cpu, 2, &cpu->D)) \
+	X(0xD3, SET_n_r(cpu, 2, &cpu->E)) \
+	X(0xD4, SET_n_r(cpu, 2, &cpu->H)) \
+	X(0xD5, SET_n_r(cpu, 2, &cpu->L)) \
+	X(0xD6, SET_n_cHL(cpu, 2)) \
+	X(0xD7, SET_n_r(cpu, 2, &cpu->A)) \
+	X(0xD8, SET_n_r(cpu, 3, &cpu->B)) \
+	X(0xD9, SET_n_r(cpu, 3, &cpu->C)) \
+	X(0xDA, SET_n_r(cpu, 3, &cpu->D)) \
+	X(0xDB, SET_n_r(cpu, 3, &cpu->E)) \
+	X(0xDC, SET_n_r(cpu, 3, &cpu->H)) \
+	X(0xDD, SET_n_r(cpu, 3, &cpu->L)) \
+	X(0xDE, SET_n_cHL(cpu, 3)) \
+	X(0xDF, SET_n_r(cpu, 3, &cpu->A)) \
+	X(0xE0, SET_n_r(cpu, 4, &cpu->B)) \
+	X(0xE1, SET_n_r(cpu, 4, &cpu->C)) \
+	X(0xE2, SET_n_r(cpu, 4, &cpu->D)) \
+	X(0xE3, SET_n_r(cpu, 4, &cpu->E)) \
+	X(0xE4, SET_n_r(cpu, 4, &cpu->H)) \
+	X(0xE5, SET_n_r(cpu, 4, &cpu->L)) \
+	X(0xE6, SET_n_cHL(cpu, 4)) \
+	X(0xE7, SET_n_r(cpu, 4, &cpu->A)) \
+	X(0xE8, SET_n_r(cpu, 5, &cpu->B)) \
+	X(0xE9, SET_n_r(cpu, 5, &cpu->C)) \
+	X(0xEA, SET_n_r(cpu, 5, &cpu->D)) \
+	X(0xEB, SET_n_r(cpu, 5, &cpu->E)) \
+	X(0xEC, SET_n_r(cpu, 5, &cpu->H)) \
+	X(0xED, SET_n_r(cpu, 5, &cpu->L)) \
+	X(0xEE, SET_n_cHL(cpu, 5)) \
+	X(0xEF, SET_n_r(cpu, 5, &cpu->A)) \
+	X(0xF0, SET_n_r(cpu, 6, &cpu->B)) \
+	X(0xF1, SET_n_r(cpu, 6, &cpu->C)) \
+	X(0xF2, SET_n_r(cpu, 6, &cpu->D)) \
+	X(0xF3, SET_n_r(cpu, 6, &cpu->E)) \
+	X(0xF4, SET_n_r(cpu, 6, &cpu->H)) \
+	X(0xF5, SET_n_r(cpu, 6, &cpu->L)) \
+	X(0xF6, SET_n_cHL(cpu, 6)) \
+	X(0xF7, SET_n_r(cpu, 6, &cpu->A)) \
+	X(0xF8, SET_n_r(cpu, 7, &cpu->B)) \
+	X(0xF9, SET_n_r(cpu, 7, &cpu->C)) \
+	X(0xFA, SET_n_r(cpu, 7, &cpu->D)) \
+	X(0xFB, SET_n_r(cpu, 7, &cpu->E)) \
+	X(0xFC, SET_n_r(cpu, 7, &cpu->H)) \
+	X(0xFD, SET_n_r(cpu, 7, &cpu->L)) \
+	X(0xFE, SET_n_cHL(cpu, 7)) \
+	X(0xFF, SET_n_r(cpu, 7, &cpu->A))
+
+#define OPCODE_CASE(code, length, instruction) \
+	case code: \
+		instruction; \
+		break;
+#define OPCODE_LENGTH(code, length, instruction) \
+	[code] = length,
+#define OPCODE_HANDLER(code, length, instruction) \
+	[code] = opcode_##code,
+#define DEFINE_OPCODE(code, length, instruction) \
+	static void opcode_##code(struct lr35902 *cpu) \
+	{ \
+		instruction; \
+	}
+#define CB_OPCODE_CASE(code, instruction) \
+	case code: \
+		instruction; \
+		break;
+#define CB_OPCODE_HANDLER(code, instruction) \
+	[code] = cb_opcode_##code,
+#define DEFINE_CB_OPCODE(code, instruction) \
+	static void cb_opcode_##code(struct lr35902 *cpu) \
+	{ \
+		instruction; \
+	}
+
 struct lr35902_flags {
 	uint8_t reserved:4;
 	uint8_t C:1;
@@ -39,6 +588,52 @@ struct lr35902_flags {
 	uint8_t Z:1;
 };
 
+/* Last flag-setting ALU operation (F is only computed when needed) */
+enum lr35902_alu_op {
+	ALU_NONE,
+	ALU_ADD,
+	ALU_SUB,
+	ALU_INC,
+	ALU_DEC,
+	ALU_AND,
+	ALU_OR
+};
+
+struct lr35902;
+
+typedef void (*lr35902_handler_t)(struct lr35902 *cpu);
+
+/* Pre-decoded instruction (handler also resolves CB-prefixed opcodes) */
+struct lr35902_uop {
+	lr35902_handler_t handler;
+	uint16_t pc;
+	uint16_t operand;
+	uint8_t length;
+};
+
+struct lr35902_block {
+	uint16_t pc;
+	uint8_t *mem;
+	bool writable;
+	int num_uops;
+	uint8_t source[CACHE_MAX_UOPS * 3];
+	struct lr35902_uop uops[CACHE_MAX_UOPS];
+};
+
+struct lr35902_idle {
+	bool valid;
+	uint16_t AF;
+	uint16_t BC;
+	uint16_t DE;
+	uint16_t HL;
+	uint16_t PC;
+	uint16_t SP;
+	uint8_t IME;
+	uint64_t cycle;
+	uint64_t num_instructions;
+	uint32_t num_updates;
+};
+
 struct lr35902 {
 	DEFINE_AF_PAIR
 	DEFINE_REGISTER_PAIR(B, C)
@@ -46,14 +641,26 @@ struct lr35902 {
 	DEFINE_REGISTER_PAIR(H, L)
 	uint16_t PC;
 	uint16_t SP;
+	uint16_t operand;
+	uint8_t alu_op;
+	uint8_t alu_a;
+	uint8_t alu_b;
+	uint16_t alu_result;
 	uint8_t IME;
 	uint8_t IF;
 	uint8_t IE;
 	bool halted;
+	bool int_check;
 	int bus_id;
 	struct clock clock;
+	struct lr35902_idle idle;
+	struct cpu_instance *instance;
 	struct region if_region;
 	struct region ie_region;
+	struct lr35902_block *blocks;
+	struct lr35902_block *block;
+	int uop_index;
+	uint32_t map_generation;
 };
 
 static bool lr35902_init(struct cpu_instance *instance);
@@ -61,8 +668,26 @@ static void lr35902_reset(struct cpu_instance *instance);
 static void lr35902_interrupt(struct cpu_instance *instance, int irq);
 static void lr35902_deinit(struct cpu_instance *instance);
 static bool lr35902_handle_interrupts(struct lr35902 *cpu);
+static void lr35902_update_interrupts(struct lr35902 *cpu);
+static uint8_t if_readb(struct lr35902 *cpu, address_t address);
+static void if_writeb(struct lr35902 *cpu, uint8_t b, address_t address);
+static uint8_t ie_readb(struct lr35902 *cpu, address_t address);
+static void ie_writeb(struct lr35902 *cpu, uint8_t b, address_t address);
+static bool int_stable(struct lr35902 *cpu, address_t address);
+static void lr35902_step(struct lr35902 *cpu);
 static void lr35902_tick(struct lr35902 *cpu);
+static void lr35902_check_idle(struct lr35902 *cpu);
 static void lr35902_opcode_CB(struct lr35902 *cpu);
+static void lr35902_cache_decode(struct lr35902 *cpu,
+	struct lr35902_block *block, uint8_t *mem, bool writable);
+static struct lr35902_block *lr35902_cache_get_block(struct lr35902 *cpu);
+static struct lr35902_uop *lr35902_cache_fetch(struct lr35902 *cpu);
+static void lr35902_cache_flush(struct lr35902 *cpu);
+static inline void lr35902_defer_flags(struct lr35902 *cpu, uint8_t op,
+	uint8_t a, uint8_t b, uint16_t result);
+static inline uint8_t lr35902_get_carry(struct lr35902 *cpu);
+static inline void lr35902_sync_flags(struct lr35902 *cpu);
+static void lr35902_compute_flags(struct lr35902 *cpu);
 static inline void LD_r_r(struct lr35902 *cpu, uint8_t *r1, uint8_t *r2);
 static inline void LD_r_n(struct lr35902 *cpu, uint8_t *r);
 static inline void LD_r_cHL(struct lr35902 *cpu, uint8_t *r);
@@ -86,7 +711,14 @@ static inline void LD_rr_nn(struct lr35902 *cpu, uint16_t *rr);
 static inline void LD_SP_HL(struct lr35902 *cpu);
 static inline void PUSH_rr(struct lr35902 *cpu, uint16_t *rr);
 static inline void POP_rr(struct lr35902 *cpu, uint16_t *rr);
-static inline void POP_AF(struct lr35902 *cpu);
+static inline void PUSH_AF(struct lr35902 *cpu);
+static inline void PUSH_AF(struct lr35902 *cpu)
+{
+	lr35902_sync_flags(cpu);
+	PUSH_rr(cpu, &cpu->AF);
+}
+
+void POP_AF(struct lr35902 *cpu);
 static inline void LD_cnn_SP(struct lr35902 *cpu);
 static inline void ADD_A_r(struct lr35902 *cpu, uint8_t *r);
 static inline void ADD_A_n(struct lr35902 *cpu);
@@ -183,6 +815,19 @@ static inline void RET_NC(struct lr35902 *cpu);
 static inline void RET_C(struct lr35902 *cpu);
 static inline void RETI(struct lr35902 *cpu);
 static inline void RST_n(struct lr35902 *cpu, uint8_t n);
+static inline void ILL(struct lr35902 *cpu);
+
+static struct mops if_mops = {
+	.readb = (readb_t)if_readb,
+	.writeb = (writeb_t)if_writeb,
+	.stable = (stable_t)int_stable
+};
+
+static struct mops ie_mops = {
+	.readb = (readb_t)ie_readb,
+	.writeb = (writeb_t)ie_writeb,
+	.stable = (stable_t)int_stable
+};
 
 void LD_r_r(struct lr35902 *UNUSED(cpu), uint8_t *r1, uint8_t *r2)
 {
@@ -192,7 +837,7 @@ void LD_r_r(struct lr35902 *UNUSED(cpu), uint8_t *r1, uint8_t *r2)
 
 void LD_r_n(struct lr35902 *cpu, uint8_t *r)
 {
-	*r = memory_readb(cpu->bus_id, cpu->PC++);
+	*r = cpu->operand;
 	clock_consume(8);
 }
 
@@ -210,8 +855,7 @@ void LD_cHL_r(struct lr35902 *cpu, uint8_t *r)
 
 void LD_cHL_n(struct lr35902 *cpu)
 {
-	memory_writeb(cpu->bus_id, memory_readb(cpu->bus_id, cpu->PC++),
-		cpu->HL);
+	memory_writeb(cpu->bus_id, cpu->operand, cpu->HL);
 	clock_consume(12);
 }
 
@@ -229,8 +873,7 @@ void LD_A_cDE(struct lr35902 *cpu)
 
 void LD_A_cnn(struct lr35902 *cpu)
 {
-	uint16_t address = memory_readb(cpu->bus_id, cpu->PC++);
-	address |= memory_readb(cpu->bus_id, cpu->PC++) << 8;
+	uint16_t address = cpu->operand;
 	cpu->A = memory_readb(cpu->bus_id, address);
 	clock_consume(16);
 }
@@ -249,23 +892,20 @@ void LD_cDE_A(struct lr35902 *cpu)
 
 void LD_cnn_A(struct lr35902 *cpu)
 {
-	uint16_t address = memory_readb(cpu->bus_id, cpu->PC++);
-	address |= memory_readb(cpu->bus_id, cpu->PC++) << 8;
+	uint16_t address = cpu->operand;
 	memory_writeb(cpu->bus_id, cpu->A, address);
 	clock_consume(16);
 }
 
 void LD_A_cFF00pn(struct lr35902 *cpu)
 {
-	cpu->A = memory_readb(cpu->bus_id, 0xFF00 +
-		memory_readb(cpu->bus_id, cpu->PC++));
+	cpu->A = memory_readb(cpu->bus_id, 0xFF00 + cpu->operand);
 	clock_consume(12);
 }
 
 void LD_cFF00pn_A(struct lr35902 *cpu)
 {
-	memory_writeb(cpu->bus_id, cpu->A, 0xFF00 +
-		memory_readb(cpu->bus_id, cpu->PC++));
+	memory_writeb(cpu->bus_id, cpu->A, 0xFF00 + cpu->operand);
 	clock_consume(12);
 }
 
@@ -307,8 +947,7 @@ void LDD_A_cHL(struct lr35902 *cpu)
 
 void LD_rr_nn(struct lr35902 *cpu, uint16_t *rr)
 {
-	uint16_t nn = memory_readb(cpu->bus_id, cpu->PC++);
-	nn |= memory_readb(cpu->bus_id, cpu->PC++) << 8;
+	uint16_t nn = cpu->operand;
 	*rr = nn;
 	clock_consume(12);
 }
@@ -337,13 +976,13 @@ void POP_AF(struct lr35902 *cpu)
 {
 	POP_rr(cpu, &cpu->AF);
 	cpu->flags.reserved = 0;
+	cpu->alu_op = ALU_NONE;
 	clock_consume(12);
 }
 
 void LD_cnn_SP(struct lr35902 *cpu)
 {
-	uint16_t nn = memory_readb(cpu->bus_id, cpu->PC++);
-	nn |= memory_readb(cpu->bus_id, cpu->PC++) << 8;
+	uint16_t nn = cpu->operand;
 	memory_writeb(cpu->bus_id, cpu->SP, nn);
 	memory_writeb(cpu->bus_id, cpu->SP >> 8, nn + 1);
 	clock_consume(20);
@@ -352,142 +991,103 @@ void LD_cnn_SP(struct lr35902 *cpu)
 void ADD_A_r(struct lr35902 *cpu, uint8_t *r)
 {
 	uint16_t result = cpu->A + *r;
-	cpu->flags.C = result >> 8;
-	cpu->flags.H = ((cpu->A & 0x0F) + (*r & 0x0F) > 0x0F);
-	cpu->flags.N = 0;
-	cpu->flags.Z = ((uint8_t)result == 0);
+	lr35902_defer_flags(cpu, ALU_ADD, cpu->A, *r, result);
 	cpu->A = result;
 	clock_consume(4);
 }
 
 void ADD_A_n(struct lr35902 *cpu)
 {
-	uint8_t n = memory_readb(cpu->bus_id, cpu->PC++);
+	uint8_t n = cpu->operand;
 	uint16_t result = cpu->A + n;
-	cpu->flags.C = result >> 8;
-	cpu->flags.H = ((cpu->A & 0x0F) + (n & 0x0F) > 0x0F);
-	cpu->flags.N = 0;
-	cpu->flags.Z = ((uint8_t)result == 0);
+	lr35902_defer_flags(cpu, ALU_ADD, cpu->A, n, result);
 	cpu->A = result;
 	clock_consume(8);
 }
 
 void ADD_A_cHL(struct lr35902 *cpu)
 {
-	uint16_t result = cpu->A + memory_readb(cpu->bus_id, cpu->HL);
-	cpu->flags.C = result >> 8;
-	cpu->flags.H = ((cpu->A & 0x0F) +
-		(memory_readb(cpu->bus_id, cpu->HL) & 0x0F) > 0x0F);
-	cpu->flags.N = 0;
-	cpu->flags.Z = ((uint8_t)result == 0);
+	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
+	uint16_t result = cpu->A + b;
+	lr35902_defer_flags(cpu, ALU_ADD, cpu->A, b, result);
 	cpu->A = result;
 	clock_consume(8);
 }
 
 void ADC_A_r(struct lr35902 *cpu, uint8_t *r)
 {
-	uint16_t result = cpu->A + *r + cpu->flags.C;
-	cpu->flags.H = ((cpu->A & 0x0F) + (*r & 0x0F) + cpu->flags.C > 0x0F);
-	cpu->flags.C = result >> 8;
-	cpu->flags.N = 0;
-	cpu->flags.Z = ((uint8_t)result == 0);
+	uint16_t result = cpu->A + *r + lr35902_get_carry(cpu);
+	lr35902_defer_flags(cpu, ALU_ADD, cpu->A, *r, result);
 	cpu->A = result;
 	clock_consume(4);
 }
 
 void ADC_A_n(struct lr35902 *cpu)
 {
-	uint8_t n = memory_readb(cpu->bus_id, cpu->PC++);
-	uint16_t result = cpu->A + n + cpu->flags.C;
-	cpu->flags.H = ((cpu->A & 0x0F) + (n & 0x0F) + cpu->flags.C > 0x0F);
-	cpu->flags.C = result >> 8;
-	cpu->flags.N = 0;
-	cpu->flags.Z = ((uint8_t)result == 0);
+	uint8_t n = cpu->operand;
+	uint16_t result = cpu->A + n + lr35902_get_carry(cpu);
+	lr35902_defer_flags(cpu, ALU_ADD, cpu->A, n, result);
 	cpu->A = result;
 	clock_consume(8);
 }
 
 void ADC_A_cHL(struct lr35902 *cpu)
 {
-	uint16_t result = cpu->A + memory_readb(cpu->bus_id, cpu->HL) +
-		cpu->flags.C;
-	cpu->flags.H = ((cpu->A & 0x0F) +
-		(memory_readb(cpu->bus_id, cpu->HL) & 0x0F) +
-		cpu->flags.C > 0x0F);
-	cpu->flags.C = result >> 8;
-	cpu->flags.N = 0;
-	cpu->flags.Z = ((uint8_t)result == 0);
+	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
+	uint16_t result = cpu->A + b + lr35902_get_carry(cpu);
+	lr35902_defer_flags(cpu, ALU_ADD, cpu->A, b, result);
 	cpu->A = result;
 	clock_consume(8);
 }
 
 void SUB_A_r(struct lr35902 *cpu, uint8_t *r)
 {
-	int16_t result = cpu->A - *r;
-	cpu->flags.C = result >> 8;
-	cpu->flags.H = ((cpu->A & 0x0F) - (*r & 0x0F) < 0);
-	cpu->flags.N = 1;
-	cpu->flags.Z = ((uint8_t)result == 0);
+	uint16_t result = cpu->A - *r;
+	lr35902_defer_flags(cpu, ALU_SUB, cpu->A, *r, result);
 	cpu->A = result;
 	clock_consume(4);
 }
 
 void SUB_A_n(struct lr35902 *cpu)
 {
-	uint8_t n = memory_readb(cpu->bus_id, cpu->PC++);
-	int16_t result = cpu->A - n;
-	cpu->flags.C = result >> 8;
-	cpu->flags.H = ((cpu->A & 0x0F) - (n & 0x0F) < 0);
-	cpu->flags.N = 1;
-	cpu->flags.Z = ((uint8_t)result == 0);
+	uint8_t n = cpu->operand;
+	uint16_t result = cpu->A - n;
+	lr35902_defer_flags(cpu, ALU_SUB, cpu->A, n, result);
 	cpu->A = result;
 	clock_consume(8);
 }
 
 void SUB_A_cHL(struct lr35902 *cpu)
 {
-	int16_t result = cpu->A - memory_readb(cpu->bus_id, cpu->HL);
-	cpu->flags.C = result >> 8;
-	cpu->flags.H = ((cpu->A & 0x0F) -
-		(memory_readb(cpu->bus_id, cpu->HL) & 0x0F) < 0);
-	cpu->flags.N = 1;
-	cpu->flags.Z = ((uint8_t)result == 0);
+	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
+	uint16_t result = cpu->A - b;
+	lr35902_defer_flags(cpu, ALU_SUB, cpu->A, b, result);
 	cpu->A = result;
 	clock_consume(8);
 }
 
 void SBC_A_r(struct lr35902 *cpu, uint8_t *r)
 {
-	int16_t result = cpu->A - *r - cpu->flags.C;
-	cpu->flags.H = ((cpu->A & 0x0F) - (*r & 0x0F) - cpu->flags.C < 0);
-	cpu->flags.C = result >> 8;
-	cpu->flags.N = 1;
-	cpu->flags.Z = ((uint8_t)result == 0);
+	uint16_t result = cpu->A - *r - lr35902_get_carry(cpu);
+	lr35902_defer_flags(cpu, ALU_SUB, cpu->A, *r, result);
 	cpu->A = result;
 	clock_consume(4);
 }
 
 void SBC_A_n(struct lr35902 *cpu)
 {
-	uint8_t n = memory_readb(cpu->bus_id, cpu->PC++);
-	int16_t result = cpu->A - n - cpu->flags.C;
-	cpu->flags.H = ((cpu->A & 0x0F) - (n & 0x0F) - cpu->flags.C < 0);
-	cpu->flags.C = result >> 8;
-	cpu->flags.N = 1;
-	cpu->flags.Z = ((uint8_t)result == 0);
+	uint8_t n = cpu->operand;
+	uint16_t result = cpu->A - n - lr35902_get_carry(cpu);
+	lr35902_defer_flags(cpu, ALU_SUB, cpu->A, n, result);
 	cpu->A = result;
 	clock_consume(8);
 }
 
 void SBC_A_cHL(struct lr35902 *cpu)
 {
-	int16_t result = cpu->A - memory_readb(cpu->bus_id, cpu->HL) -
-		cpu->flags.C;
-	cpu->flags.H = ((cpu->A & 0x0F) -
-		(memory_readb(cpu->bus_id, cpu->HL) & 0x0F) - cpu->flags.C < 0);
-	cpu->flags.C = result >> 8;
-	cpu->flags.N = 1;
-	cpu->flags.Z = ((uint8_t)result == 0);
+	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
+	uint16_t result = cpu->A - b - lr35902_get_carry(cpu);
+	lr35902_defer_flags(cpu, ALU_SUB, cpu->A, b, result);
 	cpu->A = result;
 	clock_consume(8);
 }
@@ -495,165 +1095,128 @@ void SBC_A_cHL(struct lr35902 *cpu)
 void AND_r(struct lr35902 *cpu, uint8_t *r)
 {
 	cpu->A &= *r;
-	cpu->flags.C = 0;
-	cpu->flags.H = 1;
-	cpu->flags.N = 0;
-	cpu->flags.Z = (cpu->A == 0);
+	lr35902_defer_flags(cpu, ALU_AND, 0, 0, cpu->A);
 	clock_consume(4);
 }
 
 void AND_n(struct lr35902 *cpu)
 {
-	cpu->A &= memory_readb(cpu->bus_id, cpu->PC++);
-	cpu->flags.C = 0;
-	cpu->flags.H = 1;
-	cpu->flags.N = 0;
-	cpu->flags.Z = (cpu->A == 0);
+	uint8_t n = cpu->operand;
+	cpu->A &= n;
+	lr35902_defer_flags(cpu, ALU_AND, 0, 0, cpu->A);
 	clock_consume(8);
 }
 
 void AND_cHL(struct lr35902 *cpu)
 {
-	cpu->A &= memory_readb(cpu->bus_id, cpu->HL);
-	cpu->flags.C = 0;
-	cpu->flags.H = 1;
-	cpu->flags.N = 0;
-	cpu->flags.Z = (cpu->A == 0);
+	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
+	cpu->A &= b;
+	lr35902_defer_flags(cpu, ALU_AND, 0, 0, cpu->A);
 	clock_consume(8);
 }
 
 void XOR_r(struct lr35902 *cpu, uint8_t *r)
 {
 	cpu->A ^= *r;
-	cpu->flags.C = 0;
-	cpu->flags.H = 0;
-	cpu->flags.N = 0;
-	cpu->flags.Z = (cpu->A == 0);
+	lr35902_defer_flags(cpu, ALU_OR, 0, 0, cpu->A);
 	clock_consume(4);
 }
 
 void XOR_n(struct lr35902 *cpu)
 {
-	cpu->A ^= memory_readb(cpu->bus_id, cpu->PC++);
-	cpu->flags.C = 0;
-	cpu->flags.H = 0;
-	cpu->flags.N = 0;
-	cpu->flags.Z = (cpu->A == 0);
+	uint8_t n = cpu->operand;
+	cpu->A ^= n;
+	lr35902_defer_flags(cpu, ALU_OR, 0, 0, cpu->A);
 	clock_consume(8);
 }
 
 void XOR_cHL(struct lr35902 *cpu)
 {
-	cpu->A ^= memory_readb(cpu->bus_id, cpu->HL);
-	cpu->flags.C = 0;
-	cpu->flags.H = 0;
-	cpu->flags.N = 0;
-	cpu->flags.Z = (cpu->A == 0);
+	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
+	cpu->A ^= b;
+	lr35902_defer_flags(cpu, ALU_OR, 0, 0, cpu->A);
 	clock_consume(8);
 }
 
 void OR_r(struct lr35902 *cpu, uint8_t *r)
 {
 	cpu->A |= *r;
-	cpu->flags.C = 0;
-	cpu->flags.H = 0;
-	cpu->flags.N = 0;
-	cpu->flags.Z = (cpu->A == 0);
+	lr35902_defer_flags(cpu, ALU_OR, 0, 0, cpu->A);
 	clock_consume(4);
 }
 
 void OR_n(struct lr35902 *cpu)
 {
-	cpu->A |= memory_readb(cpu->bus_id, cpu->PC++);
-	cpu->flags.C = 0;
-	cpu->flags.H = 0;
-	cpu->flags.N = 0;
-	cpu->flags.Z = (cpu->A == 0);
+	uint8_t n = cpu->operand;
+	cpu->A |= n;
+	lr35902_defer_flags(cpu, ALU_OR, 0, 0, cpu->A);
 	clock_consume(8);
 }
 
 void OR_cHL(struct lr35902 *cpu)
 {
-	cpu->A |= memory_readb(cpu->bus_id, cpu->HL);
-	cpu->flags.C = 0;
-	cpu->flags.H = 0;
-	cpu->flags.N = 0;
-	cpu->flags.Z = (cpu->A == 0);
+	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
+	cpu->A |= b;
+	lr35902_defer_flags(cpu, ALU_OR, 0, 0, cpu->A);
 	clock_consume(8);
 }
 
 void CP_r(struct lr35902 *cpu, uint8_t *r)
 {
-	int16_t result = cpu->A - *r;
-	cpu->flags.C = result >> 8;
-	cpu->flags.H = ((cpu->A & 0x0F) - (*r & 0x0F) < 0);
-	cpu->flags.N = 1;
-	cpu->flags.Z = ((uint8_t)result == 0);
+	uint16_t result = cpu->A - *r;
+	lr35902_defer_flags(cpu, ALU_SUB, cpu->A, *r, result);
 	clock_consume(4);
 }
 
 void CP_n(struct lr35902 *cpu)
 {
-	uint8_t n = memory_readb(cpu->bus_id, cpu->PC++);
-	int16_t result = cpu->A - n;
-	cpu->flags.C = result >> 8;
-	cpu->flags.H = ((cpu->A & 0x0F) - (n & 0x0F) < 0);
-	cpu->flags.N = 1;
-	cpu->flags.Z = ((uint8_t)result == 0);
+	uint8_t n = cpu->operand;
+	uint16_t result = cpu->A - n;
+	lr35902_defer_flags(cpu, ALU_SUB, cpu->A, n, result);
 	clock_consume(8);
 }
 
 void CP_cHL(struct lr35902 *cpu)
 {
-	int16_t result = cpu->A - memory_readb(cpu->bus_id, cpu->HL);
-	cpu->flags.C = result >> 8;
-	cpu->flags.H = ((cpu->A & 0x0F) -
-		(memory_readb(cpu->bus_id, cpu->HL) & 0x0F) < 0);
-	cpu->flags.N = 1;
-	cpu->flags.Z = ((uint8_t)result == 0);
+	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
+	uint16_t result = cpu->A - b;
+	lr35902_defer_flags(cpu, ALU_SUB, cpu->A, b, result);
 	clock_consume(8);
 }
 
 void INC_r(struct lr35902 *cpu, uint8_t *r)
 {
-	cpu->flags.H = ((*r & 0x0F) == 0x0F);
-	cpu->flags.N = 0;
-	cpu->flags.Z = (*r == 0xFF);
 	(*r)++;
+	lr35902_defer_flags(cpu, ALU_INC, 0, lr35902_get_carry(cpu), *r);
 	clock_consume(4);
 }
 
 void INC_cHL(struct lr35902 *cpu)
 {
-	cpu->flags.H = ((memory_readb(cpu->bus_id, cpu->HL) & 0x0F) == 0x0F);
-	cpu->flags.N = 0;
-	cpu->flags.Z = (memory_readb(cpu->bus_id, cpu->HL) == 0xFF);
-	memory_writeb(cpu->bus_id, memory_readb(cpu->bus_id, cpu->HL) + 1,
-		cpu->HL);
+	uint8_t b = memory_readb(cpu->bus_id, cpu->HL) + 1;
+	memory_writeb(cpu->bus_id, b, cpu->HL);
+	lr35902_defer_flags(cpu, ALU_INC, 0, lr35902_get_carry(cpu), b);
 	clock_consume(12);
 }
 
 void DEC_r(struct lr35902 *cpu, uint8_t *r)
 {
 	(*r)--;
-	cpu->flags.H = ((*r & 0x0F) == 0x0F);
-	cpu->flags.N = 1;
-	cpu->flags.Z = (*r == 0);
+	lr35902_defer_flags(cpu, ALU_DEC, 0, lr35902_get_carry(cpu), *r);
 	clock_consume(4);
 }
 
 void DEC_cHL(struct lr35902 *cpu)
 {
-	memory_writeb(cpu->bus_id, memory_readb(cpu->bus_id, cpu->HL) - 1,
-		cpu->HL);
-	cpu->flags.H = ((memory_readb(cpu->bus_id, cpu->HL) & 0x0F) == 0x0F);
-	cpu->flags.N = 1;
-	cpu->flags.Z = (memory_readb(cpu->bus_id, cpu->HL) == 0);
+	uint8_t b = memory_readb(cpu->bus_id, cpu->HL) - 1;
+	memory_writeb(cpu->bus_id, b, cpu->HL);
+	lr35902_defer_flags(cpu, ALU_DEC, 0, lr35902_get_carry(cpu), b);
 	clock_consume(12);
 }
 
 void DAA(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	int a = cpu->A;
 
 	/* Update A based on N/H/C flags */
@@ -690,6 +1253,7 @@ void DAA(struct lr35902 *cpu)
 
 void CPL(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	cpu->A = ~cpu->A;
 	cpu->flags.H = 1;
 	cpu->flags.N = 1;
@@ -698,6 +1262,7 @@ void CPL(struct lr35902 *cpu)
 
 void ADD_HL_rr(struct lr35902 *cpu, uint16_t *rr)
 {
+	lr35902_sync_flags(cpu);
 	uint32_t result = cpu->HL + *rr;
 	cpu->flags.C = result >> 16;
 	cpu->flags.H = ((cpu->HL & 0x0FFF) + (*rr & 0x0FFF) > 0x0FFF);
@@ -720,7 +1285,8 @@ void DEC_rr(struct lr35902 *UNUSED(cpu), uint16_t *rr)
 
 void ADD_SP_d(struct lr35902 *cpu)
 {
-	int8_t d = memory_readb(cpu->bus_id, cpu->PC++);
+	lr35902_sync_flags(cpu);
+	int8_t d = cpu->operand;
 	int32_t result = cpu->SP + d;
 	cpu->flags.C = result >> 16;
 	cpu->flags.H = ((cpu->SP & 0x0FFF) + (d & 0x0FFF) > 0x0FFF);
@@ -732,7 +1298,8 @@ void ADD_SP_d(struct lr35902 *cpu)
 
 void LD_HL_SPpd(struct lr35902 *cpu)
 {
-	int8_t d = memory_readb(cpu->bus_id, cpu->PC++);
+	lr35902_sync_flags(cpu);
+	int8_t d = cpu->operand;
 	uint32_t acc = (uint32_t)cpu->SP + (uint32_t)d;
 	cpu->F = (0x20 & (((cpu->SP>>8) ^ ((d)>>8) ^ (acc >> 8)) << 1));
 	cpu->flags.C = (acc >> 16);
@@ -742,6 +1309,7 @@ void LD_HL_SPpd(struct lr35902 *cpu)
 
 void RLCA(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	cpu->flags.C = ((cpu->A & 0x80) != 0);
 	cpu->flags.H = 0;
 	cpu->flags.N = 0;
@@ -752,6 +1320,7 @@ void RLCA(struct lr35902 *cpu)
 
 void RLA(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	int old_carry = cpu->flags.C;
 	cpu->flags.C = ((cpu->A & 0x80) != 0);
 	cpu->flags.H = 0;
@@ -763,6 +1332,7 @@ void RLA(struct lr35902 *cpu)
 
 void RRCA(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	cpu->flags.C = ((cpu->A & 0x01) != 0);
 	cpu->flags.H = 0;
 	cpu->flags.N = 0;
@@ -773,6 +1343,7 @@ void RRCA(struct lr35902 *cpu)
 
 void RRA(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	int old_carry = cpu->flags.C;
 	cpu->flags.C = ((cpu->A & 0x01) != 0);
 	cpu->flags.H = 0;
@@ -784,6 +1355,7 @@ void RRA(struct lr35902 *cpu)
 
 void RLC_r(struct lr35902 *cpu, uint8_t *r)
 {
+	lr35902_sync_flags(cpu);
 	cpu->flags.C = ((*r & 0x80) != 0);
 	cpu->flags.H = 0;
 	cpu->flags.N = 0;
@@ -794,6 +1366,7 @@ void RLC_r(struct lr35902 *cpu, uint8_t *r)
 
 void RLC_cHL(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	cpu->flags.C = ((memory_readb(cpu->bus_id, cpu->HL) & 0x80) != 0);
 	cpu->flags.H = 0;
 	cpu->flags.N = 0;
@@ -806,6 +1379,7 @@ void RLC_cHL(struct lr35902 *cpu)
 
 void RL_r(struct lr35902 *cpu, uint8_t *r)
 {
+	lr35902_sync_flags(cpu);
 	int old_carry = cpu->flags.C;
 	cpu->flags.C = ((*r & 0x80) != 0);
 	cpu->flags.H = 0;
@@ -817,6 +1391,7 @@ void RL_r(struct lr35902 *cpu, uint8_t *r)
 
 void RL_cHL(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	int old_carry = cpu->flags.C;
 	cpu->flags.C = ((memory_readb(cpu->bus_id, cpu->HL) & 0x80) != 0);
 	cpu->flags.H = 0;
@@ -830,6 +1405,7 @@ void RL_cHL(struct lr35902 *cpu)
 
 void RRC_r(struct lr35902 *cpu, uint8_t *r)
 {
+	lr35902_sync_flags(cpu);
 	cpu->flags.C = ((*r & 0x01) != 0);
 	cpu->flags.H = 0;
 	cpu->flags.N = 0;
@@ -840,6 +1416,7 @@ void RRC_r(struct lr35902 *cpu, uint8_t *r)
 
 void RRC_cHL(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	cpu->flags.C = ((memory_readb(cpu->bus_id, cpu->HL) & 0x01) != 0);
 	cpu->flags.H = 0;
 	cpu->flags.N = 0;
@@ -852,6 +1429,7 @@ void RRC_cHL(struct lr35902 *cpu)
 
 void RR_r(struct lr35902 *cpu, uint8_t *r)
 {
+	lr35902_sync_flags(cpu);
 	int old_carry = cpu->flags.C;
 	cpu->flags.C = ((*r & 0x01) != 0);
 	cpu->flags.H = 0;
@@ -863,6 +1441,7 @@ void RR_r(struct lr35902 *cpu, uint8_t *r)
 
 void RR_cHL(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	int old_carry = cpu->flags.C;
 	cpu->flags.C = ((memory_readb(cpu->bus_id, cpu->HL) & 0x01) != 0);
 	cpu->flags.H = 0;
@@ -876,6 +1455,7 @@ void RR_cHL(struct lr35902 *cpu)
 
 void SWAP_r(struct lr35902 *cpu, uint8_t *r)
 {
+	lr35902_sync_flags(cpu);
 	*r = (*r << 4) | (*r >> 4);
 	cpu->flags.C = 0;
 	cpu->flags.H = 0;
@@ -886,6 +1466,7 @@ void SWAP_r(struct lr35902 *cpu, uint8_t *r)
 
 void SWAP_cHL(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	memory_writeb(cpu->bus_id,
 		(memory_readb(cpu->bus_id, cpu->HL) << 4) |
 		(memory_readb(cpu->bus_id, cpu->HL) >> 4),
@@ -899,6 +1480,7 @@ void SWAP_cHL(struct lr35902 *cpu)
 
 void SRA_r(struct lr35902 *cpu, uint8_t *r)
 {
+	lr35902_sync_flags(cpu);
 	cpu->flags.C = ((*r & 0x01) != 0);
 	cpu->flags.H = 0;
 	cpu->flags.N = 0;
@@ -909,6 +1491,7 @@ void SRA_r(struct lr35902 *cpu, uint8_t *r)
 
 void SRA_cHL(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	cpu->flags.C = ((memory_readb(cpu->bus_id, cpu->HL) & 0x01) != 0);
 	cpu->flags.H = 0;
 	cpu->flags.N = 0;
@@ -922,6 +1505,7 @@ void SRA_cHL(struct lr35902 *cpu)
 
 void SLA_r(struct lr35902 *cpu, uint8_t *r)
 {
+	lr35902_sync_flags(cpu);
 	cpu->flags.C = ((*r & 0x80) != 0);
 	cpu->flags.H = 0;
 	cpu->flags.N = 0;
@@ -932,6 +1516,7 @@ void SLA_r(struct lr35902 *cpu, uint8_t *r)
 
 void SLA_cHL(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	cpu->flags.C = ((memory_readb(cpu->bus_id, cpu->HL) & 0x80) != 0);
 	cpu->flags.H = 0;
 	cpu->flags.N = 0;
@@ -943,6 +1528,7 @@ void SLA_cHL(struct lr35902 *cpu)
 
 void SRL_r(struct lr35902 *cpu, uint8_t *r)
 {
+	lr35902_sync_flags(cpu);
 	cpu->flags.C = ((*r & 0x01) != 0);
 	cpu->flags.H = 0;
 	cpu->flags.N = 0;
@@ -953,6 +1539,7 @@ void SRL_r(struct lr35902 *cpu, uint8_t *r)
 
 void SRL_cHL(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	cpu->flags.C = ((memory_readb(cpu->bus_id, cpu->HL) & 0x01) != 0);
 	cpu->flags.H = 0;
 	cpu->flags.N = 0;
@@ -964,6 +1551,7 @@ void SRL_cHL(struct lr35902 *cpu)
 
 void BIT_n_r(struct lr35902 *cpu, uint8_t n, uint8_t *r)
 {
+	lr35902_sync_flags(cpu);
 	cpu->flags.H = 1;
 	cpu->flags.N = 0;
 	cpu->flags.Z = ((*r & (1 << n)) == 0);
@@ -972,6 +1560,7 @@ void BIT_n_r(struct lr35902 *cpu, uint8_t n, uint8_t *r)
 
 void BIT_n_cHL(struct lr35902 *cpu, uint8_t n)
 {
+	lr35902_sync_flags(cpu);
 	cpu->flags.H = 1;
 	cpu->flags.N = 0;
 	cpu->flags.Z = ((memory_readb(cpu->bus_id, cpu->HL) & (1 << n)) == 0);
@@ -1008,6 +1597,7 @@ void RES_n_cHL(struct lr35902 *cpu, uint8_t n)
 
 void CCF(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	cpu->flags.C = !cpu->flags.C;
 	cpu->flags.H = 0;
 	cpu->flags.N = 0;
@@ -1016,6 +1606,7 @@ void CCF(struct lr35902 *cpu)
 
 void SCF(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	cpu->flags.C = 1;
 	cpu->flags.H = 0;
 	cpu->flags.N = 0;
@@ -1030,34 +1621,38 @@ void NOP(struct lr35902 *UNUSED(cpu))
 void HALT(struct lr35902 *cpu)
 {
 	cpu->halted = true;
+	lr35902_update_interrupts(cpu);
 	clock_consume(4);
 }
 
 void STOP(struct lr35902 *cpu)
 {
-	memory_readb(cpu->bus_id, cpu->PC++);
 	cpu->halted = true;
+	lr35902_update_interrupts(cpu);
 	clock_consume(4);
 }
 
 void DI(struct lr35902 *cpu)
 {
 	cpu->IME = 0;
+	lr35902_update_interrupts(cpu);
 	clock_consume(4);
 }
 
 void EI(struct lr35902 *cpu)
 {
 	cpu->IME = 1;
+	lr35902_update_interrupts(cpu);
 	clock_consume(4);
 }
 
 void JP_nn(struct lr35902 *cpu)
 {
-	uint8_t n1 = memory_readb(cpu->bus_id, cpu->PC++);
-	uint8_t n2 = memory_readb(cpu->bus_id, cpu->PC++);
-	cpu->PC = n1 | (n2 << 8);
+	bool backward = (cpu->operand < cpu->PC);
+	cpu->PC = cpu->operand;
 	clock_consume(16);
+	if (backward)
+		lr35902_check_idle(cpu);
 }
 
 void JP_HL(struct lr35902 *cpu)
@@ -1068,90 +1663,99 @@ void JP_HL(struct lr35902 *cpu)
 
 void JP_f_nn(struct lr35902 *cpu, bool condition)
 {
-	uint8_t n1 = memory_readb(cpu->bus_id, cpu->PC++);
-	uint8_t n2 = memory_readb(cpu->bus_id, cpu->PC++);
+	bool backward = (cpu->operand < cpu->PC);
 	if (condition) {
-		cpu->PC = n1 | (n2 << 8);
+		cpu->PC = cpu->operand;
 		clock_consume(4);
 	}
 	clock_consume(12);
+	if (condition && backward)
+		lr35902_check_idle(cpu);
 }
 
 void JP_NZ_nn(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	JP_f_nn(cpu, !cpu->flags.Z);
 }
 
 void JP_Z_nn(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	JP_f_nn(cpu, cpu->flags.Z);
 }
 
 void JP_NC_nn(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	JP_f_nn(cpu, !cpu->flags.C);
 }
 
 void JP_C_nn(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	JP_f_nn(cpu, cpu->flags.C);
 }
 
 void JR_d(struct lr35902 *cpu)
 {
-	int8_t d = memory_readb(cpu->bus_id, cpu->PC++);
+	int8_t d = cpu->operand;
 	cpu->PC += d;
 	clock_consume(12);
+	if (d < 0)
+		lr35902_check_idle(cpu);
 }
 
 void JR_f_d(struct lr35902 *cpu, bool condition)
 {
-	int8_t d = memory_readb(cpu->bus_id, cpu->PC++);
+	int8_t d = cpu->operand;
 	if (condition) {
 		cpu->PC += d;
 		clock_consume(4);
 	}
 	clock_consume(8);
+	if (condition && (d < 0))
+		lr35902_check_idle(cpu);
 }
 
 void JR_NZ_d(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	JR_f_d(cpu, !cpu->flags.Z);
 }
 
 void JR_Z_d(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	JR_f_d(cpu, cpu->flags.Z);
 }
 
 void JR_NC_d(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	JR_f_d(cpu, !cpu->flags.C);
 }
 
 void JR_C_d(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	JR_f_d(cpu, cpu->flags.C);
 }
 
 void CALL_nn(struct lr35902 *cpu)
 {
-	uint8_t n1 = memory_readb(cpu->bus_id, cpu->PC++);
-	uint8_t n2 = memory_readb(cpu->bus_id, cpu->PC++);
 	memory_writeb(cpu->bus_id, cpu->PC >> 8, --cpu->SP);
 	memory_writeb(cpu->bus_id, cpu->PC, --cpu->SP);
-	cpu->PC = n1 | (n2 << 8);
+	cpu->PC = cpu->operand;
 	clock_consume(24);
 }
 
 void CALL_f_nn(struct lr35902 *cpu, bool condition)
 {
-	uint8_t n1 = memory_readb(cpu->bus_id, cpu->PC++);
-	uint8_t n2 = memory_readb(cpu->bus_id, cpu->PC++);
 	if (condition) {
 		memory_writeb(cpu->bus_id, cpu->PC >> 8, --cpu->SP);
 		memory_writeb(cpu->bus_id, cpu->PC, --cpu->SP);
-		cpu->PC = n1 | (n2 << 8);
+		cpu->PC = cpu->operand;
 		clock_consume(12);
 	}
 	clock_consume(12);
@@ -1159,21 +1763,25 @@ void CALL_f_nn(struct lr35902 *cpu, bool condition)
 
 void CALL_NZ_nn(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	CALL_f_nn(cpu, !cpu->flags.Z);
 }
 
 void CALL_Z_nn(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	CALL_f_nn(cpu, cpu->flags.Z);
 }
 
 void CALL_NC_nn(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	CALL_f_nn(cpu, !cpu->flags.C);
 }
 
 void CALL_C_nn(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	CALL_f_nn(cpu, cpu->flags.C);
 }
 
@@ -1196,21 +1804,25 @@ void RET_f(struct lr35902 *cpu, bool condition)
 
 void RET_NZ(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	RET_f(cpu, !cpu->flags.Z);
 }
 
 void RET_Z(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	RET_f(cpu, cpu->flags.Z);
 }
 
 void RET_NC(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	RET_f(cpu, !cpu->flags.C);
 }
 
 void RET_C(struct lr35902 *cpu)
 {
+	lr35902_sync_flags(cpu);
 	RET_f(cpu, cpu->flags.C);
 }
 
@@ -1219,6 +1831,7 @@ void RETI(struct lr35902 *cpu)
 	cpu->PC = memory_readb(cpu->bus_id, cpu->SP++);
 	cpu->PC |= memory_readb(cpu->bus_id, cpu->SP++) << 8;
 	cpu->IME = 1;
+	lr35902_update_interrupts(cpu);
 	clock_consume(16);
 }
 
@@ -1230,6 +1843,29 @@ void RST_n(struct lr35902 *cpu, uint8_t n)
 	clock_consume(16);
 }
 
+void ILL(struct lr35902 *cpu)
+{
+	LOG_W("lr35902: unknown opcode (%02x)!\n",
+		memory_readb(cpu->bus_id, cpu->PC - 1));
+	clock_consume(1);
+}
+
+/* Opcode wrappers called by pre-decoded instructions */
+LR35902_OPCODES(DEFINE_OPCODE)
+LR35902_CB_OPCODES(DEFINE_CB_OPCODE)
+
+static const uint8_t lr35902_lengths[] = {
+	LR35902_OPCODES(OPCODE_LENGTH)
+};
+
+static const lr35902_handler_t lr35902_handlers[] = {
+	LR35902_OPCODES(OPCODE_HANDLER)
+};
+
+static const lr35902_handler_t lr35902_cb_handlers[] = {
+	LR35902_CB_OPCODES(CB_OPCODE_HANDLER)
+};
+
 bool lr35902_handle_interrupts(struct lr35902 *cpu)
 {
 	int irq;
@@ -1243,18 +1879,23 @@ bool lr35902_handle_interrupts(struct lr35902 *cpu)
 	cpu->halted = 0;
 
 	/* Check if interrupts are enabled */
-	if (!cpu->IME)
+	if (!cpu->IME) {
+		lr35902_update_interrupts(cpu);
 		return false;
+	}
 
 	/* Check if particular interrupt is enabled */
-	if (!(cpu->IE & BIT(irq)))
+	if (!(cpu->IE & BIT(irq))) {
+		lr35902_update_interrupts(cpu);
 		return false;
+	}
 
 	/* Clear master interrupt enable flag */
 	cpu->IME = 0;
 
 	/* Clear interrupt request flag */
 	cpu->IF &= ~BIT(irq);
+	lr35902_update_interrupts(cpu);
 
 	/* Push PC on stack */
 	memory_writeb(cpu->bus_id, cpu->PC >> 8, --cpu->SP);
@@ -1268,1549 +1909,360 @@ bool lr35902_handle_interrupts(struct lr35902 *cpu)
 	return true;
 }
 
+void lr35902_check_idle(struct lr35902 *cpu)
+{
+	struct lr35902_idle *idle = &cpu->idle;
+	uint64_t num_instructions;
+	uint64_t num_periods;
+
+	/* Get actual flags so that they can be compared */
+	lr35902_sync_flags(cpu);
+
+	/* Skip iterations if loop head state is repeated without any bus write
+	or side-effecting read since last visit (which makes the loop unable to
+	exit before another clock ticks) */
+	if (idle->valid &&
+		(idle->PC == cpu->PC) &&
+		(idle->AF == cpu->AF) &&
+		(idle->BC == cpu->BC) &&
+		(idle->DE == cpu->DE) &&
+		(idle->HL == cpu->HL) &&
+		(idle->SP == cpu->SP) &&
+		(idle->IME == cpu->IME) &&
+		(idle->num_updates == memory_num_updates)) {
+		num_instructions = cpu->instance->num_instructions -
+			idle->num_instructions;
+		num_periods = clock_skip_idle(cpu->clock.next_cycle -
+			idle->cycle);
+		cpu->instance->num_instructions += num_periods *
+			num_instructions;
+	}
+
+	/* Save loop head state */
+	idle->valid = true;
+	idle->PC = cpu->PC;
+	idle->AF = cpu->AF;
+	idle->BC = cpu->BC;
+	idle->DE = cpu->DE;
+	idle->HL = cpu->HL;
+	idle->SP = cpu->SP;
+	idle->IME = cpu->IME;
+	idle->cycle = cpu->clock.next_cycle;
+	idle->num_instructions = cpu->instance->num_instructions;
+	idle->num_updates = memory_num_updates;
+}
+
+void lr35902_update_interrupts(struct lr35902 *cpu)
+{
+	int irq = bitops_ffs(cpu->IF);
+
+	/* Interrupt logic only needs to run if a request is active and would
+	either resume CPU or be serviced (requests are taken by priority, so
+	only the highest one is checked against IE) */
+	cpu->int_check = (irq != 0) &&
+		(cpu->halted || (cpu->IME && (cpu->IE & BIT(irq - 1))));
+}
+
+uint8_t if_readb(struct lr35902 *cpu, address_t UNUSED(address))
+{
+	return cpu->IF;
+}
+
+void if_writeb(struct lr35902 *cpu, uint8_t b, address_t UNUSED(address))
+{
+	cpu->IF = b;
+	lr35902_update_interrupts(cpu);
+}
+
+uint8_t ie_readb(struct lr35902 *cpu, address_t UNUSED(address))
+{
+	return cpu->IE;
+}
+
+void ie_writeb(struct lr35902 *cpu, uint8_t b, address_t UNUSED(address))
+{
+	cpu->IE = b;
+	lr35902_update_interrupts(cpu);
+}
+
+bool int_stable(struct lr35902 *UNUSED(cpu), address_t UNUSED(address))
+{
+	/* Interrupt registers are read without side effects */
+	return true;
+}
+
 void lr35902_tick(struct lr35902 *cpu)
 {
+	/* Execute instructions until next device deadline (forgetting idle
+	state as other clocks might have ticked since last run) */
+	TRACE_BEGIN("lr35902");
+	cpu->idle.valid = false;
+	do
+		lr35902_step(cpu);
+	while (clock_run_ahead());
+	TRACE_END("lr35902");
+}
+
+void lr35902_step(struct lr35902 *cpu)
+{
+	struct lr35902_uop *uop;
 	uint8_t opcode;
+	uint8_t length;
 
-	/* Check for interrupt requests */
-	if (lr35902_handle_interrupts(cpu))
+	/* Check for interrupt requests (only when one might be acted upon) */
+	if (cpu->int_check && lr35902_handle_interrupts(cpu))
 		return;
 
-	/* Check if CPU is halted */
+	/* Sleep until another clock (and potential interrupt source) is due */
 	if (cpu->halted) {
-		clock_consume(1);
+		clock_consume_idle(1);
 		return;
 	}
 
-	/* Fetch opcode */
+	/* Count retired instruction */
+	cpu->instance->num_instructions++;
+
+	/* Execute pre-decoded instruction if available */
+	uop = lr35902_cache_fetch(cpu);
+	if (uop) {
+		cpu->PC += uop->length;
+		cpu->operand = uop->operand;
+		uop->handler(cpu);
+		return;
+	}
+
+	/* Fetch opcode and operand */
 	opcode = memory_readb(cpu->bus_id, cpu->PC++);
+	length = lr35902_lengths[opcode];
+	if (length > 1)
+		cpu->operand = memory_readb(cpu->bus_id, cpu->PC++);
+	if (length > 2)
+		cpu->operand |= memory_readb(cpu->bus_id, cpu->PC++) << 8;
 
 	/* Execute opcode */
 	switch (opcode) {
-	case 0x00:
-		NOP(cpu);
-		break;
-	case 0x01:
-		LD_rr_nn(cpu, &cpu->BC);
-		break;
-	case 0x02:
-		LD_cBC_A(cpu);
-		break;
-	case 0x03:
-		INC_rr(cpu, &cpu->BC);
-		break;
-	case 0x04:
-		INC_r(cpu, &cpu->B);
-		break;
-	case 0x05:
-		DEC_r(cpu, &cpu->B);
-		break;
-	case 0x06:
-		LD_r_n(cpu, &cpu->B);
-		break;
-	case 0x07:
-		RLCA(cpu);
-		break;
-	case 0x08:
-		LD_cnn_SP(cpu);
-		break;
-	case 0x09:
-		ADD_HL_rr(cpu, &cpu->BC);
-		break;
-	case 0x0A:
-		LD_A_cBC(cpu);
-		break;
-	case 0x0B:
-		DEC_rr(cpu, &cpu->BC);
-		break;
-	case 0x0C:
-		INC_r(cpu, &cpu->C);
-		break;
-	case 0x0D:
-		DEC_r(cpu, &cpu->C);
-		break;
-	case 0x0E:
-		LD_r_n(cpu, &cpu->C);
-		break;
-	case 0x0F:
-		RRCA(cpu);
-		break;
-	case 0x10:
-		STOP(cpu);
-		break;
-	case 0x11:
-		LD_rr_nn(cpu, &cpu->DE);
-		break;
-	case 0x12:
-		LD_cDE_A(cpu);
-		break;
-	case 0x13:
-		INC_rr(cpu, &cpu->DE);
-		break;
-	case 0x14:
-		INC_r(cpu, &cpu->D);
-		break;
-	case 0x15:
-		DEC_r(cpu, &cpu->D);
-		break;
-	case 0x16:
-		LD_r_n(cpu, &cpu->D);
-		break;
-	case 0x17:
-		RLA(cpu);
-		break;
-	case 0x18:
-		JR_d(cpu);
-		break;
-	case 0x19:
-		ADD_HL_rr(cpu, &cpu->DE);
-		break;
-	case 0x1A:
-		LD_A_cDE(cpu);
-		break;
-	case 0x1B:
-		DEC_rr(cpu, &cpu->DE);
-		break;
-	case 0x1C:
-		INC_r(cpu, &cpu->E);
-		break;
-	case 0x1D:
-		DEC_r(cpu, &cpu->E);
-		break;
-	case 0x1E:
-		LD_r_n(cpu, &cpu->E);
-		break;
-	case 0x1F:
-		RRA(cpu);
-		break;
-	case 0x20:
-		JR_NZ_d(cpu);
-		break;
-	case 0x21:
-		LD_rr_nn(cpu, &cpu->HL);
-		break;
-	case 0x22:
-		LDI_cHL_A(cpu);
-		break;
-	case 0x23:
-		INC_rr(cpu, &cpu->HL);
-		break;
-	case 0x24:
-		INC_r(cpu, &cpu->H);
-		break;
-	case 0x25:
-		DEC_r(cpu, &cpu->H);
-		break;
-	case 0x26:
-		LD_r_n(cpu, &cpu->H);
-		break;
-	case 0x27:
-		DAA(cpu);
-		break;
-	case 0x28:
-		JR_Z_d(cpu);
-		break;
-	case 0x29:
-		ADD_HL_rr(cpu, &cpu->HL);
-		break;
-	case 0x2A:
-		LDI_A_cHL(cpu);
-		break;
-	case 0x2B:
-		DEC_rr(cpu, &cpu->HL);
-		break;
-	case 0x2C:
-		INC_r(cpu, &cpu->L);
-		break;
-	case 0x2D:
-		DEC_r(cpu, &cpu->L);
-		break;
-	case 0x2E:
-		LD_r_n(cpu, &cpu->L);
-		break;
-	case 0x2F:
-		CPL(cpu);
-		break;
-	case 0x30:
-		JR_NC_d(cpu);
-		break;
-	case 0x31:
-		LD_rr_nn(cpu, &cpu->SP);
-		break;
-	case 0x32:
-		LDD_cHL_A(cpu);
-		break;
-	case 0x33:
-		INC_rr(cpu, &cpu->SP);
-		break;
-	case 0x34:
-		INC_cHL(cpu);
-		break;
-	case 0x35:
-		DEC_cHL(cpu);
-		break;
-	case 0x36:
-		LD_cHL_n(cpu);
-		break;
-	case 0x37:
-		SCF(cpu);
-		break;
-	case 0x38:
-		JR_C_d(cpu);
-		break;
-	case 0x39:
-		ADD_HL_rr(cpu, &cpu->SP);
-		break;
-	case 0x3A:
-		LDD_A_cHL(cpu);
-		break;
-	case 0x3B:
-		DEC_rr(cpu, &cpu->SP);
-		break;
-	case 0x3C:
-		INC_r(cpu, &cpu->A);
-		break;
-	case 0x3D:
-		DEC_r(cpu, &cpu->A);
-		break;
-	case 0x3E:
-		LD_r_n(cpu, &cpu->A);
-		break;
-	case 0x3F:
-		CCF(cpu);
-		break;
-	case 0x40:
-		LD_r_r(cpu, &cpu->B, &cpu->B);
-		break;
-	case 0x41:
-		LD_r_r(cpu, &cpu->B, &cpu->C);
-		break;
-	case 0x42:
-		LD_r_r(cpu, &cpu->B, &cpu->D);
-		break;
-	case 0x43:
-		LD_r_r(cpu, &cpu->B, &cpu->E);
-		break;
-	case 0x44:
-		LD_r_r(cpu, &cpu->B, &cpu->H);
-		break;
-	case 0x45:
-		LD_r_r(cpu, &cpu->B, &cpu->L);
-		break;
-	case 0x46:
-		LD_r_cHL(cpu, &cpu->B);
-		break;
-	case 0x47:
-		LD_r_r(cpu, &cpu->B, &cpu->A);
-		break;
-	case 0x48:
-		LD_r_r(cpu, &cpu->C, &cpu->B);
-		break;
-	case 0x49:
-		LD_r_r(cpu, &cpu->C, &cpu->C);
-		break;
-	case 0x4A:
-		LD_r_r(cpu, &cpu->C, &cpu->D);
-		break;
-	case 0x4B:
-		LD_r_r(cpu, &cpu->C, &cpu->E);
-		break;
-	case 0x4C:
-		LD_r_r(cpu, &cpu->C, &cpu->H);
-		break;
-	case 0x4D:
-		LD_r_r(cpu, &cpu->C, &cpu->L);
-		break;
-	case 0x4E:
-		LD_r_cHL(cpu, &cpu->C);
-		break;
-	case 0x4F:
-		LD_r_r(cpu, &cpu->C, &cpu->A);
-		break;
-	case 0x50:
-		LD_r_r(cpu, &cpu->D, &cpu->B);
-		break;
-	case 0x51:
-		LD_r_r(cpu, &cpu->D, &cpu->C);
-		break;
-	case 0x52:
-		LD_r_r(cpu, &cpu->D, &cpu->D);
-		break;
-	case 0x53:
-		LD_r_r(cpu, &cpu->D, &cpu->E);
-		break;
-	case 0x54:
-		LD_r_r(cpu, &cpu->D, &cpu->H);
-		break;
-	case 0x55:
-		LD_r_r(cpu, &cpu->D, &cpu->L);
+	LR35902_OPCODES(OPCODE_CASE)
+	}
+}
+
+void lr35902_opcode_CB(struct lr35902 *cpu)
+{
+	/* Execute CB opcode (fetched as operand) */
+	switch (cpu->operand) {
+	LR35902_CB_OPCODES(CB_OPCODE_CASE)
+	}
+}
+
+void lr35902_cache_decode(struct lr35902 *cpu, struct lr35902_block *block,
+	uint8_t *mem, bool writable)
+{
+	struct lr35902_uop *uop;
+	uint8_t opcode;
+	uint8_t length;
+	int offset = cpu->PC & MEM_PAGE_MASK;
+	int size = 0;
+
+	/* Initialize block */
+	block->pc = cpu->PC;
+	block->mem = mem;
+	block->writable = writable;
+	block->num_uops = 0;
+
+	/* Decode instructions until a jump or the end of the page */
+	while (block->num_uops < CACHE_MAX_UOPS) {
+		/* Leave page-crossing instructions to interpreter (opcode
+		itself might lie beyond the end of the page) */
+		if (offset + size >= MEM_PAGE_SIZE)
+			break;
+		opcode = mem[size];
+		length = lr35902_lengths[opcode];
+		if (offset + size + length > MEM_PAGE_SIZE)
+			break;
+
+		/* Decode instruction (CB-prefixed opcodes are resolved here) */
+		uop = &block->uops[block->num_uops++];
+		uop->pc = cpu->PC + size;
+		uop->length = length;
+		uop->operand = 0;
+		if (length > 1)
+			uop->operand = mem[size + 1];
+		if (length > 2)
+			uop->operand |= mem[size + 2] << 8;
+		uop->handler = (opcode == 0xCB) ?
+			lr35902_cb_handlers[uop->operand] :
+			lr35902_handlers[opcode];
+		size += length;
+
+		/* Stop after unconditional jumps and halts */
+		if ((opcode == 0x10) ||
+			(opcode == 0x18) ||
+			(opcode == 0x76) ||
+			(opcode == 0xC3) ||
+			(opcode == 0xC9) ||
+			(opcode == 0xCD) ||
+			(opcode == 0xD9) ||
+			(opcode == 0xE9) ||
+			((opcode & 0xC7) == 0xC7))
+			break;
+	}
+
+	/* Save source of writable code to validate it */
+	if (writable)
+		memcpy(block->source, mem, size);
+}
+
+struct lr35902_block *lr35902_cache_get_block(struct lr35902 *cpu)
+{
+	struct lr35902_block *block;
+	struct page *page;
+	uint8_t *mem;
+	bool writable;
+	int index;
+
+	/* Only code located in host memory is cached */
+	page = memory_get_page(cpu->bus_id, cpu->PC);
+	if (!page || !page->readb.mem)
+		return NULL;
+	mem = page->readb.mem + (cpu->PC & MEM_PAGE_MASK);
+
+	/* Return cached block if it matches location (blocks are looked up by
+	guest address and host memory, following bank switches) */
+	index = (cpu->PC ^ ((uintptr_t)page->readb.mem >> MEM_PAGE_SHIFT)) %
+		CACHE_NUM_BLOCKS;
+	block = &cpu->blocks[index];
+	if ((block->pc == cpu->PC) && (block->mem == mem))
+		return block;
+
+	/* Decode block (code might get written if region allows it) */
+	writable = (page->readb.region->mops->writeb != NULL);
+	lr35902_cache_decode(cpu, block, mem, writable);
+
+	/* Drop block if not even one instruction could be decoded */
+	if (block->num_uops == 0) {
+		block->mem = NULL;
+		return NULL;
+	}
+	return block;
+}
+
+struct lr35902_uop *lr35902_cache_fetch(struct lr35902 *cpu)
+{
+	struct lr35902_block *block = cpu->block;
+	struct lr35902_uop *uop;
+	int offset;
+
+	/* Look block up unless current one goes on at PC (changes to memory
+	mapping such as bank switches also force a lookup) */
+	if (!block ||
+		(cpu->uop_index == block->num_uops) ||
+		(block->uops[cpu->uop_index].pc != cpu->PC) ||
+		(cpu->map_generation != memory_map_generation)) {
+		block = lr35902_cache_get_block(cpu);
+		cpu->block = block;
+		cpu->uop_index = 0;
+		cpu->map_generation = memory_map_generation;
+		if (!block)
+			return NULL;
+	}
+
+	/* Drop block if instruction was overwritten (writable code only) */
+	uop = &block->uops[cpu->uop_index];
+	offset = uop->pc - block->pc;
+	if (block->writable &&
+		memcmp(&block->source[offset], &block->mem[offset], uop->length)) {
+		block->mem = NULL;
+		cpu->block = NULL;
+		return NULL;
+	}
+
+	/* Move to next instruction */
+	cpu->uop_index++;
+	return uop;
+}
+
+void lr35902_cache_flush(struct lr35902 *cpu)
+{
+	int i;
+
+	/* Invalidate all blocks */
+	for (i = 0; i < CACHE_NUM_BLOCKS; i++)
+		cpu->blocks[i].mem = NULL;
+	cpu->block = NULL;
+}
+
+void lr35902_defer_flags(struct lr35902 *cpu, uint8_t op, uint8_t a,
+	uint8_t b, uint16_t result)
+{
+	/* Record operation (INC/DEC keep previous carry in b) */
+	cpu->alu_op = op;
+	cpu->alu_a = a;
+	cpu->alu_b = b;
+	cpu->alu_result = result;
+}
+
+uint8_t lr35902_get_carry(struct lr35902 *cpu)
+{
+	/* Derive carry flag from pending operation without computing F */
+	switch (cpu->alu_op) {
+	case ALU_ADD:
+	case ALU_SUB:
+		return (cpu->alu_result >> 8) & 1;
+	case ALU_INC:
+	case ALU_DEC:
+		return cpu->alu_b;
+	case ALU_AND:
+	case ALU_OR:
+		return 0;
+	default:
+		return cpu->flags.C;
+	}
+}
+
+void lr35902_sync_flags(struct lr35902 *cpu)
+{
+	/* Compute F only if an operation is pending */
+	if (cpu->alu_op != ALU_NONE)
+		lr35902_compute_flags(cpu);
+}
+
+void lr35902_compute_flags(struct lr35902 *cpu)
+{
+	uint16_t result = cpu->alu_result;
+	uint8_t half = (cpu->alu_a ^ cpu->alu_b ^ result) & 0x10;
+
+	/* Zero flag is set the same way by all operations */
+	cpu->F = 0;
+	cpu->flags.Z = ((uint8_t)result == 0);
+
+	/* Compute remaining flags based on operation */
+	switch (cpu->alu_op) {
+	case ALU_ADD:
+		cpu->flags.H = (half != 0);
+		cpu->flags.C = result >> 8;
 		break;
-	case 0x56:
-		LD_r_cHL(cpu, &cpu->D);
+	case ALU_SUB:
+		cpu->flags.N = 1;
+		cpu->flags.H = (half != 0);
+		cpu->flags.C = result >> 8;
 		break;
-	case 0x57:
-		LD_r_r(cpu, &cpu->D, &cpu->A);
+	case ALU_INC:
+		cpu->flags.H = ((result & 0x0F) == 0x00);
+		cpu->flags.C = cpu->alu_b;
 		break;
-	case 0x58:
-		LD_r_r(cpu, &cpu->E, &cpu->B);
+	case ALU_DEC:
+		cpu->flags.N = 1;
+		cpu->flags.H = ((result & 0x0F) == 0x0F);
+		cpu->flags.C = cpu->alu_b;
 		break;
-	case 0x59:
-		LD_r_r(cpu, &cpu->E, &cpu->C);
+	case ALU_AND:
+		cpu->flags.H = 1;
 		break;
-	case 0x5A:
-		LD_r_r(cpu, &cpu->E, &cpu->D);
-		break;
-	case 0x5B:
-		LD_r_r(cpu, &cpu->E, &cpu->E);
-		break;
-	case 0x5C:
-		LD_r_r(cpu, &cpu->E, &cpu->H);
-		break;
-	case 0x5D:
-		LD_r_r(cpu, &cpu->E, &cpu->L);
-		break;
-	case 0x5E:
-		LD_r_cHL(cpu, &cpu->E);
-		break;
-	case 0x5F:
-		LD_r_r(cpu, &cpu->E, &cpu->A);
-		break;
-	case 0x60:
-		LD_r_r(cpu, &cpu->H, &cpu->B);
-		break;
-	case 0x61:
-		LD_r_r(cpu, &cpu->H, &cpu->C);
-		break;
-	case 0x62:
-		LD_r_r(cpu, &cpu->H, &cpu->D);
-		break;
-	case 0x63:
-		LD_r_r(cpu, &cpu->H, &cpu->E);
-		break;
-	case 0x64:
-		LD_r_r(cpu, &cpu->H, &cpu->H);
-		break;
-	case 0x65:
-		LD_r_r(cpu, &cpu->H, &cpu->L);
-		break;
-	case 0x66:
-		LD_r_cHL(cpu, &cpu->H);
-		break;
-	case 0x67:
-		LD_r_r(cpu, &cpu->H, &cpu->A);
-		break;
-	case 0x68:
-		LD_r_r(cpu, &cpu->L, &cpu->B);
-		break;
-	case 0x69:
-		LD_r_r(cpu, &cpu->L, &cpu->C);
-		break;
-	case 0x6A:
-		LD_r_r(cpu, &cpu->L, &cpu->D);
-		break;
-	case 0x6B:
-		LD_r_r(cpu, &cpu->L, &cpu->E);
-		break;
-	case 0x6C:
-		LD_r_r(cpu, &cpu->L, &cpu->H);
-		break;
-	case 0x6D:
-		LD_r_r(cpu, &cpu->L, &cpu->L);
-		break;
-	case 0x6E:
-		LD_r_cHL(cpu, &cpu->L);
-		break;
-	case 0x6F:
-		LD_r_r(cpu, &cpu->L, &cpu->A);
-		break;
-	case 0x70:
-		LD_cHL_r(cpu, &cpu->B);
-		break;
-	case 0x71:
-		LD_cHL_r(cpu, &cpu->C);
-		break;
-	case 0x72:
-		LD_cHL_r(cpu, &cpu->D);
-		break;
-	case 0x73:
-		LD_cHL_r(cpu, &cpu->E);
-		break;
-	case 0x74:
-		LD_cHL_r(cpu, &cpu->H);
-		break;
-	case 0x75:
-		LD_cHL_r(cpu, &cpu->L);
-		break;
-	case 0x76:
-		HALT(cpu);
-		break;
-	case 0x77:
-		LD_cHL_r(cpu, &cpu->A);
-		break;
-	case 0x78:
-		LD_r_r(cpu, &cpu->A, &cpu->B);
-		break;
-	case 0x79:
-		LD_r_r(cpu, &cpu->A, &cpu->C);
-		break;
-	case 0x7A:
-		LD_r_r(cpu, &cpu->A, &cpu->D);
-		break;
-	case 0x7B:
-		LD_r_r(cpu, &cpu->A, &cpu->E);
-		break;
-	case 0x7C:
-		LD_r_r(cpu, &cpu->A, &cpu->H);
-		break;
-	case 0x7D:
-		LD_r_r(cpu, &cpu->A, &cpu->L);
-		break;
-	case 0x7E:
-		LD_r_cHL(cpu, &cpu->A);
-		break;
-	case 0x7F:
-		LD_r_r(cpu, &cpu->A, &cpu->A);
-		break;
-	case 0x80:
-		ADD_A_r(cpu, &cpu->B);
-		break;
-	case 0x81:
-		ADD_A_r(cpu, &cpu->C);
-		break;
-	case 0x82:
-		ADD_A_r(cpu, &cpu->D);
-		break;
-	case 0x83:
-		ADD_A_r(cpu, &cpu->E);
-		break;
-	case 0x84:
-		ADD_A_r(cpu, &cpu->H);
-		break;
-	case 0x85:
-		ADD_A_r(cpu, &cpu->L);
-		break;
-	case 0x86:
-		ADD_A_cHL(cpu);
-		break;
-	case 0x87:
-		ADD_A_r(cpu, &cpu->A);
-		break;
-	case 0x88:
-		ADC_A_r(cpu, &cpu->B);
-		break;
-	case 0x89:
-		ADC_A_r(cpu, &cpu->C);
-		break;
-	case 0x8A:
-		ADC_A_r(cpu, &cpu->D);
-		break;
-	case 0x8B:
-		ADC_A_r(cpu, &cpu->E);
-		break;
-	case 0x8C:
-		ADC_A_r(cpu, &cpu->H);
-		break;
-	case 0x8D:
-		ADC_A_r(cpu, &cpu->L);
-		break;
-	case 0x8E:
-		ADC_A_cHL(cpu);
-		break;
-	case 0x8F:
-		ADC_A_r(cpu, &cpu->A);
-		break;
-	case 0x90:
-		SUB_A_r(cpu, &cpu->B);
-		break;
-	case 0x91:
-		SUB_A_r(cpu, &cpu->C);
-		break;
-	case 0x92:
-		SUB_A_r(cpu, &cpu->D);
-		break;
-	case 0x93:
-		SUB_A_r(cpu, &cpu->E);
-		break;
-	case 0x94:
-		SUB_A_r(cpu, &cpu->H);
-		break;
-	case 0x95:
-		SUB_A_r(cpu, &cpu->L);
-		break;
-	case 0x96:
-		SUB_A_cHL(cpu);
-		break;
-	case 0x97:
-		SUB_A_r(cpu, &cpu->A);
-		break;
-	case 0x98:
-		SBC_A_r(cpu, &cpu->B);
-		break;
-	case 0x99:
-		SBC_A_r(cpu, &cpu->C);
-		break;
-	case 0x9A:
-		SBC_A_r(cpu, &cpu->D);
-		break;
-	case 0x9B:
-		SBC_A_r(cpu, &cpu->E);
-		break;
-	case 0x9C:
-		SBC_A_r(cpu, &cpu->H);
-		break;
-	case 0x9D:
-		SBC_A_r(cpu, &cpu->L);
-		break;
-	case 0x9E:
-		SBC_A_cHL(cpu);
-		break;
-	case 0x9F:
-		SBC_A_r(cpu, &cpu->A);
-		break;
-	case 0xA0:
-		AND_r(cpu, &cpu->B);
-		break;
-	case 0xA1:
-		AND_r(cpu, &cpu->C);
-		break;
-	case 0xA2:
-		AND_r(cpu, &cpu->D);
-		break;
-	case 0xA3:
-		AND_r(cpu, &cpu->E);
-		break;
-	case 0xA4:
-		AND_r(cpu, &cpu->H);
-		break;
-	case 0xA5:
-		AND_r(cpu, &cpu->L);
-		break;
-	case 0xA6:
-		AND_cHL(cpu);
-		break;
-	case 0xA7:
-		AND_r(cpu, &cpu->A);
-		break;
-	case 0xA8:
-		XOR_r(cpu, &cpu->B);
-		break;
-	case 0xA9:
-		XOR_r(cpu, &cpu->C);
-		break;
-	case 0xAA:
-		XOR_r(cpu, &cpu->D);
-		break;
-	case 0xAB:
-		XOR_r(cpu, &cpu->E);
-		break;
-	case 0xAC:
-		XOR_r(cpu, &cpu->H);
-		break;
-	case 0xAD:
-		XOR_r(cpu, &cpu->L);
-		break;
-	case 0xAE:
-		XOR_cHL(cpu);
-		break;
-	case 0xAF:
-		XOR_r(cpu, &cpu->A);
-		break;
-	case 0xB0:
-		OR_r(cpu, &cpu->B);
-		break;
-	case 0xB1:
-		OR_r(cpu, &cpu->C);
-		break;
-	case 0xB2:
-		OR_r(cpu, &cpu->D);
-		break;
-	case 0xB3:
-		OR_r(cpu, &cpu->E);
-		break;
-	case 0xB4:
-		OR_r(cpu, &cpu->H);
-		break;
-	case 0xB5:
-		OR_r(cpu, &cpu->L);
-		break;
-	case 0xB6:
-		OR_cHL(cpu);
-		break;
-	case 0xB7:
-		OR_r(cpu, &cpu->A);
-		break;
-	case 0xB8:
-		CP_r(cpu, &cpu->B);
-		break;
-	case 0xB9:
-		CP_r(cpu, &cpu->C);
-		break;
-	case 0xBA:
-		CP_r(cpu, &cpu->D);
-		break;
-	case 0xBB:
-		CP_r(cpu, &cpu->E);
-		break;
-	case 0xBC:
-		CP_r(cpu, &cpu->H);
-		break;
-	case 0xBD:
-		CP_r(cpu, &cpu->L);
-		break;
-	case 0xBE:
-		CP_cHL(cpu);
-		break;
-	case 0xBF:
-		CP_r(cpu, &cpu->A);
-		break;
-	case 0xC0:
-		RET_NZ(cpu);
-		break;
-	case 0xC1:
-		POP_rr(cpu, &cpu->BC);
-		break;
-	case 0xC2:
-		JP_NZ_nn(cpu);
-		break;
-	case 0xC3:
-		JP_nn(cpu);
-		break;
-	case 0xC4:
-		CALL_NZ_nn(cpu);
-		break;
-	case 0xC5:
-		PUSH_rr(cpu, &cpu->BC);
-		break;
-	case 0xC6:
-		ADD_A_n(cpu);
-		break;
-	case 0xC7:
-		RST_n(cpu, 0x00);
-		break;
-	case 0xC8:
-		RET_Z(cpu);
-		break;
-	case 0xC9:
-		RET(cpu);
-		break;
-	case 0xCA:
-		JP_Z_nn(cpu);
-		break;
-	case 0xCB:
-		lr35902_opcode_CB(cpu);
-		break;
-	case 0xCC:
-		CALL_Z_nn(cpu);
-		break;
-	case 0xCD:
-		CALL_nn(cpu);
-		break;
-	case 0xCE:
-		ADC_A_n(cpu);
-		break;
-	case 0xCF:
-		RST_n(cpu, 0x08);
-		break;
-	case 0xD0:
-		RET_NC(cpu);
-		break;
-	case 0xD1:
-		POP_rr(cpu, &cpu->DE);
-		break;
-	case 0xD2:
-		JP_NC_nn(cpu);
-		break;
-	case 0xD4:
-		CALL_NC_nn(cpu);
-		break;
-	case 0xD5:
-		PUSH_rr(cpu, &cpu->DE);
-		break;
-	case 0xD6:
-		SUB_A_n(cpu);
-		break;
-	case 0xD7:
-		RST_n(cpu, 0x10);
-		break;
-	case 0xD8:
-		RET_C(cpu);
-		break;
-	case 0xD9:
-		RETI(cpu);
-		break;
-	case 0xDA:
-		JP_C_nn(cpu);
-		break;
-	case 0xDC:
-		CALL_C_nn(cpu);
-		break;
-	case 0xDE:
-		SBC_A_n(cpu);
-		break;
-	case 0xDF:
-		RST_n(cpu, 0x18);
-		break;
-	case 0xE0:
-		LD_cFF00pn_A(cpu);
-		break;
-	case 0xE1:
-		POP_rr(cpu, &cpu->HL);
-		break;
-	case 0xE2:
-		LD_cFF00pC_A(cpu);
-		break;
-	case 0xE5:
-		PUSH_rr(cpu, &cpu->HL);
-		break;
-	case 0xE6:
-		AND_n(cpu);
-		break;
-	case 0xE7:
-		RST_n(cpu, 0x20);
-		break;
-	case 0xE8:
-		ADD_SP_d(cpu);
-		break;
-	case 0xE9:
-		JP_HL(cpu);
-		break;
-	case 0xEA:
-		LD_cnn_A(cpu);
-		break;
-	case 0xEE:
-		XOR_n(cpu);
-		break;
-	case 0xEF:
-		RST_n(cpu, 0x28);
-		break;
-	case 0xF0:
-		LD_A_cFF00pn(cpu);
-		break;
-	case 0xF1:
-		POP_AF(cpu);
-		break;
-	case 0xF2:
-		LD_A_cFF00pC(cpu);
-		break;
-	case 0xF3:
-		DI(cpu);
-		break;
-	case 0xF5:
-		PUSH_rr(cpu, &cpu->AF);
-		break;
-	case 0xF6:
-		OR_n(cpu);
-		break;
-	case 0xF7:
-		RST_n(cpu, 0x30);
-		break;
-	case 0xF8:
-		LD_HL_SPpd(cpu);
-		break;
-	case 0xF9:
-		LD_SP_HL(cpu);
-		break;
-	case 0xFA:
-		LD_A_cnn(cpu);
-		break;
-	case 0xFB:
-		EI(cpu);
-		break;
-	case 0xFE:
-		CP_n(cpu);
-		break;
-	case 0xFF:
-		RST_n(cpu, 0x38);
-		break;
-	default:
-		LOG_W("lr35902: unknown opcode (%02x)!\n", opcode);
-		clock_consume(1);
+	default:
 		break;
 	}
-}
-
-void lr35902_opcode_CB(struct lr35902 *cpu)
-{
-	uint8_t opcode;
-
-	/* Fetch CB opcode */
-	opcode = memory_readb(cpu->bus_id, cpu->PC++);
 
-	/* Execute CB opcode */
-	switch (opcode) {
-	case 0x00:
-		RLC_r(cpu, &cpu->B);
-		break;
-	case 0x01:
-		RLC_r(cpu, &cpu->C);
-		break;
-	case 0x02:
-		RLC_r(cpu, &cpu->D);
-		break;
-	case 0x03:
-		RLC_r(cpu, &cpu->E);
-		break;
-	case 0x04:
-		RLC_r(cpu, &cpu->H);
-		break;
-	case 0x05:
-		RLC_r(cpu, &cpu->L);
-		break;
-	case 0x06:
-		RLC_cHL(cpu);
-		break;
-	case 0x07:
-		RLC_r(cpu, &cpu->A);
-		break;
-	case 0x08:
-		RRC_r(cpu, &cpu->B);
-		break;
-	case 0x09:
-		RRC_r(cpu, &cpu->C);
-		break;
-	case 0x0A:
-		RRC_r(cpu, &cpu->D);
-		break;
-	case 0x0B:
-		RRC_r(cpu, &cpu->E);
-		break;
-	case 0x0C:
-		RRC_r(cpu, &cpu->H);
-		break;
-	case 0x0D:
-		RRC_r(cpu, &cpu->L);
-		break;
-	case 0x0E:
-		RRC_cHL(cpu);
-		break;
-	case 0x0F:
-		RRC_r(cpu, &cpu->A);
-		break;
-	case 0x10:
-		RL_r(cpu, &cpu->B);
-		break;
-	case 0x11:
-		RL_r(cpu, &cpu->C);
-		break;
-	case 0x12:
-		RL_r(cpu, &cpu->D);
-		break;
-	case 0x13:
-		RL_r(cpu, &cpu->E);
-		break;
-	case 0x14:
-		RL_r(cpu, &cpu->H);
-		break;
-	case 0x15:
-		RL_r(cpu, &cpu->L);
-		break;
-	case 0x16:
-		RL_cHL(cpu);
-		break;
-	case 0x17:
-		RL_r(cpu, &cpu->A);
-		break;
-	case 0x18:
-		RR_r(cpu, &cpu->B);
-		break;
-	case 0x19:
-		RR_r(cpu, &cpu->C);
-		break;
-	case 0x1A:
-		RR_r(cpu, &cpu->D);
-		break;
-	case 0x1B:
-		RR_r(cpu, &cpu->E);
-		break;
-	case 0x1C:
-		RR_r(cpu, &cpu->H);
-		break;
-	case 0x1D:
-		RR_r(cpu, &cpu->L);
-		break;
-	case 0x1E:
-		RR_cHL(cpu);
-		break;
-	case 0x1F:
-		RR_r(cpu, &cpu->A);
-		break;
-	case 0x20:
-		SLA_r(cpu, &cpu->B);
-		break;
-	case 0x21:
-		SLA_r(cpu, &cpu->C);
-		break;
-	case 0x22:
-		SLA_r(cpu, &cpu->D);
-		break;
-	case 0x23:
-		SLA_r(cpu, &cpu->E);
-		break;
-	case 0x24:
-		SLA_r(cpu, &cpu->H);
-		break;
-	case 0x25:
-		SLA_r(cpu, &cpu->L);
-		break;
-	case 0x26:
-		SLA_cHL(cpu);
-		break;
-	case 0x27:
-		SLA_r(cpu, &cpu->A);
-		break;
-	case 0x28:
-		SRA_r(cpu, &cpu->B);
-		break;
-	case 0x29:
-		SRA_r(cpu, &cpu->C);
-		break;
-	case 0x2A:
-		SRA_r(cpu, &cpu->D);
-		break;
-	case 0x2B:
-		SRA_r(cpu, &cpu->E);
-		break;
-	case 0x2C:
-		SRA_r(cpu, &cpu->H);
-		break;
-	case 0x2D:
-		SRA_r(cpu, &cpu->L);
-		break;
-	case 0x2E:
-		SRA_cHL(cpu);
-		break;
-	case 0x2F:
-		SRA_r(cpu, &cpu->A);
-		break;
-	case 0x30:
-		SWAP_r(cpu, &cpu->B);
-		break;
-	case 0x31:
-		SWAP_r(cpu, &cpu->C);
-		break;
-	case 0x32:
-		SWAP_r(cpu, &cpu->D);
-		break;
-	case 0x33:
-		SWAP_r(cpu, &cpu->E);
-		break;
-	case 0x34:
-		SWAP_r(cpu, &cpu->H);
-		break;
-	case 0x35:
-		SWAP_r(cpu, &cpu->L);
-		break;
-	case 0x36:
-		SWAP_cHL(cpu);
-		break;
-	case 0x37:
-		SWAP_r(cpu, &cpu->A);
-		break;
-	case 0x38:
-		SRL_r(cpu, &cpu->B);
-		break;
-	case 0x39:
-		SRL_r(cpu, &cpu->C);
-		break;
-	case 0x3A:
-		SRL_r(cpu, &cpu->D);
-		break;
-	case 0x3B:
-		SRL_r(cpu, &cpu->E);
-		break;
-	case 0x3C:
-		SRL_r(cpu, &cpu->H);
-		break;
-	case 0x3D:
-		SRL_r(cpu, &cpu->L);
-		break;
-	case 0x3E:
-		SRL_cHL(cpu);
-		break;
-	case 0x3F:
-		SRL_r(cpu, &cpu->A);
-		break;
-	case 0x40:
-		BIT_n_r(cpu, 0, &cpu->B);
-		break;
-	case 0x41:
-		BIT_n_r(cpu, 0, &cpu->C);
-		break;
-	case 0x42:
-		BIT_n_r(cpu, 0, &cpu->D);
-		break;
-	case 0x43:
-		BIT_n_r(cpu, 0, &cpu->E);
-		break;
-	case 0x44:
-		BIT_n_r(cpu, 0, &cpu->H);
-		break;
-	case 0x45:
-		BIT_n_r(cpu, 0, &cpu->L);
-		break;
-	case 0x46:
-		BIT_n_cHL(cpu, 0);
-		break;
-	case 0x47:
-		BIT_n_r(cpu, 0, &cpu->A);
-		break;
-	case 0x48:
-		BIT_n_r(cpu, 1, &cpu->B);
-		break;
-	case 0x49:
-		BIT_n_r(cpu, 1, &cpu->C);
-		break;
-	case 0x4A:
-		BIT_n_r(cpu, 1, &cpu->D);
-		break;
-	case 0x4B:
-		BIT_n_r(cpu, 1, &cpu->E);
-		break;
-	case 0x4C:
-		BIT_n_r(cpu, 1, &cpu->H);
-		break;
-	case 0x4D:
-		BIT_n_r(cpu, 1, &cpu->L);
-		break;
-	case 0x4E:
-		BIT_n_cHL(cpu, 1);
-		break;
-	case 0x4F:
-		BIT_n_r(cpu, 1, &cpu->A);
-		break;
-	case 0x50:
-		BIT_n_r(cpu, 2, &cpu->B);
-		break;
-	case 0x51:
-		BIT_n_r(cpu, 2, &cpu->C);
-		break;
-	case 0x52:
-		BIT_n_r(cpu, 2, &cpu->D);
-		break;
-	case 0x53:
-		BIT_n_r(cpu, 2, &cpu->E);
-		break;
-	case 0x54:
-		BIT_n_r(cpu, 2, &cpu->H);
-		break;
-	case 0x55:
-		BIT_n_r(cpu, 2, &cpu->L);
-		break;
-	case 0x56:
-		BIT_n_cHL(cpu, 2);
-		break;
-	case 0x57:
-		BIT_n_r(cpu, 2, &cpu->A);
-		break;
-	case 0x58:
-		BIT_n_r(cpu, 3, &cpu->B);
-		break;
-	case 0x59:
-		BIT_n_r(cpu, 3, &cpu->C);
-		break;
-	case 0x5A:
-		BIT_n_r(cpu, 3, &cpu->D);
-		break;
-	case 0x5B:
-		BIT_n_r(cpu, 3, &cpu->E);
-		break;
-	case 0x5C:
-		BIT_n_r(cpu, 3, &cpu->H);
-		break;
-	case 0x5D:
-		BIT_n_r(cpu, 3, &cpu->L);
-		break;
-	case 0x5E:
-		BIT_n_cHL(cpu, 3);
-		break;
-	case 0x5F:
-		BIT_n_r(cpu, 3, &cpu->A);
-		break;
-	case 0x60:
-		BIT_n_r(cpu, 4, &cpu->B);
-		break;
-	case 0x61:
-		BIT_n_r(cpu, 4, &cpu->C);
-		break;
-	case 0x62:
-		BIT_n_r(cpu, 4, &cpu->D);
-		break;
-	case 0x63:
-		BIT_n_r(cpu, 4, &cpu->E);
-		break;
-	case 0x64:
-		BIT_n_r(cpu, 4, &cpu->H);
-		break;
-	case 0x65:
-		BIT_n_r(cpu, 4, &cpu->L);
-		break;
-	case 0x66:
-		BIT_n_cHL(cpu, 4);
-		break;
-	case 0x67:
-		BIT_n_r(cpu, 4, &cpu->A);
-		break;
-	case 0x68:
-		BIT_n_r(cpu, 5, &cpu->B);
-		break;
-	case 0x69:
-		BIT_n_r(cpu, 5, &cpu->C);
-		break;
-	case 0x6A:
-		BIT_n_r(cpu, 5, &cpu->D);
-		break;
-	case 0x6B:
-		BIT_n_r(cpu, 5, &cpu->E);
-		break;
-	case 0x6C:
-		BIT_n_r(cpu, 5, &cpu->H);
-		break;
-	case 0x6D:
-		BIT_n_r(cpu, 5, &cpu->L);
-		break;
-	case 0x6E:
-		BIT_n_cHL(cpu, 5);
-		break;
-	case 0x6F:
-		BIT_n_r(cpu, 5, &cpu->A);
-		break;
-	case 0x70:
-		BIT_n_r(cpu, 6, &cpu->B);
-		break;
-	case 0x71:
-		BIT_n_r(cpu, 6, &cpu->C);
-		break;
-	case 0x72:
-		BIT_n_r(cpu, 6, &cpu->D);
-		break;
-	case 0x73:
-		BIT_n_r(cpu, 6, &cpu->E);
-		break;
-	case 0x74:
-		BIT_n_r(cpu, 6, &cpu->H);
-		break;
-	case 0x75:
-		BIT_n_r(cpu, 6, &cpu->L);
-		break;
-	case 0x76:
-		BIT_n_cHL(cpu, 6);
-		break;
-	case 0x77:
-		BIT_n_r(cpu, 6, &cpu->A);
-		break;
-	case 0x78:
-		BIT_n_r(cpu, 7, &cpu->B);
-		break;
-	case 0x79:
-		BIT_n_r(cpu, 7, &cpu->C);
-		break;
-	case 0x7A:
-		BIT_n_r(cpu, 7, &cpu->D);
-		break;
-	case 0x7B:
-		BIT_n_r(cpu, 7, &cpu->E);
-		break;
-	case 0x7C:
-		BIT_n_r(cpu, 7, &cpu->H);
-		break;
-	case 0x7D:
-		BIT_n_r(cpu, 7, &cpu->L);
-		break;
-	case 0x7E:
-		BIT_n_cHL(cpu, 7);
-		break;
-	case 0x7F:
-		BIT_n_r(cpu, 7, &cpu->A);
-		break;
-	case 0x80:
-		RES_n_r(cpu, 0, &cpu->B);
-		break;
-	case 0x81:
-		RES_n_r(cpu, 0, &cpu->C);
-		break;
-	case 0x82:
-		RES_n_r(cpu, 0, &cpu->D);
-		break;
-	case 0x83:
-		RES_n_r(cpu, 0, &cpu->E);
-		break;
-	case 0x84:
-		RES_n_r(cpu, 0, &cpu->H);
-		break;
-	case 0x85:
-		RES_n_r(cpu, 0, &cpu->L);
-		break;
-	case 0x86:
-		RES_n_cHL(cpu, 0);
-		break;
-	case 0x87:
-		RES_n_r(cpu, 0, &cpu->A);
-		break;
-	case 0x88:
-		RES_n_r(cpu, 1, &cpu->B);
-		break;
-	case 0x89:
-		RES_n_r(cpu, 1, &cpu->C);
-		break;
-	case 0x8A:
-		RES_n_r(cpu, 1, &cpu->D);
-		break;
-	case 0x8B:
-		RES_n_r(cpu, 1, &cpu->E);
-		break;
-	case 0x8C:
-		RES_n_r(cpu, 1, &cpu->H);
-		break;
-	case 0x8D:
-		RES_n_r(cpu, 1, &cpu->L);
-		break;
-	case 0x8E:
-		RES_n_cHL(cpu, 1);
-		break;
-	case 0x8F:
-		RES_n_r(cpu, 1, &cpu->A);
-		break;
-	case 0x90:
-		RES_n_r(cpu, 2, &cpu->B);
-		break;
-	case 0x91:
-		RES_n_r(cpu, 2, &cpu->C);
-		break;
-	case 0x92:
-		RES_n_r(cpu, 2, &cpu->D);
-		break;
-	case 0x93:
-		RES_n_r(cpu, 2, &cpu->E);
-		break;
-	case 0x94:
-		RES_n_r(cpu, 2, &cpu->H);
-		break;
-	case 0x95:
-		RES_n_r(cpu, 2, &cpu->L);
-		break;
-	case 0x96:
-		RES_n_cHL(cpu, 2);
-		break;
-	case 0x97:
-		RES_n_r(cpu, 2, &cpu->A);
-		break;
-	case 0x98:
-		RES_n_r(cpu, 3, &cpu->B);
-		break;
-	case 0x99:
-		RES_n_r(cpu, 3, &cpu->C);
-		break;
-	case 0x9A:
-		RES_n_r(cpu, 3, &cpu->D);
-		break;
-	case 0x9B:
-		RES_n_r(cpu, 3, &cpu->E);
-		break;
-	case 0x9C:
-		RES_n_r(cpu, 3, &cpu->H);
-		break;
-	case 0x9D:
-		RES_n_r(cpu, 3, &cpu->L);
-		break;
-	case 0x9E:
-		RES_n_cHL(cpu, 3);
-		break;
-	case 0x9F:
-		RES_n_r(cpu, 3, &cpu->A);
-		break;
-	case 0xA0:
-		RES_n_r(cpu, 4, &cpu->B);
-		break;
-	case 0xA1:
-		RES_n_r(cpu, 4, &cpu->C);
-		break;
-	case 0xA2:
-		RES_n_r(cpu, 4, &cpu->D);
-		break;
-	case 0xA3:
-		RES_n_r(cpu, 4, &cpu->E);
-		break;
-	case 0xA4:
-		RES_n_r(cpu, 4, &cpu->H);
-		break;
-	case 0xA5:
-		RES_n_r(cpu, 4, &cpu->L);
-		break;
-	case 0xA6:
-		RES_n_cHL(cpu, 4);
-		break;
-	case 0xA7:
-		RES_n_r(cpu, 4, &cpu->A);
-		break;
-	case 0xA8:
-		RES_n_r(cpu, 5, &cpu->B);
-		break;
-	case 0xA9:
-		RES_n_r(cpu, 5, &cpu->C);
-		break;
-	case 0xAA:
-		RES_n_r(cpu, 5, &cpu->D);
-		break;
-	case 0xAB:
-		RES_n_r(cpu, 5, &cpu->E);
-		break;
-	case 0xAC:
-		RES_n_r(cpu, 5, &cpu->H);
-		break;
-	case 0xAD:
-		RES_n_r(cpu, 5, &cpu->L);
-		break;
-	case 0xAE:
-		RES_n_cHL(cpu, 5);
-		break;
-	case 0xAF:
-		RES_n_r(cpu, 5, &cpu->A);
-		break;
-	case 0xB0:
-		RES_n_r(cpu, 6, &cpu->B);
-		break;
-	case 0xB1:
-		RES_n_r(cpu, 6, &cpu->C);
-		break;
-	case 0xB2:
-		RES_n_r(cpu, 6, &cpu->D);
-		break;
-	case 0xB3:
-		RES_n_r(cpu, 6, &cpu->E);
-		break;
-	case 0xB4:
-		RES_n_r(cpu, 6, &cpu->H);
-		break;
-	case 0xB5:
-		RES_n_r(cpu, 6, &cpu->L);
-		break;
-	case 0xB6:
-		RES_n_cHL(cpu, 6);
-		break;
-	case 0xB7:
-		RES_n_r(cpu, 6, &cpu->A);
-		break;
-	case 0xB8:
-		RES_n_r(cpu, 7, &cpu->B);
-		break;
-	case 0xB9:
-		RES_n_r(cpu, 7, &cpu->C);
-		break;
-	case 0xBA:
-		RES_n_r(cpu, 7, &cpu->D);
-		break;
-	case 0xBB:
-		RES_n_r(cpu, 7, &cpu->E);
-		break;
-	case 0xBC:
-		RES_n_r(cpu, 7, &cpu->H);
-		break;
-	case 0xBD:
-		RES_n_r(cpu, 7, &cpu->L);
-		break;
-	case 0xBE:
-		RES_n_cHL(cpu, 7);
-		break;
-	case 0xBF:
-		RES_n_r(cpu, 7, &cpu->A);
-		break;
-	case 0xC0:
-		SET_n_r(cpu, 0, &cpu->B);
-		break;
-	case 0xC1:
-		SET_n_r(cpu, 0, &cpu->C);
-		break;
-	case 0xC2:
-		SET_n_r(cpu, 0, &cpu->D);
-		break;
-	case 0xC3:
-		SET_n_r(cpu, 0, &cpu->E);
-		break;
-	case 0xC4:
-		SET_n_r(cpu, 0, &cpu->H);
-		break;
-	case 0xC5:
-		SET_n_r(cpu, 0, &cpu->L);
-		break;
-	case 0xC6:
-		SET_n_cHL(cpu, 0);
-		break;
-	case 0xC7:
-		SET_n_r(cpu, 0, &cpu->A);
-		break;
-	case 0xC8:
-		SET_n_r(cpu, 1, &cpu->B);
-		break;
-	case 0xC9:
-		SET_n_r(cpu, 1, &cpu->C);
-		break;
-	case 0xCA:
-		SET_n_r(cpu, 1, &cpu->D);
-		break;
-	case 0xCB:
-		SET_n_r(cpu, 1, &cpu->E);
-		break;
-	case 0xCC:
-		SET_n_r(cpu, 1, &cpu->H);
-		break;
-	case 0xCD:
-		SET_n_r(cpu, 1, &cpu->L);
-		break;
-	case 0xCE:
-		SET_n_cHL(cpu, 1);
-		break;
-	case 0xCF:
-		SET_n_r(cpu, 1, &cpu->A);
-		break;
-	case 0xD0:
-		SET_n_r(cpu, 2, &cpu->B);
-		break;
-	case 0xD1:
-		SET_n_r(cpu, 2, &cpu->C);
-		break;
-	case 0xD2:
-		SET_n_r(cpu, 2, &cpu->D);
-		break;
-	case 0xD3:
-		SET_n_r(cpu, 2, &cpu->E);
-		break;
-	case 0xD4:
-		SET_n_r(cpu, 2, &cpu->H);
-		break;
-	case 0xD5:
-		SET_n_r(cpu, 2, &cpu->L);
-		break;
-	case 0xD6:
-		SET_n_cHL(cpu, 2);
-		break;
-	case 0xD7:
-		SET_n_r(cpu, 2, &cpu->A);
-		break;
-	case 0xD8:
-		SET_n_r(cpu, 3, &cpu->B);
-		break;
-	case 0xD9:
-		SET_n_r(cpu, 3, &cpu->C);
-		break;
-	case 0xDA:
-		SET_n_r(cpu, 3, &cpu->D);
-		break;
-	case 0xDB:
-		SET_n_r(cpu, 3, &cpu->E);
-		break;
-	case 0xDC:
-		SET_n_r(cpu, 3, &cpu->H);
-		break;
-	case 0xDD:
-		SET_n_r(cpu, 3, &cpu->L);
-		break;
-	case 0xDE:
-		SET_n_cHL(cpu, 3);
-		break;
-	case 0xDF:
-		SET_n_r(cpu, 3, &cpu->A);
-		break;
-	case 0xE0:
-		SET_n_r(cpu, 4, &cpu->B);
-		break;
-	case 0xE1:
-		SET_n_r(cpu, 4, &cpu->C);
-		break;
-	case 0xE2:
-		SET_n_r(cpu, 4, &cpu->D);
-		break;
-	case 0xE3:
-		SET_n_r(cpu, 4, &cpu->E);
-		break;
-	case 0xE4:
-		SET_n_r(cpu, 4, &cpu->H);
-		break;
-	case 0xE5:
-		SET_n_r(cpu, 4, &cpu->L);
-		break;
-	case 0xE6:
-		SET_n_cHL(cpu, 4);
-		break;
-	case 0xE7:
-		SET_n_r(cpu, 4, &cpu->A);
-		break;
-	case 0xE8:
-		SET_n_r(cpu, 5, &cpu->B);
-		break;
-	case 0xE9:
-		SET_n_r(cpu, 5, &cpu->C);
-		break;
-	case 0xEA:
-		SET_n_r(cpu, 5, &cpu->D);
-		break;
-	case 0xEB:
-		SET_n_r(cpu, 5, &cpu->E);
-		break;
-	case 0xEC:
-		SET_n_r(cpu, 5, &cpu->H);
-		break;
-	case 0xED:
-		SET_n_r(cpu, 5, &cpu->L);
-		break;
-	case 0xEE:
-		SET_n_cHL(cpu, 5);
-		break;
-	case 0xEF:
-		SET_n_r(cpu, 5, &cpu->A);
-		break;
-	case 0xF0:
-		SET_n_r(cpu, 6, &cpu->B);
-		break;
-	case 0xF1:
-		SET_n_r(cpu, 6, &cpu->C);
-		break;
-	case 0xF2:
-		SET_n_r(cpu, 6, &cpu->D);
-		break;
-	case 0xF3:
-		SET_n_r(cpu, 6, &cpu->E);
-		break;
-	case 0xF4:
-		SET_n_r(cpu, 6, &cpu->H);
-		break;
-	case 0xF5:
-		SET_n_r(cpu, 6, &cpu->L);
-		break;
-	case 0xF6:
-		SET_n_cHL(cpu, 6);
-		break;
-	case 0xF7:
-		SET_n_r(cpu, 6, &cpu->A);
-		break;
-	case 0xF8:
-		SET_n_r(cpu, 7, &cpu->B);
-		break;
-	case 0xF9:
-		SET_n_r(cpu, 7, &cpu->C);
-		break;
-	case 0xFA:
-		SET_n_r(cpu, 7, &cpu->D);
-		break;
-	case 0xFB:
-		SET_n_r(cpu, 7, &cpu->E);
-		break;
-	case 0xFC:
-		SET_n_r(cpu, 7, &cpu->H);
-		break;
-	case 0xFD:
-		SET_n_r(cpu, 7, &cpu->L);
-		break;
-	case 0xFE:
-		SET_n_cHL(cpu, 7);
-		break;
-	case 0xFF:
-		SET_n_r(cpu, 7, &cpu->A);
-		break;
-	default:
-		LOG_W("lr35902: unknown opcode (%02x)!\n", opcode);
-		clock_consume(1);
-		break;
-	}
+	/* F is now up to date */
+	cpu->alu_op = ALU_NONE;
 }
 
 bool lr35902_init(struct cpu_instance *instance)
@@ -2821,10 +2273,14 @@ bool lr35902_init(struct cpu_instance *instance)
 	/* Allocate lr35902 structure and set private data */
 	cpu = calloc(1, sizeof(struct lr35902));
 	instance->priv_data = cpu;
+	cpu->instance = instance;
 
 	/* Save bus ID */
 	cpu->bus_id = instance->bus_id;
 
+	/* Allocate block cache */
+	cpu->blocks = calloc(CACHE_NUM_BLOCKS, sizeof(struct lr35902_block));
+
 	/* Add CPU clock */
 	res = resource_get("clk",
 		RESOURCE_CLK,
@@ -2835,14 +2291,17 @@ bool lr35902_init(struct cpu_instance *instance)
 	cpu->clock.tick = (clock_tick_t)lr35902_tick;
 	clock_add(&cpu->clock);
 
+	/* Expose CPU clock for statistics */
+	instance->clock = &cpu->clock;
+
 	/* Add IF memory region */
 	res = resource_get("ifr",
 		RESOURCE_MEM,
 		instance->resources,
 		instance->num_resources);
 	cpu->if_region.area = res;
-	cpu->if_region.mops = &ram_mops;
-	cpu->if_region.data = &cpu->IF;
+	cpu->if_region.mops = &if_mops;
+	cpu->if_region.data = cpu;
 	memory_region_add(&cpu->if_region);
 
 	/* Add IE memory region */
@@ -2851,8 +2310,8 @@ bool lr35902_init(struct cpu_instance *instance)
 		instance->resources,
 		instance->num_resources);
 	cpu->ie_region.area = res;
-	cpu->ie_region.mops = &ram_mops;
-	cpu->ie_region.data = &cpu->IE;
+	cpu->ie_region.mops = &ie_mops;
+	cpu->ie_region.data = cpu;
 	memory_region_add(&cpu->ie_region);
 
 	return true;
@@ -2867,6 +2326,11 @@ void lr35902_reset(struct cpu_instance *instance)
 	cpu->IME = 0;
 	cpu->IF = 0;
 	cpu->IE = 0;
+	cpu->alu_op = ALU_NONE;
+	lr35902_update_interrupts(cpu);
+
+	/* Flush block cache */
+	lr35902_cache_flush(cpu);
 
 	/* Enable clock */
 	cpu->clock.enabled = true;
@@ -2878,11 +2342,13 @@ void lr35902_interrupt(struct cpu_instance *instance, int irq)
 
 	/* Flag interrupt request in IF register */
 	cpu->IF |= BIT(irq);
+	lr35902_update_interrupts(cpu);
 }
 
 void lr35902_deinit(struct cpu_instance *instance)
 {
 	struct lr35902 *cpu = instance->priv_data;
+	free(cpu->blocks);
 	free(cpu);
 }
 
@@ -6,6 +6,7 @@
 #include <cpu.h>
 #include <log.h>
 #include <memory.h>
+#include <trace.h>
 #include <util.h>
 
 #define NMI_VECTOR		0xFFFA
@@ -14,6 +15,370 @@
 #define STACK_START		0x100
 #define ZP_SIZE			0x100
 
+/* Status flag masks */
+#define FLAG_C			(1 << 0)
+#define FLAG_Z			(1 << 1)
+#define FLAG_I			(1 << 2)
+#define FLAG_D			(1 << 3)
+#define FLAG_V			(1 << 6)
+#define FLAG_N			(1 << 7)
+
+/* Dynamic recompiler is only available on x86-64 Linux hosts */
+#if defined(CONFIG_RP2A03_JIT) && defined(__GNUC__) && \
+	defined(__x86_64__) && defined(__linux__)
+#define RP2A03_JIT
+#define JIT_CODE_SIZE		MB(4)
+#define JIT_MAX_BLOCKS		16384
+#define JIT_MAX_BLOCK_CODE	KB(8)
+#define JIT_MAX_INSTRUCTIONS	32
+#define JIT_MAX_CYCLES		8
+#define JIT_TABLE_SIZE		4096
+#include <stddef.h>
+#include <sys/mman.h>
+#endif
+
+/* Opcode flags (extra cycle on page crossing, memory write, PC change) */
+#define OP_PAGE_PENALTY		(1 << 0)
+#define OP_WRITE		(1 << 1)
+#define OP_JUMP			(1 << 2)
+
+/* Instruction templates applying an operation through an addressing mode
+(operands are fetched beforehand and passed to the handlers) */
+#define DEFINE_READ(op, mode) \
+	static void op##_##mode(struct rp2a03 *rp2a03, uint16_t operand) \
+	{ \
+		uint16_t address = addr_##mode(rp2a03, operand); \
+		op(rp2a03, memory_readb(rp2a03->bus_id, address)); \
+	}
+#define DEFINE_READ_I(op) \
+	static void op##_I(struct rp2a03 *rp2a03, uint16_t operand) \
+	{ \
+		op(rp2a03, operand); \
+	}
+#define DEFINE_WRITE(op, mode) \
+	static void op##_##mode(struct rp2a03 *rp2a03, uint16_t operand) \
+	{ \
+		uint16_t address = addr_##mode(rp2a03, operand); \
+		memory_writeb(rp2a03->bus_id, op(rp2a03), address); \
+	}
+#define DEFINE_RMW(op, mode) \
+	static void op##_##mode(struct rp2a03 *rp2a03, uint16_t operand) \
+	{ \
+		uint16_t address = addr_##mode(rp2a03, operand); \
+		uint8_t b = memory_readb(rp2a03->bus_id, address); \
+		memory_writeb(rp2a03->bus_id, op(rp2a03, b), address); \
+	}
+#define DEFINE_RMW_ACC(op) \
+	static void op##_ACC(struct rp2a03 *rp2a03, uint16_t UNUSED(operand)) \
+	{ \
+		rp2a03->A = op(rp2a03, rp2a03->A); \
+	}
+#define DEFINE_BRANCH(op, condition) \
+	static void op(struct rp2a03 *rp2a03, uint16_t operand) \
+	{ \
+		branch(rp2a03, condition, operand); \
+	}
+
+/* Opcode table (opcode, handler, length, base cycles, flags): undocumented
+opcodes are handled by ILL and can be implemented here */
+#define RP2A03_OPCODES(X) \
+	X(0x00, BRK, 1, 7, OP_WRITE | OP_JUMP) \
+	X(0x01, ORA_IX, 2, 6, 0) \
+	X(0x02, ILL, 1, 1, 0) \
+	X(0x03, ILL, 1, 1, 0) \
+	X(0x04, NOP, 2, 3, 0) \
+	X(0x05, ORA_ZP, 2, 3, 0) \
+	X(0x06, ASL_ZP, 2, 5, OP_WRITE) \
+	X(0x07, ILL, 1, 1, 0) \
+	X(0x08, PHP, 1, 3, OP_WRITE) \
+	X(0x09, ORA_I, 2, 2, 0) \
+	X(0x0A, ASL_ACC, 1, 2, 0) \
+	X(0x0B, ILL, 1, 1, 0) \
+	X(0x0C, NOP, 3, 4, 0) \
+	X(0x0D, ORA_A, 3, 4, 0) \
+	X(0x0E, ASL_A, 3, 6, OP_WRITE) \
+	X(0x0F, ILL, 1, 1, 0) \
+	X(0x10, BPL, 2, 2, OP_PAGE_PENALTY | OP_JUMP) \
+	X(0x11, ORA_IY, 2, 5, OP_PAGE_PENALTY) \
+	X(0x12, ILL, 1, 1, 0) \
+	X(0x13, ILL, 1, 1, 0) \
+	X(0x14, ILL, 1, 1, 0) \
+	X(0x15, ORA_ZPX, 2, 4, 0) \
+	X(0x16, ASL_ZPX, 2, 6, OP_WRITE) \
+	X(0x17, ILL, 1, 1, 0) \
+	X(0x18, CLC, 1, 2, 0) \
+	X(0x19, ORA_AY, 3, 4, OP_PAGE_PENALTY) \
+	X(0x1A, ILL, 1, 1, 0) \
+	X(0x1B, ILL, 1, 1, 0) \
+	X(0x1C, ILL, 1, 1, 0) \
+	X(0x1D, ORA_AX, 3, 4, OP_PAGE_PENALTY) \
+	X(0x1E, ASL_AX, 3, 7, OP_WRITE) \
+	X(0x1F, ILL, 1, 1, 0) \
+	X(0x20, JSR, 3, 6, OP_WRITE | OP_JUMP) \
+	X(0x21, AND_IX, 2, 6, 0) \
+	X(0x22, ILL, 1, 1, 0) \
+	X(0x23, ILL, 1, 1, 0) \
+	X(0x24, BIT_ZP, 2, 3, 0) \
+	X(0x25, AND_ZP, 2, 3, 0) \
+	X(0x26, ROL_ZP, 2, 5, OP_WRITE) \
+	X(0x27, ILL, 1, 1, 0) \
+	X(0x28, PLP, 1, 4, 0) \
+	X(0x29, AND_I, 2, 2, 0) \
+	X(0x2A, ROL_ACC, 1, 2, 0) \
+	X(0x2B, ILL, 1, 1, 0) \
+	X(0x2C, BIT_A, 3, 4, 0) \
+	X(0x2D, AND_A, 3, 4, 0) \
+	X(0x2E, ROL_A, 3, 6, OP_WRITE) \
+	X(0x2F, ILL, 1, 1, 0) \
+	X(0x30, BMI, 2, 2, OP_PAGE_PENALTY | OP_JUMP) \
+	X(0x31, AND_IY, 2, 5, OP_PAGE_PENALTY) \
+	X(0x32, ILL, 1, 1, 0) \
+	X(0x33, ILL, 1, 1, 0) \
+	X(0x34, ILL, 1, 1, 0) \
+	X(0x35, AND_ZPX, 2, 4, 0) \
+	X(0x36, ROL_ZPX, 2, 6, OP_WRITE) \
+	X(0x37, ILL, 1, 1, 0) \
+	X(0x38, SEC, 1, 2, 0) \
+	X(0x39, AND_AY, 3, 4, OP_PAGE_PENALTY) \
+	X(0x3A, ILL, 1, 1, 0) \
+	X(0x3B, ILL, 1, 1, 0) \
+	X(0x3C, ILL, 1, 1, 0) \
+	X(0x3D, AND_AX, 3, 4, OP_PAGE_PENALTY) \
+	X(0x3E, ROL_AX, 3, 7, OP_WRITE) \
+	X(0x3F, ILL, 1, 1, 0) \
+	X(0x40, RTI, 1, 6, OP_JUMP) \
+	X(0x41, EOR_IX, 2, 6, 0) \
+	X(0x42, ILL, 1, 1, 0) \
+	X(0x43, ILL, 1, 1, 0) \
+	X(0x44, NOP, 2, 3, 0) \
+	X(0x45, EOR_ZP, 2, 3, 0) \
+	X(0x46, LSR_ZP, 2, 5, OP_WRITE) \
+	X(0x47, ILL, 1, 1, 0) \
+	X(0x48, PHA, 1, 3, OP_WRITE) \
+	X(0x49, EOR_I, 2, 2, 0) \
+	X(0x4A, LSR_ACC, 1, 2, 0) \
+	X(0x4B, ILL, 1, 1, 0) \
+	X(0x4C, JMP_A, 3, 3, OP_JUMP) \
+	X(0x4D, EOR_A, 3, 4, 0) \
+	X(0x4E, LSR_A, 3, 6, OP_WRITE) \
+	X(0x4F, ILL, 1, 1, 0) \
+	X(0x50, BVC, 2, 2, OP_PAGE_PENALTY | OP_JUMP) \
+	X(0x51, EOR_IY, 2, 5, OP_PAGE_PENALTY) \
+	X(0x52, ILL, 1, 1, 0) \
+	X(0x53, ILL, 1, 1, 0) \
+	X(0x54, ILL, 1, 1, 0) \
+	X(0x55, EOR_ZPX, 2, 4, 0) \
+	X(0x56, LSR_ZPX, 2, 6, OP_WRITE) \
+	X(0x57, ILL, 1, 1, 0) \
+	X(0x58, CLI, 1, 2, 0) \
+	X(0x59, EOR_AY, 3, 4, OP_PAGE_PENALTY) \
+	X(0x5A, ILL, 1, 1, 0) \
+	X(0x5B, ILL, 1, 1, 0) \
+	X(0x5C, ILL, 1, 1, 0) \
+	X(0x5D, EOR_AX, 3, 4, OP_PAGE_PENALTY) \
+	X(0x5E, LSR_AX, 3, 7, OP_WRITE) \
+	X(0x5F, ILL, 1, 1, 0) \
+	X(0x60, RTS, 1, 6, OP_JUMP) \
+	X(0x61, ADC_IX, 2, 6, 0) \
+	X(0x62, ILL, 1, 1, 0) \
+	X(0x63, ILL, 1, 1, 0) \
+	X(0x64, NOP, 2, 3, 0) \
+	X(0x65, ADC_ZP, 2, 3, 0) \
+	X(0x66, ROR_ZP, 2, 5, OP_WRITE) \
+	X(0x67, ILL, 1, 1, 0) \
+	X(0x68, PLA, 1, 4, 0) \
+	X(0x69, ADC_I, 2, 2, 0) \
+	X(0x6A, ROR_ACC, 1, 2, 0) \
+	X(0x6B, ILL, 1, 1, 0) \
+	X(0x6C, JMP_I, 3, 5, OP_JUMP) \
+	X(0x6D, ADC_A, 3, 4, 0) \
+	X(0x6E, ROR_A, 3, 6, OP_WRITE) \
+	X(0x6F, ILL, 1, 1, 0) \
+	X(0x70, BVS, 2, 2, OP_PAGE_PENALTY | OP_JUMP) \
+	X(0x71, ADC_IY, 2, 5, OP_PAGE_PENALTY) \
+	X(0x72, ILL, 1, 1, 0) \
+	X(0x73, ILL, 1, 1, 0) \
+	X(0x74, ILL, 1, 1, 0) \
+	X(0x75, ADC_ZPX, 2, 4, 0) \
+	X(0x76, ROR_ZPX, 2, 6, OP_WRITE) \
+	X(0x77, ILL, 1, 1, 0) \
+	X(0x78, SEI, 1, 2, 0) \
+	X(0x79, ADC_AY, 3, 4, OP_PAGE_PENALTY) \
+	X(0x7A, ILL, 1, 1, 0) \
+	X(0x7B, ILL, 1, 1, 0) \
+	X(0x7C, ILL, 1, 1, 0) \
+	X(0x7D, ADC_AX, 3, 4, OP_PAGE_PENALTY) \
+	X(0x7E, ROR_AX, 3, 7, OP_WRITE) \
+	X(0x7F, ILL, 1, 1, 0) \
+	X(0x80, ILL, 1, 1, 0) \
+	X(0x81, STA_IX, 2, 6, OP_WRITE) \
+	X(0x82, ILL, 1, 1, 0) \
+	X(0x83, ILL, 1, 1, 0) \
+	X(0x84, STY_ZP, 2, 3, OP_WRITE) \
+	X(0x85, STA_ZP, 2, 3, OP_WRITE) \
+	X(0x86, STX_ZP, 2, 3, OP_WRITE) \
+	X(0x87, ILL, 1, 1, 0) \
+	X(0x88, DEY, 1, 2, 0) \
+	X(0x89, ILL, 1, 1, 0) \
+	X(0x8A, TXA, 1, 2, 0) \
+	X(0x8B, ILL, 1, 1, 0) \
+	X(0x8C, STY_A, 3, 4, OP_WRITE) \
+	X(0x8D, STA_A, 3, 4, OP_WRITE) \
+	X(0x8E, STX_A, 3, 4, OP_WRITE) \
+	X(0x8F, ILL, 1, 1, 0) \
+	X(0x90, BCC, 2, 2, OP_PAGE_PENALTY | OP_JUMP) \
+	X(0x91, STA_IY, 2, 6, OP_WRITE) \
+	X(0x92, ILL, 1, 1, 0) \
+	X(0x93, ILL, 1, 1, 0) \
+	X(0x94, STY_ZPX, 2, 4, OP_WRITE) \
+	X(0x95, STA_ZPX, 2, 4, OP_WRITE) \
+	X(0x96, STX_ZPY, 2, 4, OP_WRITE) \
+	X(0x97, ILL, 1, 1, 0) \
+	X(0x98, TYA, 1, 2, 0) \
+	X(0x99, STA_AY, 3, 5, OP_WRITE) \
+	X(0x9A, TXS, 1, 2, 0) \
+	X(0x9B, ILL, 1, 1, 0) \
+	X(0x9C, ILL, 1, 1, 0) \
+	X(0x9D, STA_AX, 3, 5, OP_WRITE) \
+	X(0x9E, ILL, 1, 1, 0) \
+	X(0x9F, ILL, 1, 1, 0) \
+	X(0xA0, LDY_I, 2, 2, 0) \
+	X(0xA1, LDA_IX, 2, 6, 0) \
+	X(0xA2, LDX_I, 2, 2, 0) \
+	X(0xA3, ILL, 1, 1, 0) \
+	X(0xA4, LDY_ZP, 2, 3, 0) \
+	X(0xA5, LDA_ZP, 2, 3, 0) \
+	X(0xA6, LDX_ZP, 2, 3, 0) \
+	X(0xA7, ILL, 1, 1, 0) \
+	X(0xA8, TAY, 1, 2, 0) \
+	X(0xA9, LDA_I, 2, 2, 0) \
+	X(0xAA, TAX, 1, 2, 0) \
+	X(0xAB, ILL, 1, 1, 0) \
+	X(0xAC, LDY_A, 3, 4, 0) \
+	X(0xAD, LDA_A, 3, 4, 0) \
+	X(0xAE, LDX_A, 3, 4, 0) \
+	X(0xAF, ILL, 1, 1, 0) \
+	X(0xB0, BCS, 2, 2, OP_PAGE_PENALTY | OP_JUMP) \
+	X(0xB1, LDA_IY, 2, 5, OP_PAGE_PENALTY) \
+	X(0xB2, ILL, 1, 1, 0) \
+	X(0xB3, ILL, 1, 1, 0) \
+	X(0xB4, LDY_ZPX, 2, 4, 0) \
+	X(0xB5, LDA_ZPX, 2, 4, 0) \
+	X(0xB6, LDX_ZPY, 2, 4, 0) \
+	X(0xB7, ILL, 1, 1, 0) \
+	X(0xB8, CLV, 1, 2, 0) \
+	X(0xB9, LDA_AY, 3, 4, OP_PAGE_PENALTY) \
+	X(0xBA, TSX, 1, 2, 0) \
+	X(0xBB, ILL, 1, 1, 0) \
+	X(0xBC, LDY_AX, 3, 4, OP_PAGE_PENALTY) \
+	X(0xBD, LDA_AX, 3, 4, OP_PAGE_PENALTY) \
+	X(0xBE, LDX_AY, 3, 4, OP_PAGE_PENALTY) \
+	X(0xBF, ILL, 1, 1, 0) \
+	X(0xC0, CPY_I, 2, 2, 0) \
+	X(0xC1, CMP_IX, 2, 6, 0) \
+	X(0xC2, ILL, 1, 1, 0) \
+	X(0xC3, ILL, 1, 1, 0) \
+	X(0xC4, CPY_ZP, 2, 3, 0) \
+	X(0xC5, CMP_ZP, 2, 3, 0) \
+	X(0xC6, DEC_ZP, 2, 5, OP_WRITE) \
+	X(0xC7, ILL, 1, 1, 0) \
+	X(0xC8, INY, 1, 2, 0) \
+	X(0xC9, CMP_I, 2, 2, 0) \
+	X(0xCA, DEX, 1, 2, 0) \
+	X(0xCB, ILL, 1, 1, 0) \
+	X(0xCC, CPY_A, 3, 4, 0) \
+	X(0xCD, CMP_A, 3, 4, 0) \
+	X(0xCE, DEC_A, 3, 6, OP_WRITE) \
+	X(0xCF, ILL, 1, 1, 0) \
+	X(0xD0, BNE, 2, 2, OP_PAGE_PENALTY | OP_JUMP) \
+	X(0xD1, CMP_IY, 2, 5, OP_PAGE_PENALTY) \
+	X(0xD2, ILL, 1, 1, 0) \
+	X(0xD3, ILL, 1, 1, 0) \
+	X(0xD4, ILL, 1, 1, 0) \
+	X(0xD5, CMP_ZPX, 2, 4, 0) \
+	X(0xD6, DEC_ZPX, 2, 6, OP_WRITE) \
+	X(0xD7, ILL, 1, 1, 0) \
+	X(0xD8, CLD, 1, 2, 0) \
+	X(0xD9, CMP_AY, 3, 4, OP_PAGE_PENALTY) \
+	X(0xDA, ILL, 1, 1, 0) \
+	X(0xDB, ILL, 1, 1, 0) \
+	X(0xDC, ILL, 1, 1, 0) \
+	X(0xDD, CMP_AX, 3, 4, OP_PAGE_PENALTY) \
+	X(0xDE, DEC_AX, 3, 7, OP_WRITE) \
+	X(0xDF, ILL, 1, 1, 0) \
+	X(0xE0, CPX_I, 2, 2, 0) \
+	X(0xE1, SBC_IX, 2, 6, 0) \
+	X(0xE2, ILL, 1, 1, 0) \
+	X(0xE3, ILL, 1, 1, 0) \
+	X(0xE4, CPX_ZP, 2, 3, 0) \
+	X(0xE5, SBC_ZP, 2, 3, 0) \
+	X(0xE6, INC_ZP, 2, 5, OP_WRITE) \
+	X(0xE7, ILL, 1, 1, 0) \
+	X(0xE8, INX, 1, 2, 0) \
+	X(0xE9, SBC_I, 2, 2, 0) \
+	X(0xEA, NOP, 1, 2, 0) \
+	X(0xEB, ILL, 1, 1, 0) \
+	X(0xEC, CPX_A, 3, 4, 0) \
+	X(0xED, SBC_A, 3, 4, 0) \
+	X(0xEE, INC_A, 3, 6, OP_WRITE) \
+	X(0xEF, ILL, 1, 1, 0) \
+	X(0xF0, BEQ, 2, 2, OP_PAGE_PENALTY | OP_JUMP) \
+	X(0xF1, SBC_IY, 2, 5, OP_PAGE_PENALTY) \
+	X(0xF2, ILL, 1, 1, 0) \
+	X(0xF3, ILL, 1, 1, 0) \
+	X(0xF4, ILL, 1, 1, 0) \
+	X(0xF5, SBC_ZPX, 2, 4, 0) \
+	X(0xF6, INC_ZPX, 2, 6, OP_WRITE) \
+	X(0xF7, ILL, 1, 1, 0) \
+	X(0xF8, SED, 1, 2, 0) \
+	X(0xF9, SBC_AY, 3, 4, OP_PAGE_PENALTY) \
+	X(0xFA, ILL, 1, 1, 0) \
+	X(0xFB, ILL, 1, 1, 0) \
+	X(0xFC, ILL, 1, 1, 0) \
+	X(0xFD, SBC_AX, 3, 4, OP_PAGE_PENALTY) \
+	X(0xFE, INC_AX, 3, 7, OP_WRITE) \
+	X(0xFF, ILL, 1, 1, 0)
+
+#define OPCODE_ENTRY(code, handler, length, cycles, flags) \
+	[code] = { handler, length, cycles, flags },
+
+#ifdef __GNUC__
+/* Threaded dispatch (every handler jumps straight to the next one) */
+#define OPCODE_LABEL(code, handler, length, cycles, flags) \
+	[code] = &&op_##code,
+#define OPCODE_BODY(code, handler, length, cycles, flags) \
+	op_##code: \
+		rp2a03_execute(rp2a03, code); \
+		DISPATCH();
+#define FETCH() \
+	do { \
+		if (rp2a03->interrupted) \
+			goto interrupt; \
+		rp2a03->instance->num_instructions++; \
+		opcode = memory_readb(rp2a03->bus_id, rp2a03->PC++); \
+		goto *labels[opcode]; \
+	} while (0)
+#define DISPATCH() \
+	do { \
+		if (!clock_run_ahead()) \
+			goto done; \
+		FETCH(); \
+	} while (0)
+#endif
+
+struct rp2a03_idle {
+	bool valid;
+	uint8_t A;
+	uint8_t X;
+	uint8_t Y;
+	uint16_t PC;
+	uint8_t S;
+	uint8_t P;
+	uint64_t cycle;
+	uint64_t num_instructions;
+	uint32_t num_updates;
+};
+
 struct rp2a03 {
 	uint8_t A;
 	uint8_t X;
@@ -33,294 +398,230 @@ struct rp2a03 {
 			uint8_t N:1;
 		};
 	};
+	bool page_crossed;
+	bool idle_pending;
 	bool interrupted;
 	int interrupt;
 	int bus_id;
 	int nmi;
 	int irq;
 	struct clock clock;
+	struct rp2a03_idle idle;
+	struct cpu_instance *instance;
+#ifdef RP2A03_JIT
+	struct rp2a03_jit *jit;
+#endif
+};
+
+typedef void (*rp2a03_handler_t)(struct rp2a03 *rp2a03, uint16_t operand);
+
+struct rp2a03_opcode {
+	rp2a03_handler_t handler;
+	uint8_t length;
+	uint8_t cycles;
+	uint8_t flags;
+};
+
+#ifdef RP2A03_JIT
+/* Translated code returns whether run-ahead goes on */
+typedef bool (*rp2a03_code_t)(struct rp2a03 *rp2a03);
+
+struct rp2a03_block {
+	uint16_t pc;
+	uint8_t *mem;
+	bool writable;
+	int size;
+	uint8_t source[JIT_MAX_INSTRUCTIONS * 3];
+	rp2a03_code_t code;
+};
+
+struct rp2a03_jit {
+	uint8_t *code;
+	size_t code_used;
+	uint64_t div;
+	struct rp2a03_block *blocks;
+	int num_blocks;
+	struct rp2a03_block *table[JIT_TABLE_SIZE];
 };
+#endif
 
 static bool rp2a03_init(struct cpu_instance *instance);
 static void rp2a03_reset(struct cpu_instance *instance);
 static void rp2a03_interrupt(struct cpu_instance *instance, int irq);
 static void rp2a03_deinit(struct cpu_instance *instance);
 static void rp2a03_tick(struct rp2a03 *rp2a03);
-static inline void ADC_A(struct rp2a03 *rp2a03);
-static inline void ADC_AX(struct rp2a03 *rp2a03);
-static inline void ADC_AY(struct rp2a03 *rp2a03);
-static inline void ADC_I(struct rp2a03 *rp2a03);
-static inline void ADC_IX(struct rp2a03 *rp2a03);
-static inline void ADC_IY(struct rp2a03 *rp2a03);
-static inline void ADC_ZP(struct rp2a03 *rp2a03);
-static inline void ADC_ZPX(struct rp2a03 *rp2a03);
+#if !defined(__GNUC__) || defined(RP2A03_JIT)
+static void rp2a03_step(struct rp2a03 *rp2a03);
+#endif
+static inline void rp2a03_execute(struct rp2a03 *rp2a03, uint8_t opcode);
+static inline void rp2a03_handle_interrupt(struct rp2a03 *rp2a03);
+static void rp2a03_check_idle(struct rp2a03 *rp2a03);
+#ifdef RP2A03_JIT
+static void emit_byte(struct rp2a03_jit *jit, uint8_t b);
+static void emit_u16(struct rp2a03_jit *jit, uint16_t w);
+static void emit_u32(struct rp2a03_jit *jit, uint32_t l);
+static void emit_u64(struct rp2a03_jit *jit, uint64_t q);
+static void emit_field(struct rp2a03_jit *jit, uint8_t reg, size_t offset);
+static size_t emit_jump(struct rp2a03_jit *jit, uint8_t opcode);
+static void emit_patch(struct rp2a03_jit *jit, size_t jump);
+static void emit_prologue(struct rp2a03_jit *jit, struct rp2a03 *rp2a03);
+static void emit_exit(struct rp2a03_jit *jit, int pc, int num_instructions,
+	bool run_ahead);
+static void emit_check(struct rp2a03_jit *jit, int pc, int num_instructions,
+	bool last, bool remap);
+static void emit_flags(struct rp2a03_jit *jit, uint8_t clear, uint8_t set);
+static void emit_load(struct rp2a03_jit *jit, size_t offset, uint8_t b);
+static void emit_call(struct rp2a03_jit *jit, rp2a03_handler_t handler,
+	uint16_t operand, uint16_t pc);
+static void emit_consume(struct rp2a03_jit *jit, uint32_t num_cycles);
+static void emit_instruction(struct rp2a03_jit *jit,
+	const struct rp2a03_opcode *op, uint16_t operand, uint16_t pc);
+static struct rp2a03_jit *rp2a03_jit_init();
+static void rp2a03_jit_flush(struct rp2a03_jit *jit, uint64_t div);
+static struct rp2a03_block *rp2a03_jit_translate(struct rp2a03 *rp2a03,
+	uint8_t *mem, bool writable);
+static struct rp2a03_block *rp2a03_jit_get_block(struct rp2a03 *rp2a03);
+static void rp2a03_jit_run(struct rp2a03 *rp2a03);
+static void rp2a03_jit_deinit(struct rp2a03_jit *jit);
+#endif
+static inline uint16_t addr_A(struct rp2a03 *rp2a03, uint16_t operand);
+static inline uint16_t addr_AX(struct rp2a03 *rp2a03, uint16_t operand);
+static inline uint16_t addr_AY(struct rp2a03 *rp2a03, uint16_t operand);
+static inline uint16_t addr_IX(struct rp2a03 *rp2a03, uint16_t operand);
+static inline uint16_t addr_IY(struct rp2a03 *rp2a03, uint16_t operand);
+static inline uint16_t addr_ZP(struct rp2a03 *rp2a03, uint16_t operand);
+static inline uint16_t addr_ZPX(struct rp2a03 *rp2a03, uint16_t operand);
+static inline uint16_t addr_ZPY(struct rp2a03 *rp2a03, uint16_t operand);
+static inline void branch(struct rp2a03 *rp2a03, bool condition,
+	uint16_t operand);
+static inline void ADC(struct rp2a03 *rp2a03, uint8_t b);
 static inline void AND(struct rp2a03 *rp2a03, uint8_t b);
-static inline void AND_A(struct rp2a03 *rp2a03);
-static inline void AND_AX(struct rp2a03 *rp2a03);
-static inline void AND_AY(struct rp2a03 *rp2a03);
-static inline void AND_I(struct rp2a03 *rp2a03);
-static inline void AND_IX(struct rp2a03 *rp2a03);
-static inline void AND_IY(struct rp2a03 *rp2a03);
-static inline void AND_ZP(struct rp2a03 *rp2a03);
-static inline void AND_ZPX(struct rp2a03 *rp2a03);
-static inline void ASL_ACC(struct rp2a03 *rp2a03);
-static inline void ASL_A(struct rp2a03 *rp2a03);
-static inline void ASL_AX(struct rp2a03 *rp2a03);
-static inline void ASL_ZP(struct rp2a03 *rp2a03);
-static inline void ASL_ZPX(struct rp2a03 *rp2a03);
-static inline void BCC(struct rp2a03 *rp2a03);
-static inline void BCS(struct rp2a03 *rp2a03);
-static inline void BEQ(struct rp2a03 *rp2a03);
+static inline uint8_t ASL(struct rp2a03 *rp2a03, uint8_t b);
 static inline void BIT(struct rp2a03 *rp2a03, uint8_t b);
-static inline void BIT_A(struct rp2a03 *rp2a03);
-static inline void BIT_ZP(struct rp2a03 *rp2a03);
-static inline void BMI(struct rp2a03 *rp2a03);
-static inline void BNE(struct rp2a03 *rp2a03);
-static inline void BPL(struct rp2a03 *rp2a03);
-static inline void BRK(struct rp2a03 *rp2a03);
-static inline void BVC(struct rp2a03 *rp2a03);
-static inline void BVS(struct rp2a03 *rp2a03);
-static inline void CLC(struct rp2a03 *rp2a03);
-static inline void CLD(struct rp2a03 *rp2a03);
-static inline void CLI(struct rp2a03 *rp2a03);
-static inline void CLV(struct rp2a03 *rp2a03);
 static inline void CMP(struct rp2a03 *rp2a03, uint8_t b);
-static inline void CMP_A(struct rp2a03 *rp2a03);
-static inline void CMP_AX(struct rp2a03 *rp2a03);
-static inline void CMP_AY(struct rp2a03 *rp2a03);
-static inline void CMP_I(struct rp2a03 *rp2a03);
-static inline void CMP_IX(struct rp2a03 *rp2a03);
-static inline void CMP_IY(struct rp2a03 *rp2a03);
-static inline void CMP_ZP(struct rp2a03 *rp2a03);
-static inline void CMP_ZPX(struct rp2a03 *rp2a03);
 static inline void CPX(struct rp2a03 *rp2a03, uint8_t b);
-static inline void CPX_A(struct rp2a03 *rp2a03);
-static inline void CPX_I(struct rp2a03 *rp2a03);
-static inline void CPX_ZP(struct rp2a03 *rp2a03);
 static inline void CPY(struct rp2a03 *rp2a03, uint8_t b);
-static inline void CPY_A(struct rp2a03 *rp2a03);
-static inline void CPY_I(struct rp2a03 *rp2a03);
-static inline void CPY_ZP(struct rp2a03 *rp2a03);
-static inline void DEC(struct rp2a03 *rp2a03, uint16_t address);
-static inline void DEC_A(struct rp2a03 *rp2a03);
-static inline void DEC_AX(struct rp2a03 *rp2a03);
-static inline void DEC_ZP(struct rp2a03 *rp2a03);
-static inline void DEC_ZPX(struct rp2a03 *rp2a03);
-static inline void DEX(struct rp2a03 *rp2a03);
-static inline void DEY(struct rp2a03 *rp2a03);
+static inline uint8_t DEC(struct rp2a03 *rp2a03, uint8_t b);
 static inline void EOR(struct rp2a03 *rp2a03, uint8_t b);
-static inline void EOR_A(struct rp2a03 *rp2a03);
-static inline void EOR_AX(struct rp2a03 *rp2a03);
-static inline void EOR_AY(struct rp2a03 *rp2a03);
-static inline void EOR_I(struct rp2a03 *rp2a03);
-static inline void EOR_IX(struct rp2a03 *rp2a03);
-static inline void EOR_IY(struct rp2a03 *rp2a03);
-static inline void EOR_ZP(struct rp2a03 *rp2a03);
-static inline void EOR_ZPX(struct rp2a03 *rp2a03);
-static inline void INC(struct rp2a03 *rp2a03, uint16_t address);
-static inline void INC_A(struct rp2a03 *rp2a03);
-static inline void INC_AX(struct rp2a03 *rp2a03);
-static inline void INC_ZP(struct rp2a03 *rp2a03);
-static inline void INC_ZPX(struct rp2a03 *rp2a03);
-static inline void INX(struct rp2a03 *rp2a03);
-static inline void INY(struct rp2a03 *rp2a03);
-static inline void JMP(struct rp2a03 *rp2a03, uint16_t address);
-static inline void JMP_A(struct rp2a03 *rp2a03);
-static inline void JMP_I(struct rp2a03 *rp2a03);
-static inline void JSR(struct rp2a03 *rp2a03);
+static inline uint8_t INC(struct rp2a03 *rp2a03, uint8_t b);
 static inline void LDA(struct rp2a03 *rp2a03, uint8_t b);
-static inline void LDA_A(struct rp2a03 *rp2a03);
-static inline void LDA_AX(struct rp2a03 *rp2a03);
-static inline void LDA_AY(struct rp2a03 *rp2a03);
-static inline void LDA_I(struct rp2a03 *rp2a03);
-static inline void LDA_IX(struct rp2a03 *rp2a03);
-static inline void LDA_IY(struct rp2a03 *rp2a03);
-static inline void LDA_ZPX(struct rp2a03 *rp2a03);
-static inline void LDA_ZP(struct rp2a03 *rp2a03);
 static inline void LDX(struct rp2a03 *rp2a03, uint8_t b);
-static inline void LDX_A(struct rp2a03 *rp2a03);
-static inline void LDX_AY(struct rp2a03 *rp2a03);
-static inline void LDX_I(struct rp2a03 *rp2a03);
-static inline void LDX_ZP(struct rp2a03 *rp2a03);
-static inline void LDX_ZPY(struct rp2a03 *rp2a03);
 static inline void LDY(struct rp2a03 *rp2a03, uint8_t b);
-static inline void LDY_A(struct rp2a03 *rp2a03);
-static inline void LDY_AX(struct rp2a03 *rp2a03);
-static inline void LDY_I(struct rp2a03 *rp2a03);
-static inline void LDY_ZP(struct rp2a03 *rp2a03);
-static inline void LDY_ZPX(struct rp2a03 *rp2a03);
-static inline void LSR_ACC(struct rp2a03 *rp2a03);
-static inline void LSR_A(struct rp2a03 *rp2a03);
-static inline void LSR_AX(struct rp2a03 *rp2a03);
-static inline void LSR_ZP(struct rp2a03 *rp2a03);
-static inline void LSR_ZPX(struct rp2a03 *rp2a03);
-static inline void NOP(struct rp2a03 *rp2a03);
-static inline void NOP_A(struct rp2a03 *rp2a03);
-static inline void NOP_D(struct rp2a03 *rp2a03);
+static inline uint8_t LSR(struct rp2a03 *rp2a03, uint8_t b);
 static inline void ORA(struct rp2a03 *rp2a03, uint8_t b);
-static inline void ORA_A(struct rp2a03 *rp2a03);
-static inline void ORA_AX(struct rp2a03 *rp2a03);
-static inline void ORA_AY(struct rp2a03 *rp2a03);
-static inline void ORA_I(struct rp2a03 *rp2a03);
-static inline void ORA_IX(struct rp2a03 *rp2a03);
-static inline void ORA_IY(struct rp2a03 *rp2a03);
-static inline void ORA_ZP(struct rp2a03 *rp2a03);
-static inline void ORA_ZPX(struct rp2a03 *rp2a03);
-static inline void PHA(struct rp2a03 *rp2a03);
-static inline void PHP(struct rp2a03 *rp2a03);
-static inline void PLA(struct rp2a03 *rp2a03);
-static inline void PLP(struct rp2a03 *rp2a03);
-static inline void ROL_ACC(struct rp2a03 *rp2a03);
-static inline void ROL_A(struct rp2a03 *rp2a03);
-static inline void ROL_AX(struct rp2a03 *rp2a03);
-static inline void ROL_ZP(struct rp2a03 *rp2a03);
-static inline void ROL_ZPX(struct rp2a03 *rp2a03);
-static inline void ROR_ACC(struct rp2a03 *rp2a03);
-static inline void ROR_A(struct rp2a03 *rp2a03);
-static inline void ROR_AX(struct rp2a03 *rp2a03);
-static inline void ROR_ZP(struct rp2a03 *rp2a03);
-static inline void ROR_ZPX(struct rp2a03 *rp2a03);
-static inline void RTI(struct rp2a03 *rp2a03);
-static inline void RTS(struct rp2a03 *rp2a03);
-static inline void SBC_A(struct rp2a03 *rp2a03);
-static inline void SBC_AX(struct rp2a03 *rp2a03);
-static inline void SBC_AY(struct rp2a03 *rp2a03);
-static inline void SBC_I(struct rp2a03 *rp2a03);
-static inline void SBC_IX(struct rp2a03 *rp2a03);
-static inline void SBC_IY(struct rp2a03 *rp2a03);
-static inline void SBC_ZP(struct rp2a03 *rp2a03);
-static inline void SBC_ZPX(struct rp2a03 *rp2a03);
-static inline void SEC(struct rp2a03 *rp2a03);
-static inline void SED(struct rp2a03 *rp2a03);
-static inline void SEI(struct rp2a03 *rp2a03);
-static inline void STA_A(struct rp2a03 *rp2a03);
-static inline void STA_AX(struct rp2a03 *rp2a03);
-static inline void STA_AY(struct rp2a03 *rp2a03);
-static inline void STA_IX(struct rp2a03 *rp2a03);
-static inline void STA_IY(struct rp2a03 *rp2a03);
-static inline void STA_ZP(struct rp2a03 *rp2a03);
-static inline void STA_ZPX(struct rp2a03 *rp2a03);
-static inline void STX_A(struct rp2a03 *rp2a03);
-static inline void STX_ZP(struct rp2a03 *rp2a03);
-static inline void STX_ZPY(struct rp2a03 *rp2a03);
-static inline void STY_A(struct rp2a03 *rp2a03);
-static inline void STY_ZP(struct rp2a03 *rp2a03);
-static inline void STY_ZPX(struct rp2a03 *rp2a03);
-static inline void TAX(struct rp2a03 *rp2a03);
-static inline void TAY(struct rp2a03 *rp2a03);
-static inline void TSX(struct rp2a03 *rp2a03);
-static inline void TXA(struct rp2a03 *rp2a03);
-static inline void TXS(struct rp2a03 *rp2a03);
-static inline void TYA(struct rp2a03 *rp2a03);
-
-void ADC_A(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readw(rp2a03->bus_id,
-		rp2a03->PC));
-	uint16_t result = rp2a03->A + b + rp2a03->C;
-	rp2a03->C = result >> 8;
-	rp2a03->Z = ((uint8_t)result == 0);
-	rp2a03->V = ((~(rp2a03->A ^ b) & (rp2a03->A ^ result) & 0x80) != 0);
-	rp2a03->N = ((result & 0x80) != 0);
-	rp2a03->A = result;
-	rp2a03->PC += 2;
-	clock_consume(4);
+static inline uint8_t ROL(struct rp2a03 *rp2a03, uint8_t b);
+static inline uint8_t ROR(struct rp2a03 *rp2a03, uint8_t b);
+static inline void SBC(struct rp2a03 *rp2a03, uint8_t b);
+static inline uint8_t STA(struct rp2a03 *rp2a03);
+static inline uint8_t STX(struct rp2a03 *rp2a03);
+static inline uint8_t STY(struct rp2a03 *rp2a03);
+static void BRK(struct rp2a03 *rp2a03, uint16_t operand);
+static void CLC(struct rp2a03 *rp2a03, uint16_t operand);
+static void CLD(struct rp2a03 *rp2a03, uint16_t operand);
+static void CLI(struct rp2a03 *rp2a03, uint16_t operand);
+static void CLV(struct rp2a03 *rp2a03, uint16_t operand);
+static void DEX(struct rp2a03 *rp2a03, uint16_t operand);
+static void DEY(struct rp2a03 *rp2a03, uint16_t operand);
+static void ILL(struct rp2a03 *rp2a03, uint16_t operand);
+static void INX(struct rp2a03 *rp2a03, uint16_t operand);
+static void INY(struct rp2a03 *rp2a03, uint16_t operand);
+static void JMP_A(struct rp2a03 *rp2a03, uint16_t operand);
+static void JMP_I(struct rp2a03 *rp2a03, uint16_t operand);
+static void JSR(struct rp2a03 *rp2a03, uint16_t operand);
+static void NOP(struct rp2a03 *rp2a03, uint16_t operand);
+static void PHA(struct rp2a03 *rp2a03, uint16_t operand);
+static void PHP(struct rp2a03 *rp2a03, uint16_t operand);
+static void PLA(struct rp2a03 *rp2a03, uint16_t operand);
+static void PLP(struct rp2a03 *rp2a03, uint16_t operand);
+static void RTI(struct rp2a03 *rp2a03, uint16_t operand);
+static void RTS(struct rp2a03 *rp2a03, uint16_t operand);
+static void SEC(struct rp2a03 *rp2a03, uint16_t operand);
+static void SED(struct rp2a03 *rp2a03, uint16_t operand);
+static void SEI(struct rp2a03 *rp2a03, uint16_t operand);
+static void TAX(struct rp2a03 *rp2a03, uint16_t operand);
+static void TAY(struct rp2a03 *rp2a03, uint16_t operand);
+static void TSX(struct rp2a03 *rp2a03, uint16_t operand);
+static void TXA(struct rp2a03 *rp2a03, uint16_t operand);
+static void TXS(struct rp2a03 *rp2a03, uint16_t operand);
+static void TYA(struct rp2a03 *rp2a03, uint16_t operand);
+
+uint16_t addr_A(struct rp2a03 *UNUSED(rp2a03), uint16_t operand)
+{
+	return operand;
+}
+
+uint16_t addr_AX(struct rp2a03 *rp2a03, uint16_t operand)
+{
+	uint16_t address = operand + rp2a03->X;
+	rp2a03->page_crossed = ((operand ^ address) & 0xFF00) != 0;
+	return address;
+}
+
+uint16_t addr_AY(struct rp2a03 *rp2a03, uint16_t operand)
+{
+	uint16_t address = operand + rp2a03->Y;
+	rp2a03->page_crossed = ((operand ^ address) & 0xFF00) != 0;
+	return address;
+}
+
+uint16_t addr_IX(struct rp2a03 *rp2a03, uint16_t operand)
+{
+	uint8_t b = operand + rp2a03->X;
+	return memory_readb(rp2a03->bus_id, b) |
+		(memory_readb(rp2a03->bus_id, (b + 1) % ZP_SIZE) << 8);
 }
 
-void ADC_AX(struct rp2a03 *rp2a03)
+uint16_t addr_IY(struct rp2a03 *rp2a03, uint16_t operand)
 {
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->X;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	uint16_t result = rp2a03->A + b + rp2a03->C;
-	rp2a03->C = result >> 8;
-	rp2a03->Z = ((uint8_t)result == 0);
-	rp2a03->V = ((~(rp2a03->A ^ b) & (rp2a03->A ^ result) & 0x80) != 0);
-	rp2a03->N = ((result & 0x80) != 0);
-	rp2a03->A = result;
-	rp2a03->PC += 2;
-	clock_consume(4);
+	uint16_t base = memory_readb(rp2a03->bus_id, operand) |
+		(memory_readb(rp2a03->bus_id, (operand + 1) % ZP_SIZE) << 8);
+	uint16_t address = base + rp2a03->Y;
+	rp2a03->page_crossed = ((base ^ address) & 0xFF00) != 0;
+	return address;
 }
 
-void ADC_AY(struct rp2a03 *rp2a03)
+uint16_t addr_ZP(struct rp2a03 *UNUSED(rp2a03), uint16_t operand)
 {
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->Y;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	uint16_t result = rp2a03->A + b + rp2a03->C;
-	rp2a03->C = result >> 8;
-	rp2a03->Z = ((uint8_t)result == 0);
-	rp2a03->V = ((~(rp2a03->A ^ b) & (rp2a03->A ^ result) & 0x80) != 0);
-	rp2a03->N = ((result & 0x80) != 0);
-	rp2a03->A = result;
-	rp2a03->PC += 2;
-	clock_consume(4);
+	return operand;
 }
 
-void ADC_I(struct rp2a03 *rp2a03)
+uint16_t addr_ZPX(struct rp2a03 *rp2a03, uint16_t operand)
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	uint16_t result = rp2a03->A + b + rp2a03->C;
-	rp2a03->C = result >> 8;
-	rp2a03->Z = ((uint8_t)result == 0);
-	rp2a03->V = ((~(rp2a03->A ^ b) & (rp2a03->A ^ result) & 0x80) != 0);
-	rp2a03->N = ((result & 0x80) != 0);
-	rp2a03->A = result;
-	clock_consume(2);
+	return (operand + rp2a03->X) % ZP_SIZE;
 }
 
-void ADC_IX(struct rp2a03 *rp2a03)
+uint16_t addr_ZPY(struct rp2a03 *rp2a03, uint16_t operand)
 {
-	uint8_t b = (memory_readb(rp2a03->bus_id, rp2a03->PC++) + rp2a03->X);
-	uint16_t address = memory_readb(rp2a03->bus_id, b % ZP_SIZE) |
-		(memory_readb(rp2a03->bus_id, (b + 1) % ZP_SIZE) << 8);
-	b = memory_readb(rp2a03->bus_id, address);
-	uint16_t result = rp2a03->A + b + rp2a03->C;
-	rp2a03->C = result >> 8;
-	rp2a03->Z = ((uint8_t)result == 0);
-	rp2a03->V = ((~(rp2a03->A ^ b) & (rp2a03->A ^ result) & 0x80) != 0);
-	rp2a03->N = ((result & 0x80) != 0);
-	rp2a03->A = result;
-	clock_consume(6);
+	return (operand + rp2a03->Y) % ZP_SIZE;
 }
 
-void ADC_IY(struct rp2a03 *rp2a03)
+void branch(struct rp2a03 *rp2a03, bool condition, uint16_t operand)
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	uint16_t address = memory_readb(rp2a03->bus_id, b % ZP_SIZE) |
-		(memory_readb(rp2a03->bus_id, (b + 1) % ZP_SIZE) << 8);
-	b = memory_readb(rp2a03->bus_id, address + rp2a03->Y);
-	uint16_t result = rp2a03->A + b + rp2a03->C;
-	rp2a03->C = result >> 8;
-	rp2a03->Z = ((uint8_t)result == 0);
-	rp2a03->V = ((~(rp2a03->A ^ b) & (rp2a03->A ^ result) & 0x80) != 0);
-	rp2a03->N = ((result & 0x80) != 0);
-	rp2a03->A = result;
-	clock_consume(5);
-}
+	uint16_t address = rp2a03->PC;
 
-void ADC_ZP(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readb(rp2a03->bus_id,
-		rp2a03->PC++));
-	uint16_t result = rp2a03->A + b + rp2a03->C;
-	rp2a03->C = result >> 8;
-	rp2a03->Z = ((uint8_t)result == 0);
-	rp2a03->V = ((~(rp2a03->A ^ b) & (rp2a03->A ^ result) & 0x80) != 0);
-	rp2a03->N = ((result & 0x80) != 0);
-	rp2a03->A = result;
-	clock_consume(3);
+	/* Leave PC after offset if branch is not taken */
+	if (!condition) {
+		rp2a03->page_crossed = false;
+		return;
+	}
+
+	/* Jump (taken branches and page crossings take an extra cycle) */
+	rp2a03->PC = address + (int8_t)operand;
+	rp2a03->page_crossed = ((address ^ rp2a03->PC) & 0xFF00) != 0;
+	clock_consume(1);
+
+	/* Backward branches might close an idle loop */
+	rp2a03->idle_pending = (rp2a03->PC < address);
 }
 
-void ADC_ZPX(struct rp2a03 *rp2a03)
+void ADC(struct rp2a03 *rp2a03, uint8_t b)
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, (memory_readb(rp2a03->bus_id,
-		rp2a03->PC++) + rp2a03->X) % ZP_SIZE);
 	uint16_t result = rp2a03->A + b + rp2a03->C;
 	rp2a03->C = result >> 8;
 	rp2a03->Z = ((uint8_t)result == 0);
 	rp2a03->V = ((~(rp2a03->A ^ b) & (rp2a03->A ^ result) & 0x80) != 0);
 	rp2a03->N = ((result & 0x80) != 0);
 	rp2a03->A = result;
-	clock_consume(4);
 }
 
 void AND(struct rp2a03 *rp2a03, uint8_t b)
@@ -330,221 +631,273 @@ void AND(struct rp2a03 *rp2a03, uint8_t b)
 	rp2a03->N = ((rp2a03->A & 0x80) != 0);
 }
 
-void AND_A(struct rp2a03 *rp2a03)
+uint8_t ASL(struct rp2a03 *rp2a03, uint8_t b)
 {
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC);
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	AND(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
-
-void AND_AX(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->X;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	AND(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
-
-void AND_AY(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->Y;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	AND(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
+	rp2a03->C = ((b & 0x80) != 0);
+	b <<= 1;
+	rp2a03->Z = (b == 0);
+	rp2a03->N = ((b & 0x80) != 0);
+	return b;
 }
 
-void AND_I(struct rp2a03 *rp2a03)
+void BIT(struct rp2a03 *rp2a03, uint8_t b)
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	AND(rp2a03, b);
-	clock_consume(2);
+	rp2a03->Z = ((rp2a03->A & b) == 0);
+	rp2a03->V = ((b & 0x40) != 0);
+	rp2a03->N = ((b & 0x80) != 0);
 }
 
-void AND_IX(struct rp2a03 *rp2a03)
+void CMP(struct rp2a03 *rp2a03, uint8_t b)
 {
-	uint8_t b = (memory_readb(rp2a03->bus_id, rp2a03->PC++) + rp2a03->X);
-	uint16_t address = memory_readb(rp2a03->bus_id, b % ZP_SIZE) |
-		(memory_readb(rp2a03->bus_id, (b + 1) % ZP_SIZE) << 8);
-	b = memory_readb(rp2a03->bus_id, address);
-	AND(rp2a03, b);
-	clock_consume(6);
+	rp2a03->C = (rp2a03->A >= b);
+	rp2a03->Z = (rp2a03->A == b);
+	rp2a03->N = (((rp2a03->A - b) & 0x80) != 0);
 }
 
-void AND_IY(struct rp2a03 *rp2a03)
+void CPX(struct rp2a03 *rp2a03, uint8_t b)
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	uint16_t address = memory_readb(rp2a03->bus_id, b % ZP_SIZE) |
-		(memory_readb(rp2a03->bus_id, (b + 1) % ZP_SIZE) << 8);
-	b = memory_readb(rp2a03->bus_id, address + rp2a03->Y);
-	AND(rp2a03, b);
-	clock_consume(5);
+	rp2a03->C = (rp2a03->X >= b);
+	rp2a03->Z = (rp2a03->X == b);
+	rp2a03->N = (((rp2a03->X - b) & 0x80) != 0);
 }
 
-void AND_ZP(struct rp2a03 *rp2a03)
+void CPY(struct rp2a03 *rp2a03, uint8_t b)
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readb(rp2a03->bus_id,
-		rp2a03->PC++));
-	AND(rp2a03, b);
-	clock_consume(3);
+	rp2a03->C = (rp2a03->Y >= b);
+	rp2a03->Z = (rp2a03->Y == b);
+	rp2a03->N = (((rp2a03->Y - b) & 0x80) != 0);
 }
 
-void AND_ZPX(struct rp2a03 *rp2a03)
+uint8_t DEC(struct rp2a03 *rp2a03, uint8_t b)
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, (memory_readb(rp2a03->bus_id,
-		rp2a03->PC++) + rp2a03->X) % ZP_SIZE);
-	AND(rp2a03, b);
-	clock_consume(4);
+	b--;
+	rp2a03->Z = (b == 0);
+	rp2a03->N = ((b & 0x80) != 0);
+	return b;
 }
 
-void ASL_ACC(struct rp2a03 *rp2a03)
+void EOR(struct rp2a03 *rp2a03, uint8_t b)
 {
-	rp2a03->C = ((rp2a03->A & 0x80) != 0);
-	rp2a03->A <<= 1;
+	rp2a03->A ^= b;
 	rp2a03->Z = (rp2a03->A == 0);
 	rp2a03->N = ((rp2a03->A & 0x80) != 0);
-	clock_consume(2);
 }
 
-void ASL_A(struct rp2a03 *rp2a03)
+uint8_t INC(struct rp2a03 *rp2a03, uint8_t b)
 {
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC);
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	rp2a03->C = ((b & 0x80) != 0);
-	b <<= 1;
-	memory_writeb(rp2a03->bus_id, b, address);
-	rp2a03->Z = (b == 0);
-	rp2a03->N = ((b & 0x80) != 0);
-	rp2a03->PC += 2;
-	clock_consume(6);
-}
-
-void ASL_AX(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->X;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	rp2a03->C = ((b & 0x80) != 0);
-	b <<= 1;
-	memory_writeb(rp2a03->bus_id, b, address);
+	b++;
 	rp2a03->Z = (b == 0);
 	rp2a03->N = ((b & 0x80) != 0);
-	rp2a03->PC += 2;
-	clock_consume(7);
+	return b;
 }
 
-void ASL_ZP(struct rp2a03 *rp2a03)
+void LDA(struct rp2a03 *rp2a03, uint8_t b)
 {
-	uint8_t address = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	rp2a03->C = ((b & 0x80) != 0);
-	b <<= 1;
-	memory_writeb(rp2a03->bus_id, b, address);
-	rp2a03->Z = (b == 0);
-	rp2a03->N = ((b & 0x80) != 0);
-	clock_consume(5);
+	rp2a03->A = b;
+	rp2a03->Z = (rp2a03->A == 0);
+	rp2a03->N = ((rp2a03->A & 0x80) != 0);
 }
 
-void ASL_ZPX(struct rp2a03 *rp2a03)
+void LDX(struct rp2a03 *rp2a03, uint8_t b)
 {
-	uint8_t address = (memory_readb(rp2a03->bus_id, rp2a03->PC++) +
-		rp2a03->X) % ZP_SIZE;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	rp2a03->C = ((b & 0x80) != 0);
-	b <<= 1;
-	memory_writeb(rp2a03->bus_id, b, address);
-	rp2a03->Z = (b == 0);
-	rp2a03->N = ((b & 0x80) != 0);
-	clock_consume(6);
+	rp2a03->X = b;
+	rp2a03->Z = (rp2a03->X == 0);
+	rp2a03->N = ((rp2a03->X & 0x80) != 0);
 }
 
-void BCC(struct rp2a03 *rp2a03)
+void LDY(struct rp2a03 *rp2a03, uint8_t b)
 {
-	if (!rp2a03->C) {
-		rp2a03->PC += (int8_t)memory_readb(rp2a03->bus_id, rp2a03->PC);
-		clock_consume(1);
-	}
-	rp2a03->PC++;
-	clock_consume(2);
+	rp2a03->Y = b;
+	rp2a03->Z = (rp2a03->Y == 0);
+	rp2a03->N = ((rp2a03->Y & 0x80) != 0);
 }
 
-void BCS(struct rp2a03 *rp2a03)
+uint8_t LSR(struct rp2a03 *rp2a03, uint8_t b)
 {
-	if (rp2a03->C) {
-		rp2a03->PC += (int8_t)memory_readb(rp2a03->bus_id, rp2a03->PC);
-		clock_consume(1);
-	}
-	rp2a03->PC++;
-	clock_consume(2);
+	rp2a03->C = ((b & 0x01) != 0);
+	b >>= 1;
+	rp2a03->Z = (b == 0);
+	rp2a03->N = 0;
+	return b;
 }
 
-void BEQ(struct rp2a03 *rp2a03)
+void ORA(struct rp2a03 *rp2a03, uint8_t b)
 {
-	if (rp2a03->Z) {
-		rp2a03->PC += (int8_t)memory_readb(rp2a03->bus_id, rp2a03->PC);
-		clock_consume(1);
-	}
-	rp2a03->PC++;
-	clock_consume(2);
+	rp2a03->A |= b;
+	rp2a03->Z = (rp2a03->A == 0);
+	rp2a03->N = ((rp2a03->A & 0x80) != 0);
 }
 
-void BIT(struct rp2a03 *rp2a03, uint8_t b)
+uint8_t ROL(struct rp2a03 *rp2a03, uint8_t b)
 {
-	rp2a03->Z = ((rp2a03->A & b) == 0);
-	rp2a03->V = ((b & 0x40) != 0);
+	uint8_t old_carry = rp2a03->C;
+	rp2a03->C = ((b & 0x80) != 0);
+	b = (b << 1) | old_carry;
+	rp2a03->Z = (b == 0);
 	rp2a03->N = ((b & 0x80) != 0);
+	return b;
 }
 
-void BIT_A(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC);
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	BIT(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
-
-void BIT_ZP(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	BIT(rp2a03, b);
-	clock_consume(3);
-}
-
-void BMI(struct rp2a03 *rp2a03)
-{
-	if (rp2a03->N) {
-		rp2a03->PC += (int8_t)memory_readb(rp2a03->bus_id, rp2a03->PC);
-		clock_consume(1);
-	}
-	rp2a03->PC++;
-	clock_consume(2);
-}
-
-void BNE(struct rp2a03 *rp2a03)
+uint8_t ROR(struct rp2a03 *rp2a03, uint8_t b)
 {
-	if (!rp2a03->Z) {
-		rp2a03->PC += (int8_t)memory_readb(rp2a03->bus_id, rp2a03->PC);
-		clock_consume(1);
-	}
-	rp2a03->PC++;
-	clock_consume(2);
+	uint8_t old_carry = rp2a03->C;
+	rp2a03->C = ((b & 0x01) != 0);
+	b = (b >> 1) | (old_carry << 7);
+	rp2a03->Z = (b == 0);
+	rp2a03->N = ((b & 0x80) != 0);
+	return b;
 }
 
-void BPL(struct rp2a03 *rp2a03)
+void SBC(struct rp2a03 *rp2a03, uint8_t b)
 {
-	if (!rp2a03->N) {
-		rp2a03->PC += (int8_t)memory_readb(rp2a03->bus_id, rp2a03->PC);
-		clock_consume(1);
-	}
-	rp2a03->PC++;
-	clock_consume(2);
+	int16_t result = rp2a03->A - b - (1 - rp2a03->C);
+	rp2a03->C = ~(result >> 8);
+	rp2a03->Z = ((uint8_t)result == 0);
+	rp2a03->V = (((rp2a03->A ^ b) & (rp2a03->A ^ result) & 0x80) != 0);
+	rp2a03->N = ((result & 0x80) != 0);
+	rp2a03->A = result;
 }
 
-void BRK(struct rp2a03 *rp2a03)
+uint8_t STA(struct rp2a03 *rp2a03)
+{
+	return rp2a03->A;
+}
+
+uint8_t STX(struct rp2a03 *rp2a03)
+{
+	return rp2a03->X;
+}
+
+uint8_t STY(struct rp2a03 *rp2a03)
+{
+	return rp2a03->Y;
+}
+
+DEFINE_READ(ADC, A)
+DEFINE_READ(ADC, AX)
+DEFINE_READ(ADC, AY)
+DEFINE_READ_I(ADC)
+DEFINE_READ(ADC, IX)
+DEFINE_READ(ADC, IY)
+DEFINE_READ(ADC, ZP)
+DEFINE_READ(ADC, ZPX)
+DEFINE_READ(AND, A)
+DEFINE_READ(AND, AX)
+DEFINE_READ(AND, AY)
+DEFINE_READ_I(AND)
+DEFINE_READ(AND, IX)
+DEFINE_READ(AND, IY)
+DEFINE_READ(AND, ZP)
+DEFINE_READ(AND, ZPX)
+DEFINE_RMW_ACC(ASL)
+DEFINE_RMW(ASL, A)
+DEFINE_RMW(ASL, AX)
+DEFINE_RMW(ASL, ZP)
+DEFINE_RMW(ASL, ZPX)
+DEFINE_BRANCH(BCC, !rp2a03->C)
+DEFINE_BRANCH(BCS, rp2a03->C)
+DEFINE_BRANCH(BEQ, rp2a03->Z)
+DEFINE_READ(BIT, A)
+DEFINE_READ(BIT, ZP)
+DEFINE_BRANCH(BMI, rp2a03->N)
+DEFINE_BRANCH(BNE, !rp2a03->Z)
+DEFINE_BRANCH(BPL, !rp2a03->N)
+DEFINE_BRANCH(BVC, !rp2a03->V)
+DEFINE_BRANCH(BVS, rp2a03->V)
+DEFINE_READ(CMP, A)
+DEFINE_READ(CMP, AX)
+DEFINE_READ(CMP, AY)
+DEFINE_READ_I(CMP)
+DEFINE_READ(CMP, IX)
+DEFINE_READ(CMP, IY)
+DEFINE_READ(CMP, ZP)
+DEFINE_READ(CMP, ZPX)
+DEFINE_READ(CPX, A)
+DEFINE_READ_I(CPX)
+DEFINE_READ(CPX, ZP)
+DEFINE_READ(CPY, A)
+DEFINE_READ_I(CPY)
+DEFINE_READ(CPY, ZP)
+DEFINE_RMW(DEC, A)
+DEFINE_RMW(DEC, AX)
+DEFINE_RMW(DEC, ZP)
+DEFINE_RMW(DEC, ZPX)
+DEFINE_READ(EOR, A)
+DEFINE_READ(EOR, AX)
+DEFINE_READ(EOR, AY)
+DEFINE_READ_I(EOR)
+DEFINE_READ(EOR, IX)
+DEFINE_READ(EOR, IY)
+DEFINE_READ(EOR, ZP)
+DEFINE_READ(EOR, ZPX)
+DEFINE_RMW(INC, A)
+DEFINE_RMW(INC, AX)
+DEFINE_RMW(INC, ZP)
+DEFINE_RMW(INC, ZPX)
+DEFINE_READ(LDA, A)
+DEFINE_READ(LDA, AX)
+DEFINE_READ(LDA, AY)
+DEFINE_READ_I(LDA)
+DEFINE_READ(LDA, IX)
+DEFINE_READ(LDA, IY)
+DEFINE_READ(LDA, ZP)
+DEFINE_READ(LDA, ZPX)
+DEFINE_READ(LDX, A)
+DEFINE_READ(LDX, AY)
+DEFINE_READ_I(LDX)
+DEFINE_READ(LDX, ZP)
+DEFINE_READ(LDX, ZPY)
+DEFINE_READ(LDY, A)
+DEFINE_READ(LDY, AX)
+DEFINE_READ_I(LDY)
+DEFINE_READ(LDY, ZP)
+DEFINE_READ(LDY, ZPX)
+DEFINE_RMW_ACC(LSR)
+DEFINE_RMW(LSR, A)
+DEFINE_RMW(LSR, AX)
+DEFINE_RMW(LSR, ZP)
+DEFINE_RMW(LSR, ZPX)
+DEFINE_READ(ORA, A)
+DEFINE_READ(ORA, AX)
+DEFINE_READ(ORA, AY)
+DEFINE_READ_I(ORA)
+DEFINE_READ(ORA, IX)
+DEFINE_READ(ORA, IY)
+DEFINE_READ(ORA, ZP)
+DEFINE_READ(ORA, ZPX)
+DEFINE_RMW_ACC(ROL)
+DEFINE_RMW(ROL, A)
+DEFINE_RMW(ROL, AX)
+DEFINE_RMW(ROL, ZP)
+DEFINE_RMW(ROL, ZPX)
+DEFINE_RMW_ACC(ROR)
+DEFINE_RMW(ROR, A)
+DEFINE_RMW(ROR, AX)
+DEFINE_RMW(ROR, ZP)
+DEFINE_RMW(ROR, ZPX)
+DEFINE_READ(SBC, A)
+DEFINE_READ(SBC, AX)
+DEFINE_READ(SBC, AY)
+DEFINE_READ_I(SBC)
+DEFINE_READ(SBC, IX)
+DEFINE_READ(SBC, IY)
+DEFINE_READ(SBC, ZP)
+DEFINE_READ(SBC, ZPX)
+DEFINE_WRITE(STA, A)
+DEFINE_WRITE(STA, AX)
+DEFINE_WRITE(STA, AY)
+DEFINE_WRITE(STA, IX)
+DEFINE_WRITE(STA, IY)
+DEFINE_WRITE(STA, ZP)
+DEFINE_WRITE(STA, ZPX)
+DEFINE_WRITE(STX, A)
+DEFINE_WRITE(STX, ZP)
+DEFINE_WRITE(STX, ZPY)
+DEFINE_WRITE(STY, A)
+DEFINE_WRITE(STY, ZP)
+DEFINE_WRITE(STY, ZPX)
+
+void BRK(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
 	/* Save PC */
 	memory_writeb(rp2a03->bus_id, rp2a03->PC >> 8, STACK_START +
@@ -561,1698 +914,829 @@ void BRK(struct rp2a03 *rp2a03)
 
 	/* Set new PC to value written at the interrupt vector address */
 	rp2a03->PC = memory_readw(rp2a03->bus_id, IRQ_VECTOR);
-	clock_consume(7);
 }
 
-void BVC(struct rp2a03 *rp2a03)
-{
-	if (!rp2a03->V) {
-		rp2a03->PC += (int8_t)memory_readb(rp2a03->bus_id, rp2a03->PC);
-		clock_consume(1);
-	}
-	rp2a03->PC++;
-	clock_consume(2);
-}
-
-void BVS(struct rp2a03 *rp2a03)
-{
-	if (rp2a03->V) {
-		rp2a03->PC += (int8_t)memory_readb(rp2a03->bus_id, rp2a03->PC);
-		clock_consume(1);
-	}
-	rp2a03->PC++;
-	clock_consume(2);
-}
-
-void CLC(struct rp2a03 *rp2a03)
+void CLC(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
 	rp2a03->C = 0;
-	clock_consume(2);
 }
 
-void CLD(struct rp2a03 *rp2a03)
+void CLD(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
 	rp2a03->D = 0;
-	clock_consume(2);
 }
 
-void CLI(struct rp2a03 *rp2a03)
+void CLI(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
 	rp2a03->I = 0;
-	clock_consume(2);
 }
 
-void CLV(struct rp2a03 *rp2a03)
+void CLV(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
 	rp2a03->V = 0;
-	clock_consume(2);
 }
 
-void CMP(struct rp2a03 *rp2a03, uint8_t b)
+void DEX(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	rp2a03->C = (rp2a03->A >= b);
-	rp2a03->Z = (rp2a03->A == b);
-	rp2a03->N = (((rp2a03->A - b) & 0x80) != 0);
+	rp2a03->X--;
+	rp2a03->Z = (rp2a03->X == 0);
+	rp2a03->N = ((rp2a03->X & 0x80) != 0);
 }
 
-void CMP_A(struct rp2a03 *rp2a03)
+void DEY(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readw(rp2a03->bus_id,
-		rp2a03->PC));
-	CMP(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
+	rp2a03->Y--;
+	rp2a03->Z = (rp2a03->Y == 0);
+	rp2a03->N = ((rp2a03->Y & 0x80) != 0);
 }
 
-void CMP_AX(struct rp2a03 *rp2a03)
+void ILL(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readw(rp2a03->bus_id,
-		rp2a03->PC) + rp2a03->X);
-	CMP(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
+	LOG_W("rp2a03: unknown opcode (%02x)!\n",
+		memory_readb(rp2a03->bus_id, rp2a03->PC - 1));
 }
 
-void CMP_AY(struct rp2a03 *rp2a03)
+void INX(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readw(rp2a03->bus_id,
-		rp2a03->PC) + rp2a03->Y);
-	CMP(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(6);
+	rp2a03->X++;
+	rp2a03->Z = (rp2a03->X == 0);
+	rp2a03->N = ((rp2a03->X & 0x80) != 0);
 }
 
-void CMP_I(struct rp2a03 *rp2a03)
+void INY(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	CMP(rp2a03, b);
-	clock_consume(2);
+	rp2a03->Y++;
+	rp2a03->Z = (rp2a03->Y == 0);
+	rp2a03->N = ((rp2a03->Y & 0x80) != 0);
 }
 
-void CMP_IX(struct rp2a03 *rp2a03)
+void JMP_A(struct rp2a03 *rp2a03, uint16_t operand)
 {
-	uint8_t b = (memory_readb(rp2a03->bus_id, rp2a03->PC++) + rp2a03->X);
-	uint16_t address = memory_readb(rp2a03->bus_id, b % ZP_SIZE) |
-		(memory_readb(rp2a03->bus_id, (b + 1) % ZP_SIZE) << 8);
-	b = memory_readb(rp2a03->bus_id, address);
-	CMP(rp2a03, b);
-	clock_consume(6);
+	/* Backward jumps might close an idle loop */
+	rp2a03->idle_pending = (operand < rp2a03->PC);
+	rp2a03->PC = operand;
 }
 
-void CMP_IY(struct rp2a03 *rp2a03)
+void JMP_I(struct rp2a03 *rp2a03, uint16_t operand)
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	uint16_t address = memory_readb(rp2a03->bus_id, b % ZP_SIZE) |
-		(memory_readb(rp2a03->bus_id, (b + 1) % ZP_SIZE) << 8);
-	b = memory_readb(rp2a03->bus_id, address + rp2a03->Y);
-	CMP(rp2a03, b);
-	clock_consume(5);
+	uint16_t address_2 = ((operand + 1) & 0xFF) | (operand & 0xFF00);
+	rp2a03->PC = memory_readb(rp2a03->bus_id, operand) |
+		(memory_readb(rp2a03->bus_id, address_2) << 8);
 }
 
-void CMP_ZP(struct rp2a03 *rp2a03)
+void JSR(struct rp2a03 *rp2a03, uint16_t operand)
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readb(rp2a03->bus_id,
-		rp2a03->PC++));
-	CMP(rp2a03, b);
-	clock_consume(3);
+	memory_writeb(rp2a03->bus_id, (rp2a03->PC - 1) >> 8,
+		STACK_START + rp2a03->S--);
+	memory_writeb(rp2a03->bus_id, (rp2a03->PC - 1) & 0xFF,
+		STACK_START + rp2a03->S--);
+	rp2a03->PC = operand;
 }
 
-void CMP_ZPX(struct rp2a03 *rp2a03)
+void NOP(struct rp2a03 *UNUSED(rp2a03), uint16_t UNUSED(operand))
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, (memory_readb(rp2a03->bus_id,
-		rp2a03->PC++) + rp2a03->X) % ZP_SIZE);
-	CMP(rp2a03, b);
-	clock_consume(4);
 }
 
-void CPX(struct rp2a03 *rp2a03, uint8_t b)
+void PHA(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	rp2a03->C = (rp2a03->X >= b);
-	rp2a03->Z = (rp2a03->X == b);
-	rp2a03->N = (((rp2a03->X - b) & 0x80) != 0);
+	memory_writeb(rp2a03->bus_id, rp2a03->A, STACK_START + rp2a03->S--);
 }
 
-void CPX_A(struct rp2a03 *rp2a03)
+void PHP(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readw(rp2a03->bus_id,
-		rp2a03->PC));
-	CPX(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
+	rp2a03->B = 1;
+	memory_writeb(rp2a03->bus_id, rp2a03->P, STACK_START + rp2a03->S--);
+	rp2a03->B = 0;
 }
 
-void CPX_I(struct rp2a03 *rp2a03)
+void PLA(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	CPX(rp2a03, b);
-	clock_consume(2);
+	rp2a03->A = memory_readb(rp2a03->bus_id, STACK_START + ++rp2a03->S);
+	rp2a03->Z = (rp2a03->A == 0);
+	rp2a03->N = ((rp2a03->A & 0x80) != 0);
 }
 
-void CPX_ZP(struct rp2a03 *rp2a03)
+void PLP(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readb(rp2a03->bus_id,
-		rp2a03->PC++));
-	CPX(rp2a03, b);
-	clock_consume(3);
+	rp2a03->P = memory_readb(rp2a03->bus_id, STACK_START + ++rp2a03->S);
+	rp2a03->unused = 1;
+	rp2a03->B = 0;
 }
 
-void CPY(struct rp2a03 *rp2a03, uint8_t b)
+void RTI(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	rp2a03->C = (rp2a03->Y >= b);
-	rp2a03->Z = (rp2a03->Y == b);
-	rp2a03->N = (((rp2a03->Y - b) & 0x80) != 0);
+	rp2a03->P = memory_readb(rp2a03->bus_id, STACK_START + ++rp2a03->S);
+	rp2a03->unused = 1;
+	rp2a03->B = 0;
+	rp2a03->PC = memory_readb(rp2a03->bus_id, STACK_START + ++rp2a03->S);
+	rp2a03->PC |= memory_readb(rp2a03->bus_id, STACK_START +
+		++rp2a03->S) << 8;
 }
 
-void CPY_A(struct rp2a03 *rp2a03)
+void RTS(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readw(rp2a03->bus_id,
-		rp2a03->PC));
-	CPY(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
+	uint16_t PC = memory_readb(rp2a03->bus_id, STACK_START + ++rp2a03->S);
+	PC |= memory_readb(rp2a03->bus_id, STACK_START + ++rp2a03->S) << 8;
+	rp2a03->PC = PC + 1;
 }
 
-void CPY_I(struct rp2a03 *rp2a03)
+void SEC(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	CPY(rp2a03, b);
-	clock_consume(2);
+	rp2a03->C = 1;
 }
 
-void CPY_ZP(struct rp2a03 *rp2a03)
+void SED(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readb(rp2a03->bus_id,
-		rp2a03->PC++));
-	CPY(rp2a03, b);
-	clock_consume(3);
+	rp2a03->D = 1;
 }
 
-void DEC(struct rp2a03 *rp2a03, uint16_t address)
+void SEI(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, address) - 1;
-	rp2a03->Z = (b == 0);
-	rp2a03->N = ((b & 0x80) != 0);
-	memory_writeb(rp2a03->bus_id, b, address);
+	rp2a03->I = 1;
 }
 
-void DEC_A(struct rp2a03 *rp2a03)
+void TAX(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC);
-	DEC(rp2a03, address);
-	rp2a03->PC += 2;
-	clock_consume(6);
+	rp2a03->X = rp2a03->A;
+	rp2a03->Z = (rp2a03->X == 0);
+	rp2a03->N = ((rp2a03->X & 0x80) != 0);
 }
 
-void DEC_AX(struct rp2a03 *rp2a03)
+void TAY(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->X;
-	DEC(rp2a03, address);
-	rp2a03->PC += 2;
-	clock_consume(7);
+	rp2a03->Y = rp2a03->A;
+	rp2a03->Z = (rp2a03->Y == 0);
+	rp2a03->N = ((rp2a03->Y & 0x80) != 0);
 }
 
-void DEC_ZP(struct rp2a03 *rp2a03)
+void TSX(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	uint16_t address = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	DEC(rp2a03, address);
-	clock_consume(5);
+	rp2a03->X = rp2a03->S;
+	rp2a03->Z = (rp2a03->X == 0);
+	rp2a03->N = ((rp2a03->X & 0x80) != 0);
 }
 
-void DEC_ZPX(struct rp2a03 *rp2a03)
+void TXA(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	uint16_t address = (memory_readb(rp2a03->bus_id, rp2a03->PC++) +
-		rp2a03->X) % ZP_SIZE;
-	DEC(rp2a03, address);
-	clock_consume(6);
+	rp2a03->A = rp2a03->X;
+	rp2a03->Z = (rp2a03->A == 0);
+	rp2a03->N = ((rp2a03->A & 0x80) != 0);
 }
 
-void DEX(struct rp2a03 *rp2a03)
+void TXS(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	rp2a03->X--;
-	rp2a03->Z = (rp2a03->X == 0);
-	rp2a03->N = ((rp2a03->X & 0x80) != 0);
-	clock_consume(2);
+	rp2a03->S = rp2a03->X;
 }
 
-void DEY(struct rp2a03 *rp2a03)
+void TYA(struct rp2a03 *rp2a03, uint16_t UNUSED(operand))
 {
-	rp2a03->Y--;
-	rp2a03->Z = (rp2a03->Y == 0);
-	rp2a03->N = ((rp2a03->Y & 0x80) != 0);
-	clock_consume(2);
-}
-
-void EOR(struct rp2a03 *rp2a03, uint8_t b)
-{
-	rp2a03->A ^= b;
-	rp2a03->Z = (rp2a03->A == 0);
-	rp2a03->N = ((rp2a03->A & 0x80) != 0);
-}
-
-void EOR_A(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC);
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	EOR(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
-
-void EOR_AX(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->X;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	EOR(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
-
-void EOR_AY(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->Y;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	EOR(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
-
-void EOR_I(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	EOR(rp2a03, b);
-	clock_consume(2);
-}
-
-void EOR_IX(struct rp2a03 *rp2a03)
-{
-	uint8_t b = (memory_readb(rp2a03->bus_id, rp2a03->PC++) + rp2a03->X);
-	uint16_t address = memory_readb(rp2a03->bus_id, b % ZP_SIZE) |
-		(memory_readb(rp2a03->bus_id, (b + 1) % ZP_SIZE) << 8);
-	b = memory_readb(rp2a03->bus_id, address);
-	EOR(rp2a03, b);
-	clock_consume(6);
-}
-
-void EOR_IY(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	uint16_t address = memory_readb(rp2a03->bus_id, b % ZP_SIZE) |
-		(memory_readb(rp2a03->bus_id, (b + 1) % ZP_SIZE) << 8);
-	b = memory_readb(rp2a03->bus_id, address + rp2a03->Y);
-	EOR(rp2a03, b);
-	clock_consume(5);
-}
-
-void EOR_ZP(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readb(rp2a03->bus_id,
-		rp2a03->PC++));
-	EOR(rp2a03, b);
-	clock_consume(3);
-}
-
-void EOR_ZPX(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, (memory_readb(rp2a03->bus_id,
-		rp2a03->PC++) + rp2a03->X) % ZP_SIZE);
-	EOR(rp2a03, b);
-	clock_consume(4);
-}
-
-void INC(struct rp2a03 *rp2a03, uint16_t address)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, address) + 1;
-	rp2a03->Z = (b == 0);
-	rp2a03->N = ((b & 0x80) != 0);
-	memory_writeb(rp2a03->bus_id, b, address);
-}
-
-void INC_A(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC);
-	INC(rp2a03, address);
-	rp2a03->PC += 2;
-	clock_consume(6);
-}
-
-void INC_AX(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->X;
-	INC(rp2a03, address);
-	rp2a03->PC += 2;
-	clock_consume(7);
-}
-
-void INC_ZP(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	INC(rp2a03, address);
-	clock_consume(5);
-}
-
-void INC_ZPX(struct rp2a03 *rp2a03)
-{
-	uint16_t address = (memory_readb(rp2a03->bus_id, rp2a03->PC++) +
-		rp2a03->X) % ZP_SIZE;
-	INC(rp2a03, address);
-	clock_consume(6);
-}
-
-void INX(struct rp2a03 *rp2a03)
-{
-	rp2a03->X++;
-	rp2a03->Z = (rp2a03->X == 0);
-	rp2a03->N = ((rp2a03->X & 0x80) != 0);
-	clock_consume(2);
-}
-
-void INY(struct rp2a03 *rp2a03)
-{
-	rp2a03->Y++;
-	rp2a03->Z = (rp2a03->Y == 0);
-	rp2a03->N = ((rp2a03->Y & 0x80) != 0);
-	clock_consume(2);
-}
-
-void JMP(struct rp2a03 *rp2a03, uint16_t address)
-{
-	rp2a03->PC = address;
-}
-
-void JMP_A(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC);
-	JMP(rp2a03, address);
-	clock_consume(3);
-}
-
-void JMP_I(struct rp2a03 *rp2a03)
-{
-	uint16_t address_1 = memory_readw(rp2a03->bus_id, rp2a03->PC);
-	uint16_t address_2 = ((address_1 + 1) & 0xFF) | (address_1 & 0xFF00);
-	uint16_t address = memory_readb(rp2a03->bus_id, address_1) |
-		(memory_readb(rp2a03->bus_id, address_2) << 8);
-	JMP(rp2a03, address);
-	clock_consume(5);
-}
-
-void JSR(struct rp2a03 *rp2a03)
-{
-	memory_writeb(rp2a03->bus_id, (rp2a03->PC + 1) >> 8,
-		STACK_START + rp2a03->S--);
-	memory_writeb(rp2a03->bus_id, (rp2a03->PC + 1) & 0xFF,
-		STACK_START + rp2a03->S--);
-	rp2a03->PC = memory_readw(rp2a03->bus_id, rp2a03->PC);
-	clock_consume(6);
-}
-
-void LDA(struct rp2a03 *rp2a03, uint8_t b)
-{
-	rp2a03->A = b;
-	rp2a03->Z = (rp2a03->A == 0);
-	rp2a03->N = ((rp2a03->A & 0x80) != 0);
-}
-
-void LDA_A(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC);
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	LDA(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
-
-void LDA_AX(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->X;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	LDA(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
-
-void LDA_AY(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->Y;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	LDA(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
-
-void LDA_I(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	LDA(rp2a03, b);
-	clock_consume(2);
-}
-
-void LDA_IX(struct rp2a03 *rp2a03)
-{
-	uint8_t b = (memory_readb(rp2a03->bus_id, rp2a03->PC++) + rp2a03->X);
-	uint16_t address = memory_readb(rp2a03->bus_id, b % ZP_SIZE) |
-		(memory_readb(rp2a03->bus_id, (b + 1) % ZP_SIZE) << 8);
-	b = memory_readb(rp2a03->bus_id, address);
-	LDA(rp2a03, b);
-	clock_consume(5);
-}
-
-void LDA_IY(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	uint16_t address = memory_readb(rp2a03->bus_id, b % ZP_SIZE) |
-		(memory_readb(rp2a03->bus_id, (b + 1) % ZP_SIZE) << 8);
-	b = memory_readb(rp2a03->bus_id, address + rp2a03->Y);
-	LDA(rp2a03, b);
-	clock_consume(5);
-}
-
-void LDA_ZPX(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, (memory_readb(rp2a03->bus_id,
-		rp2a03->PC++) + rp2a03->X) % ZP_SIZE);
-	LDA(rp2a03, b);
-	clock_consume(4);
-}
-
-void LDA_ZP(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readb(rp2a03->bus_id,
-		rp2a03->PC++));
-	LDA(rp2a03, b);
-	clock_consume(3);
-}
-
-void LDX(struct rp2a03 *rp2a03, uint8_t b)
-{
-	rp2a03->X = b;
-	rp2a03->Z = (rp2a03->X == 0);
-	rp2a03->N = ((rp2a03->X & 0x80) != 0);
-}
-
-void LDX_A(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC);
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	LDX(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
-
-void LDX_AY(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->Y;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	LDX(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
-
-void LDX_I(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	LDX(rp2a03, b);
-	clock_consume(2);
-}
-
-void LDX_ZP(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readb(rp2a03->bus_id,
-		rp2a03->PC++));
-	LDX(rp2a03, b);
-	clock_consume(3);
-}
-
-void LDX_ZPY(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, (memory_readb(rp2a03->bus_id,
-		rp2a03->PC++) + rp2a03->Y) % ZP_SIZE);
-	LDX(rp2a03, b);
-	clock_consume(4);
-}
-
-void LDY(struct rp2a03 *rp2a03, uint8_t b)
-{
-	rp2a03->Y = b;
-	rp2a03->Z = (rp2a03->Y == 0);
-	rp2a03->N = ((rp2a03->Y & 0x80) != 0);
-}
-
-void LDY_A(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC);
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	LDY(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
-
-void LDY_AX(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->X;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	LDY(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
-
-void LDY_I(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	LDY(rp2a03, b);
-	clock_consume(2);
-}
-
-void LDY_ZP(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readb(rp2a03->bus_id,
-		rp2a03->PC++));
-	LDY(rp2a03, b);
-	clock_consume(3);
-}
-
-void LDY_ZPX(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, (memory_readb(rp2a03->bus_id,
-		rp2a03->PC++) + rp2a03->X) % ZP_SIZE);
-	LDY(rp2a03, b);
-	clock_consume(4);
-}
-
-void LSR_ACC(struct rp2a03 *rp2a03)
-{
-	rp2a03->C = ((rp2a03->A & 0x01) != 0);
-	rp2a03->A >>= 1;
-	rp2a03->Z = (rp2a03->A == 0);
-	rp2a03->N = 0;
-	clock_consume(2);
-}
-
-void LSR_A(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC);
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	rp2a03->C = ((b & 0x01) != 0);
-	b >>= 1;
-	memory_writeb(rp2a03->bus_id, b, address);
-	rp2a03->Z = (b == 0);
-	rp2a03->N = 0;
-	rp2a03->PC += 2;
-	clock_consume(6);
-}
-
-void LSR_AX(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->X;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	rp2a03->C = ((b & 0x01) != 0);
-	b >>= 1;
-	memory_writeb(rp2a03->bus_id, b, address);
-	rp2a03->Z = (b == 0);
-	rp2a03->N = 0;
-	rp2a03->PC += 2;
-	clock_consume(7);
-}
-
-void LSR_ZP(struct rp2a03 *rp2a03)
-{
-	uint8_t address = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	rp2a03->C = ((b & 0x01) != 0);
-	b >>= 1;
-	memory_writeb(rp2a03->bus_id, b, address);
-	rp2a03->Z = (b == 0);
-	rp2a03->N = 0;
-	clock_consume(5);
-}
-
-void LSR_ZPX(struct rp2a03 *rp2a03)
-{
-	uint8_t address = (memory_readb(rp2a03->bus_id, rp2a03->PC++) +
-		rp2a03->X) % ZP_SIZE;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	rp2a03->C = ((b & 0x01) != 0);
-	b >>= 1;
-	memory_writeb(rp2a03->bus_id, b, address);
-	rp2a03->Z = (b == 0);
-	rp2a03->N = 0;
-	clock_consume(6);
-}
-
-void NOP(struct rp2a03 *UNUSED(rp2a03))
-{
-	clock_consume(2);
-}
-
-void NOP_A(struct rp2a03 *rp2a03)
-{
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
-
-void NOP_D(struct rp2a03 *rp2a03)
-{
-	rp2a03->PC++;
-	clock_consume(3);
-}
-
-void ORA(struct rp2a03 *rp2a03, uint8_t b)
-{
-	rp2a03->A |= b;
+	rp2a03->A = rp2a03->Y;
 	rp2a03->Z = (rp2a03->A == 0);
 	rp2a03->N = ((rp2a03->A & 0x80) != 0);
 }
 
-void ORA_A(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC);
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	ORA(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
+static const struct rp2a03_opcode rp2a03_opcodes[] = {
+	RP2A03_OPCODES(OPCODE_ENTRY)
+};
 
-void ORA_AX(struct rp2a03 *rp2a03)
+void rp2a03_execute(struct rp2a03 *rp2a03, uint8_t opcode)
 {
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->X;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	ORA(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
+	const struct rp2a03_opcode *op = &rp2a03_opcodes[opcode];
+	uint16_t operand = 0;
 
-void ORA_AY(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->Y;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	ORA(rp2a03, b);
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
+	/* Fetch operand and move PC to next instruction */
+	if (op->length == 2)
+		operand = memory_readb(rp2a03->bus_id, rp2a03->PC);
+	else if (op->length == 3)
+		operand = memory_readw(rp2a03->bus_id, rp2a03->PC);
+	rp2a03->PC += op->length - 1;
 
-void ORA_I(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	ORA(rp2a03, b);
-	clock_consume(2);
-}
+	/* Run handler and consume cycles (adding page-cross penalty if any) */
+	op->handler(rp2a03, operand);
+	clock_consume(op->cycles + ((op->flags & OP_PAGE_PENALTY) &&
+		rp2a03->page_crossed));
 
-void ORA_IX(struct rp2a03 *rp2a03)
-{
-	uint8_t b = (memory_readb(rp2a03->bus_id, rp2a03->PC++) + rp2a03->X);
-	uint16_t address = memory_readb(rp2a03->bus_id, b % ZP_SIZE) |
-		(memory_readb(rp2a03->bus_id, (b + 1) % ZP_SIZE) << 8);
-	b = memory_readb(rp2a03->bus_id, address);
-	ORA(rp2a03, b);
-	clock_consume(6);
+	/* Check for idle loop once jump has been completed */
+	if (rp2a03->idle_pending) {
+		rp2a03->idle_pending = false;
+		rp2a03_check_idle(rp2a03);
+	}
 }
 
-void ORA_IY(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	uint16_t address = memory_readb(rp2a03->bus_id, b % ZP_SIZE) |
-		(memory_readb(rp2a03->bus_id, (b + 1) % ZP_SIZE) << 8);
-	b = memory_readb(rp2a03->bus_id, address + rp2a03->Y);
-	ORA(rp2a03, b);
-	clock_consume(5);
-}
+void rp2a03_check_idle(struct rp2a03 *rp2a03)
+{
+	struct rp2a03_idle *idle = &rp2a03->idle;
+	uint64_t num_instructions;
+	uint64_t num_periods;
+
+	/* Skip iterations if loop head state is repeated without any bus write
+	or side-effecting read since last visit (which makes the loop unable to
+	exit before another clock ticks) */
+	if (idle->valid &&
+		(idle->PC == rp2a03->PC) &&
+		(idle->A == rp2a03->A) &&
+		(idle->X == rp2a03->X) &&
+		(idle->Y == rp2a03->Y) &&
+		(idle->S == rp2a03->S) &&
+		(idle->P == rp2a03->P) &&
+		(idle->num_updates == memory_num_updates)) {
+		num_instructions = rp2a03->instance->num_instructions -
+			idle->num_instructions;
+		num_periods = clock_skip_idle(rp2a03->clock.next_cycle -
+			idle->cycle);
+		rp2a03->instance->num_instructions += num_periods *
+			num_instructions;
+	}
 
-void ORA_ZP(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readb(rp2a03->bus_id,
-		rp2a03->PC++));
-	ORA(rp2a03, b);
-	clock_consume(3);
+	/* Save loop head state */
+	idle->valid = true;
+	idle->PC = rp2a03->PC;
+	idle->A = rp2a03->A;
+	idle->X = rp2a03->X;
+	idle->Y = rp2a03->Y;
+	idle->S = rp2a03->S;
+	idle->P = rp2a03->P;
+	idle->cycle = rp2a03->clock.next_cycle;
+	idle->num_instructions = rp2a03->instance->num_instructions;
+	idle->num_updates = memory_num_updates;
 }
 
-void ORA_ZPX(struct rp2a03 *rp2a03)
+void rp2a03_handle_interrupt(struct rp2a03 *rp2a03)
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, (memory_readb(rp2a03->bus_id,
-		rp2a03->PC++) + rp2a03->X) % ZP_SIZE);
-	ORA(rp2a03, b);
-	clock_consume(4);
-}
+	uint16_t vector = 0;
 
-void PHA(struct rp2a03 *rp2a03)
-{
-	memory_writeb(rp2a03->bus_id, rp2a03->A, STACK_START + rp2a03->S--);
-	clock_consume(3);
-}
+	/* Save PC */
+	memory_writeb(rp2a03->bus_id, rp2a03->PC >> 8, STACK_START +
+		rp2a03->S--);
+	memory_writeb(rp2a03->bus_id, rp2a03->PC & 0xFF, STACK_START +
+		rp2a03->S--);
 
-void PHP(struct rp2a03 *rp2a03)
-{
-	rp2a03->B = 1;
+	/* Push flags */
 	memory_writeb(rp2a03->bus_id, rp2a03->P, STACK_START + rp2a03->S--);
-	rp2a03->B = 0;
-	clock_consume(3);
-}
 
-void PLA(struct rp2a03 *rp2a03)
-{
-	rp2a03->A = memory_readb(rp2a03->bus_id, STACK_START + ++rp2a03->S);
-	rp2a03->Z = (rp2a03->A == 0);
-	rp2a03->N = ((rp2a03->A & 0x80) != 0);
-	clock_consume(4);
-}
+	/* Get interrupt vector address */
+	if (rp2a03->interrupt == rp2a03->nmi)
+		vector = NMI_VECTOR;
+	else if (rp2a03->interrupt == rp2a03->irq)
+		vector = IRQ_VECTOR;
 
-void PLP(struct rp2a03 *rp2a03)
-{
-	rp2a03->P = memory_readb(rp2a03->bus_id, STACK_START + ++rp2a03->S);
-	rp2a03->unused = 1;
-	rp2a03->B = 0;
-	clock_consume(4);
-}
+	/* Set PC to value written at the interrupt vector address */
+	rp2a03->PC = memory_readw(rp2a03->bus_id, vector);
+	clock_consume(7);
 
-void ROL_ACC(struct rp2a03 *rp2a03)
-{
-	uint8_t old_carry = rp2a03->C;
-	rp2a03->C = ((rp2a03->A & 0x80) != 0);
-	rp2a03->A = (rp2a03->A << 1) | old_carry;
-	rp2a03->Z = (rp2a03->A == 0);
-	rp2a03->N = ((rp2a03->A & 0x80) != 0);
-	clock_consume(2);
+	/* Interrupt is now being handled */
+	rp2a03->interrupted = false;
 }
 
-void ROL_A(struct rp2a03 *rp2a03)
+#ifdef __GNUC__
+void rp2a03_tick(struct rp2a03 *rp2a03)
 {
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC);
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	uint8_t old_carry = rp2a03->C;
-	rp2a03->C = ((b & 0x80) != 0);
-	b = (b << 1) | old_carry;
-	memory_writeb(rp2a03->bus_id, b, address);
-	rp2a03->Z = (b == 0);
-	rp2a03->N = ((b & 0x80) != 0);
-	rp2a03->PC += 2;
-	clock_consume(6);
-}
+	static void *labels[] = { RP2A03_OPCODES(OPCODE_LABEL) };
+	uint8_t opcode;
 
-void ROL_AX(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->X;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	uint8_t old_carry = rp2a03->C;
-	rp2a03->C = ((b & 0x80) != 0);
-	b = (b << 1) | old_carry;
-	memory_writeb(rp2a03->bus_id, b, address);
-	rp2a03->Z = (b == 0);
-	rp2a03->N = ((b & 0x80) != 0);
-	rp2a03->PC += 2;
-	clock_consume(7);
-}
+	/* Execute instructions until next device deadline (forgetting idle
+	state as other clocks might have ticked since last run) */
+	TRACE_BEGIN("rp2a03");
+	rp2a03->idle.valid = false;
+#ifdef RP2A03_JIT
+	if (rp2a03->jit) {
+		rp2a03_jit_run(rp2a03);
+		goto done;
+	}
+#endif
+	FETCH();
 
-void ROL_ZP(struct rp2a03 *rp2a03)
-{
-	uint8_t address = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	uint8_t old_carry = rp2a03->C;
-	rp2a03->C = ((b & 0x80) != 0);
-	b = (b << 1) | old_carry;
-	memory_writeb(rp2a03->bus_id, b, address);
-	rp2a03->Z = (b == 0);
-	rp2a03->N = ((b & 0x80) != 0);
-	clock_consume(5);
-}
+	/* Handle interrupt (not counted as an instruction) */
+interrupt:
+	rp2a03_handle_interrupt(rp2a03);
+	DISPATCH();
 
-void ROL_ZPX(struct rp2a03 *rp2a03)
-{
-	uint8_t address = (memory_readb(rp2a03->bus_id, rp2a03->PC++) +
-		rp2a03->X) % ZP_SIZE;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	uint8_t old_carry = rp2a03->C;
-	rp2a03->C = ((b & 0x80) != 0);
-	b = (b << 1) | old_carry;
-	memory_writeb(rp2a03->bus_id, b, address);
-	rp2a03->Z = (b == 0);
-	rp2a03->N = ((b & 0x80) != 0);
-	clock_consume(6);
-}
+	/* Execute opcodes */
+	RP2A03_OPCODES(OPCODE_BODY)
 
-void ROR_ACC(struct rp2a03 *rp2a03)
-{
-	uint8_t old_carry = rp2a03->C;
-	rp2a03->C = ((rp2a03->A & 0x01) != 0);
-	rp2a03->A = (rp2a03->A >> 1) | (old_carry << 7);
-	rp2a03->Z = (rp2a03->A == 0);
-	rp2a03->N = ((rp2a03->A & 0x80) != 0);
-	clock_consume(2);
+done:
+	TRACE_END("rp2a03");
 }
-
-void ROR_A(struct rp2a03 *rp2a03)
+#else
+void rp2a03_tick(struct rp2a03 *rp2a03)
 {
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC);
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	uint8_t old_carry = rp2a03->C;
-	rp2a03->C = ((b & 0x01) != 0);
-	b = (b >> 1) | (old_carry << 7);
-	memory_writeb(rp2a03->bus_id, b, address);
-	rp2a03->Z = (b == 0);
-	rp2a03->N = ((b & 0x80) != 0);
-	rp2a03->PC += 2;
-	clock_consume(6);
+	/* Execute instructions until next device deadline (forgetting idle
+	state as other clocks might have ticked since last run) */
+	TRACE_BEGIN("rp2a03");
+	rp2a03->idle.valid = false;
+	do
+		rp2a03_step(rp2a03);
+	while (clock_run_ahead());
+	TRACE_END("rp2a03");
 }
+#endif
 
-void ROR_AX(struct rp2a03 *rp2a03)
+#if !defined(__GNUC__) || defined(RP2A03_JIT)
+void rp2a03_step(struct rp2a03 *rp2a03)
 {
-	uint16_t address = memory_readw(rp2a03->bus_id, rp2a03->PC) + rp2a03->X;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	uint8_t old_carry = rp2a03->C;
-	rp2a03->C = ((b & 0x01) != 0);
-	b = (b >> 1) | (old_carry << 7);
-	memory_writeb(rp2a03->bus_id, b, address);
-	rp2a03->Z = (b == 0);
-	rp2a03->N = ((b & 0x80) != 0);
-	rp2a03->PC += 2;
-	clock_consume(7);
-}
+	uint8_t opcode;
 
-void ROR_ZP(struct rp2a03 *rp2a03)
-{
-	uint8_t address = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	uint8_t old_carry = rp2a03->C;
-	rp2a03->C = ((b & 0x01) != 0);
-	b = (b >> 1) | (old_carry << 7);
-	memory_writeb(rp2a03->bus_id, b, address);
-	rp2a03->Z = (b == 0);
-	rp2a03->N = ((b & 0x80) != 0);
-	clock_consume(5);
-}
+	/* Check if CPU has been interrupted */
+	if (rp2a03->interrupted) {
+		rp2a03_handle_interrupt(rp2a03);
+		return;
+	}
 
-void ROR_ZPX(struct rp2a03 *rp2a03)
-{
-	uint8_t address = (memory_readb(rp2a03->bus_id, rp2a03->PC++) +
-		rp2a03->X) % ZP_SIZE;
-	uint8_t b = memory_readb(rp2a03->bus_id, address);
-	uint8_t old_carry = rp2a03->C;
-	rp2a03->C = ((b & 0x01) != 0);
-	b = (b >> 1) | (old_carry << 7);
-	memory_writeb(rp2a03->bus_id, b, address);
-	rp2a03->Z = (b == 0);
-	rp2a03->N = ((b & 0x80) != 0);
-	clock_consume(6);
-}
+	/* Count retired instruction */
+	rp2a03->instance->num_instructions++;
 
-void RTI(struct rp2a03 *rp2a03)
-{
-	rp2a03->P = memory_readb(rp2a03->bus_id, STACK_START + ++rp2a03->S);
-	rp2a03->unused = 1;
-	rp2a03->B = 0;
-	rp2a03->PC = memory_readb(rp2a03->bus_id, STACK_START + ++rp2a03->S);
-	rp2a03->PC |= memory_readb(rp2a03->bus_id, STACK_START +
-		++rp2a03->S) << 8;
-	clock_consume(6);
+	/* Fetch and execute opcode */
+	opcode = memory_readb(rp2a03->bus_id, rp2a03->PC++);
+	rp2a03_execute(rp2a03, opcode);
 }
+#endif
 
-void RTS(struct rp2a03 *rp2a03)
+#ifdef RP2A03_JIT
+void emit_byte(struct rp2a03_jit *jit, uint8_t b)
 {
-	uint16_t PC = memory_readb(rp2a03->bus_id, STACK_START + ++rp2a03->S);
-	PC |= memory_readb(rp2a03->bus_id, STACK_START + ++rp2a03->S) << 8;
-	rp2a03->PC = PC + 1;
-	clock_consume(6);
+	jit->code[jit->code_used++] = b;
 }
 
-void SBC_A(struct rp2a03 *rp2a03)
+void emit_u16(struct rp2a03_jit *jit, uint16_t w)
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readw(rp2a03->bus_id,
-		rp2a03->PC));
-	int16_t result = rp2a03->A - b - (1 - rp2a03->C);
-	rp2a03->C = ~(result >> 8);
-	rp2a03->Z = ((uint8_t)result == 0);
-	rp2a03->V = (((rp2a03->A ^ b) & (rp2a03->A ^ result) & 0x80) != 0);
-	rp2a03->N = ((result & 0x80) != 0);
-	rp2a03->A = result;
-	rp2a03->PC += 2;
-	clock_consume(4);
+	memcpy(&jit->code[jit->code_used], &w, sizeof(uint16_t));
+	jit->code_used += sizeof(uint16_t);
 }
 
-void SBC_AX(struct rp2a03 *rp2a03)
+void emit_u32(struct rp2a03_jit *jit, uint32_t l)
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readw(rp2a03->bus_id,
-		rp2a03->PC) + rp2a03->X);
-	int16_t result = rp2a03->A - b - (1 - rp2a03->C);
-	rp2a03->C = ~(result >> 8);
-	rp2a03->Z = ((uint8_t)result == 0);
-	rp2a03->V = (((rp2a03->A ^ b) & (rp2a03->A ^ result) & 0x80) != 0);
-	rp2a03->N = ((result & 0x80) != 0);
-	rp2a03->A = result;
-	rp2a03->PC += 2;
-	clock_consume(4);
+	memcpy(&jit->code[jit->code_used], &l, sizeof(uint32_t));
+	jit->code_used += sizeof(uint32_t);
 }
 
-void SBC_AY(struct rp2a03 *rp2a03)
+void emit_u64(struct rp2a03_jit *jit, uint64_t q)
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readw(rp2a03->bus_id,
-		rp2a03->PC) + rp2a03->Y);
-	int16_t result = rp2a03->A - b - (1 - rp2a03->C);
-	rp2a03->C = ~(result >> 8);
-	rp2a03->Z = ((uint8_t)result == 0);
-	rp2a03->V = (((rp2a03->A ^ b) & (rp2a03->A ^ result) & 0x80) != 0);
-	rp2a03->N = ((result & 0x80) != 0);
-	rp2a03->A = result;
-	rp2a03->PC += 2;
-	clock_consume(4);
+	memcpy(&jit->code[jit->code_used], &q, sizeof(uint64_t));
+	jit->code_used += sizeof(uint64_t);
 }
 
-void SBC_I(struct rp2a03 *rp2a03)
+void emit_field(struct rp2a03_jit *jit, uint8_t reg, size_t offset)
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	int16_t result = rp2a03->A - b - (1 - rp2a03->C);
-	rp2a03->C = ~(result >> 8);
-	rp2a03->Z = ((uint8_t)result == 0);
-	rp2a03->V = (((rp2a03->A ^ b) & (rp2a03->A ^ result) & 0x80) != 0);
-	rp2a03->N = ((result & 0x80) != 0);
-	rp2a03->A = result;
-	clock_consume(2);
+	/* Encode [rbx + disp32] operand (rbx holding rp2a03 pointer) */
+	emit_byte(jit, 0x83 | (reg << 3));
+	emit_u32(jit, offset);
 }
 
-void SBC_IX(struct rp2a03 *rp2a03)
+size_t emit_jump(struct rp2a03_jit *jit, uint8_t opcode)
 {
-	uint8_t b = (memory_readb(rp2a03->bus_id, rp2a03->PC++) + rp2a03->X);
-	uint16_t address = memory_readb(rp2a03->bus_id, b % ZP_SIZE) |
-		(memory_readb(rp2a03->bus_id, (b + 1) % ZP_SIZE) << 8);
-	b = memory_readb(rp2a03->bus_id, address);
-	int16_t result = rp2a03->A - b - (1 - rp2a03->C);
-	rp2a03->C = ~(result >> 8);
-	rp2a03->Z = ((uint8_t)result == 0);
-	rp2a03->V = (((rp2a03->A ^ b) & (rp2a03->A ^ result) & 0x80) != 0);
-	rp2a03->N = ((result & 0x80) != 0);
-	rp2a03->A = result;
-	clock_consume(6);
+	/* Emit short conditional jump and return its offset for patching */
+	emit_byte(jit, opcode);
+	emit_byte(jit, 0);
+	return jit->code_used - 1;
 }
 
-void SBC_IY(struct rp2a03 *rp2a03)
+void emit_patch(struct rp2a03_jit *jit, size_t jump)
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-	uint16_t address = memory_readb(rp2a03->bus_id, b % ZP_SIZE) |
-		(memory_readb(rp2a03->bus_id, (b + 1) % ZP_SIZE) << 8);
-	b = memory_readb(rp2a03->bus_id, address + rp2a03->Y);
-	int16_t result = rp2a03->A - b - (1 - rp2a03->C);
-	rp2a03->C = ~(result >> 8);
-	rp2a03->Z = ((uint8_t)result == 0);
-	rp2a03->V = (((rp2a03->A ^ b) & (rp2a03->A ^ result) & 0x80) != 0);
-	rp2a03->N = ((result & 0x80) != 0);
-	rp2a03->A = result;
-	clock_consume(5);
+	/* Make short jump land on current location */
+	jit->code[jump] = jit->code_used - (jump + 1);
 }
 
-void SBC_ZP(struct rp2a03 *rp2a03)
+void emit_prologue(struct rp2a03_jit *jit, struct rp2a03 *rp2a03)
 {
-	uint8_t b = memory_readb(rp2a03->bus_id, memory_readb(rp2a03->bus_id,
-		rp2a03->PC++));
-	int16_t result = rp2a03->A - b - (1 - rp2a03->C);
-	rp2a03->C = ~(result >> 8);
-	rp2a03->Z = ((uint8_t)result == 0);
-	rp2a03->V = (((rp2a03->A ^ b) & (rp2a03->A ^ result) & 0x80) != 0);
-	rp2a03->N = ((result & 0x80) != 0);
-	rp2a03->A = result;
-	clock_consume(3);
-}
+	/* push rbx, r12, r13, r14, r15 (also aligning stack for calls) */
+	emit_byte(jit, 0x53);
+	emit_byte(jit, 0x41);
+	emit_byte(jit, 0x54);
+	emit_byte(jit, 0x41);
+	emit_byte(jit, 0x55);
+	emit_byte(jit, 0x41);
+	emit_byte(jit, 0x56);
+	emit_byte(jit, 0x41);
+	emit_byte(jit, 0x57);
 
-void SBC_ZPX(struct rp2a03 *rp2a03)
-{
-	uint8_t b = memory_readb(rp2a03->bus_id, (memory_readb(rp2a03->bus_id,
-		rp2a03->PC++) + rp2a03->X) % ZP_SIZE);
-	int16_t result = rp2a03->A - b - (1 - rp2a03->C);
-	rp2a03->C = ~(result >> 8);
-	rp2a03->Z = ((uint8_t)result == 0);
-	rp2a03->V = (((rp2a03->A ^ b) & (rp2a03->A ^ result) & 0x80) != 0);
-	rp2a03->N = ((result & 0x80) != 0);
-	rp2a03->A = result;
-	clock_consume(4);
-}
+	/* mov rbx, rdi */
+	emit_byte(jit, 0x48);
+	emit_byte(jit, 0x89);
+	emit_byte(jit, 0xFB);
 
-void SEC(struct rp2a03 *rp2a03)
-{
-	rp2a03->C = 1;
-	clock_consume(2);
-}
+	/* mov r12, &current_cycle */
+	emit_byte(jit, 0x49);
+	emit_byte(jit, 0xBC);
+	emit_u64(jit, (uintptr_t)&current_cycle);
 
-void SED(struct rp2a03 *rp2a03)
-{
-	rp2a03->D = 1;
-	clock_consume(2);
-}
+	/* mov r13, &run_ahead_limit */
+	emit_byte(jit, 0x49);
+	emit_byte(jit, 0xBD);
+	emit_u64(jit, (uintptr_t)&run_ahead_limit);
 
-void SEI(struct rp2a03 *rp2a03)
-{
-	rp2a03->I = 1;
-	clock_consume(2);
-}
+	/* mov r14, &num_instructions */
+	emit_byte(jit, 0x49);
+	emit_byte(jit, 0xBE);
+	emit_u64(jit, (uintptr_t)&rp2a03->instance->num_instructions);
 
-void STA_A(struct rp2a03 *rp2a03)
-{
-	memory_writeb(rp2a03->bus_id, rp2a03->A, memory_readw(rp2a03->bus_id,
-		rp2a03->PC));
-	rp2a03->PC += 2;
-	clock_consume(4);
+	/* mov rax, &memory_map_generation and mov r15d, [rax] */
+	emit_byte(jit, 0x48);
+	emit_byte(jit, 0xB8);
+	emit_u64(jit, (uintptr_t)&memory_map_generation);
+	emit_byte(jit, 0x44);
+	emit_byte(jit, 0x8B);
+	emit_byte(jit, 0x38);
 }
 
-void STA_AX(struct rp2a03 *rp2a03)
+void emit_exit(struct rp2a03_jit *jit, int pc, int num_instructions,
+	bool run_ahead)
 {
-	memory_writeb(rp2a03->bus_id, rp2a03->A, memory_readw(rp2a03->bus_id,
-		rp2a03->PC) + rp2a03->X);
-	rp2a03->PC += 2;
-	clock_consume(5);
-}
+	/* Set PC to next instruction if needed */
+	if (pc >= 0) {
+		emit_byte(jit, 0x66);
+		emit_byte(jit, 0xC7);
+		emit_field(jit, 0, offsetof(struct rp2a03, PC));
+		emit_u16(jit, pc);
+	}
 
-void STA_AY(struct rp2a03 *rp2a03)
-{
-	memory_writeb(rp2a03->bus_id, rp2a03->A, memory_readw(rp2a03->bus_id,
-		rp2a03->PC) + rp2a03->Y);
-	rp2a03->PC += 2;
-	clock_consume(5);
-}
+	/* add qword [r14], num_instructions */
+	emit_byte(jit, 0x49);
+	emit_byte(jit, 0x83);
+	emit_byte(jit, 0x06);
+	emit_byte(jit, num_instructions);
+
+	/* Return whether run-ahead goes on (mov eax, 1 or xor eax, eax) */
+	if (run_ahead) {
+		emit_byte(jit, 0xB8);
+		emit_u32(jit, 1);
+	} else {
+		emit_byte(jit, 0x31);
+		emit_byte(jit, 0xC0);
+	}
 
-void STA_IX(struct rp2a03 *rp2a03)
-{
-	uint8_t b = (memory_readb(rp2a03->bus_id, rp2a03->PC++) + rp2a03->X);
-	uint16_t address = memory_readb(rp2a03->bus_id, b % ZP_SIZE) |
-		(memory_readb(rp2a03->bus_id, (b + 1) % ZP_SIZE) << 8);
-	memory_writeb(rp2a03->bus_id, rp2a03->A, address);
-	clock_consume(6);
-}
+	/* pop r15, r14, r13, r12, rbx and return */
+	emit_byte(jit, 0x41);
+	emit_byte(jit, 0x5F);
+	emit_byte(jit, 0x41);
+	emit_byte(jit, 0x5E);
+	emit_byte(jit, 0x41);
+	emit_byte(jit, 0x5D);
+	emit_byte(jit, 0x41);
+	emit_byte(jit, 0x5C);
+	emit_byte(jit, 0x5B);
+	emit_byte(jit, 0xC3);
+}
+
+void emit_check(struct rp2a03_jit *jit, int pc, int num_instructions,
+	bool last, bool remap)
+{
+	size_t jump;
+
+	/* mov rax, [next_cycle] */
+	emit_byte(jit, 0x48);
+	emit_byte(jit, 0x8B);
+	emit_field(jit, 0, offsetof(struct rp2a03, clock) +
+		offsetof(struct clock, next_cycle));
+
+	/* cmp rax, [r13] (stopping like clock_run_ahead once limit is hit) */
+	emit_byte(jit, 0x49);
+	emit_byte(jit, 0x3B);
+	emit_byte(jit, 0x45);
+	emit_byte(jit, 0x00);
+	jump = emit_jump(jit, 0x72);
+	emit_exit(jit, pc, num_instructions, false);
+	emit_patch(jit, jump);
+
+	/* mov [r12], rax (advancing machine time as clock_run_ahead does) */
+	emit_byte(jit, 0x49);
+	emit_byte(jit, 0x89);
+	emit_byte(jit, 0x04);
+	emit_byte(jit, 0x24);
+
+	/* Leave block once its last instruction is done */
+	if (last) {
+		emit_exit(jit, pc, num_instructions, true);
+		return;
+	}
 
-void STA_IY(struct rp2a03 *rp2a03)
-{
-	uint16_t address = memory_readw(rp2a03->bus_id,
-		memory_readb(rp2a03->bus_id, rp2a03->PC++)) + rp2a03->Y;
-	memory_writeb(rp2a03->bus_id, rp2a03->A, address);
-	clock_consume(6);
+	/* Leave block if an interrupt needs to be serviced */
+	emit_byte(jit, 0x80);
+	emit_field(jit, 7, offsetof(struct rp2a03, interrupted));
+	emit_byte(jit, 0x00);
+	jump = emit_jump(jit, 0x74);
+	emit_exit(jit, pc, num_instructions, true);
+	emit_patch(jit, jump);
+
+	/* Leave block if a write changed memory mapping (bank switch) */
+	if (remap) {
+		/* mov rax, &memory_map_generation */
+		emit_byte(jit, 0x48);
+		emit_byte(jit, 0xB8);
+		emit_u64(jit, (uintptr_t)&memory_map_generation);
+
+		/* cmp r15d, [rax] */
+		emit_byte(jit, 0x44);
+		emit_byte(jit, 0x3B);
+		emit_byte(jit, 0x38);
+		jump = emit_jump(jit, 0x74);
+		emit_exit(jit, pc, num_instructions, true);
+		emit_patch(jit, jump);
+	}
 }
 
-void STA_ZP(struct rp2a03 *rp2a03)
+void emit_flags(struct rp2a03_jit *jit, uint8_t clear, uint8_t set)
 {
-	memory_writeb(rp2a03->bus_id, rp2a03->A, memory_readb(rp2a03->bus_id,
-		rp2a03->PC++));
-	clock_consume(3);
-}
+	/* and byte [P], ~clear */
+	if (clear) {
+		emit_byte(jit, 0x80);
+		emit_field(jit, 4, offsetof(struct rp2a03, P));
+		emit_byte(jit, ~clear);
+	}
 
-void STA_ZPX(struct rp2a03 *rp2a03)
-{
-	memory_writeb(rp2a03->bus_id, rp2a03->A, (memory_readb(rp2a03->bus_id,
-		rp2a03->PC++) + rp2a03->X) % ZP_SIZE);
-	clock_consume(4);
+	/* or byte [P], set */
+	if (set) {
+		emit_byte(jit, 0x80);
+		emit_field(jit, 1, offsetof(struct rp2a03, P));
+		emit_byte(jit, set);
+	}
 }
 
-void STX_A(struct rp2a03 *rp2a03)
-{
-	memory_writeb(rp2a03->bus_id, rp2a03->X, memory_readw(rp2a03->bus_id,
-		rp2a03->PC));
-	rp2a03->PC += 2;
-	clock_consume(4);
+void emit_load(struct rp2a03_jit *jit, size_t offset, uint8_t b)
+{
+	/* mov byte [register], b */
+	emit_byte(jit, 0xC6);
+	emit_field(jit, 0, offset);
+	emit_byte(jit, b);
+
+	/* Set Z and N flags based on known value */
+	emit_flags(jit, FLAG_Z | FLAG_N, ((b == 0) ? FLAG_Z : 0) |
+		((b & 0x80) ? FLAG_N : 0));
+}
+
+void emit_call(struct rp2a03_jit *jit, rp2a03_handler_t handler,
+	uint16_t operand, uint16_t pc)
+{
+	/* mov word [PC], pc (handlers expect PC on next instruction) */
+	emit_byte(jit, 0x66);
+	emit_byte(jit, 0xC7);
+	emit_field(jit, 0, offsetof(struct rp2a03, PC));
+	emit_u16(jit, pc);
+
+	/* mov rdi, rbx */
+	emit_byte(jit, 0x48);
+	emit_byte(jit, 0x89);
+	emit_byte(jit, 0xDF);
+
+	/* mov esi, operand */
+	emit_byte(jit, 0xBE);
+	emit_u32(jit, operand);
+
+	/* mov rax, handler and call rax */
+	emit_byte(jit, 0x48);
+	emit_byte(jit, 0xB8);
+	emit_u64(jit, (uintptr_t)handler);
+	emit_byte(jit, 0xFF);
+	emit_byte(jit, 0xD0);
+}
+
+void emit_consume(struct rp2a03_jit *jit, uint32_t num_cycles)
+{
+	/* add qword [next_cycle], num_cycles */
+	emit_byte(jit, 0x48);
+	emit_byte(jit, 0x81);
+	emit_field(jit, 0, offsetof(struct rp2a03, clock) +
+		offsetof(struct clock, next_cycle));
+	emit_u32(jit, num_cycles);
+}
+
+void emit_instruction(struct rp2a03_jit *jit,
+	const struct rp2a03_opcode *op, uint16_t operand, uint16_t pc)
+{
+	rp2a03_handler_t handler = op->handler;
+	size_t jump;
+
+	/* Translate simple instructions and call handlers for others */
+	if (handler == CLC)
+		emit_flags(jit, FLAG_C, 0);
+	else if (handler == SEC)
+		emit_flags(jit, 0, FLAG_C);
+	else if (handler == CLI)
+		emit_flags(jit, FLAG_I, 0);
+	else if (handler == SEI)
+		emit_flags(jit, 0, FLAG_I);
+	else if (handler == CLD)
+		emit_flags(jit, FLAG_D, 0);
+	else if (handler == SED)
+		emit_flags(jit, 0, FLAG_D);
+	else if (handler == CLV)
+		emit_flags(jit, FLAG_V, 0);
+	else if (handler == LDA_I)
+		emit_load(jit, offsetof(struct rp2a03, A), operand);
+	else if (handler == LDX_I)
+		emit_load(jit, offsetof(struct rp2a03, X), operand);
+	else if (handler == LDY_I)
+		emit_load(jit, offsetof(struct rp2a03, Y), operand);
+	else if (handler == JMP_A)
+		emit_call(jit, handler, operand, operand);
+	else if (handler != NOP)
+		emit_call(jit, handler, operand, pc);
+
+	/* Consume base cycles */
+	emit_consume(jit, op->cycles * jit->div);
+
+	/* Consume extra cycle if page was crossed */
+	if (op->flags & OP_PAGE_PENALTY) {
+		emit_byte(jit, 0x80);
+		emit_field(jit, 7, offsetof(struct rp2a03, page_crossed));
+		emit_byte(jit, 0x00);
+		jump = emit_jump(jit, 0x74);
+		emit_consume(jit, jit->div);
+		emit_patch(jit, jump);
+	}
 }
 
-void STX_ZP(struct rp2a03 *rp2a03)
+struct rp2a03_jit *rp2a03_jit_init()
 {
-	memory_writeb(rp2a03->bus_id, rp2a03->X, memory_readb(rp2a03->bus_id,
-		rp2a03->PC++));
-	clock_consume(3);
-}
+	struct rp2a03_jit *jit;
 
-void STX_ZPY(struct rp2a03 *rp2a03)
-{
-	memory_writeb(rp2a03->bus_id, rp2a03->X, (memory_readb(rp2a03->bus_id,
-		rp2a03->PC++) + rp2a03->Y) % ZP_SIZE);
-	clock_consume(4);
-}
+	/* Allocate recompiler and block pool */
+	jit = calloc(1, sizeof(struct rp2a03_jit));
+	if (!jit)
+		return NULL;
+	jit->blocks = calloc(JIT_MAX_BLOCKS, sizeof(struct rp2a03_block));
+	if (!jit->blocks) {
+		free(jit);
+		return NULL;
+	}
 
-void STY_A(struct rp2a03 *rp2a03)
-{
-	memory_writeb(rp2a03->bus_id, rp2a03->Y, memory_readw(rp2a03->bus_id,
-		rp2a03->PC));
-	rp2a03->PC += 2;
-	clock_consume(4);
-}
+	/* Map executable code buffer */
+	jit->code = mmap(NULL,
+		JIT_CODE_SIZE,
+		PROT_READ | PROT_WRITE | PROT_EXEC,
+		MAP_PRIVATE | MAP_ANONYMOUS,
+		-1,
+		0);
+	if (jit->code == MAP_FAILED) {
+		free(jit->blocks);
+		free(jit);
+		return NULL;
+	}
 
-void STY_ZP(struct rp2a03 *rp2a03)
-{
-	memory_writeb(rp2a03->bus_id, rp2a03->Y, memory_readb(rp2a03->bus_id,
-		rp2a03->PC++));
-	clock_consume(3);
-}
+	return jit;
+}
+
+void rp2a03_jit_flush(struct rp2a03_jit *jit, uint64_t div)
+{
+	/* Drop all blocks and code */
+	memset(jit->table, 0, sizeof(jit->table));
+	jit->num_blocks = 0;
+	jit->code_used = 0;
+	jit->div = div;
+}
+
+struct rp2a03_block *rp2a03_jit_translate(struct rp2a03 *rp2a03,
+	uint8_t *mem, bool writable)
+{
+	struct rp2a03_jit *jit = rp2a03->jit;
+	const struct rp2a03_opcode *op = NULL;
+	const struct rp2a03_opcode *next;
+	struct rp2a03_block *block;
+	size_t start;
+	uint16_t operand;
+	int offset = rp2a03->PC & MEM_PAGE_MASK;
+	bool wrote = false;
+	int size = 0;
+	int n = 0;
+
+	/* Make room for a full block if needed */
+	if ((jit->num_blocks == JIT_MAX_BLOCKS) ||
+		(jit->code_used + JIT_MAX_BLOCK_CODE > JIT_CODE_SIZE))
+		rp2a03_jit_flush(jit, jit->div);
+	start = jit->code_used;
+	emit_prologue(jit, rp2a03);
+
+	/* Translate instructions until a jump or the end of the page */
+	while (n < JIT_MAX_INSTRUCTIONS) {
+		/* Leave unknown or page-crossing instructions to interpreter
+		(opcode itself might lie beyond the end of the page) */
+		if (offset + size >= MEM_PAGE_SIZE)
+			break;
+		next = &rp2a03_opcodes[mem[size]];
+		if ((next->handler == ILL) ||
+			(offset + size + next->length > MEM_PAGE_SIZE))
+			break;
+		op = next;
+
+		/* Get operand */
+		operand = 0;
+		if (op->length == 2)
+			operand = mem[size + 1];
+		else if (op->length == 3)
+			operand = mem[size + 1] | (mem[size + 2] << 8);
+
+		/* Check deadlines and interrupts between instructions */
+		if (n > 0)
+			emit_check(jit, rp2a03->PC + size, n, false, wrote);
+		wrote = (op->flags & OP_WRITE);
+		size += op->length;
+		n++;
+
+		/* Translate instruction */
+		emit_instruction(jit, op, operand, rp2a03->PC + size);
+
+		/* Stop after jumps and after writes to writable code (any
+		modification is then caught on next block lookup) */
+		if ((op->flags & OP_JUMP) ||
+			(writable && (op->flags & OP_WRITE)))
+			break;
+	}
 
-void STY_ZPX(struct rp2a03 *rp2a03)
-{
-	memory_writeb(rp2a03->bus_id, rp2a03->Y, (memory_readb(rp2a03->bus_id,
-		rp2a03->PC++) + rp2a03->X) % ZP_SIZE);
-	clock_consume(4);
-}
+	/* Drop block if not even one instruction could be translated */
+	if (n == 0) {
+		jit->code_used = start;
+		return NULL;
+	}
 
-void TAX(struct rp2a03 *rp2a03)
-{
-	rp2a03->X = rp2a03->A;
-	rp2a03->Z = (rp2a03->X == 0);
-	rp2a03->N = ((rp2a03->X & 0x80) != 0);
-	clock_consume(2);
-}
+	/* Leave block (PC is already set if last instruction jumped) */
+	emit_check(jit,
+		(op->flags & OP_JUMP) ? -1 : rp2a03->PC + size,
+		n,
+		true,
+		false);
+
+	/* Fill block (saving source of writable code to validate it) */
+	block = &jit->blocks[jit->num_blocks++];
+	block->pc = rp2a03->PC;
+	block->mem = mem;
+	block->writable = writable;
+	block->size = size;
+	if (writable)
+		memcpy(block->source, mem, size);
+	block->code = (rp2a03_code_t)(void *)&jit->code[start];
+	return block;
+}
+
+struct rp2a03_block *rp2a03_jit_get_block(struct rp2a03 *rp2a03)
+{
+	struct rp2a03_jit *jit = rp2a03->jit;
+	struct rp2a03_block *block;
+	struct page *page;
+	uint8_t *mem;
+	bool writable;
+	int index;
+
+	/* Only code located in host memory is translated */
+	page = memory_get_page(rp2a03->bus_id, rp2a03->PC);
+	if (!page || !page->readb.mem)
+		return NULL;
+	mem = page->readb.mem + (rp2a03->PC & MEM_PAGE_MASK);
+
+	/* Flush blocks if clock divider changed (cycles are embedded) */
+	if (rp2a03->clock.div != jit->div) {
+		if (rp2a03->clock.div * JIT_MAX_CYCLES > INT32_MAX)
+			return NULL;
+		rp2a03_jit_flush(jit, rp2a03->clock.div);
+	}
 
-void TAY(struct rp2a03 *rp2a03)
-{
-	rp2a03->Y = rp2a03->A;
-	rp2a03->Z = (rp2a03->Y == 0);
-	rp2a03->N = ((rp2a03->Y & 0x80) != 0);
-	clock_consume(2);
-}
+	/* Return cached block if it still matches code (blocks are looked up
+	by guest address and host memory, following bank switches) */
+	index = (rp2a03->PC ^ ((uintptr_t)page->readb.mem >> MEM_PAGE_SHIFT)) %
+		JIT_TABLE_SIZE;
+	block = jit->table[index];
+	if (block &&
+		(block->pc == rp2a03->PC) &&
+		(block->mem == mem) &&
+		(!block->writable || !memcmp(block->source, mem, block->size)))
+		return block;
 
-void TSX(struct rp2a03 *rp2a03)
-{
-	rp2a03->X = rp2a03->S;
-	rp2a03->Z = (rp2a03->X == 0);
-	rp2a03->N = ((rp2a03->X & 0x80) != 0);
-	clock_consume(2);
+	/* Translate block (code might get written if region allows it) */
+	writable = (page->readb.region->mops->writeb != NULL);
+	block = rp2a03_jit_translate(rp2a03, mem, writable);
+	jit->table[index] = block;
+	return block;
 }
 
-void TXA(struct rp2a03 *rp2a03)
+void rp2a03_jit_run(struct rp2a03 *rp2a03)
 {
-	rp2a03->A = rp2a03->X;
-	rp2a03->Z = (rp2a03->A == 0);
-	rp2a03->N = ((rp2a03->A & 0x80) != 0);
-	clock_consume(2);
-}
+	struct rp2a03_block *block;
+	bool run;
 
-void TXS(struct rp2a03 *rp2a03)
-{
-	rp2a03->S = rp2a03->X;
-	clock_consume(2);
-}
+	/* Run translated blocks until next device deadline (interpreting
+	interrupts and instructions which could not be translated) */
+	do {
+		block = !rp2a03->interrupted ? rp2a03_jit_get_block(rp2a03) :
+			NULL;
+		if (!block) {
+			rp2a03_step(rp2a03);
+			run = clock_run_ahead();
+			continue;
+		}
+		clock_get_run_ahead_limit();
+		run = block->code(rp2a03);
 
-void TYA(struct rp2a03 *rp2a03)
-{
-	rp2a03->A = rp2a03->Y;
-	rp2a03->Z = (rp2a03->A == 0);
-	rp2a03->N = ((rp2a03->A & 0x80) != 0);
-	clock_consume(2);
+		/* Discard idle loop candidate flagged by translated branches
+		(idle loops are only detected while interpreting) */
+		rp2a03->idle_pending = false;
+	} while (run);
 }
 
-void rp2a03_tick(struct rp2a03 *rp2a03)
+void rp2a03_jit_deinit(struct rp2a03_jit *jit)
 {
-	uint16_t vector = 0;
-	uint8_t opcode;
-
-	/* Check if CPU has been interrupted */
-	if (rp2a03->interrupted) {
-		/* Save PC */
-		memory_writeb(rp2a03->bus_id, rp2a03->PC >> 8, STACK_START +
-			rp2a03->S--);
-		memory_writeb(rp2a03->bus_id, rp2a03->PC & 0xFF, STACK_START +
-			rp2a03->S--);
-
-		/* Push flags */
-		memory_writeb(rp2a03->bus_id, rp2a03->P, STACK_START +
-			rp2a03->S--);
-
-		/* Get interrupt vector address */
-		if (rp2a03->interrupt == rp2a03->nmi)
-			vector = NMI_VECTOR;
-		else if (rp2a03->interrupt == rp2a03->irq)
-			vector = IRQ_VECTOR;
-
-		/* Set PC to value written at the interrupt vector address */
-		rp2a03->PC = memory_readw(rp2a03->bus_id, vector);
-		clock_consume(7);
-
-		/* Interrupt is now being handled */
-		rp2a03->interrupted = false;
-		return;
-	}
-
-	/* Fetch opcode */
-	opcode = memory_readb(rp2a03->bus_id, rp2a03->PC++);
-
-	/* Execute opcode */
-	switch (opcode) {
-	case 0x00:
-		BRK(rp2a03);
-		break;
-	case 0x01:
-		ORA_IX(rp2a03);
-		break;
-	case 0x04:
-		NOP_D(rp2a03);
-		break;
-	case 0x05:
-		ORA_ZP(rp2a03);
-		break;
-	case 0x06:
-		ASL_ZP(rp2a03);
-		break;
-	case 0x08:
-		PHP(rp2a03);
-		break;
-	case 0x09:
-		ORA_I(rp2a03);
-		break;
-	case 0x0A:
-		ASL_ACC(rp2a03);
-		break;
-	case 0x0C:
-		NOP_A(rp2a03);
-		break;
-	case 0x0D:
-		ORA_A(rp2a03);
-		break;
-	case 0x0E:
-		ASL_A(rp2a03);
-		break;
-	case 0x10:
-		BPL(rp2a03);
-		break;
-	case 0x11:
-		ORA_IY(rp2a03);
-		break;
-	case 0x15:
-		ORA_ZPX(rp2a03);
-		break;
-	case 0x16:
-		ASL_ZPX(rp2a03);
-		break;
-	case 0x18:
-		CLC(rp2a03);
-		break;
-	case 0x19:
-		ORA_AY(rp2a03);
-		break;
-	case 0x1D:
-		ORA_AX(rp2a03);
-		break;
-	case 0x1E:
-		ASL_AX(rp2a03);
-		break;
-	case 0x20:
-		JSR(rp2a03);
-		break;
-	case 0x21:
-		AND_IX(rp2a03);
-		break;
-	case 0x24:
-		BIT_ZP(rp2a03);
-		break;
-	case 0x25:
-		AND_ZP(rp2a03);
-		break;
-	case 0x26:
-		ROL_ZP(rp2a03);
-		break;
-	case 0x28:
-		PLP(rp2a03);
-		break;
-	case 0x29:
-		AND_I(rp2a03);
-		break;
-	case 0x2A:
-		ROL_ACC(rp2a03);
-		break;
-	case 0x2C:
-		BIT_A(rp2a03);
-		break;
-	case 0x2D:
-		AND_A(rp2a03);
-		break;
-	case 0x2E:
-		ROL_A(rp2a03);
-		break;
-	case 0x30:
-		BMI(rp2a03);
-		break;
-	case 0x31:
-		AND_IY(rp2a03);
-		break;
-	case 0x35:
-		AND_ZPX(rp2a03);
-		break;
-	case 0x36:
-		ROL_ZPX(rp2a03);
-		break;
-	case 0x38:
-		SEC(rp2a03);
-		break;
-	case 0x39:
-		AND_AY(rp2a03);
-		break;
-	case 0x3D:
-		AND_AX(rp2a03);
-		break;
-	case 0x3E:
-		ROL_AX(rp2a03);
-		break;
-	case 0x40:
-		RTI(rp2a03);
-		break;
-	case 0x41:
-		EOR_IX(rp2a03);
-		break;
-	case 0x44:
-		NOP_D(rp2a03);
-		break;
-	case 0x45:
-		EOR_ZP(rp2a03);
-		break;
-	case 0x46:
-		LSR_ZP(rp2a03);
-		break;
-	case 0x48:
-		PHA(rp2a03);
-		break;
-	case 0x49:
-		EOR_I(rp2a03);
-		break;
-	case 0x4A:
-		LSR_ACC(rp2a03);
-		break;
-	case 0x4C:
-		JMP_A(rp2a03);
-		break;
-	case 0x4D:
-		EOR_A(rp2a03);
-		break;
-	case 0x4E:
-		LSR_A(rp2a03);
-		break;
-	case 0x50:
-		BVC(rp2a03);
-		break;
-	case 0x51:
-		EOR_IY(rp2a03);
-		break;
-	case 0x55:
-		EOR_ZPX(rp2a03);
-		break;
-	case 0x56:
-		LSR_ZPX(rp2a03);
-		break;
-	case 0x58:
-		CLI(rp2a03);
-		break;
-	case 0x59:
-		EOR_AY(rp2a03);
-		break;
-	case 0x5D:
-		EOR_AX(rp2a03);
-		break;
-	case 0x5E:
-		LSR_AX(rp2a03);
-		break;
-	case 0x60:
-		RTS(rp2a03);
-		break;
-	case 0x61:
-		ADC_IX(rp2a03);
-		break;
-	case 0x64:
-		NOP_D(rp2a03);
-		break;
-	case 0x65:
-		ADC_ZP(rp2a03);
-		break;
-	case 0x66:
-		ROR_ZP(rp2a03);
-		break;
-	case 0x68:
-		PLA(rp2a03);
-		break;
-	case 0x69:
-		ADC_I(rp2a03);
-		break;
-	case 0x6A:
-		ROR_ACC(rp2a03);
-		break;
-	case 0x6C:
-		JMP_I(rp2a03);
-		break;
-	case 0x6D:
-		ADC_A(rp2a03);
-		break;
-	case 0x6E:
-		ROR_A(rp2a03);
-		break;
-	case 0x70:
-		BVS(rp2a03);
-		break;
-	case 0x71:
-		ADC_IY(rp2a03);
-		break;
-	case 0x75:
-		ADC_ZPX(rp2a03);
-		break;
-	case 0x76:
-		ROR_ZPX(rp2a03);
-		break;
-	case 0x78:
-		SEI(rp2a03);
-		break;
-	case 0x79:
-		ADC_AY(rp2a03);
-		break;
-	case 0x7D:
-		ADC_AX(rp2a03);
-		break;
-	case 0x7E:
-		ROR_AX(rp2a03);
-		break;
-	case 0x81:
-		STA_IX(rp2a03);
-		break;
-	case 0x84:
-		STY_ZP(rp2a03);
-		break;
-	case 0x85:
-		STA_ZP(rp2a03);
-		break;
-	case 0x86:
-		STX_ZP(rp2a03);
-		break;
-	case 0x88:
-		DEY(rp2a03);
-		break;
-	case 0x8A:
-		TXA(rp2a03);
-		break;
-	case 0x8C:
-		STY_A(rp2a03);
-		break;
-	case 0x8D:
-		STA_A(rp2a03);
-		break;
-	case 0x8E:
-		STX_A(rp2a03);
-		break;
-	case 0x90:
-		BCC(rp2a03);
-		break;
-	case 0x91:
-		STA_IY(rp2a03);
-		break;
-	case 0x94:
-		STY_ZPX(rp2a03);
-		break;
-	case 0x95:
-		STA_ZPX(rp2a03);
-		break;
-	case 0x96:
-		STX_ZPY(rp2a03);
-		break;
-	case 0x98:
-		TYA(rp2a03);
-		break;
-	case 0x99:
-		STA_AY(rp2a03);
-		break;
-	case 0x9A:
-		TXS(rp2a03);
-		break;
-	case 0x9D:
-		STA_AX(rp2a03);
-		break;
-	case 0xA0:
-		LDY_I(rp2a03);
-		break;
-	case 0xA1:
-		LDA_IX(rp2a03);
-		break;
-	case 0xA2:
-		LDX_I(rp2a03);
-		break;
-	case 0xA4:
-		LDY_ZP(rp2a03);
-		break;
-	case 0xA5:
-		LDA_ZP(rp2a03);
-		break;
-	case 0xA6:
-		LDX_ZP(rp2a03);
-		break;
-	case 0xA8:
-		TAY(rp2a03);
-		break;
-	case 0xA9:
-		LDA_I(rp2a03);
-		break;
-	case 0xAC:
-		LDY_A(rp2a03);
-		break;
-	case 0xAD:
-		LDA_A(rp2a03);
-		break;
-	case 0xAE:
-		LDX_A(rp2a03);
-		break;
-	case 0xAA:
-		TAX(rp2a03);
-		break;
-	case 0xB0:
-		BCS(rp2a03);
-		break;
-	case 0xB1:
-		LDA_IY(rp2a03);
-		break;
-	case 0xB4:
-		LDY_ZPX(rp2a03);
-		break;
-	case 0xB5:
-		LDA_ZPX(rp2a03);
-		break;
-	case 0xB6:
-		LDX_ZPY(rp2a03);
-		break;
-	case 0xB8:
-		CLV(rp2a03);
-		break;
-	case 0xB9:
-		LDA_AY(rp2a03);
-		break;
-	case 0xBA:
-		TSX(rp2a03);
-		break;
-	case 0xBC:
-		LDY_AX(rp2a03);
-		break;
-	case 0xBD:
-		LDA_AX(rp2a03);
-		break;
-	case 0xBE:
-		LDX_AY(rp2a03);
-		break;
-	case 0xC0:
-		CPY_I(rp2a03);
-		break;
-	case 0xC1:
-		CMP_IX(rp2a03);
-		break;
-	case 0xC4:
-		CPY_ZP(rp2a03);
-		break;
-	case 0xC5:
-		CMP_ZP(rp2a03);
-		break;
-	case 0xC6:
-		DEC_ZP(rp2a03);
-		break;
-	case 0xC8:
-		INY(rp2a03);
-		break;
-	case 0xC9:
-		CMP_I(rp2a03);
-		break;
-	case 0xCA:
-		DEX(rp2a03);
-		break;
-	case 0xCC:
-		CPY_A(rp2a03);
-		break;
-	case 0xCD:
-		CMP_A(rp2a03);
-		break;
-	case 0xCE:
-		DEC_A(rp2a03);
-		break;
-	case 0xD0:
-		BNE(rp2a03);
-		break;
-	case 0xD1:
-		CMP_IY(rp2a03);
-		break;
-	case 0xD5:
-		CMP_ZPX(rp2a03);
-		break;
-	case 0xD6:
-		DEC_ZPX(rp2a03);
-		break;
-	case 0xD8:
-		CLD(rp2a03);
-		break;
-	case 0xD9:
-		CMP_AY(rp2a03);
-		break;
-	case 0xDD:
-		CMP_AX(rp2a03);
-		break;
-	case 0xDE:
-		DEC_AX(rp2a03);
-		break;
-	case 0xE0:
-		CPX_I(rp2a03);
-		break;
-	case 0xE1:
-		SBC_IX(rp2a03);
-		break;
-	case 0xE4:
-		CPX_ZP(rp2a03);
-		break;
-	case 0xE5:
-		SBC_ZP(rp2a03);
-		break;
-	case 0xE6:
-		INC_ZP(rp2a03);
-		break;
-	case 0xE8:
-		INX(rp2a03);
-		break;
-	case 0xE9:
-		SBC_I(rp2a03);
-		break;
-	case 0xEA:
-		NOP(rp2a03);
-		break;
-	case 0xEC:
-		CPX_A(rp2a03);
-		break;
-	case 0xED:
-		SBC_A(rp2a03);
-		break;
-	case 0xEE:
-		INC_A(rp2a03);
-		break;
-	case 0xF0:
-		BEQ(rp2a03);
-		break;
-	case 0xF1:
-		SBC_IY(rp2a03);
-		break;
-	case 0xF5:
-		SBC_ZPX(rp2a03);
-		break;
-	case 0xF6:
-		INC_ZPX(rp2a03);
-		break;
-	case 0xF8:
-		SED(rp2a03);
-		break;
-	case 0xF9:
-		SBC_AY(rp2a03);
-		break;
-	case 0xFD:
-		SBC_AX(rp2a03);
-		break;
-	case 0xFE:
-		INC_AX(rp2a03);
-		break;
-	default:
-		LOG_W("rp2a03: unknown opcode (%02x)!\n", opcode);
-		clock_consume(1);
-		break;
-	}
+	munmap(jit->code, JIT_CODE_SIZE);
+	free(jit->blocks);
+	free(jit);
 }
+#endif
 
 bool rp2a03_init(struct cpu_instance *instance)
 {
@@ -2262,6 +1746,7 @@ bool rp2a03_init(struct cpu_instance *instance)
 	/* Allocate rp2a03 structure and set private data */
 	rp2a03 = calloc(1, sizeof(struct rp2a03));
 	instance->priv_data = rp2a03;
+	rp2a03->instance = instance;
 
 	/* Save bus ID */
 	rp2a03->bus_id = instance->bus_id;
@@ -2290,6 +1775,16 @@ bool rp2a03_init(struct cpu_instance *instance)
 	rp2a03->clock.tick = (clock_tick_t)rp2a03_tick;
 	clock_add(&rp2a03->clock);
 
+	/* Expose CPU clock for statistics */
+	instance->clock = &rp2a03->clock;
+
+#ifdef RP2A03_JIT
+	/* Initialize recompiler (falling back to interpreter on failure) */
+	rp2a03->jit = rp2a03_jit_init();
+	if (!rp2a03->jit)
+		LOG_W("rp2a03: could not initialize recompiler!\n");
+#endif
+
 	return true;
 }
 
@@ -2303,6 +1798,12 @@ void rp2a03_reset(struct cpu_instance *instance)
 	rp2a03->unused = 1;
 	rp2a03->interrupted = false;
 
+#ifdef RP2A03_JIT
+	/* Drop previously translated code */
+	if (rp2a03->jit)
+		rp2a03_jit_flush(rp2a03->jit, 0);
+#endif
+
 	/* Enable clock */
 	rp2a03->clock.enabled = true;
 }
@@ -2321,6 +1822,10 @@ void rp2a03_interrupt(struct cpu_instance *instance, int irq)
 void rp2a03_deinit(struct cpu_instance *instance)
 {
 	struct rp2a03 *rp2a03 = instance->priv_data;
+#ifdef RP2A03_JIT
+	if (rp2a03->jit)
+		rp2a03_jit_deinit(rp2a03->jit);
+#endif
 	free(rp2a03);
 }
 
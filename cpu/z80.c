@@ -1,11 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <bitops.h>
 #include <clock.h>
 #include <cpu.h>
 #include <log.h>
 #include <memory.h>
 #include <port.h>
+#include <trace.h>
 #include <util.h>
 
 #define DEFINE_AF_PAIR \
@@ -42,6 +44,22 @@
 #define NMI_N		1
 #define IRQ_VECTOR	0x0038
 #define NMI_VECTOR	0x0066
+#define REPEAT_CYCLES	21
+
+#define FLAG_C		0x01
+#define FLAG_N		0x02
+#define FLAG_PV		0x04
+#define FLAG_X		0x08
+#define FLAG_H		0x10
+#define FLAG_Y		0x20
+#define FLAG_Z		0x40
+#define FLAG_S		0x80
+
+/* Flag updates replace the whole F register except undocumented X/Y bits */
+#define SET_FLAGS(cpu, f) \
+	((cpu)->F = ((cpu)->F & (FLAG_X | FLAG_Y)) | (f))
+#define SET_FLAGS_KEEP_C(cpu, f) \
+	((cpu)->F = ((cpu)->F & (FLAG_X | FLAG_Y | FLAG_C)) | (f))
 
 struct z80_flags {
 	uint8_t C:1;
@@ -54,6 +72,32 @@ struct z80_flags {
 	uint8_t S:1;
 };
 
+struct z80_idle {
+	bool valid;
+	uint16_t AF;
+	uint16_t A2F2;
+	uint16_t BC;
+	uint16_t B2C2;
+	uint16_t DE;
+	uint16_t D2E2;
+	uint16_t HL;
+	uint16_t H2L2;
+	uint16_t IX;
+	uint16_t IY;
+	uint16_t PC;
+	uint16_t SP;
+	uint8_t I;
+	uint8_t R;
+	bool IFF1;
+	bool IFF2;
+	bool irq_delay;
+	bool irq_pending;
+	bool nmi_pending;
+	uint64_t cycle;
+	uint64_t num_instructions;
+	uint32_t num_updates;
+};
+
 struct z80 {
 	DEFINE_AF_PAIR
 	DEFINE_REGISTER_PAIR(A2, F2)
@@ -76,21 +120,44 @@ struct z80 {
 	bool irq_pending;
 	bool nmi_pending;
 	bool halted;
+	bool int_check;
 	int bus_id;
 	struct clock clock;
+	struct z80_idle idle;
+	struct cpu_instance *instance;
 };
 
+/* Precomputed flags: sign/zero/parity of a result, INC (indexed by operand),
+DEC (indexed by result), and ADD/SUB indexed by [carry][A << 8 | operand] */
+static uint8_t szp_flags[256];
+static uint8_t inc_flags[256];
+static uint8_t dec_flags[256];
+static uint8_t add_flags[2][65536];
+static uint8_t sub_flags[2][65536];
+static bool flag_tables_ready;
+
 static bool z80_init(struct cpu_instance *instance);
 static void z80_reset(struct cpu_instance *instance);
 static void z80_interrupt(struct cpu_instance *instance, int irq);
 static void z80_deinit(struct cpu_instance *instance);
+static void z80_init_flag_tables();
 static bool z80_handle_irq(struct z80 *cpu);
 static bool z80_handle_nmi(struct z80 *cpu);
+static void z80_update_interrupts(struct z80 *cpu);
+static void z80_step(struct z80 *cpu);
 static void z80_tick(struct z80 *cpu);
+static void z80_check_idle(struct z80 *cpu);
 static void z80_opcode_CB(struct z80 *cpu);
 static void z80_opcode_DDFD(struct z80 *cpu, uint8_t prefix);
 static void z80_opcode_DDFD_CB(struct z80 *cpu, uint16_t *reg);
 static void z80_opcode_ED(struct z80 *cpu);
+static bool z80_repeat(struct z80 *cpu, uint8_t opcode);
+static int z80_get_num_repeats(struct z80 *cpu, int max);
+static void z80_skip_repeats(struct z80 *cpu, int num_repeats);
+static bool z80_is_code(struct z80 *cpu, uint8_t *start, uint8_t *end);
+static void z80_copy_bulk(struct z80 *cpu, int step);
+static void z80_compare_bulk(struct z80 *cpu, int step);
+static void z80_output_bulk(struct z80 *cpu);
 static inline void LD_r_r(uint8_t *r1, uint8_t *r2);
 static inline void LD_r_n(struct z80 *cpu, uint8_t *r);
 static inline void LD_r_cHL(struct z80 *cpu, uint8_t *r);
@@ -562,16 +629,17 @@ void LDI(struct z80 *cpu)
 
 void LDIR(struct z80 *cpu)
 {
-	uint8_t b = memory_readb(cpu->bus_id, cpu->HL++);
-	memory_writeb(cpu->bus_id, b, cpu->DE++);
-	if (--cpu->BC != 0) {
-		cpu->PC -= 2;
-		clock_consume(5);
-	}
-	cpu->flags.H = 0;
-	cpu->flags.PV = (cpu->BC != 0);
-	cpu->flags.N = 0;
-	clock_consume(16);
+	uint8_t b;
+	do {
+		z80_copy_bulk(cpu, 1);
+		b = memory_readb(cpu->bus_id, cpu->HL++);
+		memory_writeb(cpu->bus_id, b, cpu->DE++);
+		cpu->BC--;
+		cpu->flags.H = 0;
+		cpu->flags.PV = (cpu->BC != 0);
+		cpu->flags.N = 0;
+		clock_consume(16);
+	} while ((cpu->BC != 0) && z80_repeat(cpu, 0xB0));
 }
 
 void LDD(struct z80 *cpu)
@@ -587,16 +655,17 @@ void LDD(struct z80 *cpu)
 
 void LDDR(struct z80 *cpu)
 {
-	uint8_t b = memory_readb(cpu->bus_id, cpu->HL--);
-	memory_writeb(cpu->bus_id, b, cpu->DE--);
-	if (--cpu->BC != 0) {
-		cpu->PC -= 2;
-		clock_consume(5);
-	}
-	cpu->flags.H = 0;
-	cpu->flags.PV = (cpu->BC != 0);
-	cpu->flags.N = 0;
-	clock_consume(16);
+	uint8_t b;
+	do {
+		z80_copy_bulk(cpu, -1);
+		b = memory_readb(cpu->bus_id, cpu->HL--);
+		memory_writeb(cpu->bus_id, b, cpu->DE--);
+		cpu->BC--;
+		cpu->flags.H = 0;
+		cpu->flags.PV = (cpu->BC != 0);
+		cpu->flags.N = 0;
+		clock_consume(16);
+	} while ((cpu->BC != 0) && z80_repeat(cpu, 0xB8));
 }
 
 void CPI(struct z80 *cpu)
@@ -614,19 +683,20 @@ void CPI(struct z80 *cpu)
 
 void CPIR(struct z80 *cpu)
 {
-	uint8_t b = memory_readb(cpu->bus_id, cpu->HL++);
-	int8_t result = cpu->A - b;
-	cpu->BC--;
-	if ((cpu->BC != 0) && (result != 0)) {
-		cpu->PC -= 2;
-		clock_consume(5);
-	}
-	cpu->flags.S = (result < 0);
-	cpu->flags.Z = (result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) - (b & 0x0F) < 0);
-	cpu->flags.PV = (cpu->BC == 0);
-	cpu->flags.N = 1;
-	clock_consume(16);
+	uint8_t b;
+	int8_t result;
+	do {
+		z80_compare_bulk(cpu, 1);
+		b = memory_readb(cpu->bus_id, cpu->HL++);
+		result = cpu->A - b;
+		cpu->BC--;
+		cpu->flags.S = (result < 0);
+		cpu->flags.Z = (result == 0);
+		cpu->flags.H = ((cpu->A & 0x0F) - (b & 0x0F) < 0);
+		cpu->flags.PV = (cpu->BC == 0);
+		cpu->flags.N = 1;
+		clock_consume(16);
+	} while ((cpu->BC != 0) && (result != 0) && z80_repeat(cpu, 0xB1));
 }
 
 void CPD(struct z80 *cpu)
@@ -644,59 +714,42 @@ void CPD(struct z80 *cpu)
 
 void CPDR(struct z80 *cpu)
 {
-	uint8_t b = memory_readb(cpu->bus_id, cpu->HL--);
-	int8_t result = cpu->A - b;
-	cpu->BC--;
-	if ((cpu->BC != 0) && (result != 0)) {
-		cpu->PC -= 2;
-		clock_consume(5);
-	}
-	cpu->flags.S = (result < 0);
-	cpu->flags.Z = (result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) - (b & 0x0F) < 0);
-	cpu->flags.PV = (cpu->BC == 0);
-	cpu->flags.N = 1;
-	clock_consume(16);
+	uint8_t b;
+	int8_t result;
+	do {
+		z80_compare_bulk(cpu, -1);
+		b = memory_readb(cpu->bus_id, cpu->HL--);
+		result = cpu->A - b;
+		cpu->BC--;
+		cpu->flags.S = (result < 0);
+		cpu->flags.Z = (result == 0);
+		cpu->flags.H = ((cpu->A & 0x0F) - (b & 0x0F) < 0);
+		cpu->flags.PV = (cpu->BC == 0);
+		cpu->flags.N = 1;
+		clock_consume(16);
+	} while ((cpu->BC != 0) && (result != 0) && z80_repeat(cpu, 0xB9));
 }
 
 void ADD_A_r(struct z80 *cpu, uint8_t *r)
 {
-	int16_t result = cpu->A + *r;
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) + (*r & 0x0F) > 0x0F);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 0;
-	cpu->flags.C = result >> 8;
-	cpu->A = result;
+	SET_FLAGS(cpu, add_flags[0][(cpu->A << 8) | *r]);
+	cpu->A += *r;
 	clock_consume(4);
 }
 
 void ADD_A_n(struct z80 *cpu)
 {
 	uint8_t n = memory_readb(cpu->bus_id, cpu->PC++);
-	int16_t result = cpu->A + n;
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) + (n & 0x0F) > 0x0F);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 0;
-	cpu->flags.C = result >> 8;
-	cpu->A = result;
+	SET_FLAGS(cpu, add_flags[0][(cpu->A << 8) | n]);
+	cpu->A += n;
 	clock_consume(7);
 }
 
 void ADD_A_cHL(struct z80 *cpu)
 {
 	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
-	int16_t result = cpu->A + b;
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) + (b & 0x0F) > 0x0F);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 0;
-	cpu->flags.C = result >> 8;
-	cpu->A = result;
+	SET_FLAGS(cpu, add_flags[0][(cpu->A << 8) | b]);
+	cpu->A += b;
 	clock_consume(7);
 }
 
@@ -705,55 +758,34 @@ void ADD_A_cIXYpd(struct z80 *cpu, uint16_t *reg)
 	int8_t d = memory_readb(cpu->bus_id, cpu->PC++);
 	uint16_t address = *reg + d;
 	uint8_t b = memory_readb(cpu->bus_id, address);
-	int16_t result = cpu->A + b;
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) + (b & 0x0F) > 0x0F);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 0;
-	cpu->flags.C = result >> 8;
-	cpu->A = result;
+	SET_FLAGS(cpu, add_flags[0][(cpu->A << 8) | b]);
+	cpu->A += b;
 	clock_consume(19);
 }
 
 void ADC_A_r(struct z80 *cpu, uint8_t *r)
 {
-	int16_t result = cpu->A + *r + cpu->flags.C;
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) + (*r & 0x0F) + cpu->flags.C > 0x0F);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 0;
-	cpu->flags.C = result >> 8;
-	cpu->A = result;
+	int carry = cpu->flags.C;
+	SET_FLAGS(cpu, add_flags[carry][(cpu->A << 8) | *r]);
+	cpu->A += *r + carry;
 	clock_consume(4);
 }
 
 void ADC_A_n(struct z80 *cpu)
 {
 	uint8_t n = memory_readb(cpu->bus_id, cpu->PC++);
-	int16_t result = cpu->A + n + cpu->flags.C;
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) + (n & 0x0F) + cpu->flags.C > 0x0F);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 0;
-	cpu->flags.C = result >> 8;
-	cpu->A = result;
+	int carry = cpu->flags.C;
+	SET_FLAGS(cpu, add_flags[carry][(cpu->A << 8) | n]);
+	cpu->A += n + carry;
 	clock_consume(7);
 }
 
 void ADC_A_cHL(struct z80 *cpu)
 {
 	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
-	int16_t result = cpu->A + b + cpu->flags.C;
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) + (b & 0x0F) + cpu->flags.C > 0x0F);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 0;
-	cpu->flags.C = result >> 8;
-	cpu->A = result;
+	int carry = cpu->flags.C;
+	SET_FLAGS(cpu, add_flags[carry][(cpu->A << 8) | b]);
+	cpu->A += b + carry;
 	clock_consume(7);
 }
 
@@ -762,55 +794,32 @@ void ADC_A_cIXYpd(struct z80 *cpu, uint16_t *reg)
 	int8_t d = memory_readb(cpu->bus_id, cpu->PC++);
 	uint16_t address = *reg + d;
 	uint8_t b = memory_readb(cpu->bus_id, address);
-	int16_t result = cpu->A + b + cpu->flags.C;
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) + (b & 0x0F) + cpu->flags.C > 0x0F);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 0;
-	cpu->flags.C = result >> 8;
-	cpu->A = result;
+	int carry = cpu->flags.C;
+	SET_FLAGS(cpu, add_flags[carry][(cpu->A << 8) | b]);
+	cpu->A += b + carry;
 	clock_consume(19);
 }
 
 void SUB_A_r(struct z80 *cpu, uint8_t *r)
 {
-	int16_t result = cpu->A - *r;
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) - (*r & 0x0F) < 0);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 1;
-	cpu->flags.C = result >> 8;
-	cpu->A = result;
+	SET_FLAGS(cpu, sub_flags[0][(cpu->A << 8) | *r]);
+	cpu->A -= *r;
 	clock_consume(4);
 }
 
 void SUB_A_n(struct z80 *cpu)
 {
 	uint8_t n = memory_readb(cpu->bus_id, cpu->PC++);
-	int16_t result = cpu->A - n;
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) - (n & 0x0F) < 0);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 1;
-	cpu->flags.C = result >> 8;
-	cpu->A = result;
+	SET_FLAGS(cpu, sub_flags[0][(cpu->A << 8) | n]);
+	cpu->A -= n;
 	clock_consume(7);
 }
 
 void SUB_A_cHL(struct z80 *cpu)
 {
 	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
-	int16_t result = cpu->A - memory_readb(cpu->bus_id, cpu->HL);
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) - (b & 0x0F) < 0);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 1;
-	cpu->flags.C = result >> 8;
-	cpu->A = result;
+	SET_FLAGS(cpu, sub_flags[0][(cpu->A << 8) | b]);
+	cpu->A -= b;
 	clock_consume(7);
 }
 
@@ -819,55 +828,34 @@ void SUB_A_cIXYpd(struct z80 *cpu, uint16_t *reg)
 	int8_t d = memory_readb(cpu->bus_id, cpu->PC++);
 	uint16_t address = *reg + d;
 	uint8_t b = memory_readb(cpu->bus_id, address);
-	int16_t result = cpu->A - b;
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) - (b & 0x0F) < 0);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 1;
-	cpu->flags.C = result >> 8;
-	cpu->A = result;
+	SET_FLAGS(cpu, sub_flags[0][(cpu->A << 8) | b]);
+	cpu->A -= b;
 	clock_consume(19);
 }
 
 void SBC_A_r(struct z80 *cpu, uint8_t *r)
 {
-	int16_t result = cpu->A - *r - cpu->flags.C;
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) - (*r & 0x0F) - cpu->flags.C < 0);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 1;
-	cpu->flags.C = result >> 8;
-	cpu->A = result;
+	int carry = cpu->flags.C;
+	SET_FLAGS(cpu, sub_flags[carry][(cpu->A << 8) | *r]);
+	cpu->A -= *r + carry;
 	clock_consume(4);
 }
 
 void SBC_A_n(struct z80 *cpu)
 {
 	uint8_t n = memory_readb(cpu->bus_id, cpu->PC++);
-	int16_t result = cpu->A - n - cpu->flags.C;
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) - (n & 0x0F) - cpu->flags.C < 0);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 1;
-	cpu->flags.C = result >> 8;
-	cpu->A = result;
+	int carry = cpu->flags.C;
+	SET_FLAGS(cpu, sub_flags[carry][(cpu->A << 8) | n]);
+	cpu->A -= n + carry;
 	clock_consume(7);
 }
 
 void SBC_A_cHL(struct z80 *cpu)
 {
 	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
-	int16_t result = cpu->A - b - cpu->flags.C;
-	cpu->flags.S = (result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) - b - cpu->flags.C < 0);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 1;
-	cpu->flags.C = result >> 8;
-	cpu->A = result;
+	int carry = cpu->flags.C;
+	SET_FLAGS(cpu, sub_flags[carry][(cpu->A << 8) | b]);
+	cpu->A -= b + carry;
 	clock_consume(7);
 }
 
@@ -876,199 +864,128 @@ void SBC_A_cIXYpd(struct z80 *cpu, uint16_t *reg)
 	int8_t d = memory_readb(cpu->bus_id, cpu->PC++);
 	uint16_t address = *reg + d;
 	uint8_t b = memory_readb(cpu->bus_id, address);
-	int16_t result = cpu->A - b - cpu->flags.C;
-	cpu->flags.S = (result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) - b - cpu->flags.C < 0);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 1;
-	cpu->flags.C = result >> 8;
-	cpu->A = result;
+	int carry = cpu->flags.C;
+	SET_FLAGS(cpu, sub_flags[carry][(cpu->A << 8) | b]);
+	cpu->A -= b + carry;
 	clock_consume(19);
 }
 
 void AND_r(struct z80 *cpu, uint8_t *r)
 {
 	cpu->A &= *r;
-	cpu->flags.S = ((int8_t)cpu->A < 0);
-	cpu->flags.Z = (cpu->A == 0);
-	cpu->flags.H = 1;
-	cpu->flags.PV = !bitops_parity(cpu->A);
-	cpu->flags.N = 0;
-	cpu->flags.C = 0;
+	SET_FLAGS(cpu, szp_flags[cpu->A] | FLAG_H);
 	clock_consume(4);
 }
 
 void AND_n(struct z80 *cpu)
 {
-	cpu->A &= memory_readb(cpu->bus_id, cpu->PC++);
-	cpu->flags.S = ((int8_t)cpu->A < 0);
-	cpu->flags.Z = (cpu->A == 0);
-	cpu->flags.H = 1;
-	cpu->flags.PV = !bitops_parity(cpu->A);
-	cpu->flags.N = 0;
-	cpu->flags.C = 0;
+	uint8_t n = memory_readb(cpu->bus_id, cpu->PC++);
+	cpu->A &= n;
+	SET_FLAGS(cpu, szp_flags[cpu->A] | FLAG_H);
 	clock_consume(7);
 }
 
 void AND_cHL(struct z80 *cpu)
 {
-	cpu->A &= memory_readb(cpu->bus_id, cpu->HL);
-	cpu->flags.S = ((int8_t)cpu->A < 0);
-	cpu->flags.Z = (cpu->A == 0);
-	cpu->flags.H = 1;
-	cpu->flags.PV = !bitops_parity(cpu->A);
-	cpu->flags.N = 0;
-	cpu->flags.C = 0;
+	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
+	cpu->A &= b;
+	SET_FLAGS(cpu, szp_flags[cpu->A] | FLAG_H);
 	clock_consume(7);
 }
 
 void AND_cIXYpd(struct z80 *cpu, uint16_t *reg)
 {
 	int8_t d = memory_readb(cpu->bus_id, cpu->PC++);
-	cpu->A &= memory_readb(cpu->bus_id, *reg + d);
-	cpu->flags.S = ((int8_t)cpu->A < 0);
-	cpu->flags.Z = (cpu->A == 0);
-	cpu->flags.H = 1;
-	cpu->flags.PV = !bitops_parity(cpu->A);
-	cpu->flags.N = 0;
-	cpu->flags.C = 0;
+	uint16_t address = *reg + d;
+	uint8_t b = memory_readb(cpu->bus_id, address);
+	cpu->A &= b;
+	SET_FLAGS(cpu, szp_flags[cpu->A] | FLAG_H);
 	clock_consume(19);
 }
 
 void OR_r(struct z80 *cpu, uint8_t *r)
 {
 	cpu->A |= *r;
-	cpu->flags.S = ((int8_t)cpu->A < 0);
-	cpu->flags.Z = (cpu->A == 0);
-	cpu->flags.H = 0;
-	cpu->flags.PV = !bitops_parity(cpu->A);
-	cpu->flags.N = 0;
-	cpu->flags.C = 0;
+	SET_FLAGS(cpu, szp_flags[cpu->A]);
 	clock_consume(4);
 }
 
 void OR_n(struct z80 *cpu)
 {
-	cpu->A |= memory_readb(cpu->bus_id, cpu->PC++);
-	cpu->flags.S = ((int8_t)cpu->A < 0);
-	cpu->flags.Z = (cpu->A == 0);
-	cpu->flags.H = 0;
-	cpu->flags.PV = !bitops_parity(cpu->A);
-	cpu->flags.N = 0;
-	cpu->flags.C = 0;
+	uint8_t n = memory_readb(cpu->bus_id, cpu->PC++);
+	cpu->A |= n;
+	SET_FLAGS(cpu, szp_flags[cpu->A]);
 	clock_consume(7);
 }
 
 void OR_cHL(struct z80 *cpu)
 {
-	cpu->A |= memory_readb(cpu->bus_id, cpu->HL);
-	cpu->flags.S = ((int8_t)cpu->A < 0);
-	cpu->flags.Z = (cpu->A == 0);
-	cpu->flags.H = 0;
-	cpu->flags.PV = !bitops_parity(cpu->A);
-	cpu->flags.N = 0;
-	cpu->flags.C = 0;
+	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
+	cpu->A |= b;
+	SET_FLAGS(cpu, szp_flags[cpu->A]);
 	clock_consume(7);
 }
 
 void OR_cIXYpd(struct z80 *cpu, uint16_t *reg)
 {
 	int8_t d = memory_readb(cpu->bus_id, cpu->PC++);
-	cpu->A |= memory_readb(cpu->bus_id, *reg + d);
-	cpu->flags.S = ((int8_t)cpu->A < 0);
-	cpu->flags.Z = (cpu->A == 0);
-	cpu->flags.H = 0;
-	cpu->flags.PV = !bitops_parity(cpu->A);
-	cpu->flags.N = 0;
-	cpu->flags.C = 0;
+	uint16_t address = *reg + d;
+	uint8_t b = memory_readb(cpu->bus_id, address);
+	cpu->A |= b;
+	SET_FLAGS(cpu, szp_flags[cpu->A]);
 	clock_consume(19);
 }
 
 void XOR_r(struct z80 *cpu, uint8_t *r)
 {
 	cpu->A ^= *r;
-	cpu->flags.S = ((int8_t)cpu->A < 0);
-	cpu->flags.Z = (cpu->A == 0);
-	cpu->flags.H = 0;
-	cpu->flags.PV = !bitops_parity(cpu->A);
-	cpu->flags.N = 0;
-	cpu->flags.C = 0;
+	SET_FLAGS(cpu, szp_flags[cpu->A]);
 	clock_consume(4);
 }
 
 void XOR_n(struct z80 *cpu)
 {
-	cpu->A ^= memory_readb(cpu->bus_id, cpu->PC++);
-	cpu->flags.S = ((int8_t)cpu->A < 0);
-	cpu->flags.Z = (cpu->A == 0);
-	cpu->flags.H = 0;
-	cpu->flags.PV = !bitops_parity(cpu->A);
-	cpu->flags.N = 0;
-	cpu->flags.C = 0;
+	uint8_t n = memory_readb(cpu->bus_id, cpu->PC++);
+	cpu->A ^= n;
+	SET_FLAGS(cpu, szp_flags[cpu->A]);
 	clock_consume(7);
 }
 
 void XOR_cHL(struct z80 *cpu)
 {
-	cpu->A ^= memory_readb(cpu->bus_id, cpu->HL);
-	cpu->flags.S = ((int8_t)cpu->A < 0);
-	cpu->flags.Z = (cpu->A == 0);
-	cpu->flags.H = 0;
-	cpu->flags.PV = !bitops_parity(cpu->A);
-	cpu->flags.N = 0;
-	cpu->flags.C = 0;
+	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
+	cpu->A ^= b;
+	SET_FLAGS(cpu, szp_flags[cpu->A]);
 	clock_consume(7);
 }
 
 void XOR_cIXYpd(struct z80 *cpu, uint16_t *reg)
 {
 	int8_t d = memory_readb(cpu->bus_id, cpu->PC++);
-	cpu->A ^= memory_readb(cpu->bus_id,  *reg + d);
-	cpu->flags.S = ((int8_t)cpu->A < 0);
-	cpu->flags.Z = (cpu->A == 0);
-	cpu->flags.H = 0;
-	cpu->flags.PV = !bitops_parity(cpu->A);
-	cpu->flags.N = 0;
-	cpu->flags.C = 0;
+	uint16_t address = *reg + d;
+	uint8_t b = memory_readb(cpu->bus_id, address);
+	cpu->A ^= b;
+	SET_FLAGS(cpu, szp_flags[cpu->A]);
 	clock_consume(19);
 }
 
 void CP_r(struct z80 *cpu, uint8_t *r)
 {
-	int16_t result = cpu->A - *r;
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) - (*r & 0x0F) < 0);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 1;
-	cpu->flags.C = result >> 8;
+	SET_FLAGS(cpu, sub_flags[0][(cpu->A << 8) | *r]);
 	clock_consume(4);
 }
 
 void CP_n(struct z80 *cpu)
 {
 	uint8_t n = memory_readb(cpu->bus_id, cpu->PC++);
-	int16_t result = cpu->A - n;
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) - (n & 0x0F) < 0);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 1;
-	cpu->flags.C = result >> 8;
+	SET_FLAGS(cpu, sub_flags[0][(cpu->A << 8) | n]);
 	clock_consume(7);
 }
 
 void CP_cHL(struct z80 *cpu)
 {
 	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
-	int16_t result = cpu->A - b;
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) - (b & 0x0F) < 0);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 1;
-	cpu->flags.C = result >> 8;
+	SET_FLAGS(cpu, sub_flags[0][(cpu->A << 8) | b]);
 	clock_consume(7);
 }
 
@@ -1077,23 +994,13 @@ void CP_IXYpd(struct z80 *cpu, uint16_t *reg)
 	int8_t d = memory_readb(cpu->bus_id, cpu->PC++);
 	uint16_t address = *reg + d;
 	uint8_t b = memory_readb(cpu->bus_id, address);
-	int16_t result = cpu->A - b;
-	cpu->flags.S = ((int8_t)result < 0);
-	cpu->flags.Z = ((uint8_t)result == 0);
-	cpu->flags.H = ((cpu->A & 0x0F) - (b & 0x0F) < 0);
-	cpu->flags.PV = ((uint16_t)result > 0xFF);
-	cpu->flags.N = 1;
-	cpu->flags.C = result >> 8;
+	SET_FLAGS(cpu, sub_flags[0][(cpu->A << 8) | b]);
 	clock_consume(19);
 }
 
 void INC_r(struct z80 *cpu, uint8_t *r)
 {
-	cpu->flags.S = ((int8_t)(*r + 1) < 0);
-	cpu->flags.Z = (*r == 0xFF);
-	cpu->flags.H = ((*r & 0x0F) == 0x0F);
-	cpu->flags.PV = (*r == 0x7F);
-	cpu->flags.N = 0;
+	SET_FLAGS_KEEP_C(cpu, inc_flags[*r]);
 	(*r)++;
 	clock_consume(4);
 }
@@ -1101,11 +1008,7 @@ void INC_r(struct z80 *cpu, uint8_t *r)
 void INC_cHL(struct z80 *cpu)
 {
 	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
-	cpu->flags.S = ((int8_t)(b + 1) < 0);
-	cpu->flags.Z = (b == 0xFF);
-	cpu->flags.H = ((b & 0x0F) == 0x0F);
-	cpu->flags.PV = (b == 0x7F);
-	cpu->flags.N = 0;
+	SET_FLAGS_KEEP_C(cpu, inc_flags[b]);
 	memory_writeb(cpu->bus_id, b + 1, cpu->HL);
 	clock_consume(11);
 }
@@ -1115,11 +1018,7 @@ void INC_cIXYpd(struct z80 *cpu, uint16_t *reg)
 	int8_t d = memory_readb(cpu->bus_id, cpu->PC++);
 	uint16_t address = *reg + d;
 	uint8_t b = memory_readb(cpu->bus_id, address);
-	cpu->flags.S = ((int8_t)(b + 1) < 0);
-	cpu->flags.Z = (b == 0xFF);
-	cpu->flags.H = ((b & 0x0F) == 0x0F);
-	cpu->flags.PV = (b == 0x7F);
-	cpu->flags.N = 0;
+	SET_FLAGS_KEEP_C(cpu, inc_flags[b]);
 	memory_writeb(cpu->bus_id, b + 1, address);
 	clock_consume(23);
 }
@@ -1127,23 +1026,16 @@ void INC_cIXYpd(struct z80 *cpu, uint16_t *reg)
 void DEC_r(struct z80 *cpu, uint8_t *r)
 {
 	(*r)--;
-	cpu->flags.S = ((int8_t)*r < 0);
-	cpu->flags.Z = (*r == 0);
-	cpu->flags.H = ((*r & 0x0F) == 0x0F);
-	cpu->flags.PV = (*r == 0x7F);
-	cpu->flags.N = 1;
+	SET_FLAGS_KEEP_C(cpu, dec_flags[*r]);
 	clock_consume(4);
 }
 
 void DEC_cHL(struct z80 *cpu)
 {
-	int8_t result = memory_readb(cpu->bus_id, cpu->HL) - 1;
-	memory_writeb(cpu->bus_id, result, cpu->HL);
-	cpu->flags.S = (result < 0);
-	cpu->flags.Z = (result == 0);
-	cpu->flags.H = ((result & 0x0F) == 0x0F);
-	cpu->flags.PV = (result == 0x7F);
-	cpu->flags.N = 1;
+	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
+	b--;
+	memory_writeb(cpu->bus_id, b, cpu->HL);
+	SET_FLAGS_KEEP_C(cpu, dec_flags[b]);
 	clock_consume(11);
 }
 
@@ -1152,13 +1044,9 @@ void DEC_cIXYpd(struct z80 *cpu, uint16_t *reg)
 	int8_t d = memory_readb(cpu->bus_id, cpu->PC++);
 	uint16_t address = *reg + d;
 	uint8_t b = memory_readb(cpu->bus_id, address);
-	int8_t result = b - 1;
-	memory_writeb(cpu->bus_id, result, address);
-	cpu->flags.S = (result < 0);
-	cpu->flags.Z = (result == 0);
-	cpu->flags.H = ((b & 0x0F) - 1 == 0x0F);
-	cpu->flags.PV = (b == 0x80);
-	cpu->flags.N = 0;
+	b--;
+	memory_writeb(cpu->bus_id, b, address);
+	SET_FLAGS_KEEP_C(cpu, dec_flags[b]);
 	clock_consume(23);
 }
 
@@ -1239,6 +1127,7 @@ void HALT(struct z80 *cpu)
 {
 	cpu->halted = true;
 	cpu->PC--;
+	z80_update_interrupts(cpu);
 	clock_consume(4);
 }
 
@@ -1246,6 +1135,7 @@ void DI(struct z80 *cpu)
 {
 	cpu->IFF1 = false;
 	cpu->IFF2 = false;
+	z80_update_interrupts(cpu);
 	clock_consume(4);
 }
 
@@ -1254,6 +1144,7 @@ void EI(struct z80 *cpu)
 	cpu->IFF1 = true;
 	cpu->IFF2 = true;
 	cpu->irq_delay = true;
+	z80_update_interrupts(cpu);
 	clock_consume(4);
 }
 
@@ -1728,11 +1619,7 @@ void RLD(struct z80 *cpu)
 	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
 	memory_writeb(cpu->bus_id, (b << 4) | (cpu->A & 0x0F), cpu->HL);
 	cpu->A = (cpu->A & 0xF0) | (b >> 4);
-	cpu->flags.S = ((int8_t)cpu->A < 0);
-	cpu->flags.Z = (cpu->A == 0);
-	cpu->flags.H = 0;
-	cpu->flags.PV = !bitops_parity(cpu->A);
-	cpu->flags.N = 0;
+	SET_FLAGS_KEEP_C(cpu, szp_flags[cpu->A]);
 	clock_consume(18);
 }
 
@@ -1741,11 +1628,7 @@ void RRD(struct z80 *cpu)
 	uint8_t b = memory_readb(cpu->bus_id, cpu->HL);
 	memory_writeb(cpu->bus_id, (b >> 4) | ((cpu->A & 0x0F) << 4), cpu->HL);
 	cpu->A = (cpu->A & 0xF0) | (b & 0x0F);
-	cpu->flags.S = ((int8_t)cpu->A < 0);
-	cpu->flags.Z = (cpu->A == 0);
-	cpu->flags.H = 0;
-	cpu->flags.PV = !bitops_parity(cpu->A);
-	cpu->flags.N = 0;
+	SET_FLAGS_KEEP_C(cpu, szp_flags[cpu->A]);
 	clock_consume(18);
 }
 
@@ -1827,17 +1710,23 @@ void JP_nn(struct z80 *cpu)
 {
 	uint8_t n1 = memory_readb(cpu->bus_id, cpu->PC++);
 	uint8_t n2 = memory_readb(cpu->bus_id, cpu->PC++);
+	bool backward = ((n1 | (n2 << 8)) < cpu->PC);
 	cpu->PC = n1 | (n2 << 8);
 	clock_consume(10);
+	if (backward)
+		z80_check_idle(cpu);
 }
 
 void JP_cc_nn(struct z80 *cpu, bool condition)
 {
 	uint8_t n1 = memory_readb(cpu->bus_id, cpu->PC++);
 	uint8_t n2 = memory_readb(cpu->bus_id, cpu->PC++);
+	bool backward = ((n1 | (n2 << 8)) < cpu->PC);
 	if (condition)
 		cpu->PC = n1 | (n2 << 8);
 	clock_consume(10);
+	if (condition && backward)
+		z80_check_idle(cpu);
 }
 
 void JR_e(struct z80 *cpu)
@@ -1845,6 +1734,8 @@ void JR_e(struct z80 *cpu)
 	int8_t e = memory_readb(cpu->bus_id, cpu->PC++);
 	cpu->PC += e;
 	clock_consume(12);
+	if (e < 0)
+		z80_check_idle(cpu);
 }
 
 void JR_cc_e(struct z80 *cpu, bool condition)
@@ -1855,6 +1746,8 @@ void JR_cc_e(struct z80 *cpu, bool condition)
 		clock_consume(5);
 	}
 	clock_consume(7);
+	if (condition && (d < 0))
+		z80_check_idle(cpu);
 }
 
 void JP_HL(struct z80 *cpu)
@@ -1924,6 +1817,7 @@ void RETI(struct z80 *cpu)
 	cpu->PC = memory_readb(cpu->bus_id, cpu->SP++);
 	cpu->PC |= memory_readb(cpu->bus_id, cpu->SP++) << 8;
 	cpu->IFF1 = cpu->IFF2;
+	z80_update_interrupts(cpu);
 	clock_consume(14);
 }
 
@@ -1932,6 +1826,7 @@ void RETN(struct z80 *cpu)
 	cpu->PC = memory_readb(cpu->bus_id, cpu->SP++);
 	cpu->PC |= memory_readb(cpu->bus_id, cpu->SP++) << 8;
 	cpu->IFF1 = cpu->IFF2;
+	z80_update_interrupts(cpu);
 	clock_consume(14);
 }
 
@@ -1973,15 +1868,15 @@ void INI(struct z80 *cpu)
 
 void INIR(struct z80 *cpu)
 {
-	uint8_t b = port_read(cpu->C);
-	memory_writeb(cpu->bus_id, b, cpu->HL++);
-	if (--cpu->B != 0) {
-		cpu->PC -= 2;
-		clock_consume(5);
-	}
-	cpu->flags.Z = (cpu->B == 0);
-	cpu->flags.N = 1;
-	clock_consume(16);
+	uint8_t b;
+	do {
+		b = port_read(cpu->C);
+		memory_writeb(cpu->bus_id, b, cpu->HL++);
+		cpu->B--;
+		cpu->flags.Z = (cpu->B == 0);
+		cpu->flags.N = 1;
+		clock_consume(16);
+	} while ((cpu->B != 0) && z80_repeat(cpu, 0xB2));
 }
 
 void IND(struct z80 *cpu)
@@ -1996,15 +1891,15 @@ void IND(struct z80 *cpu)
 
 void INDR(struct z80 *cpu)
 {
-	uint8_t b = port_read(cpu->C);
-	memory_writeb(cpu->bus_id, b, cpu->HL--);
-	if (--cpu->B != 0) {
-		cpu->PC -= 2;
-		clock_consume(5);
-	}
-	cpu->flags.Z = (cpu->B == 0);
-	cpu->flags.N = 1;
-	clock_consume(16);
+	uint8_t b;
+	do {
+		b = port_read(cpu->C);
+		memory_writeb(cpu->bus_id, b, cpu->HL--);
+		cpu->B--;
+		cpu->flags.Z = (cpu->B == 0);
+		cpu->flags.N = 1;
+		clock_consume(16);
+	} while ((cpu->B != 0) && z80_repeat(cpu, 0xBA));
 }
 
 void OUT_cn_A(struct z80 *cpu)
@@ -2032,15 +1927,16 @@ void OUTI(struct z80 *cpu)
 
 void OTIR(struct z80 *cpu)
 {
-	uint8_t b = memory_readb(cpu->bus_id, cpu->HL++);
-	port_write(b, cpu->C);
-	if (--cpu->B != 0) {
-		cpu->PC -= 2;
-		clock_consume(5);
-	}
-	cpu->flags.Z = (cpu->B == 0);
-	cpu->flags.N = 1;
-	clock_consume(16);
+	uint8_t b;
+	do {
+		z80_output_bulk(cpu);
+		b = memory_readb(cpu->bus_id, cpu->HL++);
+		port_write(b, cpu->C);
+		cpu->B--;
+		cpu->flags.Z = (cpu->B == 0);
+		cpu->flags.N = 1;
+		clock_consume(16);
+	} while ((cpu->B != 0) && z80_repeat(cpu, 0xB3));
 }
 
 void OUTD(struct z80 *cpu)
@@ -2055,15 +1951,15 @@ void OUTD(struct z80 *cpu)
 
 void OTDR(struct z80 *cpu)
 {
-	uint8_t b = memory_readb(cpu->bus_id, cpu->HL--);
-	port_write(b, cpu->C);
-	if (--cpu->B != 0) {
-		cpu->PC -= 2;
-		clock_consume(5);
-	}
-	cpu->flags.Z = (cpu->B == 0);
-	cpu->flags.N = 1;
-	clock_consume(16);
+	uint8_t b;
+	do {
+		b = memory_readb(cpu->bus_id, cpu->HL--);
+		port_write(b, cpu->C);
+		cpu->B--;
+		cpu->flags.Z = (cpu->B == 0);
+		cpu->flags.N = 1;
+		clock_consume(16);
+	} while ((cpu->B != 0) && z80_repeat(cpu, 0xBB));
 }
 
 bool z80_handle_irq(struct z80 *cpu)
@@ -2071,6 +1967,7 @@ bool z80_handle_irq(struct z80 *cpu)
 	/* Reset IRQ delay and exit if needed */
 	if (cpu->irq_delay) {
 		cpu->irq_delay = false;
+		z80_update_interrupts(cpu);
 		return false;
 	}
 
@@ -2082,6 +1979,7 @@ bool z80_handle_irq(struct z80 *cpu)
 	if (cpu->halted) {
 		cpu->PC++;
 		cpu->halted = false;
+		z80_update_interrupts(cpu);
 	}
 
 	/* Check if interrupts are enabled */
@@ -2104,6 +2002,7 @@ bool z80_handle_irq(struct z80 *cpu)
 
 	/* Reset IRQ pending flag */
 	cpu->irq_pending = false;
+	z80_update_interrupts(cpu);
 	return true;
 }
 
@@ -2113,6 +2012,12 @@ bool z80_handle_nmi(struct z80 *cpu)
 	if (!cpu->nmi_pending)
 		return false;
 
+	/* Any interrupt should resume CPU */
+	if (cpu->halted) {
+		cpu->PC++;
+		cpu->halted = false;
+	}
+
 	/* Push PC on stack */
 	memory_writeb(cpu->bus_id, cpu->PC >> 8, --cpu->SP);
 	memory_writeb(cpu->bus_id, cpu->PC, --cpu->SP);
@@ -2125,17 +2030,113 @@ bool z80_handle_nmi(struct z80 *cpu)
 
 	/* Reset NMI pending flag */
 	cpu->nmi_pending = false;
+	z80_update_interrupts(cpu);
 	return true;
 }
 
+void z80_update_interrupts(struct z80 *cpu)
+{
+	/* Interrupt logic only needs to run if an NMI is pending, IRQ delay has
+	to be reset, or an IRQ would either resume CPU or be serviced */
+	cpu->int_check = cpu->nmi_pending || cpu->irq_delay ||
+		(cpu->irq_pending && (cpu->IFF1 || cpu->halted));
+}
+
+void z80_check_idle(struct z80 *cpu)
+{
+	struct z80_idle *idle = &cpu->idle;
+	uint64_t num_instructions;
+	uint64_t num_periods;
+
+	/* Skip iterations if loop head state is repeated without any bus write
+	or side-effecting read since last visit (which makes the loop unable to
+	exit before another clock ticks) */
+	if (idle->valid &&
+		(idle->PC == cpu->PC) &&
+		(idle->AF == cpu->AF) &&
+		(idle->A2F2 == cpu->A2F2) &&
+		(idle->BC == cpu->BC) &&
+		(idle->B2C2 == cpu->B2C2) &&
+		(idle->DE == cpu->DE) &&
+		(idle->D2E2 == cpu->D2E2) &&
+		(idle->HL == cpu->HL) &&
+		(idle->H2L2 == cpu->H2L2) &&
+		(idle->IX == cpu->IX) &&
+		(idle->IY == cpu->IY) &&
+		(idle->SP == cpu->SP) &&
+		(idle->I == cpu->I) &&
+		(idle->R == cpu->R) &&
+		(idle->IFF1 == cpu->IFF1) &&
+		(idle->IFF2 == cpu->IFF2) &&
+		(idle->irq_delay == cpu->irq_delay) &&
+		(idle->irq_pending == cpu->irq_pending) &&
+		(idle->nmi_pending == cpu->nmi_pending) &&
+		(idle->num_updates == memory_num_updates)) {
+		num_instructions = cpu->instance->num_instructions -
+			idle->num_instructions;
+		num_periods = clock_skip_idle(cpu->clock.next_cycle -
+			idle->cycle);
+		cpu->instance->num_instructions += num_periods *
+			num_instructions;
+	}
+
+	/* Save loop head state */
+	idle->valid = true;
+	idle->PC = cpu->PC;
+	idle->AF = cpu->AF;
+	idle->A2F2 = cpu->A2F2;
+	idle->BC = cpu->BC;
+	idle->B2C2 = cpu->B2C2;
+	idle->DE = cpu->DE;
+	idle->D2E2 = cpu->D2E2;
+	idle->HL = cpu->HL;
+	idle->H2L2 = cpu->H2L2;
+	idle->IX = cpu->IX;
+	idle->IY = cpu->IY;
+	idle->SP = cpu->SP;
+	idle->I = cpu->I;
+	idle->R = cpu->R;
+	idle->IFF1 = cpu->IFF1;
+	idle->IFF2 = cpu->IFF2;
+	idle->irq_delay = cpu->irq_delay;
+	idle->irq_pending = cpu->irq_pending;
+	idle->nmi_pending = cpu->nmi_pending;
+	idle->cycle = cpu->clock.next_cycle;
+	idle->num_instructions = cpu->instance->num_instructions;
+	idle->num_updates = memory_num_updates;
+}
+
 void z80_tick(struct z80 *cpu)
+{
+	/* Execute instructions until next device deadline (forgetting idle
+	state as other clocks might have ticked since last run) */
+	TRACE_BEGIN("z80");
+	cpu->idle.valid = false;
+	do
+		z80_step(cpu);
+	while (clock_run_ahead());
+	TRACE_END("z80");
+}
+
+void z80_step(struct z80 *cpu)
 {
 	uint8_t opcode;
 
-	/* Check for interrupt requests (IRQ or NMI) */
-	if (z80_handle_irq(cpu) || z80_handle_nmi(cpu))
+	/* Check for interrupt requests (IRQ or NMI) when one might be acted
+	upon */
+	if (cpu->int_check && (z80_handle_irq(cpu) || z80_handle_nmi(cpu)))
 		return;
 
+	/* Repeat HALT until another clock (and potential interrupt source) is
+	due, accounting for each repetition as an executed instruction */
+	if (cpu->halted) {
+		cpu->instance->num_instructions += clock_consume_idle(4);
+		return;
+	}
+
+	/* Count retired instruction */
+	cpu->instance->num_instructions++;
+
 	/* Fetch opcode */
 	opcode = memory_readb(cpu->bus_id, cpu->PC++);
 
@@ -4156,6 +4157,263 @@ void z80_opcode_ED(struct z80 *cpu)
 	}
 }
 
+bool z80_repeat(struct z80 *cpu, uint8_t opcode)
+{
+	/* Rewind PC so that instruction gets executed again */
+	cpu->PC -= 2;
+	clock_consume(5);
+
+	/* Leave next iteration to interpreter if an interrupt has to be checked
+	or if instruction got overwritten */
+	if (cpu->int_check ||
+		(memory_readb(cpu->bus_id, cpu->PC) != 0xED) ||
+		(memory_readb(cpu->bus_id, cpu->PC + 1) != opcode))
+		return false;
+
+	/* Run next iteration in place as long as run-ahead goes on */
+	if (!clock_run_ahead())
+		return false;
+	cpu->instance->num_instructions++;
+	cpu->PC += 2;
+	return true;
+}
+
+int z80_get_num_repeats(struct z80 *cpu, int max)
+{
+	uint64_t cycles = REPEAT_CYCLES * cpu->clock.div;
+	uint64_t limit;
+	uint64_t num;
+
+	/* Leave pending interrupts to interpreter */
+	if (cpu->int_check)
+		return 0;
+
+	/* Count iterations ending before run-ahead limit (each one would have
+	been followed by a successful clock_run_ahead call) */
+	limit = clock_get_run_ahead_limit();
+	if (limit <= cpu->clock.next_cycle)
+		return 0;
+	num = (limit - 1 - cpu->clock.next_cycle) / cycles;
+	return (num < (uint64_t)max) ? (int)num : max;
+}
+
+void z80_skip_repeats(struct z80 *cpu, int num_repeats)
+{
+	/* Account for iterations as if each was executed on its own */
+	clock_consume(num_repeats * REPEAT_CYCLES);
+	current_cycle = cpu->clock.next_cycle;
+	cpu->instance->num_instructions += num_repeats;
+}
+
+bool z80_is_code(struct z80 *cpu, uint8_t *start, uint8_t *end)
+{
+	struct page *page;
+	uint8_t *mem;
+	int i;
+
+	/* Check if host range holds any byte of current instruction */
+	for (i = 2; i > 0; i--) {
+		page = memory_get_page(cpu->bus_id, (uint16_t)(cpu->PC - i));
+		if (!page || !page->readb.mem)
+			continue;
+		mem = page->readb.mem + ((uint16_t)(cpu->PC - i) & MEM_PAGE_MASK);
+		if ((mem >= start) && (mem < end))
+			return true;
+	}
+	return false;
+}
+
+void z80_copy_bulk(struct z80 *cpu, int step)
+{
+	struct page *src_page;
+	struct page *dst_page;
+	uint8_t *src;
+	uint8_t *dst;
+	int room;
+	int num;
+	int i;
+
+	/* Get number of repeating iterations which can run uninterrupted */
+	num = z80_get_num_repeats(cpu, (uint16_t)(cpu->BC - 1));
+
+	/* Stay within source and destination pages */
+	room = (step > 0) ? MEM_PAGE_SIZE - (cpu->HL & MEM_PAGE_MASK) :
+		(cpu->HL & MEM_PAGE_MASK) + 1;
+	if (num > room)
+		num = room;
+	room = (step > 0) ? MEM_PAGE_SIZE - (cpu->DE & MEM_PAGE_MASK) :
+		(cpu->DE & MEM_PAGE_MASK) + 1;
+	if (num > room)
+		num = room;
+	if (num == 0)
+		return;
+
+	/* Only copy plain memory in bulk */
+	src_page = memory_get_page(cpu->bus_id, cpu->HL);
+	dst_page = memory_get_page(cpu->bus_id, cpu->DE);
+	if (!src_page || !src_page->readb.mem ||
+		!dst_page || !dst_page->writeb.mem)
+		return;
+	src = src_page->readb.mem + (cpu->HL & MEM_PAGE_MASK);
+	dst = dst_page->writeb.mem + (cpu->DE & MEM_PAGE_MASK);
+
+	/* Leave copies overwriting instruction to interpreter */
+	if (z80_is_code(cpu, (step > 0) ? dst : dst - num + 1,
+		(step > 0) ? dst + num : dst + 1))
+		return;
+
+	/* Copy bytes in order (a destination trailing source by one byte is
+	the usual way of filling memory), noting bus got written */
+	memory_num_updates++;
+	if ((step > 0) && (dst == src + 1))
+		memset(dst, *src, num);
+	else if ((step > 0) && ((dst <= src) || (dst >= src + num)))
+		memmove(dst, src, num);
+	else
+		for (i = 0; i < num; i++)
+			dst[i * step] = src[i * step];
+
+	/* Update registers and account for skipped iterations */
+	cpu->HL += num * step;
+	cpu->DE += num * step;
+	cpu->BC -= num;
+	z80_skip_repeats(cpu, num);
+}
+
+void z80_compare_bulk(struct z80 *cpu, int step)
+{
+	struct page *page;
+	uint8_t *src;
+	int room;
+	int num;
+	int i;
+
+	/* Get number of repeating iterations which can run uninterrupted */
+	num = z80_get_num_repeats(cpu, (uint16_t)(cpu->BC - 1));
+
+	/* Stay within source page */
+	room = (step > 0) ? MEM_PAGE_SIZE - (cpu->HL & MEM_PAGE_MASK) :
+		(cpu->HL & MEM_PAGE_MASK) + 1;
+	if (num > room)
+		num = room;
+	if (num == 0)
+		return;
+
+	/* Only search plain memory in bulk */
+	page = memory_get_page(cpu->bus_id, cpu->HL);
+	if (!page || !page->readb.mem)
+		return;
+	src = page->readb.mem + (cpu->HL & MEM_PAGE_MASK);
+
+	/* Skip bytes until a match (which ends the repeat) is found */
+	for (i = 0; i < num; i++)
+		if (src[i * step] == cpu->A)
+			break;
+	if (i == 0)
+		return;
+
+	/* Update registers and account for skipped iterations */
+	cpu->HL += i * step;
+	cpu->BC -= i;
+	z80_skip_repeats(cpu, i);
+}
+
+void z80_output_bulk(struct z80 *cpu)
+{
+	struct page *page;
+	uint8_t *src;
+	int room;
+	int num;
+
+	/* Get number of repeating iterations which can run uninterrupted */
+	num = z80_get_num_repeats(cpu, (uint8_t)(cpu->B - 1));
+
+	/* Stay within source page */
+	room = MEM_PAGE_SIZE - (cpu->HL & MEM_PAGE_MASK);
+	if (num > room)
+		num = room;
+	if (num == 0)
+		return;
+
+	/* Only output plain memory in bulk (if port supports it) */
+	page = memory_get_page(cpu->bus_id, cpu->HL);
+	if (!page || !page->readb.mem)
+		return;
+	src = page->readb.mem + (cpu->HL & MEM_PAGE_MASK);
+	if (!port_write_bulk(src, num, cpu->C))
+		return;
+
+	/* Update registers and account for skipped iterations */
+	cpu->HL += num;
+	cpu->B -= num;
+	z80_skip_repeats(cpu, num);
+}
+
+void z80_init_flag_tables()
+{
+	int a, b, c, r;
+	uint8_t f;
+
+	/* Tables only need to be built once */
+	if (flag_tables_ready)
+		return;
+
+	/* Compute sign, zero and parity (set when even) of each value */
+	for (a = 0; a < 256; a++) {
+		f = a & FLAG_S;
+		if (a == 0)
+			f |= FLAG_Z;
+		if (!bitops_parity(a))
+			f |= FLAG_PV;
+		szp_flags[a] = f;
+	}
+
+	/* Compute INC/DEC flags (overflow when crossing 0x7F/0x80) */
+	for (a = 0; a < 256; a++) {
+		r = (a + 1) & 0xFF;
+		f = (r & FLAG_S) | ((r == 0) ? FLAG_Z : 0);
+		if ((a & 0x0F) == 0x0F)
+			f |= FLAG_H;
+		if (a == 0x7F)
+			f |= FLAG_PV;
+		inc_flags[a] = f;
+
+		f = (a & FLAG_S) | ((a == 0) ? FLAG_Z : 0) | FLAG_N;
+		if ((a & 0x0F) == 0x0F)
+			f |= FLAG_H;
+		if (a == 0x7F)
+			f |= FLAG_PV;
+		dec_flags[a] = f;
+	}
+
+	/* Compute ADD/ADC and SUB/SBC/CP flags for every operand pair (PV
+	deliberately mirrors carry as the former ALU helpers did, instead of
+	the signed overflow computed by a real Z80: fixing this would change
+	emulation behaviour and belongs to its own change) */
+	for (c = 0; c < 2; c++)
+		for (a = 0; a < 256; a++)
+			for (b = 0; b < 256; b++) {
+				r = a + b + c;
+				f = (r & FLAG_S) | (((r & 0xFF) == 0) ? FLAG_Z : 0);
+				if ((a & 0x0F) + (b & 0x0F) + c > 0x0F)
+					f |= FLAG_H;
+				if (r > 0xFF)
+					f |= FLAG_PV | FLAG_C;
+				add_flags[c][(a << 8) | b] = f;
+
+				r = a - b - c;
+				f = (r & FLAG_S) | (((r & 0xFF) == 0) ? FLAG_Z : 0);
+				f |= FLAG_N;
+				if ((a & 0x0F) - (b & 0x0F) - c < 0)
+					f |= FLAG_H;
+				if (r < 0)
+					f |= FLAG_PV | FLAG_C;
+				sub_flags[c][(a << 8) | b] = f;
+			}
+
+	flag_tables_ready = true;
+}
+
 bool z80_init(struct cpu_instance *instance)
 {
 	struct z80 *cpu;
@@ -4164,10 +4422,14 @@ bool z80_init(struct cpu_instance *instance)
 	/* Allocate z80 structure and set private data */
 	cpu = calloc(1, sizeof(struct z80));
 	instance->priv_data = cpu;
+	cpu->instance = instance;
 
 	/* Save bus ID */
 	cpu->bus_id = instance->bus_id;
 
+	/* Build flag tables shared by all instances */
+	z80_init_flag_tables();
+
 	/* Add CPU clock */
 	res = resource_get("clk",
 		RESOURCE_CLK,
@@ -4178,6 +4440,9 @@ bool z80_init(struct cpu_instance *instance)
 	cpu->clock.tick = (clock_tick_t)z80_tick;
 	clock_add(&cpu->clock);
 
+	/* Expose CPU clock for statistics */
+	instance->clock = &cpu->clock;
+
 	return true;
 }
 
@@ -4205,6 +4470,7 @@ void z80_reset(struct cpu_instance *instance)
 	cpu->irq_pending = false;
 	cpu->nmi_pending = false;
 	cpu->halted = false;
+	z80_update_interrupts(cpu);
 
 	/* Enable clock */
 	cpu->clock.enabled = true;
@@ -4219,6 +4485,7 @@ void z80_interrupt(struct cpu_instance *instance, int irq)
 		cpu->irq_pending = true;
 	else if (irq == NMI_N)
 		cpu->nmi_pending = true;
+	z80_update_interrupts(cpu);
 }
 
 void z80_deinit(struct cpu_instance *instance)
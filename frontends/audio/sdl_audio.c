@@ -4,6 +4,7 @@
 #include <SDL.h>
 #include <audio.h>
 #include <log.h>
+#include <trace.h>
 #include <util.h>
 
 #define LATENCY_MS_MAX	100
@@ -123,6 +124,8 @@ void sdl_dequeue(struct audio_data *data, void *buffer, int len)
 	int len1 = len;
 	int len2 = 0;
 
+	TRACE_BEGIN("audio_dequeue");
+
 	/* Lock access */
 	SDL_LockAudio();
 
@@ -152,6 +155,8 @@ void sdl_dequeue(struct audio_data *data, void *buffer, int len)
 
 	/* Unlock access */
 	SDL_UnlockAudio();
+
+	TRACE_END("audio_dequeue");
 }
 
 void sdl_start(struct audio_frontend *UNUSED(fe))
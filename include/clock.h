@@ -3,30 +3,71 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <profile.h>
+
+/* Lazy clocks keep lagging behind until caught up or until a deadline */
+#define CLOCK_NO_DEADLINE UINT64_MAX
 
 typedef void clock_data_t;
 typedef void (*clock_tick_t)(clock_data_t *data);
 
 struct clock {
 	float rate;
-	float div;
-	float num_remaining_cycles;
+	uint64_t div;
+	uint64_t next_cycle;
+	uint64_t sync_cycle;
+	uint64_t num_remaining_cycles;
 	bool enabled;
+	bool watch_writes;
+	int index;
+	int heap_index;
 	clock_data_t *data;
 	clock_tick_t tick;
+#ifdef CONFIG_PROFILE
+	char *name;
+	uint64_t num_ticks;
+	uint64_t num_cycles;
+	uint64_t num_ns;
+#endif
 };
 
 void clock_add(struct clock *clock);
+void clock_enable(struct clock *clock, bool enable);
+void clock_schedule(struct clock *clock, uint64_t cycle);
+void clock_set_deadline(struct clock *clock, uint64_t cycle);
+void clock_catch_up(struct clock *clock);
+void clock_catch_up_all();
+void clock_sync();
+bool clock_run_ahead();
+uint64_t clock_get_run_ahead_limit();
+uint64_t clock_get_catch_up_cycle();
+uint64_t clock_consume_idle(int num_cycles);
+uint64_t clock_skip_idle(uint64_t period);
 void clock_reset();
 void clock_tick_all(bool handle_delay);
 void clock_remove_all();
 
+extern struct clock **clocks;
+extern int num_clocks;
 extern struct clock *current_clock;
+extern uint64_t current_cycle;
+extern uint64_t run_ahead_limit;
+extern struct clock **watchers;
+extern int num_watchers;
 
 static inline void clock_consume(int num_cycles)
 {
-	/* Increase number of remaining clock cycles by desired amount */
-	current_clock->num_remaining_cycles += num_cycles * current_clock->div;
+	/* Push next clock tick by desired amount of clock cycles */
+	current_clock->next_cycle += num_cycles * current_clock->div;
+}
+
+static inline void clock_catch_up_watchers()
+{
+	int i;
+
+	/* Catch up lazy clocks which might observe device being written */
+	for (i = 0; i < num_watchers; i++)
+		clock_catch_up(watchers[i]);
 }
 
 #endif
@@ -2,6 +2,8 @@
 #define _CPU_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <clock.h>
 #include <list.h>
 #include <util.h>
 
@@ -20,6 +22,12 @@
 		atexit(_unregister); \
 	}
 
+/* IRQ numbers select target CPU instance (in order of addition) and line */
+#define CPU_IRQ_SHIFT	8
+#define CPU_IRQ_LINE	((1 << CPU_IRQ_SHIFT) - 1)
+#define CPU_IRQ(_cpu_id, _line) \
+	(((_cpu_id) << CPU_IRQ_SHIFT) | (_line))
+
 typedef void cpu_mach_data_t;
 typedef void cpu_priv_data_t;
 
@@ -35,10 +43,13 @@ struct cpu {
 };
 
 struct cpu_instance {
+	int id;
 	char *cpu_name;
 	int bus_id;
 	struct resource *resources;
 	int num_resources;
+	struct clock *clock;
+	uint64_t num_instructions;
 	cpu_mach_data_t *mach_data;
 	cpu_priv_data_t *priv_data;
 	struct cpu *cpu;
@@ -51,6 +62,7 @@ void cpu_halt(bool halt);
 void cpu_remove_all();
 
 extern struct list_link *cpus;
+extern struct list_link *cpu_instances;
 
 #endif
 
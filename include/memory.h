@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
+#include <clock.h>
 #include <list.h>
 #include <log.h>
 #include <resource.h>
@@ -13,6 +15,12 @@
 #define MEM_SIZE(area) \
 	(area->data.mem.end - area->data.mem.start + 1)
 
+/* Page tables decode the first 64KB of each bus with 256-byte pages */
+#define MEM_PAGE_SHIFT	8
+#define MEM_PAGE_SIZE	(1 << MEM_PAGE_SHIFT)
+#define MEM_PAGE_MASK	(MEM_PAGE_SIZE - 1)
+#define MEM_NUM_PAGES	(0x10000 >> MEM_PAGE_SHIFT)
+
 #define DECLARE_MEMORY_READ_OP(ext, type) \
 	typedef type (*read##ext##_t)(region_data_t *, address_t);
 #define DECLARE_MEMORY_WRITE_OP(ext, type) \
@@ -29,6 +37,13 @@ typedef uint32_t address_t;
 typedef void region_data_t;
 typedef void dma_channel_data_t;
 
+/* Return host memory backing a page-aligned region address (or NULL) */
+typedef uint8_t *(*map_t)(region_data_t *, address_t, bool *writable);
+
+/* Return true if reading address has no side effects (its value can then
+only change when a clock ticks or the bus is written) */
+typedef bool (*stable_t)(region_data_t *, address_t);
+
 /* Declare memory read/write operation function pointers */
 DECLARE_MEMORY_READ_OP(b, uint8_t)
 DECLARE_MEMORY_READ_OP(w, uint16_t)
@@ -52,12 +67,35 @@ struct mops {
 	writeb_t writeb;
 	writew_t writew;
 	writel_t writel;
+	map_t map;
+	stable_t stable;
 };
 
 struct region {
 	struct resource *area;
 	struct mops *mops;
 	region_data_t *data;
+	struct clock *clock;
+#ifdef CONFIG_PROFILE
+	uint64_t num_calls;
+#endif
+};
+
+struct page_entry {
+	struct region *region;
+	address_t base;
+	uint8_t *mem;
+};
+
+struct page {
+	struct page_entry readb;
+	struct page_entry readw;
+	struct page_entry readl;
+	struct page_entry writeb;
+	struct page_entry writew;
+	struct page_entry writel;
+	struct region **regions;
+	int num_regions;
 };
 
 struct dma_ops {
@@ -77,127 +115,199 @@ struct dma_channel {
 
 void memory_region_add(struct region *region);
 void memory_region_remove(struct region *region);
+void memory_region_remap(struct region *region);
 void memory_region_remove_all();
 
+uint8_t memory_scan_readb(struct region **list, int num, int bus_id,
+	address_t address);
+uint16_t memory_scan_readw(struct region **list, int num, int bus_id,
+	address_t address);
+uint32_t memory_scan_readl(struct region **list, int num, int bus_id,
+	address_t address);
+void memory_scan_writeb(struct region **list, int num, int bus_id,
+	uint8_t data, address_t address);
+void memory_scan_writew(struct region **list, int num, int bus_id,
+	uint16_t data, address_t address);
+void memory_scan_writel(struct region **list, int num, int bus_id,
+	uint32_t data, address_t address);
+
 void dma_channel_add(struct dma_channel *channel);
 void dma_channel_remove(struct dma_channel *channel);
 void dma_channel_remove_all();
 
 extern struct region **regions;
 extern int num_regions;
+extern struct page **page_tables;
+extern int num_page_tables;
 extern struct dma_channel **dma_channels;
 extern int num_dma_channels;
+extern uint32_t memory_map_generation;
+extern uint32_t memory_num_updates;
 extern struct mops rom_mops;
 extern struct mops ram_mops;
 
+static inline uint8_t memory_loadb(uint8_t *mem)
+{
+	return *mem;
+}
+
+static inline uint16_t memory_loadw(uint8_t *mem)
+{
+	uint16_t w;
+	memcpy(&w, mem, sizeof(uint16_t));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	w = __builtin_bswap16(w);
+#endif
+	return w;
+}
+
+static inline uint32_t memory_loadl(uint8_t *mem)
+{
+	uint32_t l;
+	memcpy(&l, mem, sizeof(uint32_t));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	l = __builtin_bswap32(l);
+#endif
+	return l;
+}
+
+static inline void memory_storeb(uint8_t *mem, uint8_t b)
+{
+	*mem = b;
+}
+
+static inline void memory_storew(uint8_t *mem, uint16_t w)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	w = __builtin_bswap16(w);
+#endif
+	memcpy(mem, &w, sizeof(uint16_t));
+}
+
+static inline void memory_storel(uint8_t *mem, uint32_t l)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	l = __builtin_bswap32(l);
+#endif
+	memcpy(mem, &l, sizeof(uint32_t));
+}
+
+static inline void memory_sync(struct region *region)
+{
+#ifdef CONFIG_PROFILE
+	/* Account for operation about to be called */
+	region->num_calls++;
+#endif
+
+	/* Catch up clock owning region (if any) before accessing it */
+	if (region->clock)
+		clock_catch_up(region->clock);
+}
+
+static inline struct page *memory_get_page(int bus_id, address_t address)
+{
+	/* Return page only if address is covered by bus page table */
+	if ((bus_id >= num_page_tables) ||
+		!page_tables[bus_id] ||
+		(address >= (MEM_NUM_PAGES << MEM_PAGE_SHIFT)))
+		return NULL;
+	return &page_tables[bus_id][address >> MEM_PAGE_SHIFT];
+}
+
+static inline void memory_check_read(struct region *region,
+	address_t address)
+{
+	/* Count reads which might change state along with bus writes */
+	if (!region->mops->stable ||
+		!region->mops->stable(region->data, address))
+		memory_num_updates++;
+}
+
 #define DEFINE_MEMORY_READ(ext, type) \
 	static inline type memory_read##ext(int bus_id, address_t address) \
 	{ \
-		struct region *r; \
-		struct resource *mirror; \
-		address_t size; \
+		struct page *page; \
+		struct page_entry *entry; \
 		address_t a; \
-		int i; \
-		int j; \
 	\
-		/* Parse regions */ \
-		for (i = 0; i < num_regions; i++) { \
-			r = regions[i]; \
-	\
-			/* Skip if region if operation is not supported */ \
-			if (!r->mops->read##ext) \
-				continue; \
-	\
-			/* Call operation if address is within area */ \
-			if ((bus_id == r->area->data.mem.bus_id) && \
-				(address >= r->area->data.mem.start) && \
-				(address <= r->area->data.mem.end)) { \
-				a = address - r->area->data.mem.start; \
-				return r->mops->read##ext(r->data, a); \
-			} \
+		/* Parse all regions if address is not paged */ \
+		page = memory_get_page(bus_id, address); \
+		if (!page) \
+			return memory_scan_read##ext(regions, \
+				num_regions, \
+				bus_id, \
+				address); \
 	\
-			/* Get region size */ \
-			size = MEM_SIZE(r->area); \
+		/* Load data from host memory if access stays within page */ \
+		entry = &page->read##ext; \
+		a = address & MEM_PAGE_MASK; \
+		if (entry->mem && (a <= MEM_PAGE_SIZE - sizeof(type))) \
+			return memory_load##ext(entry->mem + a); \
 	\
-			/* Call operation if address is within a mirror */ \
-			for (j = 0; j < r->area->num_children; j++) { \
-				mirror = &r->area->children[j]; \
-				if ((bus_id == mirror->data.mem.bus_id) && \
-					(address >= mirror->data.mem.start) && \
-					(address <= mirror->data.mem.end)) { \
-					a = address - mirror->data.mem.start; \
-					a %= size; \
-					return r->mops->read##ext(r->data, a); \
-				} \
-			} \
+		/* Call operation directly if page maps to a single region */ \
+		if (entry->region) { \
+			a += entry->base; \
+			memory_sync(entry->region); \
+			memory_check_read(entry->region, a); \
+			return entry->region->mops->read##ext( \
+				entry->region->data, \
+				a); \
 		} \
 	\
-		/* Return 0 in case of read failure */ \
-		LOG_W("Region not found in %s(%u, 0x%08x)!\n", \
-			__func__, \
+		/* Parse regions overlapping page otherwise */ \
+		return memory_scan_read##ext(page->regions, \
+			page->num_regions, \
 			bus_id, \
 			address); \
-		return 0; \
 	}
 
 #define DEFINE_MEMORY_WRITE(ext, type) \
 	static inline void memory_write##ext(int bus_id, type data, \
 		address_t addr) \
 	{ \
-		struct region *r; \
-		struct resource *mirror; \
-		address_t size; \
+		struct page *page; \
+		struct page_entry *entry; \
 		address_t a; \
-		int num; \
-		int i; \
-		int j; \
-	\
-		/* Parse regions */ \
-		num = 0; \
-		for (i = 0; i < num_regions; i++) { \
-			r = regions[i]; \
-	\
-			/* Skip if region if operation is not supported */ \
-			if (!r->mops->write##ext) \
-				continue; \
 	\
-			/* Adapt address and call write operation if needed */ \
-			if ((bus_id == r->area->data.mem.bus_id) && \
-				(addr >= r->area->data.mem.start) && \
-				(addr <= r->area->data.mem.end)) { \
-				a = addr - r->area->data.mem.start; \
-				r->mops->write##ext(r->data, data, a); \
-				num++; \
-			} \
-	\
-			/* Get region size */ \
-			size = MEM_SIZE(r->area); \
+		/* Let users know that machine state might have changed */ \
+		memory_num_updates++; \
 	\
-			/* Parse mirrors */ \
-			for (j = 0; j < r->area->num_children; j++) { \
-				mirror = &r->area->children[j]; \
+		/* Parse all regions if address is not paged */ \
+		page = memory_get_page(bus_id, addr); \
+		if (!page) { \
+			memory_scan_write##ext(regions, \
+				num_regions, \
+				bus_id, \
+				data, \
+				addr); \
+			return; \
+		} \
 	\
-				/* Skip if address is not within mirror */ \
-				if ((bus_id != mirror->data.mem.bus_id) || \
-					!((addr >= mirror->data.mem.start) && \
-					(addr <= mirror->data.mem.end))) \
-					continue; \
+		/* Store data to host memory if access stays within page */ \
+		entry = &page->write##ext; \
+		a = addr & MEM_PAGE_MASK; \
+		if (entry->mem && (a <= MEM_PAGE_SIZE - sizeof(type))) { \
+			memory_store##ext(entry->mem + a, data); \
+			return; \
+		} \
 	\
-				/* Adapt address and call write operation */ \
-				a = (addr - mirror->data.mem.start) % size; \
-				r->mops->write##ext(r->data, data, a); \
-				num++; \
-			} \
+		/* Call operation directly if page maps to a single region */ \
+		if (entry->region) { \
+			a += entry->base; \
+			memory_sync(entry->region); \
+			clock_catch_up_watchers(); \
+			entry->region->mops->write##ext(entry->region->data, \
+				data, \
+				a); \
+			return; \
 		} \
 	\
-		/* Warn on write failure */ \
-		if (num == 0) \
-			LOG_W("Region not found in %s(%u, 0x%08x, 0x%0*x)!\n", \
-				__func__, \
-				bus_id, \
-				addr, \
-				sizeof(type) * 2, \
-				data); \
+		/* Parse regions overlapping page otherwise */ \
+		memory_scan_write##ext(page->regions, \
+			page->num_regions, \
+			bus_id, \
+			data, \
+			addr); \
 	}
 
 #define DEFINE_DMA_READ(ext, type) \
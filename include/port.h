@@ -2,6 +2,7 @@
 #define _PORT_H
 
 #include <stdint.h>
+#include <clock.h>
 #include <list.h>
 #include <resource.h>
 
@@ -13,16 +14,22 @@ typedef uint8_t port_t;
 typedef void port_data_t;
 typedef uint8_t (*read_t)(port_data_t *data, port_t port);
 typedef void (*write_t)(port_data_t *data, uint8_t b, port_t port);
+typedef void (*write_bulk_t)(port_data_t *data, uint8_t *buf, int count,
+	port_t port);
+typedef bool (*port_stable_t)(port_data_t *data, port_t port);
 
 struct pops {
 	read_t read;
 	write_t write;
+	write_bulk_t write_bulk;
+	port_stable_t stable;
 };
 
 struct port_region {
 	struct resource *area;
 	struct pops *pops;
 	port_data_t *data;
+	struct clock *clock;
 };
 
 bool port_region_add(struct port_region *region);
@@ -30,6 +37,7 @@ void port_region_remove(struct port_region *region);
 void port_region_remove_all();
 uint8_t port_read(port_t port);
 void port_write(uint8_t b, port_t port);
+bool port_write_bulk(uint8_t *buf, int count, port_t port);
 
 #endif
 
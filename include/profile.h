@@ -0,0 +1,26 @@
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#ifndef __LIBRETRO__
+#ifdef __GNUC__
+#include <config.h>
+#endif
+#endif
+
+#ifdef CONFIG_PROFILE
+#include <stdint.h>
+
+/* Components created while an owner is set get labeled with its name */
+#define PROFILE_SET_OWNER(name) \
+	profile_owner = (name)
+
+uint64_t profile_get_time();
+void profile_check();
+void profile_report();
+
+extern char *profile_owner;
+#else
+#define PROFILE_SET_OWNER(name) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#ifndef __LIBRETRO__
+#ifdef __GNUC__
+#include <config.h>
+#endif
+#endif
+
+#ifdef CONFIG_TRACE
+#include <stdbool.h>
+
+/* Zones must be properly nested within a thread */
+#define TRACE_BEGIN(name) \
+	do { \
+		if (trace_enabled) \
+			trace_event(name, 'B'); \
+	} while (0)
+#define TRACE_END(name) \
+	do { \
+		if (trace_enabled) \
+			trace_event(name, 'E'); \
+	} while (0)
+
+/* Async zones may overlap others (devices spreading work over ticks) */
+#define TRACE_ASYNC_BEGIN(name) \
+	do { \
+		if (trace_enabled) \
+			trace_event(name, 'b'); \
+	} while (0)
+#define TRACE_ASYNC_END(name) \
+	do { \
+		if (trace_enabled) \
+			trace_event(name, 'e'); \
+	} while (0)
+
+bool trace_init();
+void trace_event(const char *name, char phase);
+void trace_dump();
+
+extern bool trace_enabled;
+#else
+#define TRACE_BEGIN(name) do {} while (0)
+#define TRACE_END(name) do {} while (0)
+#define TRACE_ASYNC_BEGIN(name) do {} while (0)
+#define TRACE_ASYNC_END(name) do {} while (0)
+#endif
+
+#endif
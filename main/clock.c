@@ -1,129 +1,599 @@
+#include <math.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #ifdef __GNUC__
-#include <unistd.h>
-#include <sys/time.h>
+#include <errno.h>
+#include <time.h>
 #endif
 #include <clock.h>
+#include <cmdline.h>
 #include <log.h>
+#include <trace.h>
 
 #define NS(s) ((s) * 1000000000)
+#define MAX_MULTIPLIER 1000
+#define DIV_TOLERANCE 1e-6
+#define PACE_PERIOD_US 1000
+#define MAX_LAG_NS 100000000
 
-static struct clock **clocks;
-static int num_clocks;
-static float machine_clock_rate;
-static float mach_delay;
-static float current_cycle;
-static float num_remaining_cycles;
+static void update_dividers();
+static void pace();
+static uint64_t get_key(struct clock *clock);
+static void run_tick(struct clock *clock);
+static void run_until(struct clock *clock, uint64_t cycle, int index);
+static void update_key(struct clock *clock);
+static bool heap_less(struct clock *a, struct clock *b);
+static void heap_swap(int i, int j);
+static void heap_sift_up(int i);
+static void heap_sift_down(int i);
+static void heap_insert(struct clock *clock);
+static void heap_remove(struct clock *clock);
+
+static struct clock **heap;
+static int heap_size;
+static bool sync_requested;
+static bool catch_up_requested;
+static double machine_clock_rate;
+static double mach_delay;
+static uint64_t start_cycle;
+static uint64_t pace_cycle;
+static uint64_t pace_period;
+static uint64_t catch_up_cycle;
 #ifdef __GNUC__
-static struct timeval start_time;
+static struct timespec start_time;
+#endif
+#ifdef CONFIG_PROFILE
+static uint64_t nested_ns;
 #endif
+static int speed = 1;
+PARAM(speed, int, "speed", NULL, "Sets speed multiplier (0 for unlimited)")
+static bool no_idle_skip;
+PARAM(no_idle_skip, bool, "no-idle-skip", NULL, "Disables idle loop skipping")
+struct clock **clocks;
+int num_clocks;
 struct clock *current_clock;
+uint64_t current_cycle;
+uint64_t run_ahead_limit;
+struct clock **watchers;
+int num_watchers;
 
-void clock_add(struct clock *clock)
+void update_dividers()
 {
+	double max_rate;
+	double div;
+	int mult;
 	int i;
 
-	/* Grow clocks array and insert clock */
-	clocks = realloc(clocks, ++num_clocks * sizeof(struct clock *));
-	clocks[num_clocks - 1] = clock;
+	/* Get fastest clock rate */
+	max_rate = 0.0;
+	for (i = 0; i < num_clocks; i++)
+		if (clocks[i]->rate > max_rate)
+			max_rate = clocks[i]->rate;
 
-	/* Update machine rate/delay if needed */
-	if (clock->rate > machine_clock_rate) {
-		machine_clock_rate = clock->rate;
-		mach_delay = NS(1) / machine_clock_rate;
+	/* Find smallest multiple of the fastest clock rate so that every clock
+	is an integer divider of the resulting machine clock (the NES APU frame
+	sequencer for instance runs at master clock / 89490, which is not an
+	integer divider of the PPU clock running at master clock / 4) */
+	for (mult = 1; mult < MAX_MULTIPLIER; mult++) {
+		for (i = 0; i < num_clocks; i++) {
+			div = mult * max_rate / clocks[i]->rate;
+			if (fabs(div - round(div)) > div * DIV_TOLERANCE)
+				break;
+		}
+		if (i == num_clocks)
+			break;
 	}
 
+	/* Warn if clocks could not be evenly divided */
+	if (mult == MAX_MULTIPLIER)
+		LOG_W("Could not find exact clock dividers!\n");
+
+	/* Update machine rate/delay */
+	machine_clock_rate = mult * max_rate;
+	mach_delay = NS(1) / machine_clock_rate;
+	pace_period = machine_clock_rate * PACE_PERIOD_US / 1000000;
+
 	/* Set clock dividers */
 	for (i = 0; i < num_clocks; i++)
-		clocks[i]->div = machine_clock_rate / clocks[i]->rate;
+		clocks[i]->div = llround(machine_clock_rate / clocks[i]->rate);
 }
 
-void clock_reset()
+uint64_t get_key(struct clock *clock)
 {
-	int i;
+	/* Lazy clocks are only scheduled when their deadline is reached */
+	if (clock->sync_cycle > clock->next_cycle)
+		return clock->sync_cycle;
+	return clock->next_cycle;
+}
 
-	/* Initialize current cycle and start time */
-	current_cycle = 0.0f;
-#ifdef __GNUC__
-	gettimeofday(&start_time, NULL);
+void run_tick(struct clock *clock)
+{
+#ifdef CONFIG_PROFILE
+	uint64_t saved_ns = nested_ns;
+	uint64_t cycle = clock->next_cycle;
+	uint64_t start = profile_get_time();
+	uint64_t elapsed;
+
+	/* Time spent in clocks caught up during this tick is theirs */
+	nested_ns = 0;
 #endif
 
-	/* Reset all clock remaining cycles */
-	for (i = 0; i < num_clocks; i++)
-		clocks[i]->num_remaining_cycles = 0.0f;
+	/* Tick clock */
+	clock->tick(clock->data);
+
+#ifdef CONFIG_PROFILE
+	/* Update clock statistics (excluding nested ticks) */
+	elapsed = profile_get_time() - start;
+	clock->num_ticks++;
+	if (clock->next_cycle > cycle)
+		clock->num_cycles += (clock->next_cycle - cycle) / clock->div;
+	clock->num_ns += elapsed - nested_ns;
+	nested_ns = saved_ns + elapsed;
+#endif
 }
 
-void clock_tick_all(bool handle_delay)
+void run_until(struct clock *clock, uint64_t cycle, int index)
 {
-	float num_cycles;
-#ifdef __GNUC__
-	float real_delay;
-	float d;
-	struct timeval current_time;
-#endif
-	int i;
+	struct clock *saved_clock = current_clock;
+	uint64_t saved_cycle = current_cycle;
+	uint64_t saved_catch_up_cycle = catch_up_cycle;
 
-	/* Initialize number of cycles to skip */
-	num_cycles = machine_clock_rate;
+	/* Let clock know how far it is being run */
+	catch_up_cycle = cycle;
 
-	/* Tick clocks */
-	for (i = 0; i < num_clocks; i++) {
-		/* Set current clock */
-		current_clock = clocks[i];
+	/* Tick clock while it is scheduled before cycle/index pair */
+	while (clock->enabled && ((clock->next_cycle < cycle) ||
+		((clock->next_cycle == cycle) && (clock->index < index)))) {
+		current_clock = clock;
+		current_cycle = clock->next_cycle;
+		run_tick(clock);
+		update_key(clock);
+	}
 
-		/* Skip clock if disabled */
-		if (!current_clock->enabled)
-			continue;
+	/* Restore current clock and cycles */
+	current_clock = saved_clock;
+	current_cycle = saved_cycle;
+	catch_up_cycle = saved_catch_up_cycle;
+}
 
-		/* Decrease clock cycles */
-		current_clock->num_remaining_cycles -= num_remaining_cycles;
+void update_key(struct clock *clock)
+{
+	/* Skip clock if it is not scheduled */
+	if (clock->heap_index < 0)
+		return;
 
-		/* Tick clock if necessary */
-		if (current_clock->num_remaining_cycles <= 0.0f)
-			current_clock->tick(current_clock->data);
+	/* Remove clock from heap if it disabled itself while ticking */
+	if (!clock->enabled) {
+		clock->num_remaining_cycles =
+			(clock->next_cycle > current_cycle) ?
+			clock->next_cycle - current_cycle : 0;
+		heap_remove(clock);
+		return;
+	}
+
+	/* Restore heap order */
+	heap_sift_up(clock->heap_index);
+	heap_sift_down(clock->heap_index);
+}
 
-		/* Save next number of remaining cycles if needed */
-		if ((current_clock->num_remaining_cycles < num_cycles) &&
-			current_clock->enabled)
-			num_cycles = current_clock->num_remaining_cycles;
+bool heap_less(struct clock *a, struct clock *b)
+{
+	uint64_t key_a = get_key(a);
+	uint64_t key_b = get_key(b);
+
+	/* Order clocks by key cycle, then by registration order */
+	if (key_a != key_b)
+		return key_a < key_b;
+	return a->index < b->index;
+}
+
+void heap_swap(int i, int j)
+{
+	struct clock *clock;
+
+	/* Swap entries and update their positions */
+	clock = heap[i];
+	heap[i] = heap[j];
+	heap[j] = clock;
+	heap[i]->heap_index = i;
+	heap[j]->heap_index = j;
+}
+
+void heap_sift_up(int i)
+{
+	int parent;
+
+	/* Move entry up until its parent fires earlier */
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (!heap_less(heap[i], heap[parent]))
+			break;
+		heap_swap(i, parent);
+		i = parent;
+	}
+}
+
+void heap_sift_down(int i)
+{
+	int child;
+
+	/* Move entry down until both children fire later */
+	for (;;) {
+		child = 2 * i + 1;
+		if (child >= heap_size)
+			break;
+		if ((child + 1 < heap_size) &&
+			heap_less(heap[child + 1], heap[child]))
+			child++;
+		if (!heap_less(heap[child], heap[i]))
+			break;
+		heap_swap(i, child);
+		i = child;
 	}
+}
 
-	/* Update current cycle and number of remaining cycles */
-	current_cycle += num_cycles;
-	num_remaining_cycles = num_cycles;
+void heap_insert(struct clock *clock)
+{
+	/* Append clock and restore heap order */
+	clock->heap_index = heap_size;
+	heap[heap_size++] = clock;
+	heap_sift_up(clock->heap_index);
+}
 
+void heap_remove(struct clock *clock)
+{
+	int i = clock->heap_index;
+
+	/* Replace entry with last one and restore heap order */
+	clock->heap_index = -1;
+	if (i != --heap_size) {
+		heap[i] = heap[heap_size];
+		heap[i]->heap_index = i;
+		heap_sift_up(i);
+		heap_sift_down(heap[i]->heap_index);
+	}
+}
+
+void pace()
+{
 #ifdef __GNUC__
-	/* Only sleep if delay handling is needed */
-	if (handle_delay) {
-		/* Get actual delay (in ns) */
-		gettimeofday(&current_time, NULL);
-		real_delay = NS(current_time.tv_sec - start_time.tv_sec) +
-			(current_time.tv_usec - start_time.tv_usec) * 1000;
-
-		/* Sleep to match machine delay if needed */
-		if (current_cycle * mach_delay > real_delay) {
-			d = (current_cycle * mach_delay - real_delay) / 1000;
-			usleep(d);
+	struct timespec now;
+	struct timespec deadline;
+	int64_t elapsed;
+	int64_t target;
+
+	/* Get machine time elapsed since start point (in ns) */
+	target = (current_cycle - start_cycle) * mach_delay / speed;
+
+	/* Get actual time elapsed since start point (in ns) */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	elapsed = NS((int64_t)(now.tv_sec - start_time.tv_sec)) +
+		(now.tv_nsec - start_time.tv_nsec);
+
+	/* Restart from current point if emulation is lagging too much */
+	if (elapsed - target > MAX_LAG_NS) {
+		start_cycle = current_cycle;
+		start_time = now;
+		return;
+	}
+
+	/* Sleep until absolute deadline if emulation is ahead */
+	if (target > elapsed) {
+		deadline.tv_sec = start_time.tv_sec + target / NS(1);
+		deadline.tv_nsec = start_time.tv_nsec + target % NS(1);
+		if (deadline.tv_nsec >= NS(1)) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= NS(1);
 		}
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline,
+			NULL) == EINTR);
 	}
 #endif
+}
+
+void clock_add(struct clock *clock)
+{
+	/* Grow clocks array and insert clock */
+	clocks = realloc(clocks, ++num_clocks * sizeof(struct clock *));
+	clocks[num_clocks - 1] = clock;
+
+#ifdef CONFIG_PROFILE
+	/* Label clock with its owner and clear its statistics */
+	clock->name = profile_owner;
+	clock->num_ticks = 0;
+	clock->num_cycles = 0;
+	clock->num_ns = 0;
+#endif
+
+	/* Grow heap (clock gets scheduled on reset) */
+	heap = realloc(heap, num_clocks * sizeof(struct clock *));
+	clock->index = num_clocks - 1;
+	clock->heap_index = -1;
+
+	/* Register clock if it has to be caught up on device writes */
+	if (clock->watch_writes) {
+		watchers = realloc(watchers,
+			++num_watchers * sizeof(struct clock *));
+		watchers[num_watchers - 1] = clock;
+	}
+
+	/* Update machine rate and clock dividers */
+	update_dividers();
+}
+
+void clock_enable(struct clock *clock, bool enable)
+{
+	/* Leave clock untouched if its state does not change */
+	if (clock->enabled == enable)
+		return;
+	clock->enabled = enable;
+
+	/* Deadline might have changed */
+	clock_sync();
+
+	/* Clock being ticked is handled once its tick completes */
+	if (clock == current_clock)
+		return;
 
-	/* Reset current cycle and start time if needed */
-	if (current_cycle >= machine_clock_rate) {
+	/* Disabled clocks do not age (save remaining cycles until next tick) */
+	if (!enable) {
+		clock->num_remaining_cycles = (clock->next_cycle > current_cycle) ?
+			clock->next_cycle - current_cycle : 0;
+		heap_remove(clock);
+		return;
+	}
+
+	/* Schedule clock based on its remaining cycles */
+	clock->next_cycle = current_cycle + clock->num_remaining_cycles;
+	heap_insert(clock);
+}
+
+void clock_schedule(struct clock *clock, uint64_t cycle)
+{
+	/* Update next cycle and re-key clock if needed */
+	clock->next_cycle = cycle;
+	if (clock->heap_index >= 0) {
+		heap_sift_up(clock->heap_index);
+		heap_sift_down(clock->heap_index);
+	}
+
+	/* Deadline might have changed */
+	clock_sync();
+}
+
+void clock_set_deadline(struct clock *clock, uint64_t cycle)
+{
+	uint64_t key;
+
+	/* Leave clock untouched if deadline does not change */
+	if (clock->sync_cycle == cycle)
+		return;
+
+	/* Update deadline and re-key clock if needed */
+	key = get_key(clock);
+	clock->sync_cycle = cycle;
+	if (clock->heap_index >= 0) {
+		heap_sift_up(clock->heap_index);
+		heap_sift_down(clock->heap_index);
+	}
+
+	/* Deadline might have moved closer */
+	if (get_key(clock) < key)
+		clock_sync();
+}
+
+void clock_catch_up(struct clock *clock)
+{
+	int index;
+
+	/* Skip clock if it is the one being ticked */
+	if (clock == current_clock)
+		return;
+
+	/* Run clock until it reaches the ticking clock (if any) */
+	index = current_clock ? current_clock->index : num_clocks;
+	run_until(clock, current_cycle, index);
+}
+
+void clock_catch_up_all()
+{
+	/* Catch up all clocks once current step completes */
+	catch_up_requested = true;
+	run_ahead_limit = 0;
+}
+
+void clock_sync()
+{
+	/* Stop current clock run-ahead after its ongoing step */
+	sync_requested = true;
+	run_ahead_limit = 0;
+}
+
+bool clock_run_ahead()
+{
+	/* Stop if a sync was requested (clock state changed or frame ended) */
+	if (sync_requested || catch_up_requested)
+		return false;
+
+	/* Stop if no cycles were consumed (let other due clocks tick first) */
+	if (current_clock->next_cycle <= current_cycle)
+		return false;
+
+	/* Stop if another clock is due before current clock */
+	if ((heap_size == 0) || !heap_less(current_clock, heap[0]))
+		return false;
+
+	/* Advance machine time and keep running current clock */
+	current_cycle = current_clock->next_cycle;
+	return true;
+}
+
+uint64_t clock_get_run_ahead_limit()
+{
+	/* Run-ahead is over if a sync was requested or no other clock exists */
+	if (sync_requested || catch_up_requested || (heap_size == 0)) {
+		run_ahead_limit = 0;
+		return 0;
+	}
+
+	/* Current clock can run while its next cycle stays below the limit
+	(limit only gets conservative until next sync request clears it) */
+	run_ahead_limit = get_key(heap[0]);
+	if (current_clock->index < heap[0]->index)
+		run_ahead_limit++;
+	return run_ahead_limit;
+}
+
+uint64_t clock_get_catch_up_cycle()
+{
+	/* Clock being caught up runs while it is scheduled before this cycle
+	(lazy clocks can use it to process several ticks at once) */
+	return catch_up_cycle;
+}
+
+uint64_t clock_consume_idle(int num_cycles)
+{
+	uint64_t period = num_cycles * current_clock->div;
+	uint64_t next_cycle = current_clock->next_cycle + period;
+	uint64_t limit = clock_get_run_ahead_limit();
+	uint64_t num_periods = 1;
+
+	/* Consume idle periods up to where run-ahead would have stopped anyway
+	(clock ends up exactly as if each period was consumed on its own) */
+	if (limit > next_cycle)
+		num_periods += (limit - next_cycle + period - 1) / period;
+	current_clock->next_cycle += num_periods * period;
+	return num_periods;
+}
+
+uint64_t clock_skip_idle(uint64_t period)
+{
+	uint64_t next_cycle = current_clock->next_cycle;
+	uint64_t limit;
+	uint64_t num_periods;
+
+	/* Leave if skipping is disabled */
+	if (no_idle_skip || (period == 0))
+		return 0;
+
+	/* Skip whole periods (expressed in machine cycles) which would end
+	before run-ahead stops (clock ends up exactly as if each period was
+	run on its own) */
+	limit = clock_get_run_ahead_limit();
+	if (limit <= next_cycle + period)
+		return 0;
+	num_periods = (limit - 1 - next_cycle) / period;
+	current_clock->next_cycle += num_periods * period;
+	return num_periods;
+}
+
+void clock_reset()
+{
+	int i;
+
+	/* Initialize start cycle and start time */
+	start_cycle = current_cycle;
+	pace_cycle = current_cycle + pace_period;
 #ifdef __GNUC__
-		if (handle_delay)
-			gettimeofday(&start_time, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &start_time);
 #endif
-		current_cycle -= machine_clock_rate;
+
+	/* Schedule all enabled clocks at current cycle */
+	heap_size = 0;
+	current_clock = NULL;
+	catch_up_requested = false;
+	for (i = 0; i < num_clocks; i++) {
+		clocks[i]->next_cycle = current_cycle;
+		clocks[i]->num_remaining_cycles = 0;
+		clocks[i]->heap_index = -1;
+		if (clocks[i]->enabled)
+			heap_insert(clocks[i]);
+	}
+}
+
+void clock_tick_all(bool handle_delay)
+{
+	struct clock *clock;
+	uint64_t next_cycle;
+	int last_index;
+	int i;
+
+	/* Tick due clocks in registration order (a clock becoming due again at
+	the current cycle with a lower index is handled on next call) */
+	last_index = -1;
+	while (heap_size > 0) {
+		/* Stop if earliest clock is not due yet */
+		clock = heap[0];
+		if ((get_key(clock) > current_cycle) ||
+			(clock->index <= last_index))
+			break;
+		last_index = clock->index;
+
+		/* Remove clock from heap and catch up lazy clock if needed */
+		heap_remove(clock);
+		run_until(clock, current_cycle, 0);
+
+		/* Tick clock if still due */
+		if (clock->enabled && (clock->next_cycle <= current_cycle)) {
+			sync_requested = false;
+			current_clock = clock;
+			run_tick(clock);
+			current_clock = NULL;
+		}
+
+		/* Re-key clock or save its remaining cycles if it got disabled */
+		if (clock->enabled)
+			heap_insert(clock);
+		else
+			clock->num_remaining_cycles =
+				(clock->next_cycle > current_cycle) ?
+				clock->next_cycle - current_cycle : 0;
 	}
+
+	/* Bring all clocks up to current cycle if requested */
+	if (catch_up_requested) {
+		TRACE_BEGIN("catch_up");
+		for (i = 0; i < num_clocks; i++)
+			run_until(clocks[i], current_cycle, num_clocks);
+		catch_up_requested = false;
+		TRACE_END("catch_up");
+	}
+
+	/* Get next cycle (wait at most one second) */
+	next_cycle = current_cycle + (uint64_t)machine_clock_rate;
+	if ((heap_size > 0) && (get_key(heap[0]) < next_cycle))
+		next_cycle = get_key(heap[0]);
+
+	/* Never go back in time */
+	if (next_cycle < current_cycle)
+		next_cycle = current_cycle;
+
+	/* Update current cycle */
+	current_cycle = next_cycle;
+
+	/* Pace emulation once per period of machine time if needed */
+	if (handle_delay && (speed > 0) && (current_cycle >= pace_cycle)) {
+		pace();
+		pace_cycle = current_cycle + pace_period;
+	}
+
+#ifdef CONFIG_PROFILE
+	/* Print statistics if a report was requested */
+	profile_check();
+#endif
 }
 
 void clock_remove_all()
 {
 	free(clocks);
+	free(heap);
+	free(watchers);
 	clocks = NULL;
+	heap = NULL;
+	watchers = NULL;
 	num_clocks = 0;
+	num_watchers = 0;
+	heap_size = 0;
 }
 
@@ -4,6 +4,7 @@
 #include <controller.h>
 #include <list.h>
 #include <log.h>
+#include <profile.h>
 
 struct list_link *controllers;
 static struct list_link *controller_instances;
@@ -16,6 +17,7 @@ bool controller_add(struct controller_instance *instance)
 	while ((c = list_get_next(&link)))
 		if (!strcmp(instance->controller_name, c->name)) {
 			instance->controller = c;
+			PROFILE_SET_OWNER(instance->controller_name);
 			if ((c->init && c->init(instance)) || !c->init) {
 				list_insert(&controller_instances,
 					instance);
@@ -4,9 +4,12 @@
 #include <cpu.h>
 #include <list.h>
 #include <log.h>
+#include <profile.h>
 
 struct list_link *cpus;
-static struct list_link *cpu_instances;
+struct list_link *cpu_instances;
+static struct cpu_instance **instance_table;
+static int num_instances;
 
 bool cpu_add(struct cpu_instance *instance)
 {
@@ -16,8 +19,16 @@ bool cpu_add(struct cpu_instance *instance)
 	while ((cpu = list_get_next(&link)))
 		if (!strcmp(instance->cpu_name, cpu->name)) {
 			instance->cpu = cpu;
+			PROFILE_SET_OWNER(instance->cpu_name);
 			if ((cpu->init && cpu->init(instance)) || !cpu->init) {
 				list_insert(&cpu_instances, instance);
+
+				/* Index instance so IRQs can reach it directly */
+				instance_table = realloc(instance_table,
+					++num_instances *
+					sizeof(struct cpu_instance *));
+				instance_table[num_instances - 1] = instance;
+				instance->id = num_instances - 1;
 				return true;
 			}
 			return false;
@@ -41,21 +52,28 @@ void cpu_reset_all()
 void cpu_interrupt(int irq)
 {
 	struct cpu_instance *instance;
-	struct list_link *link = cpu_instances;
+	int id = irq >> CPU_IRQ_SHIFT;
 
-	/* Interrupt first CPU only */
-	instance = list_get_next(&link);
+	/* Check target CPU */
+	if (id >= num_instances) {
+		LOG_W("IRQ %d targets unknown CPU!\n", irq);
+		return;
+	}
+
+	/* Raise line on target CPU (which latches it into its own state) */
+	instance = instance_table[id];
 	if (instance->cpu && instance->cpu->interrupt)
-		instance->cpu->interrupt(instance, irq);
+		instance->cpu->interrupt(instance, irq & CPU_IRQ_LINE);
 }
 
 void cpu_halt(bool halt)
 {
 	struct cpu_instance *instance;
-	struct list_link *link = cpu_instances;
 
 	/* Halt first CPU only */
-	instance = list_get_next(&link);
+	if (num_instances == 0)
+		return;
+	instance = instance_table[0];
 	if (instance->cpu && instance->cpu->halt)
 		instance->cpu->halt(instance, halt);
 }
@@ -70,5 +88,8 @@ void cpu_remove_all()
 			instance->cpu->deinit(instance);
 
 	list_remove_all(&cpu_instances);
+	free(instance_table);
+	instance_table = NULL;
+	num_instances = 0;
 }
 
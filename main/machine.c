@@ -1,6 +1,8 @@
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #ifdef EMSCRIPTEN
 #include <emscripten.h>
 #endif
@@ -15,10 +17,16 @@
 #include <machine.h>
 #include <memory.h>
 #include <port.h>
+#include <profile.h>
+#include <trace.h>
 #include <util.h>
 #include <video.h>
 
+/* Number of benchmark steps between two time limit checks */
+#define BENCHMARK_CHECK_PERIOD	1024
+
 static void machine_cleanup();
+static void machine_benchmark();
 static void machine_event(int id, enum input_type type, input_data_t *data);
 static void quit();
 #ifdef EMSCRIPTEN
@@ -31,6 +39,10 @@ static bool no_sync;
 PARAM(no_sync, bool, "no-sync", NULL, "Disables emulation syncing")
 static unsigned int cycles;
 PARAM(cycles, int, "cycles", NULL, "Sets number of machine cycles to emulate")
+static int benchmark;
+PARAM(benchmark, int, "benchmark", NULL, "Runs frames headless and prints stats")
+static int time_limit = 60;
+PARAM(time_limit, int, "time-limit", NULL, "Sets benchmark time limit in seconds (0 disables it)")
 
 struct list_link *machines;
 static struct machine *machine;
@@ -53,6 +65,81 @@ void machine_cleanup()
 	controller_remove_all();
 }
 
+void machine_benchmark()
+{
+	struct list_link *link;
+	struct cpu_instance *instance;
+	struct timespec start_time;
+	struct timespec end_time;
+	uint64_t *start_cycles = NULL;
+	uint64_t num_cycles;
+	double wall_time;
+	bool timed_out = false;
+	int num_frames = 0;
+	int num_steps = 0;
+	int num_cpus = 0;
+	int i;
+
+	/* Save CPU clock states and reset instruction counters */
+	link = cpu_instances;
+	while ((instance = list_get_next(&link))) {
+		start_cycles = realloc(start_cycles, ++num_cpus * sizeof(uint64_t));
+		start_cycles[num_cpus - 1] = instance->clock ?
+			instance->clock->next_cycle : 0;
+		instance->num_instructions = 0;
+	}
+
+	/* Run requested number of frames without any delay, giving up once
+	time limit is reached (machine might stop presenting frames) */
+	video_updated();
+	clock_gettime(CLOCK_MONOTONIC, &start_time);
+	while ((num_frames < benchmark) && !timed_out) {
+		clock_tick_all(false);
+		if (video_updated()) {
+			num_frames++;
+			continue;
+		}
+		if ((time_limit <= 0) ||
+			(++num_steps % BENCHMARK_CHECK_PERIOD != 0))
+			continue;
+		clock_gettime(CLOCK_MONOTONIC, &end_time);
+		wall_time = (end_time.tv_sec - start_time.tv_sec) +
+			(end_time.tv_nsec - start_time.tv_nsec) / 1e9;
+		timed_out = (wall_time >= time_limit);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end_time);
+	wall_time = (end_time.tv_sec - start_time.tv_sec) +
+		(end_time.tv_nsec - start_time.tv_nsec) / 1e9;
+
+	/* Print machine statistics as JSON */
+	printf("{\"machine\": \"%s\", \"frames\": %d, ",
+		machine->name,
+		num_frames);
+	printf("\"timed_out\": %s, ",
+		timed_out ? "true" : "false");
+	printf("\"wall_time\": %.6f, \"fps\": %.3f, \"cpus\": [",
+		wall_time,
+		num_frames / wall_time);
+
+	/* Print CPU statistics (effective clock rate and instructions) */
+	link = cpu_instances;
+	for (i = 0; (instance = list_get_next(&link)); i++) {
+		num_cycles = instance->clock ?
+			(instance->clock->next_cycle - start_cycles[i]) /
+			instance->clock->div : 0;
+		printf("%s{\"name\": \"%s\", \"cycles\": %" PRIu64 ", ",
+			(i > 0) ? ", " : "",
+			instance->cpu_name,
+			num_cycles);
+		printf("\"mhz\": %.3f, \"instructions\": %" PRIu64 "}",
+			num_cycles / wall_time / 1e6,
+			instance->num_instructions);
+	}
+	printf("]}\n");
+
+	free(start_cycles);
+}
+
 void machine_event(int UNUSED(id), enum input_type UNUSED(type),
 	input_data_t *UNUSED(data))
 {
@@ -68,6 +155,15 @@ void quit()
 	/* Unregister quit events */
 	input_unregister(&input_config);
 
+#ifdef CONFIG_PROFILE
+	/* Print profiling statistics */
+	profile_report();
+#endif
+#ifdef CONFIG_TRACE
+	/* Write timeline trace */
+	trace_dump();
+#endif
+
 	/* Deinitialize machine */
 	machine_deinit();
 }
@@ -113,6 +209,18 @@ bool machine_init()
 	/* Display machine name and description */
 	LOG_I("Machine: %s (%s)\n", machine->name, machine->description);
 
+#ifdef CONFIG_TRACE
+	/* Start recording timeline trace if requested */
+	if (!trace_init())
+		return false;
+#endif
+
+	/* Disable audio/video frontends when benchmarking */
+	if (benchmark > 0) {
+		cmdline_set_param("audio", NULL, NULL);
+		cmdline_set_param("video", NULL, NULL);
+	}
+
 	if (machine->init && !machine->init(machine)) {
 		machine_cleanup();
 		return false;
@@ -147,6 +255,15 @@ void machine_reset()
 
 void machine_run()
 {
+#ifndef EMSCRIPTEN
+	/* Run benchmark and quit if requested */
+	if (benchmark > 0) {
+		machine_benchmark();
+		quit();
+		return;
+	}
+#endif
+
 	/* Start audio processing */
 	audio_start();
 
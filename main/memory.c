@@ -15,16 +15,184 @@ static uint32_t ram_readl(uint8_t *ram, address_t address);
 static void ram_writeb(uint8_t *ram, uint8_t b, address_t address);
 static void ram_writew(uint8_t *ram, uint16_t w, address_t address);
 static void ram_writel(uint8_t *ram, uint32_t l, address_t address);
+static uint8_t *rom_map(uint8_t *rom, address_t address, bool *writable);
+static uint8_t *ram_map(uint8_t *ram, address_t address, bool *writable);
+static bool mem_stable(uint8_t *mem, address_t address);
+static bool has_op(struct region *region, int op);
+static int get_coverage(struct resource *mapping, int bus_id, address_t start,
+	address_t end);
+static bool get_base(struct region *region, struct resource *mapping,
+	address_t start, address_t *base);
+static void resolve_read(struct page *page, struct page_entry *entry, int op,
+	int bus_id);
+static void resolve_write(struct page *page, struct page_entry *entry, int op,
+	int bus_id);
+static void resolve_mem(struct page_entry *entry, bool write);
+static void update_page(int bus_id, int index);
+static void update_pages(struct region *region);
+static void remap_entry(struct page_entry *entry, struct region *region,
+	bool write);
+
+/* Operations resolved by page tables */
+enum {
+	OP_READB,
+	OP_READW,
+	OP_READL,
+	OP_WRITEB,
+	OP_WRITEW,
+	OP_WRITEL
+};
+
+/* Page coverage by a region area or mirror */
+enum {
+	COVERAGE_NONE,
+	COVERAGE_PARTIAL,
+	COVERAGE_FULL
+};
 
 struct region **regions;
 int num_regions;
+struct page **page_tables;
+int num_page_tables;
 struct dma_channel **dma_channels;
 int num_dma_channels;
+uint32_t memory_map_generation;
+uint32_t memory_num_updates;
+
+#define DEFINE_MEMORY_SCAN_READ(ext, type) \
+	type memory_scan_read##ext(struct region **list, int num, int bus_id, \
+		address_t address) \
+	{ \
+		struct region *r; \
+		struct resource *mirror; \
+		address_t size; \
+		address_t a; \
+		int i; \
+		int j; \
+	\
+		/* Parse regions */ \
+		for (i = 0; i < num; i++) { \
+			r = list[i]; \
+	\
+			/* Skip if region if operation is not supported */ \
+			if (!r->mops->read##ext) \
+				continue; \
+	\
+			/* Call operation if address is within area */ \
+			if ((bus_id == r->area->data.mem.bus_id) && \
+				(address >= r->area->data.mem.start) && \
+				(address <= r->area->data.mem.end)) { \
+				a = address - r->area->data.mem.start; \
+				memory_sync(r); \
+				memory_check_read(r, a); \
+				return r->mops->read##ext(r->data, a); \
+			} \
+	\
+			/* Get region size */ \
+			size = MEM_SIZE(r->area); \
+	\
+			/* Call operation if address is within a mirror */ \
+			for (j = 0; j < r->area->num_children; j++) { \
+				mirror = &r->area->children[j]; \
+				if ((bus_id == mirror->data.mem.bus_id) && \
+					(address >= mirror->data.mem.start) && \
+					(address <= mirror->data.mem.end)) { \
+					a = address - mirror->data.mem.start; \
+					a %= size; \
+					memory_sync(r); \
+					memory_check_read(r, a); \
+					return r->mops->read##ext(r->data, a); \
+				} \
+			} \
+		} \
+	\
+		/* Return 0 in case of read failure (warning is a side effect) */ \
+		memory_num_updates++; \
+		LOG_W("Region not found in %s(%u, 0x%08x)!\n", \
+			"memory_read" #ext, \
+			bus_id, \
+			address); \
+		return 0; \
+	}
+
+#define DEFINE_MEMORY_SCAN_WRITE(ext, type) \
+	void memory_scan_write##ext(struct region **list, int num, int bus_id, \
+		type data, address_t addr) \
+	{ \
+		struct region *r; \
+		struct resource *mirror; \
+		address_t size; \
+		address_t a; \
+		int n; \
+		int i; \
+		int j; \
+	\
+		/* Parse regions */ \
+		n = 0; \
+		for (i = 0; i < num; i++) { \
+			r = list[i]; \
+	\
+			/* Skip if region if operation is not supported */ \
+			if (!r->mops->write##ext) \
+				continue; \
+	\
+			/* Adapt address and call write operation if needed */ \
+			if ((bus_id == r->area->data.mem.bus_id) && \
+				(addr >= r->area->data.mem.start) && \
+				(addr <= r->area->data.mem.end)) { \
+				a = addr - r->area->data.mem.start; \
+				memory_sync(r); \
+				clock_catch_up_watchers(); \
+				r->mops->write##ext(r->data, data, a); \
+				n++; \
+			} \
+	\
+			/* Get region size */ \
+			size = MEM_SIZE(r->area); \
+	\
+			/* Parse mirrors */ \
+			for (j = 0; j < r->area->num_children; j++) { \
+				mirror = &r->area->children[j]; \
+	\
+				/* Skip if address is not within mirror */ \
+				if ((bus_id != mirror->data.mem.bus_id) || \
+					!((addr >= mirror->data.mem.start) && \
+					(addr <= mirror->data.mem.end))) \
+					continue; \
+	\
+				/* Adapt address and call write operation */ \
+				a = (addr - mirror->data.mem.start) % size; \
+				memory_sync(r); \
+				clock_catch_up_watchers(); \
+				r->mops->write##ext(r->data, data, a); \
+				n++; \
+			} \
+		} \
+	\
+		/* Warn on write failure */ \
+		if (n == 0) \
+			LOG_W("Region not found in %s(%u, 0x%08x, 0x%0*x)!\n", \
+				"memory_write" #ext, \
+				bus_id, \
+				addr, \
+				sizeof(type) * 2, \
+				data); \
+	}
+
+/* Define memory scan functions (used when pages cannot be resolved) */
+DEFINE_MEMORY_SCAN_READ(b, uint8_t)
+DEFINE_MEMORY_SCAN_READ(w, uint16_t)
+DEFINE_MEMORY_SCAN_READ(l, uint32_t)
+DEFINE_MEMORY_SCAN_WRITE(b, uint8_t)
+DEFINE_MEMORY_SCAN_WRITE(w, uint16_t)
+DEFINE_MEMORY_SCAN_WRITE(l, uint32_t)
 
 struct mops rom_mops = {
 	.readb = (readb_t)rom_readb,
 	.readw = (readw_t)rom_readw,
-	.readl = (readl_t)rom_readl
+	.readl = (readl_t)rom_readl,
+	.map = (map_t)rom_map,
+	.stable = (stable_t)mem_stable
 };
 
 struct mops ram_mops = {
@@ -33,7 +201,9 @@ struct mops ram_mops = {
 	.readl = (readl_t)ram_readl,
 	.writeb = (writeb_t)ram_writeb,
 	.writew = (writew_t)ram_writew,
-	.writel = (writel_t)ram_writel
+	.writel = (writel_t)ram_writel,
+	.map = (map_t)ram_map,
+	.stable = (stable_t)mem_stable
 };
 
 uint8_t rom_readb(uint8_t *rom, address_t address)
@@ -97,6 +267,266 @@ void ram_writel(uint8_t *ram, uint32_t l, address_t address)
 	*mem = (uint8_t)(l >> 24);
 }
 
+uint8_t *rom_map(uint8_t *rom, address_t address, bool *writable)
+{
+	*writable = false;
+	return rom + address;
+}
+
+uint8_t *ram_map(uint8_t *ram, address_t address, bool *writable)
+{
+	*writable = true;
+	return ram + address;
+}
+
+bool mem_stable(uint8_t *UNUSED(mem), address_t UNUSED(address))
+{
+	/* Reading plain memory never has side effects */
+	return true;
+}
+
+bool has_op(struct region *region, int op)
+{
+	switch (op) {
+	case OP_READB:
+		return region->mops->readb;
+	case OP_READW:
+		return region->mops->readw;
+	case OP_READL:
+		return region->mops->readl;
+	case OP_WRITEB:
+		return region->mops->writeb;
+	case OP_WRITEW:
+		return region->mops->writew;
+	case OP_WRITEL:
+	default:
+		return region->mops->writel;
+	}
+}
+
+int get_coverage(struct resource *mapping, int bus_id, address_t start,
+	address_t end)
+{
+	/* Check if mapping overlaps page at all */
+	if ((mapping->data.mem.bus_id != bus_id) ||
+		(mapping->data.mem.end < start) ||
+		(mapping->data.mem.start > end))
+		return COVERAGE_NONE;
+
+	/* Check if mapping contains the whole page */
+	if ((mapping->data.mem.start <= start) &&
+		(mapping->data.mem.end >= end))
+		return COVERAGE_FULL;
+
+	return COVERAGE_PARTIAL;
+}
+
+bool get_base(struct region *region, struct resource *mapping,
+	address_t start, address_t *base)
+{
+	address_t size;
+
+	/* Main area is always contiguous */
+	if (mapping == region->area) {
+		*base = start - mapping->data.mem.start;
+		return true;
+	}
+
+	/* Fold mirror and make sure page does not wrap around region */
+	size = MEM_SIZE(region->area);
+	*base = (start - mapping->data.mem.start) % size;
+	return (*base + MEM_PAGE_MASK < size);
+}
+
+void resolve_read(struct page *page, struct page_entry *entry, int op,
+	int bus_id)
+{
+	struct resource *mapping;
+	struct region *r;
+	address_t start;
+	address_t end;
+	int coverage;
+	int i;
+	int j;
+
+	/* Consider page as complex until proven otherwise */
+	entry->region = NULL;
+	start = (page - page_tables[bus_id]) << MEM_PAGE_SHIFT;
+	end = start + MEM_PAGE_MASK;
+
+	/* Find first region (and first mapping) overlapping page */
+	for (i = 0; i < page->num_regions; i++) {
+		r = page->regions[i];
+		if (!has_op(r, op))
+			continue;
+
+		/* Parse main area first and then mirrors (as reads do) */
+		for (j = -1; j < r->area->num_children; j++) {
+			mapping = (j < 0) ? r->area : &r->area->children[j];
+			coverage = get_coverage(mapping, bus_id, start, end);
+			if (coverage == COVERAGE_NONE)
+				continue;
+
+			/* Resolve page only if mapping covers it entirely */
+			if ((coverage == COVERAGE_FULL) &&
+				get_base(r, mapping, start, &entry->base))
+				entry->region = r;
+			return;
+		}
+	}
+}
+
+void resolve_write(struct page *page, struct page_entry *entry, int op,
+	int bus_id)
+{
+	struct resource *mapping;
+	struct region *r;
+	address_t start;
+	address_t end;
+	int coverage;
+	int num;
+	int i;
+	int j;
+
+	/* Consider page as complex until proven otherwise */
+	entry->region = NULL;
+	start = (page - page_tables[bus_id]) << MEM_PAGE_SHIFT;
+	end = start + MEM_PAGE_MASK;
+
+	/* Writes reach every mapping so exactly one has to cover the page */
+	num = 0;
+	for (i = 0; i < page->num_regions; i++) {
+		r = page->regions[i];
+		if (!has_op(r, op))
+			continue;
+
+		for (j = -1; j < r->area->num_children; j++) {
+			mapping = (j < 0) ? r->area : &r->area->children[j];
+			coverage = get_coverage(mapping, bus_id, start, end);
+			if (coverage == COVERAGE_NONE)
+				continue;
+
+			/* Bail out on partial coverage or multiple mappings */
+			if ((coverage == COVERAGE_PARTIAL) ||
+				(++num > 1) ||
+				!get_base(r, mapping, start, &entry->base)) {
+				entry->region = NULL;
+				return;
+			}
+			entry->region = r;
+		}
+	}
+}
+
+void resolve_mem(struct page_entry *entry, bool write)
+{
+	struct region *r = entry->region;
+	uint8_t *mem;
+	bool writable;
+
+	/* Access host memory directly if resolved region publishes it (regions
+	owned by a clock need to catch it up first and are never mapped) */
+	entry->mem = NULL;
+	if (!r || !r->mops->map || r->clock)
+		return;
+	writable = false;
+	mem = r->mops->map(r->data, entry->base, &writable);
+	if (!write || writable)
+		entry->mem = mem;
+}
+
+void update_page(int bus_id, int index)
+{
+	struct page *page = &page_tables[bus_id][index];
+	struct resource *mapping;
+	struct region *r;
+	address_t start;
+	address_t end;
+	int i;
+	int j;
+
+	/* Get page boundaries */
+	start = index << MEM_PAGE_SHIFT;
+	end = start + MEM_PAGE_MASK;
+
+	/* Build list of regions overlapping page (keeping precedence) */
+	page->num_regions = 0;
+	for (i = 0; i < num_regions; i++) {
+		r = regions[i];
+		for (j = -1; j < r->area->num_children; j++) {
+			mapping = (j < 0) ? r->area : &r->area->children[j];
+			if (get_coverage(mapping, bus_id, start, end) ==
+				COVERAGE_NONE)
+				continue;
+			page->regions = realloc(page->regions,
+				++page->num_regions * sizeof(struct region *));
+			page->regions[page->num_regions - 1] = r;
+			break;
+		}
+	}
+
+	/* Resolve page for each operation */
+	resolve_read(page, &page->readb, OP_READB, bus_id);
+	resolve_read(page, &page->readw, OP_READW, bus_id);
+	resolve_read(page, &page->readl, OP_READL, bus_id);
+	resolve_write(page, &page->writeb, OP_WRITEB, bus_id);
+	resolve_write(page, &page->writew, OP_WRITEW, bus_id);
+	resolve_write(page, &page->writel, OP_WRITEL, bus_id);
+
+	/* Publish host memory for plain memory pages */
+	resolve_mem(&page->readb, false);
+	resolve_mem(&page->readw, false);
+	resolve_mem(&page->readl, false);
+	resolve_mem(&page->writeb, true);
+	resolve_mem(&page->writew, true);
+	resolve_mem(&page->writel, true);
+}
+
+void update_pages(struct region *region)
+{
+	struct resource *mapping;
+	address_t end;
+	int bus_id;
+	int i;
+	int j;
+
+	/* Parse region area and mirrors */
+	for (j = -1; j < region->area->num_children; j++) {
+		mapping = (j < 0) ? region->area : &region->area->children[j];
+		bus_id = mapping->data.mem.bus_id;
+
+		/* Skip mapping if it lies beyond paged address space */
+		if (mapping->data.mem.start >= (MEM_NUM_PAGES << MEM_PAGE_SHIFT))
+			continue;
+
+		/* Grow page tables array if needed */
+		if (bus_id >= num_page_tables) {
+			page_tables = realloc(page_tables,
+				(bus_id + 1) * sizeof(struct page *));
+			for (i = num_page_tables; i <= bus_id; i++)
+				page_tables[i] = NULL;
+			num_page_tables = bus_id + 1;
+		}
+
+		/* Allocate bus page table if needed */
+		if (!page_tables[bus_id])
+			page_tables[bus_id] = calloc(MEM_NUM_PAGES,
+				sizeof(struct page));
+
+		/* Update all pages overlapped by mapping */
+		end = mapping->data.mem.end;
+		if (end >= (MEM_NUM_PAGES << MEM_PAGE_SHIFT))
+			end = (MEM_NUM_PAGES << MEM_PAGE_SHIFT) - 1;
+		for (i = mapping->data.mem.start >> MEM_PAGE_SHIFT;
+			i <= (int)(end >> MEM_PAGE_SHIFT);
+			i++)
+			update_page(bus_id, i);
+	}
+
+	/* Let users of host memory know that mapping changed */
+	memory_map_generation++;
+}
+
 void memory_region_add(struct region *region)
 {
 	/* Grow memory regions array */
@@ -109,6 +539,14 @@ void memory_region_add(struct region *region)
 
 	/* Insert region before others (it will take precedence on read ops) */
 	regions[0] = region;
+
+#ifdef CONFIG_PROFILE
+	/* Clear region statistics */
+	region->num_calls = 0;
+#endif
+
+	/* Update page tables */
+	update_pages(region);
 }
 
 void memory_region_remove(struct region *region)
@@ -119,6 +557,7 @@ void memory_region_remove(struct region *region)
 	if ((num_regions > 0) && (region == regions[num_regions - 1])) {
 		regions = realloc(regions,
 			--num_regions * sizeof(struct region *));
+		update_pages(region);
 		return;
 	}
 
@@ -127,18 +566,85 @@ void memory_region_remove(struct region *region)
 		if (regions[i] == region) {
 			memmove(&regions[i],
 				&regions[i + 1],
-				(num_regions - i) * sizeof(struct region *));
+				(num_regions - i - 1) * sizeof(struct region *));
 			regions = realloc(regions,
 				--num_regions * sizeof(struct region *));
 		}
+
+	/* Update page tables */
+	update_pages(region);
+}
+
+void remap_entry(struct page_entry *entry, struct region *region, bool write)
+{
+	/* Refresh host memory only if entry resolves to region */
+	if (entry->region == region)
+		resolve_mem(entry, write);
+}
+
+void memory_region_remap(struct region *region)
+{
+	struct resource *mapping;
+	struct page *page;
+	address_t end;
+	int bus_id;
+	int i;
+	int j;
+
+	/* Parse region area and mirrors */
+	for (j = -1; j < region->area->num_children; j++) {
+		mapping = (j < 0) ? region->area : &region->area->children[j];
+		bus_id = mapping->data.mem.bus_id;
+
+		/* Skip mapping if it is not covered by page tables */
+		if ((bus_id >= num_page_tables) ||
+			!page_tables[bus_id] ||
+			(mapping->data.mem.start >=
+			(MEM_NUM_PAGES << MEM_PAGE_SHIFT)))
+			continue;
+
+		/* Refresh host memory of all pages overlapped by mapping */
+		end = mapping->data.mem.end;
+		if (end >= (MEM_NUM_PAGES << MEM_PAGE_SHIFT))
+			end = (MEM_NUM_PAGES << MEM_PAGE_SHIFT) - 1;
+		for (i = mapping->data.mem.start >> MEM_PAGE_SHIFT;
+			i <= (int)(end >> MEM_PAGE_SHIFT);
+			i++) {
+			page = &page_tables[bus_id][i];
+			remap_entry(&page->readb, region, false);
+			remap_entry(&page->readw, region, false);
+			remap_entry(&page->readl, region, false);
+			remap_entry(&page->writeb, region, true);
+			remap_entry(&page->writew, region, true);
+			remap_entry(&page->writel, region, true);
+		}
+	}
+
+	/* Let users of host memory know that mapping changed */
+	memory_map_generation++;
 }
 
 void memory_region_remove_all()
 {
+	int i;
+	int j;
+
 	/* Free all regions */
 	free(regions);
 	regions = NULL;
 	num_regions = 0;
+
+	/* Free all page tables */
+	for (i = 0; i < num_page_tables; i++) {
+		if (!page_tables[i])
+			continue;
+		for (j = 0; j < MEM_NUM_PAGES; j++)
+			free(page_tables[i][j].regions);
+		free(page_tables[i]);
+	}
+	free(page_tables);
+	page_tables = NULL;
+	num_page_tables = 0;
 }
 
 void dma_channel_add(struct dma_channel *channel)
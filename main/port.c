@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <log.h>
+#include <memory.h>
 #include <port.h>
 
 #define NUM_PORTS 256
@@ -10,10 +11,29 @@
 static void insert_region(struct port_region *r, struct resource *a);
 static void remove_region(struct port_region *r, struct resource *a);
 static bool fixup_port(struct port_region *region, port_t *port);
+static void update_port(int port);
+
+struct read_entry {
+	read_t read;
+	port_stable_t stable;
+	port_data_t *data;
+	struct clock *clock;
+	port_t port;
+};
+
+struct write_entry {
+	write_t write;
+	write_bulk_t write_bulk;
+	port_data_t *data;
+	struct clock *clock;
+	port_t port;
+};
 
 static struct list_link *port_regions;
 static struct list_link **read_map;
 static struct list_link **write_map;
+static struct read_entry read_table[NUM_PORTS];
+static struct write_entry write_table[NUM_PORTS];
 
 void insert_region(struct port_region *r, struct resource *a)
 {
@@ -27,6 +47,7 @@ void insert_region(struct port_region *r, struct resource *a)
 			list_insert_before(&read_map[i], r);
 		if (r->pops->write)
 			list_insert_before(&write_map[i], r);
+		update_port(i);
 	}
 }
 
@@ -40,6 +61,46 @@ void remove_region(struct port_region *r, struct resource *a)
 	for (i = start; i <= end; i++) {
 		list_remove(&read_map[i], r);
 		list_remove(&write_map[i], r);
+		update_port(i);
+	}
+}
+
+void update_port(int port)
+{
+	struct list_link *link;
+	struct port_region *region;
+	port_t p;
+
+	/* Clear table entries */
+	memset(&read_table[port], 0, sizeof(struct read_entry));
+	memset(&write_table[port], 0, sizeof(struct write_entry));
+
+	/* Fill read entry with first region found (and its adapted port) */
+	link = read_map[port];
+	region = list_get_next(&link);
+	p = port;
+	if (region && fixup_port(region, &p)) {
+		read_table[port].read = region->pops->read;
+		read_table[port].stable = region->pops->stable;
+		read_table[port].data = region->data;
+		read_table[port].clock = region->clock;
+		read_table[port].port = p;
+	} else if (region) {
+		LOG_E("Port %02x fixup failed!\n", port);
+	}
+
+	/* Fill write entry with first region found (and its adapted port) */
+	link = write_map[port];
+	region = list_get_next(&link);
+	p = port;
+	if (region && fixup_port(region, &p)) {
+		write_table[port].write = region->pops->write;
+		write_table[port].write_bulk = region->pops->write_bulk;
+		write_table[port].data = region->data;
+		write_table[port].clock = region->clock;
+		write_table[port].port = p;
+	} else if (region) {
+		LOG_E("Port %02x fixup failed!\n", port);
 	}
 }
 
@@ -93,11 +154,13 @@ void port_region_remove_all()
 	/* Remove all regions */
 	list_remove_all(&port_regions);
 
-	/* Free maps */
+	/* Free maps and clear tables */
 	free(read_map);
 	free(write_map);
 	read_map = NULL;
 	write_map = NULL;
+	memset(read_table, 0, sizeof(read_table));
+	memset(write_table, 0, sizeof(write_table));
 }
 
 bool fixup_port(struct port_region *region, port_t *port)
@@ -131,45 +194,63 @@ bool fixup_port(struct port_region *region, port_t *port)
 
 uint8_t port_read(port_t port)
 {
-	struct list_link *link = read_map[port];
-	struct port_region *region;
+	struct read_entry *entry = &read_table[port];
 
-	/* Get region */
-	region = list_get_next(&link);
-	if (!region) {
+	/* Check entry (warning is a side effect) */
+	if (!entry->read) {
+		memory_num_updates++;
 		LOG_W("Port region not found (read %02x)!\n", port);
 		return 0;
 	}
 
-	/* Adapt port */
-	if (!fixup_port(region, &port)) {
-		LOG_E("Port %02x fixup failed!\n", port);
-		return 0;
-	}
+	/* Catch up clock owning region if needed */
+	if (entry->clock)
+		clock_catch_up(entry->clock);
+
+	/* Count reads which might change state (see memory_num_updates) */
+	if (!entry->stable || !entry->stable(entry->data, entry->port))
+		memory_num_updates++;
 
 	/* Call port operation */
-	return region->pops->read(region->data, port);
+	return entry->read(entry->data, entry->port);
 }
 
 void port_write(uint8_t b, port_t port)
 {
-	struct list_link *link = write_map[port];
-	struct port_region *region;
+	struct write_entry *entry = &write_table[port];
 
-	/* Get region */
-	region = list_get_next(&link);
-	if (!region) {
+	/* Let users know that machine state might have changed */
+	memory_num_updates++;
+
+	/* Check entry */
+	if (!entry->write) {
 		LOG_W("Port region not found (write %02x)!\n", port);
 		return;
 	}
 
-	/* Adapt port */
-	if (!fixup_port(region, &port)) {
-		LOG_E("Port %04x fixup failed!\n", port);
-		return;
-	}
+	/* Catch up clock owning region if needed */
+	if (entry->clock)
+		clock_catch_up(entry->clock);
+	clock_catch_up_watchers();
 
 	/* Call port operation */
-	region->pops->write(region->data, b, port);
+	entry->write(entry->data, b, entry->port);
 }
 
+bool port_write_bulk(uint8_t *buf, int count, port_t port)
+{
+	struct write_entry *entry = &write_table[port];
+
+	/* Leave bytes to port_write if region has no bulk operation or if its
+	clock would need to catch up before each byte */
+	if (!entry->write_bulk || entry->clock)
+		return false;
+
+	/* Let users know that machine state might have changed */
+	memory_num_updates++;
+	clock_catch_up_watchers();
+
+	/* Call bulk port operation */
+	entry->write_bulk(entry->data, buf, count, entry->port);
+	return true;
+}
@@ -0,0 +1,110 @@
+#include <inttypes.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <clock.h>
+#include <log.h>
+#include <memory.h>
+#include <profile.h>
+#include <util.h>
+
+#define NS(s) ((s) * 1000000000)
+
+static void report_clocks();
+static void report_regions();
+static void request_report(int sig);
+
+char *profile_owner;
+static volatile sig_atomic_t report_requested;
+
+uint64_t profile_get_time()
+{
+	struct timespec now;
+
+	/* Return monotonic time (in ns) */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return NS((uint64_t)now.tv_sec) + now.tv_nsec;
+}
+
+void report_clocks()
+{
+	struct clock *clock;
+	uint64_t total_ns = 0;
+	int i;
+
+	/* Get total time spent ticking clocks */
+	for (i = 0; i < num_clocks; i++)
+		total_ns += clocks[i]->num_ns;
+
+	/* Print statistics for each clock */
+	LOG_I("Profile: %-16s %12s %10s %14s %12s %6s\n",
+		"clock",
+		"rate (Hz)",
+		"ticks",
+		"cycles",
+		"time (us)",
+		"%");
+	for (i = 0; i < num_clocks; i++) {
+		clock = clocks[i];
+		LOG_I("Profile: %-16s %12.0f %10" PRIu64 " %14" PRIu64
+			" %12" PRIu64 " %6.2f\n",
+			clock->name ? clock->name : "?",
+			clock->rate,
+			clock->num_ticks,
+			clock->num_cycles,
+			clock->num_ns / 1000,
+			total_ns ? 100.0 * clock->num_ns / total_ns : 0.0);
+	}
+}
+
+void report_regions()
+{
+	struct region *region;
+	int i;
+
+	/* Print operation count for each region not backed by host memory */
+	LOG_I("Profile: %-16s %4s %21s %14s\n",
+		"region",
+		"bus",
+		"area",
+		"calls");
+	for (i = 0; i < num_regions; i++) {
+		region = regions[i];
+		if (region->num_calls == 0)
+			continue;
+		LOG_I("Profile: %-16s %4d %10" PRIx32 "-%-10" PRIx32 " %14"
+			PRIu64 "\n",
+			region->area->name ? region->area->name : "?",
+			region->area->data.mem.bus_id,
+			region->area->data.mem.start,
+			region->area->data.mem.end,
+			region->num_calls);
+	}
+}
+
+void profile_check()
+{
+	/* Report statistics once requested from signal handler */
+	if (report_requested) {
+		report_requested = 0;
+		profile_report();
+	}
+}
+
+void profile_report()
+{
+	report_clocks();
+	report_regions();
+}
+
+void request_report(int UNUSED(sig))
+{
+	/* Defer report to emulation loop (not async-signal-safe) */
+	report_requested = 1;
+}
+
+INITIALIZER(profile_init)
+{
+	/* Report statistics on demand (kill -USR1 <pid>) */
+	signal(SIGUSR1, request_report);
+}
@@ -0,0 +1,206 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <cmdline.h>
+#include <log.h>
+#include <trace.h>
+
+#define NS(s) ((s) * 1000000000)
+
+struct trace_entry {
+	const char *name;
+	uint64_t time;
+	char phase;
+};
+
+struct trace_buffer {
+	struct trace_entry *entries;
+	uint64_t head;
+	int tid;
+	struct trace_buffer *next;
+};
+
+static uint64_t get_time();
+static struct trace_buffer *get_buffer();
+static int dump_buffer(FILE *f, struct trace_buffer *buffer, int num_events);
+
+static char *trace_file;
+PARAM(trace_file, string, "trace", NULL, "Records a timeline trace (JSON)")
+static int trace_size = 1048576;
+PARAM(trace_size, int, "trace-size", NULL, "Sets trace events kept per thread")
+
+bool trace_enabled;
+static struct trace_buffer *buffers;
+static int num_buffers;
+static __thread struct trace_buffer *thread_buffer;
+static uint64_t start_time;
+
+uint64_t get_time()
+{
+	struct timespec now;
+
+	/* Return monotonic time (in ns) */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return NS((uint64_t)now.tv_sec) + now.tv_nsec;
+}
+
+struct trace_buffer *get_buffer()
+{
+	struct trace_buffer *buffer;
+
+	/* Allocate ring buffer owned by calling thread */
+	buffer = calloc(1, sizeof(struct trace_buffer));
+	if (!buffer)
+		return NULL;
+	buffer->entries = malloc(trace_size * sizeof(struct trace_entry));
+	if (!buffer->entries) {
+		free(buffer);
+		return NULL;
+	}
+	buffer->tid = __atomic_add_fetch(&num_buffers, 1, __ATOMIC_RELAXED);
+
+	/* Push buffer to global list without locking */
+	buffer->next = __atomic_load_n(&buffers, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&buffers,
+		&buffer->next,
+		buffer,
+		true,
+		__ATOMIC_RELEASE,
+		__ATOMIC_RELAXED));
+
+	/* Save buffer for next events of this thread */
+	thread_buffer = buffer;
+	return buffer;
+}
+
+void trace_event(const char *name, char phase)
+{
+	struct trace_buffer *buffer = thread_buffer;
+	struct trace_entry *entry;
+
+	/* Get buffer of calling thread (registering it if needed) */
+	if (!buffer && !(buffer = get_buffer()))
+		return;
+
+	/* Fill next entry (overwriting oldest one once buffer is full) */
+	entry = &buffer->entries[buffer->head % trace_size];
+	entry->name = name;
+	entry->time = get_time();
+	entry->phase = phase;
+
+	/* Publish entry (only the owning thread ever writes its buffer) */
+	__atomic_store_n(&buffer->head, buffer->head + 1, __ATOMIC_RELEASE);
+}
+
+int dump_buffer(FILE *f, struct trace_buffer *buffer, int num_events)
+{
+	struct trace_entry *entry;
+	uint64_t head;
+	uint64_t i;
+	int depth = 0;
+	int async_depth = 0;
+
+	/* Get published entries still held by ring buffer */
+	head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+	i = (head > (uint64_t)trace_size) ? head - trace_size : 0;
+
+	/* Write entries as trace events */
+	for (; i < head; i++) {
+		entry = &buffer->entries[i % trace_size];
+
+		/* Skip zone ends whose beginning got overwritten */
+		switch (entry->phase) {
+		case 'B':
+			depth++;
+			break;
+		case 'E':
+			if (depth == 0)
+				continue;
+			depth--;
+			break;
+		case 'b':
+			async_depth++;
+			break;
+		case 'e':
+			if (async_depth == 0)
+				continue;
+			async_depth--;
+			break;
+		}
+
+		/* Async events also need a category and an identifier */
+		fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,"
+			"\"pid\":1,\"tid\":%d",
+			(num_events > 0) ? ",\n" : "",
+			entry->name,
+			entry->phase,
+			(entry->time - start_time) / 1000.0,
+			buffer->tid);
+		if ((entry->phase == 'b') || (entry->phase == 'e'))
+			fprintf(f, ",\"cat\":\"async\",\"id\":%d", buffer->tid);
+		fprintf(f, "}");
+		num_events++;
+	}
+
+	return num_events;
+}
+
+bool trace_init()
+{
+	/* Leave tracing disabled if not requested */
+	if (!trace_file)
+		return true;
+
+	/* Validate buffer size */
+	if (trace_size <= 0) {
+		LOG_E("Trace size should be positive!\n");
+		return false;
+	}
+
+	/* Save start time and enable event recording */
+	start_time = get_time();
+	trace_enabled = true;
+	return true;
+}
+
+void trace_dump()
+{
+	struct trace_buffer *buffer;
+	struct trace_buffer *next;
+	FILE *f;
+	int num_events = 0;
+
+	/* Leave already if tracing is disabled */
+	if (!trace_enabled)
+		return;
+
+	/* Stop recording events */
+	trace_enabled = false;
+
+	/* Write all thread buffers in Chrome trace event format */
+	f = fopen(trace_file, "w");
+	if (f) {
+		fprintf(f, "{\"traceEvents\":[\n");
+		for (buffer = buffers; buffer; buffer = buffer->next)
+			num_events = dump_buffer(f, buffer, num_events);
+		fprintf(f, "\n]}\n");
+		fclose(f);
+		LOG_I("Trace written to %s (%d events).\n",
+			trace_file,
+			num_events);
+	} else {
+		LOG_E("Could not open trace file \"%s\"!\n", trace_file);
+	}
+
+	/* Free buffers */
+	for (buffer = buffers; buffer; buffer = next) {
+		next = buffer->next;
+		free(buffer->entries);
+		free(buffer);
+	}
+	buffers = NULL;
+	thread_buffer = NULL;
+}
+
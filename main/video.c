@@ -1,9 +1,11 @@
 #include <stdio.h>
 #include <string.h>
+#include <clock.h>
 #include <cmdline.h>
 #include <input.h>
 #include <list.h>
 #include <log.h>
+#include <trace.h>
 #include <video.h>
 
 /* Command-line parameters */
@@ -79,14 +81,25 @@ void video_update()
 	/* Set updated state */
 	updated = true;
 
+	/* Bring lazy devices (audio output for instance) up to frame end */
+	clock_catch_up_all();
+
 	if (!frontend)
 		return;
 
-	if (frontend->update)
+	TRACE_BEGIN("video_update");
+
+	/* Present frame */
+	if (frontend->update) {
+		TRACE_BEGIN("present");
 		frontend->update(frontend);
+		TRACE_END("present");
+	}
 
 	/* Update input sub-system as well */
 	input_update();
+
+	TRACE_END("video_update");
 }
 
 bool video_updated()